@@ -0,0 +1,215 @@
+#!/bin/bash
+# End-to-end scan benchmarks against the mports-sim target simulator.
+#
+# Usage: sudo ./benchmark.sh [--save-baseline] [scenario ...]
+#
+# Scenarios: common, full, sweep, lossy, and connect and connfull, which run
+# common and full as connect() scans (default: all).  Each result is appended
+# to bench/results.csv and compared against bench/baseline.csv; the script
+# exits with 1 if any scenario regressed.
+#
+# Environment:
+#   BENCH_TOLERANCE      Allowed relative wall time / pps change (default 0.2)
+#   BENCH_ACC_TOLERANCE  Allowed accuracy drop (default 0.05)
+#   BENCH_SWEEP_HOSTS    Hosts scanned by the sweep scenario (default 16)
+
+cd "$(dirname "$0")"
+
+BENCH_DIR=bench
+RESULTS=$BENCH_DIR/results.csv
+BASELINE=$BENCH_DIR/baseline.csv
+TOLERANCE=${BENCH_TOLERANCE:-0.2}
+ACC_TOLERANCE=${BENCH_ACC_TOLERANCE:-0.05}
+SWEEP_HOSTS=${BENCH_SWEEP_HOSTS:-16}
+
+# Roadmap goal for a full port scan
+FULL_SCAN_GOAL_S=120
+
+COMMON_PORTS_LEN=54
+NS=mports-sim
+HEADER="scenario,hosts,probes,wall_s,pps,cpu_s,max_rss_kb,expected_open,\
+found_open,false_open,accuracy"
+
+SAVE_BASELINE=0
+SCENARIOS=()
+
+for arg in "$@"; do
+    case $arg in
+        --save-baseline) SAVE_BASELINE=1 ;;
+        common|full|sweep|lossy|connect|connfull) SCENARIOS+=("$arg") ;;
+        *) echo "usage: $0 [--save-baseline]" \
+               "[common|full|sweep|lossy|connect|connfull ...]"
+           exit 2 ;;
+    esac
+done
+
+if [ ${#SCENARIOS[@]} -eq 0 ]; then
+    SCENARIOS=(common full sweep lossy connect connfull)
+fi
+
+if [ "$(id -u)" -ne 0 ]; then
+    echo "ERROR: benchmarks must be run as root!" >&2
+    exit 2
+fi
+
+./compile.sh || exit 2
+
+mkdir -p $BENCH_DIR
+TMP_DIR=$(mktemp -d)
+RUN_FILE=$TMP_DIR/run.csv
+
+tools/setup_sim_netns.sh down
+tools/setup_sim_netns.sh up || exit 2
+trap 'pkill -INT -x mports-sim; tools/setup_sim_netns.sh down; \
+    rm -rf $TMP_DIR' EXIT
+
+# start_sim <simulator args...>
+start_sim() {
+    pkill -INT -x mports-sim
+    ip netns exec $NS ./mports-sim -dev sim1 -seed 1 "$@" \
+        > $TMP_DIR/sim.log 2>&1 &
+    sleep 0.5
+}
+
+# run_scenario <name> <mports args> <expected open ports> <ip ...>
+run_scenario() {
+    local name=$1 scan_args=$2 expected=$3
+    shift 3
+
+    local probes_per_host=$COMMON_PORTS_LEN
+    [[ $scan_args == *-f* ]] && probes_per_host=65535
+
+    local hosts=0 found=0 false_open=0 max_rss=0 expected_total=0
+    local cpu_ticks=0 wall_start wall_end
+    wall_start=$(date +%s.%N)
+
+    for ip in "$@"; do
+        ./mports -ip "$ip" -dev sim0 $scan_args > $TMP_DIR/scan.log 2>&1 &
+        local pid=$! rss ticks host_ticks=0
+
+        # Peak RSS and CPU time are sampled until the scanner exits, which
+        # misses at most the last 50 ms of (idle drain) CPU time
+        while kill -0 $pid 2> /dev/null; do
+            rss=$(awk '/VmHWM/ { print $2 }' /proc/$pid/status 2> /dev/null)
+            [ -n "$rss" ] && [ "$rss" -gt "$max_rss" ] && max_rss=$rss
+            ticks=$(awk '{ print $14 + $15 }' /proc/$pid/stat 2> /dev/null)
+            [ -n "$ticks" ] && host_ticks=$ticks
+            sleep 0.05
+        done
+
+        wait $pid
+        cpu_ticks=$((cpu_ticks + host_ticks))
+
+        local open port
+        open=$(sed -n 's/^Port: \([0-9]*\)$/\1/p' $TMP_DIR/scan.log)
+
+        for port in $open; do
+            if [[ " $expected " == *" $port "* ]]; then
+                found=$((found + 1))
+            else
+                false_open=$((false_open + 1))
+            fi
+        done
+
+        hosts=$((hosts + 1))
+        expected_total=$((expected_total + $(wc -w <<< "$expected")))
+    done
+
+    wall_end=$(date +%s.%N)
+
+    awk -v name="$name" -v hosts=$hosts -v probes=$((hosts * probes_per_host)) \
+        -v wall_start="$wall_start" -v wall_end="$wall_end" \
+        -v cpu_ticks=$cpu_ticks -v clk_tck="$(getconf CLK_TCK)" -v rss=$max_rss \
+        -v expected=$expected_total -v found=$found -v false_open=$false_open \
+        'BEGIN {
+            wall = wall_end - wall_start
+            printf "%s,%d,%d,%.3f,%.1f,%.3f,%d,%d,%d,%d,%.4f\n", name, hosts,
+                probes, wall, probes / wall, cpu_ticks / clk_tck, rss,
+                expected, found, false_open,
+                expected ? found / expected : 1
+        }' >> $RUN_FILE
+}
+
+for scenario in "${SCENARIOS[@]}"; do
+    echo "Running scenario: $scenario"
+
+    case $scenario in
+        common)
+            start_sim -host 10.200.1.0/24 -open 22,80,443,3306
+            run_scenario common "" "22 80 443 3306" 10.200.1.5
+            ;;
+        full)
+            start_sim -host 10.200.1.0/24 -open 22,80,443,8080,31337,65000
+            run_scenario full "-f" "22 80 443 8080 31337 65000" 10.200.1.5
+            ;;
+        sweep)
+            # A /24 is swept one host at a time, limited to SWEEP_HOSTS
+            start_sim -host 10.200.1.0/24 -open 22,80,443
+            hosts=()
+            for i in $(seq 1 "$SWEEP_HOSTS"); do
+                hosts+=("10.200.1.$i")
+            done
+            run_scenario sweep "" "22 80 443" "${hosts[@]}"
+            ;;
+        lossy)
+            start_sim -host 10.200.1.0/24 -open 22,80,443,3306 \
+                -rtt 10 -jitter 5 -loss 0.05 -retrans 2
+            run_scenario lossy "" "22 80 443 3306" 10.200.1.5
+            ;;
+        connect)
+            # The host's kernel makes the connections through sim0
+            start_sim -host 10.200.1.0/24 -open 22,80,443,3306
+            run_scenario connect "--connect" "22 80 443 3306" 10.200.1.5
+            ;;
+        connfull)
+            start_sim -host 10.200.1.0/24 -open 22,80,443,8080,31337,65000
+            run_scenario connfull "-f --connect" \
+                "22 80 443 8080 31337 65000" 10.200.1.5
+            ;;
+    esac
+done
+
+[ -f $RESULTS ] || echo "$HEADER" > $RESULTS
+cat $RUN_FILE >> $RESULTS
+
+echo
+(echo "$HEADER"; cat $RUN_FILE) | awk -F , '{
+    printf "%-8s %5s %8s %9s %9s %7s %10s %8s %6s %6s %8s\n", $1, $2, $3, $4,
+        $5, $6, $7, $8, $9, $10, $11 }'
+
+awk -F , -v goal=$FULL_SCAN_GOAL_S '$1 == "full" && $4 > goal {
+    printf "\nNOTE: full scan took %.1f s, goal is %d s\n", $4, goal }' $RUN_FILE
+
+if [ $SAVE_BASELINE -eq 1 ]; then
+    (echo "$HEADER"; cat $RUN_FILE) > $BASELINE
+    echo
+    echo "Saved baseline to $BASELINE"
+    exit 0
+fi
+
+if [ ! -f $BASELINE ]; then
+    echo
+    echo "No baseline found, run with --save-baseline to create one."
+    exit 0
+fi
+
+echo
+awk -F , -v tol=$TOLERANCE -v acc_tol=$ACC_TOLERANCE '
+    NR == FNR {
+        if (FNR > 1) { wall[$1] = $4; pps[$1] = $5; acc[$1] = $11 }
+        next
+    }
+    !($1 in wall) { printf "%-8s no baseline\n", $1; next }
+    {
+        status = "ok"
+        if ($4 > wall[$1] * (1 + tol)) status = "REGRESSION (wall time)"
+        if ($5 < pps[$1] * (1 - tol)) status = "REGRESSION (pps)"
+        if ($11 < acc[$1] - acc_tol) status = "REGRESSION (accuracy)"
+        if (status != "ok") failed = 1
+        printf "%-8s wall %.3f s (baseline %.3f s)  accuracy %.4f " \
+            "(baseline %.4f)  %s\n", $1, $4, wall[$1], $11, acc[$1], status
+    }
+    END { exit failed }' $BASELINE $RUN_FILE
+ret=$?
+
+exit $ret
@@ -1,2 +1,6 @@
-gcc mports.c ./services/network_helper.c ./services/packet_service.c ./services/arp_service.c ./services/process_service.c ./services/icmp_service.c ./services/scanning_service.c ./services/tcp_service.c ./services/checksum_service.c ./validators/ip_validator.c ./validators/mac_validator.c ./validators/validate_port.c -lm -o mports
+./tools/gen_top_ports.sh ./constants/tcp_port_ranks.txt ./constants/top_ports.h
 
+gcc mports.c ./services/network_helper.c ./services/packet_service.c ./services/arp_service.c ./services/ndp_service.c ./services/process_service.c ./services/icmp_service.c ./services/scanning_service.c ./services/tcp_service.c ./services/checksum_service.c ./services/ring_buffer.c ./services/checkpoint_service.c ./services/result_store.c ./services/result_query.c ./services/stats_service.c ./services/histogram_service.c ./services/transport_service.c ./services/pcap_service.c ./services/sim_service.c ./services/replay_service.c ./services/udp_service.c ./services/connect_service.c ./services/banner_service.c ./services/fingerprint_service.c ./services/handshake_service.c ./services/interval_set.c ./services/spec_service.c ./services/prefix_tree.c ./services/discovery_service.c ./services/route_service.c ./services/neighbor_cache.c ./validators/ip_validator.c ./validators/mac_validator.c ./validators/validate_port.c -lm -lpthread -o mports
+
+gcc ./tools/mports_sim.c ./services/sim_service.c ./services/checksum_service.c ./services/histogram_service.c -lm -o mports-sim
+gcc ./tools/mports_bench.c ./services/network_helper.c ./services/packet_service.c ./services/arp_service.c ./services/ndp_service.c ./services/process_service.c ./services/icmp_service.c ./services/scanning_service.c ./services/tcp_service.c ./services/checksum_service.c ./services/ring_buffer.c ./services/checkpoint_service.c ./services/result_store.c ./services/result_query.c ./services/stats_service.c ./services/histogram_service.c ./services/udp_service.c ./services/connect_service.c ./services/banner_service.c ./services/fingerprint_service.c ./services/handshake_service.c ./services/transport_service.c ./services/pcap_service.c ./services/sim_service.c ./services/interval_set.c ./services/prefix_tree.c -Wl,--wrap=malloc -Wl,--wrap=calloc -lm -lpthread -o mports-bench
@@ -11,5 +11,14 @@
 #define MAX_PORT 65535
 #define MAC_LEN 6
 #define IP_LEN 4
+#define IP6_LEN 16
 
-#define MAX_THREADS 16
\ No newline at end of file
+#define MAX_THREADS 16
+// Size of a CPU cache line, used to pad data shared between threads
+#define CACHE_LINE_SIZE 64
+
+// Port states recorded in the per-port state table
+#define PORT_STATE_UNKNOWN 0
+#define PORT_STATE_OPEN 1
+#define PORT_STATE_CLOSED 2
+#define PORT_STATE_FILTERED 3
@@ -0,0 +1,68 @@
+/*
+ * Generated by tools/gen_top_ports.sh from tcp_port_ranks.txt.
+ * Do not edit, edit the port list instead.
+ */
+#ifndef TOP_PORTS_H
+#define TOP_PORTS_H
+
+#define TOP_TCP_PORTS_LEN 54
+
+// TCP ports ordered by how likely they are to be open, most likely first
+static const unsigned short TOP_TCP_PORTS[TOP_TCP_PORTS_LEN] = {
+    80,         // http
+    443,        // https
+    22,         // ssh
+    21,         // ftp
+    23,         // telnet
+    25,         // smtp
+    3389,       // rdp
+    445,        // microsoft-ds
+    139,        // netbios-ssn
+    135,        // msrpc
+    53,         // dns
+    110,        // pop3
+    143,        // imap
+    8080,       // http-proxy
+    993,        // imaps
+    995,        // pop3s
+    3306,       // mysql
+    1025,       // ms-rpc
+    5432,       // postgresql
+    8000,       // http-alt
+    3128,       // squid-http
+    1080,       // socks
+    6379,       // redis
+    27017,      // mongodb
+    5060,       // sip
+    5061,       // sips
+    389,        // ldap
+    113,        // ident
+    179,        // bgp
+    554,        // rtsp
+    1720,       // h323
+    2082,       // cpanel
+    20,         // ftp-data
+    79,         // finger
+    88,         // kerberos
+    119,        // nntp
+    123,        // ntp
+    161,        // snmp
+    137,        // netbios-ns
+    138,        // netbios-dgm
+    9092,       // kafka
+    8200,       // vmware
+    8222,       // vmware
+    69,         // tftp
+    43,         // whois
+    49,         // tacacs
+    42,         // wins
+    102,        // iso-tsap
+    70,         // gopher
+    194,        // irc
+    6970,       // quicktime
+    201,        // appletalk
+    264,        // bgmp
+    19226       // adminsecure
+};
+
+#endif
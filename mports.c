@@ -2,6 +2,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
@@ -9,8 +10,26 @@
 #include "mports.h"
 #include "services/network_helper.h"
 #include "services/arp_service.h"
+#include "services/ndp_service.h"
 #include "services/icmp_service.h"
 #include "services/scanning_service.h"
+#include "services/checkpoint_service.h"
+#include "services/stats_service.h"
+#include "services/histogram_service.h"
+#include "services/result_store.h"
+#include "services/result_query.h"
+#include "services/replay_service.h"
+#include "services/transport_service.h"
+#include "services/udp_service.h"
+#include "services/banner_service.h"
+#include "services/fingerprint_service.h"
+#include "services/handshake_service.h"
+#include "services/spec_service.h"
+#include "services/prefix_tree.h"
+#include "services/discovery_service.h"
+#include "services/route_service.h"
+#include "services/neighbor_cache.h"
+#include "constants/top_ports.h"
 #include "validators/ip_validator.h"
 #include "constants/constants.h"
 
@@ -19,6 +38,16 @@
 #include "validators/validate_port.h"
 
 int main(int argc, const char *argv[]) {
+    // Subcommand for querying binary result files
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) {
+        return run_result_query(argc - 1, argv + 1) == 0 ? 0 : -1;
+    }
+
+    // Subcommand for benchmarking the reply path against a capture
+    if (argc >= 2 && strcmp(argv[1], "replay") == 0) {
+        return run_replay(argc - 1, argv + 1) == 0 ? 0 : -1;
+    }
+
     struct input_args *args = parse_input_args(argc, argv);
 
     if (args == NULL) {
@@ -27,29 +56,361 @@ int main(int argc, const char *argv[]) {
 
     printf("Matt's Port Scanner v%s\n\n", VERSION);
 
-    const unsigned char full_scan = !(args->simp_scan);
-    const struct in_addr *dest_ip = args->tar_ip;
-    const unsigned short start_prt = args->start_port;
-    const unsigned short end_prt = args->end_port;
-    const char *dev_name = args->dev_name;
-    
-    const unsigned char *mac_dest;                // Destination MAC address
-    int loc_int_index;                            // Local interface index
-    const unsigned char *loc_mac_add;             // Local MAC address
-    const struct in_addr *loc_ip_add;             // Local IP address
+    if (args->transport_spec != NULL && 
+            transport_configure(args->transport_spec) < 0) {
+        return -1;
+    }
+
+    // Probes of a dry run only go to the pcap file
+    if (args->dry_run_path != NULL) {
+        char *spec = malloc(strlen(args->dry_run_path) + strlen("pcap:") + 1);
+
+        if (spec == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return -1;
+        }
+
+        sprintf(spec, "pcap:%s", args->dry_run_path);
+
+        int ret = transport_configure(spec);
+        free(spec);
+
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    // Must be enabled before the scan state is created
+    if (args->show_timings || args->timings_path != NULL) {
+        enable_timings();
+    }
+
+    // On a real network IPv4 targets are scanned through the interface they
+    // are routed out of, or only through -dev
+    enum transport_kind kind = transport_get_kind();
+
+    if (args->tar_ip6 == NULL && !args->connect_scan && 
+            args->dry_run_path == NULL && 
+            (kind == TRANSPORT_RAW || kind == TRANSPORT_RING)) {
+        args->routes = malloc(sizeof(struct route_table));
+
+        if (args->routes == NULL || 
+                load_route_table(args->routes, args->dev_name) < 0) {
+            return -1;
+        }
+
+        // Repeat scans start from the MAC addresses earlier runs resolved
+        if (args->neighbor_cache_path != NULL) {
+            args->routes->neighbors = neighbor_cache_open(
+                    args->neighbor_cache_path);
+
+            if (args->routes->neighbors == NULL) {
+                return -1;
+            }
+        }
+    }
+
+    // Fingerprints are loaded up front so a bad file fails before the scan
+    struct fingerprint_matcher *matcher = NULL;
+
+    if (args->grab_banners) {
+        matcher = make_fingerprint_matcher(args->fingerprints_path);
+
+        if (matcher == NULL) {
+            return -1;
+        }
+    }
+
+    struct scan_state *resumed = NULL;
+
+    // The checkpoint decides the target and ports of a resumed scan
+    if (args->resume_path != NULL) {
+        resumed = load_checkpoint(args->resume_path, &args->targets, 
+                TOP_TCP_PORTS_LEN);
+
+        if (resumed == NULL) {
+            return -1;
+        }
+
+        // The targets after the resumed one are checkpointed to the same file
+        if (args->checkpoint_path == NULL) {
+            args->checkpoint_path = args->resume_path;
+        }
+
+        args->simp_scan = !(resumed->full_scan);
+
+        // The ports of a top ports scan are a prefix of the table
+        if (!resumed->full_scan) {
+            args->top_ports = resumed->probes_len;
+        }
+
+        printf("Resuming scan at probe %u of %u\n\n", 
+                atomic_load(&resumed->cursor), resumed->probes_len);
+    }
+
+    unsigned short *ports_buff = NULL;
+    const unsigned short *ports = NULL;
+    int ports_len = get_scan_ports(args, &ports, &ports_buff);
+
+    if (ports_len < 0) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    struct result_writer *writer = NULL;
+
+    if (args->bin_output_path != NULL) {
+        writer = result_writer_open(args->bin_output_path);
+
+        if (writer == NULL) {
+            fprintf(stderr, "ERROR: Cannot write result file!\n");
+
+            return -1;
+        }
+    }
+
+    int ret = 0;
+
+    if (resumed != NULL && resumed->targets == NULL) {
+        ret = scan_target(args, resumed, NULL, ports, ports_len, matcher, 
+                writer);
+    } else if (args->tar_ip6 != NULL) {
+        ret = scan_target(args, create_target_state(args, 0), NULL, ports, 
+                ports_len, matcher, writer);
+    } else {
+        // The live targets are found by one sweep instead of resolving and
+        // pinging each in turn, unless nothing is sent to them or every 
+        // target is taken to be up
+        struct host_discovery disc;
+        unsigned char discover = !args->connect_scan && 
+                args->dry_run_path == NULL && !args->skip_discovery;
+
+        if (discover) {
+            ret = discover_hosts(&disc, &args->targets, 
+                    args->discovery_probes, args->discovery_rate, 
+                    args->routes, args->dev_name);
+        }
+
+        // UDP scans probe several live targets at once, as each one is 
+        // paced by its own ICMP rate limit.  The status line follows a 
+        // single target, so with it targets are scanned one at a time.
+        struct scan_state *udp_states[UDP_PARALLEL_HOSTS];
+        const unsigned char *udp_macs[UDP_PARALLEL_HOSTS];
+        int udp_len = 0;
+        const int udp_max = args->show_stats ? 1 : UDP_PARALLEL_HOSTS;
+
+        // Targets are scanned in address order, stopping at the first error 
+        // or interrupt.  A resumed list starts at the target of the 
+        // checkpoint, which resolves and pings its target again itself.
+        unsigned long long first = resumed != NULL ? resumed->target_index : 
+                0;
 
+        if (resumed != NULL) {
+            ret = scan_target(args, resumed, NULL, ports, ports_len, matcher, 
+                    writer);
+            first++;
+        }
+
+        for (unsigned long long i = first; ret == 0 && i < args->targets.size; 
+                i++) {
+            unsigned int tar_ip = htonl(interval_set_at(&args->targets, i));
+
+            if (discover && !discovery_is_live(&disc, i)) {
+                if (DEBUG >= 1) {
+                    printf("Target IP (%s) is down or not responding to "
+                            "pings\n", get_ip_32_str(tar_ip));
+                }
+
+                continue;
+            }
+
+            if (!args->udp_scan || !discover) {
+                ret = scan_target(args, create_target_state(args, tar_ip), 
+                        discover ? disc.macs[i] : NULL, ports, ports_len, 
+                        matcher, writer);
+
+                continue;
+            }
+
+            udp_states[udp_len] = create_target_state(args, tar_ip);
+            udp_macs[udp_len++] = disc.macs[i];
+
+            if (udp_len == udp_max) {
+                ret = scan_udp_targets(args, udp_states, udp_macs, udp_len, 
+                        ports, ports_len, writer);
+                udp_len = 0;
+            }
+        }
+
+        if (udp_len > 0) {
+            ret = scan_udp_targets(args, udp_states, udp_macs, udp_len, 
+                    ports, ports_len, writer);
+        }
+
+        if (discover) {
+            free_discovery(&disc);
+        }
+
+        // Targets after the last live one never moved the checkpoint on
+        if (ret == 0 && args->checkpoint_path != NULL) {
+            unlink(args->checkpoint_path);
+        }
+    }
+
+    free_fingerprints(matcher);
+    free(ports_buff);
+
+    if (writer != NULL && result_writer_close(writer) < 0) {
+        fprintf(stderr, "ERROR: Cannot write result file!\n");
+
+        ret = -1;
+    }
+
+    dump_timings(args->show_timings, args->timings_path);
+
+    prefix_tree_free(args->exclusions);
+
+    if (args->routes != NULL) {
+        neighbor_cache_close(args->routes->neighbors);
+        free_route_table(args->routes);
+        free(args->routes);
+    }
+
+    interval_set_free(&args->targets);
+    interval_set_free(&args->ports);
     free(args);
 
-    int sock_raw = socket(AF_PACKET, SOCK_RAW, IPPROTO_RAW);
+    if (transport_shutdown() < 0 || ret < 0) {
+        return -1;
+    }
+
+    if (DEBUG >= 2) {
+        printf("Exiting!\n");
+    }
+
+    return 0;
+}
+
+struct scan_state * create_target_state(const struct input_args *args, 
+        unsigned int tar_ip) {
+    struct scan_state *state = create_scan_state(tar_ip, !(args->simp_scan), 
+            (unsigned int)(time(0) ^ getpid()), args->checkpoint_path);
+
+    if (state != NULL && args->tar_ip6 != NULL) {
+        state->family = AF_INET6;
+        memcpy(state->tar_ip6, args->tar_ip6, IP6_LEN);
+    }
+
+    // The checkpoint of a target list records where in the list it is
+    if (state != NULL && args->targets.size > 1) {
+        state->targets = &args->targets;
+        state->target_index = interval_set_index(&args->targets, 
+                ntohl(tar_ip));
+    }
+
+    return state;
+}
+
+/*
+ * Waits for the background check of the cached MAC address a target is
+ * reached at, its own or its gateway's.  Returns 1 if the check corrected the
+ * address, which the target's MAC address then points to, otherwise 0.
+ */
+static int confirm_cached_mac(const struct input_args *args, 
+        struct route *route, int *check, unsigned char *cached_mac) {
+    if (*check < 0) {
+        return 0;
+    }
+
+    struct neighbor_cache *cache = args->routes->neighbors;
+    const int waited = *check;
+
+    // Each check is waited for once per target
+    *check = -1;
+
+    if (route->gateway == 0) {
+        return neighbor_cache_wait(cache, waited, cached_mac);
+    }
+
+    unsigned char gw_mac[MAC_LEN];
+    memcpy(gw_mac, route->gw_mac, MAC_LEN);
+
+    if (!neighbor_cache_wait(cache, waited, gw_mac)) {
+        return 0;
+    }
+
+    // Every route through the gateway is corrected
+    route_learn_gateway(args->routes, route->if_index, route->gateway, 
+            gw_mac);
+
+    return 1;
+}
+
+/*
+ * Finds the route of an IPv4 target, if a routing table is used.  Returns 1 
+ * if the target is skipped as it is excluded or has no route, otherwise 0.
+ */
+static int route_target(const struct input_args *args, 
+        const struct scan_state *state, struct route **route) {
+    *route = NULL;
+
+    if (state->family != AF_INET) {
+        return 0;
+    }
+
+    // Nothing is sent to an excluded address, not even an ARP request
+    if (args->exclusions != NULL && 
+            prefix_tree_contains(args->exclusions, ntohl(state->tar_ip))) {
+        printf("Skipping excluded target %s\n", get_ip_32_str(state->tar_ip));
+
+        return 1;
+    }
+
+    if (args->routes != NULL) {
+        *route = route_lookup(args->routes, ntohl(state->tar_ip));
+
+        if (*route == NULL) {
+            printf("Skipping target %s, no route to it\n", 
+                    get_ip_32_str(state->tar_ip));
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Finds the index and addresses of the interface a target is scanned 
+ * through, from its route or else from the -dev interface.  Returns 0 on 
+ * success, -1 on error.
+ */
+static int find_local_interface(const char *dev_name, int family, 
+        const unsigned char *tar_ip_arr, const struct route *route, 
+        int *loc_int_index, const unsigned char **loc_mac_add, 
+        const unsigned char **loc_ip_arr) {
+    // The route already holds the addresses of its interface
+    if (route != NULL) {
+        *loc_int_index = route->if_index;
+        *loc_mac_add = route->loc_mac;
+        *loc_ip_arr = (const unsigned char *)&route->loc_ip;
+
+        return 0;
+    }
+
+    // Only used to query the interface, which needs no privileges
+    int sock_raw = socket(AF_INET, SOCK_DGRAM, 0);
     if(sock_raw == -1) {
-        fprintf(stderr, "ERROR: Cannot open raw socket!\n");
+        fprintf(stderr, "ERROR: Cannot open socket!\n");
 
         return -1;
     }
 
     // Get interface index
-    loc_int_index = get_interface_index(&sock_raw, dev_name);
-    if (loc_int_index == -1) {
+    *loc_int_index = get_interface_index(&sock_raw, dev_name);
+    if (*loc_int_index == -1) {
         fprintf(stderr, "ERROR: Cannot get interface index.\n");
         close(sock_raw);
 
@@ -57,94 +418,326 @@ int main(int argc, const char *argv[]) {
     }
 
     // Get MAC address of the interface
-    loc_mac_add = get_mac_address(&sock_raw, dev_name);
-    if (loc_mac_add == NULL) {
+    *loc_mac_add = get_mac_address(&sock_raw, dev_name);
+    if (*loc_mac_add == NULL) {
         fprintf(stderr, "ERROR: Cannot get MAC address.\n");
         close(sock_raw);
 
         return -1;
     }
 
-    // Get IP address of the interface
-    loc_ip_add = get_ip_address(&sock_raw, dev_name);
-    if (loc_ip_add == NULL) {
-        fprintf(stderr, "ERROR: Cannot get IP address.\n");
-        close(sock_raw);
+    // Get IP address of the interface, for IPv6 one that can reach the 
+    // target
+    if (family == AF_INET6) {
+        *loc_ip_arr = (const unsigned char *)get_ip6_address(dev_name, 
+                (const struct in6_addr *)tar_ip_arr);
+    } else {
+        const struct in_addr *loc_ip_add = get_ip_address(&sock_raw, 
+                dev_name);
 
-        return -1;
+        *loc_ip_arr = loc_ip_add != NULL ? get_ip_arr_rep(loc_ip_add) : 
+                NULL;
     }
 
-    // Search the ARP table for the MAC address associated with dest_ip.
-    mac_dest = get_mac_add_from_ip(get_ip_arr_rep(dest_ip), sock_raw,
-            loc_mac_add, get_ip_arr_rep(loc_ip_add), loc_int_index, dev_name);
+    close(sock_raw);
 
-    if (mac_dest == NULL) {
-        fprintf(stderr, "ERROR: Cannot get MAC address of destination IP!\n");
-        close(sock_raw);
+    if (*loc_ip_arr == NULL) {
+        fprintf(stderr, "ERROR: Cannot get IP address.\n");
 
         return -1;
     }
 
+    return 0;
+}
+
+// Prints where a target is scanned from and to before its scan starts
+static void print_target_info(const struct input_args *args, 
+        const struct scan_state *state, const unsigned char *tar_ip_arr, 
+        int ports_len, const unsigned char *mac_dest, const char *dev_name, 
+        int loc_int_index, const unsigned char *loc_mac_add, 
+        const unsigned char *loc_ip_arr) {
     printf("\n");
     printf("Information\n");
     printf("-----------\n\n");
-    printf("Destination IP:             %s\n", get_ip_str(dest_ip));
+    printf("Destination IP:             %s\n", 
+            get_family_ip_str(state->family, tar_ip_arr));
 
-    if (full_scan) {
-        printf("Destination ports:          %d-%d\n", start_prt, end_prt);
+    if (state->full_scan) {
+        printf("Destination ports:          1-%d\n", MAX_PORT);
+    } else if (args->ports_spec != NULL) {
+        printf("Destination ports:          %s\n", args->ports_spec);
+    } else if (!args->udp_scan) {
+        printf("Destination ports:          top %d\n", ports_len);
     }
 
     printf("Destination MAC address:    %s\n", get_mac_str(mac_dest));
     printf("Local network device:       %s\n", dev_name);
     printf("Local device index:         %d\n", loc_int_index);
     printf("Local MAC address:          %s\n", get_mac_str(loc_mac_add));
-    printf("Local IP address:           %s\n\n", get_ip_str(loc_ip_add));
+    printf("Local IP address:           %s\n\n", 
+            get_family_ip_str(state->family, loc_ip_arr));
+}
 
-    // Ping target
-    int ping_ret_val = ping_target(get_ip_arr_rep(loc_ip_add), 
-            get_ip_arr_rep(dest_ip), loc_mac_add, mac_dest, sock_raw, 
-            loc_int_index);
+int scan_target(const struct input_args *args, struct scan_state *state, 
+        const unsigned char *next_hop_mac, const unsigned short *ports, 
+        int ports_len, struct fingerprint_matcher *matcher, 
+        struct result_writer *writer) {
+    if (state == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
 
-    close(sock_raw);
+        return -1;
+    }
+
+    // Addresses are handled in array format, 4 or 16 bytes long
+    const int family = state->family;
+    unsigned char tar_ip4_arr[IP_LEN];
+    memcpy(tar_ip4_arr, &state->tar_ip, IP_LEN);
+    const unsigned char *tar_ip_arr = family == AF_INET6 ? state->tar_ip6 :
+            tar_ip4_arr;
+
+    // The route decides the interface and whether the target is on-link
+    struct route *route = NULL;
+
+    if (route_target(args, state, &route) != 0) {
+        return finish_target(state, 0);
+    }
+
+    // Banners are kept with the port states so the result file holds them
+    if (args->grab_banners) {
+        state->banners = malloc(sizeof(struct banner_log));
+
+        if (state->banners == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return finish_target(state, -1);
+        }
+
+        memset(state->banners, 0, sizeof(struct banner_log));
+        state->banners->matcher = matcher;
+    }
+
+    const unsigned char full_scan = state->full_scan;
+    const unsigned char udp_scan = args->udp_scan;
+    const char *dev_name = route != NULL ? route->if_name : args->dev_name;
+    const unsigned char show_stats = args->show_stats;
+    const char *stats_path = args->stats_path;
+    const char *dry_run_path = args->dry_run_path;
+    const unsigned char connect_scan = args->connect_scan;
+    const unsigned char banners = args->grab_banners;
+    const unsigned char stateless_banners = args->stateless_banners;
+    
+    const unsigned char *mac_dest;                // Destination MAC address
+    unsigned char cached_mac[MAC_LEN];            // From the neighbor cache
+    int check = -1;                               // Check of a cached MAC
+    int loc_int_index;                            // Local interface index
+    const unsigned char *loc_mac_add;             // Local MAC address
+    const unsigned char *loc_ip_arr;              // Local IP address
+
+    // Connections are made by the kernel, so no interface, ARP or ping
+    if (connect_scan) {
+        install_interrupt_handler(state);
+
+        if (show_stats) {
+            start_stats_thread(state, stats_path);
+        }
+
+        int ret = run_connect_scan(ports, ports_len, tar_ip_arr, state);
+
+        stop_stats_thread(state);
+
+        if (ret == 0 && banners && !scan_interrupted(state)) {
+            ret = run_banner_grab(tar_ip_arr, state);
+        }
+
+        if (ret == 0 && writer != NULL && 
+                write_bin_results(writer, state) < 0) {
+            fprintf(stderr, "ERROR: Cannot write result file!\n");
+            ret = -1;
+        }
+
+        return finish_target(state, ret);
+    }
+
+    unsigned long long phase_start = get_time_ns();
+
+    if (find_local_interface(dev_name, family, tar_ip_arr, route, 
+            &loc_int_index, &loc_mac_add, &loc_ip_arr) < 0) {
+        return finish_target(state, -1);
+    }
+
+    record_phase(PHASE_INTERFACE, phase_start);
+
+    if (dry_run_path != NULL) {
+        // No ARP request is sent, use the cached entry if there is one
+        char *mac_str = family == AF_INET6 ? 
+                search_neighbor_table(get_ip6_arr_str(tar_ip_arr)) :
+                search_arp_table(get_ip_arr_str(tar_ip_arr));
+        mac_dest = mac_str != NULL ? get_mac_from_str(mac_str) : 
+                get_mac_from_str("ff:ff:ff:ff:ff:ff");
+
+        int ret = run_dry_run(dry_run_path, full_scan, ports, ports_len, 
+                loc_ip_arr, tar_ip_arr, loc_mac_add, mac_dest, state);
+
+        return finish_target(state, ret);
+    }
+
+    phase_start = get_time_ns();
+
+    // Search the ARP table for the MAC address associated with the target, 
+    // or solicit it with neighbor discovery for IPv6, unless host discovery
+    // already found it
+    if (next_hop_mac != NULL) {
+        mac_dest = next_hop_mac;
+    } else if (route != NULL && route->gateway != 0) {
+        // Off-link targets are reached through the gateway, never ARP
+        mac_dest = route_gateway_mac(args->routes, route);
+        check = route->gw_check;
+    } else if (route != NULL && args->routes->neighbors != NULL && 
+            neighbor_cache_lookup(args->routes->neighbors, state->tar_ip, 
+            loc_int_index, cached_mac) == 0) {
+        // Checked in the background while the scan starts
+        check = neighbor_cache_check(args->routes->neighbors, state->tar_ip, 
+                loc_int_index, loc_mac_add, route->loc_ip);
+        mac_dest = cached_mac;
+    } else if (family == AF_INET6) {
+        mac_dest = get_mac_add_from_ip6(tar_ip_arr, loc_mac_add, loc_ip_arr, 
+                loc_int_index, dev_name);
+    } else {
+        mac_dest = get_mac_add_from_ip(tar_ip_arr, loc_mac_add, loc_ip_arr, 
+                loc_int_index, dev_name);
+    }
+
+    // Without discovery, an on-link target of a list may simply be down
+    if (mac_dest == NULL && args->skip_discovery) {
+        printf("Target IP (%s) is down or its MAC address cannot be "
+                "resolved\n", get_family_ip_str(family, tar_ip_arr));
+
+        return finish_target(state, 0);
+    }
+
+    if (mac_dest == NULL) {
+        fprintf(stderr, "ERROR: Cannot get MAC address of destination IP!\n");
+
+        return finish_target(state, -1);
+    }
+
+    record_phase(PHASE_ARP, phase_start);
+
+    print_target_info(args, state, tar_ip_arr, ports_len, mac_dest, dev_name, 
+            loc_int_index, loc_mac_add, loc_ip_arr);
+
+    // Ping target, a discovered target already answered a ping and -Pn 
+    // takes every target to be up
+    int ping_ret_val = 1;
+
+    if (next_hop_mac == NULL && !args->skip_discovery) {
+        phase_start = get_time_ns();
+
+        for (;;) {
+            ping_ret_val = family == AF_INET6 ? 
+                    ping_target6(loc_ip_arr, tar_ip_arr, loc_mac_add, 
+                    mac_dest, loc_int_index) : 
+                    ping_target(loc_ip_arr, tar_ip_arr, loc_mac_add, 
+                    mac_dest, loc_int_index);
+
+            // A stale cached MAC address is not answered at
+            if (ping_ret_val != 0 || 
+                    !confirm_cached_mac(args, route, &check, cached_mac)) {
+                break;
+            }
+
+            printf("Cached MAC address was stale, pinging %s again at %s\n", 
+                    get_family_ip_str(family, tar_ip_arr), 
+                    get_mac_str(mac_dest));
+        }
+
+        record_phase(PHASE_PING, phase_start);
+    }
 
     // ICMP reply received
     if(ping_ret_val) {
         if (DEBUG >= 2) {
-            printf("Target IP (%s) is up.\n", get_ip_str(dest_ip));
+            printf("Target IP (%s) is up.\n", 
+                    get_family_ip_str(family, tar_ip_arr));
         }
         
-        // Commence port scan
-        if (full_scan == 1) {
-            scan_ports_raw_multi(get_ip_arr_rep(loc_ip_add), 
-                    get_ip_arr_rep(dest_ip), loc_mac_add, mac_dest, 1, 
-                    MAX_PORT, loc_int_index);
-        } else {
-            unsigned short int *comm_ports = malloc(
-                sizeof(unsigned short int) * MAX_PORT);
-            memset(comm_ports, 0, sizeof(unsigned short int) * MAX_PORT);
+        int rescan;
 
-            int comm_ports_len = get_common_ports_arr(comm_ports);
+        do {
+            // Banners are read by the consumer as the scan finds open ports
+            if (stateless_banners) {
+                state->handshake = handshake_create(loc_ip_arr, tar_ip_arr, 
+                        loc_mac_add, mac_dest, loc_int_index, log_banner, 
+                        state->banners);
 
-            // Reallocate common ports array to save memory
-            comm_ports = realloc(comm_ports, 
-                sizeof(unsigned short int) * comm_ports_len);
+                if (state->handshake == NULL) {
+                    fprintf(stderr, 
+                            "ERROR: Cannot start stateless handshakes!\n");
 
-            if (comm_ports == NULL) {
-                fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+                    return finish_target(state, -1);
+                }
+            }
 
-                return -1;
+            // Flush partial results and the checkpoint on SIGINT
+            install_interrupt_handler(state);
+
+            if (show_stats) {
+                start_stats_thread(state, stats_path);
+            }
+
+            // Commence port scan
+            if (udp_scan == 1) {
+                scan_udp_ports_multi(loc_ip_arr, tar_ip_arr, loc_mac_add, 
+                        mac_dest, ports, ports_len, loc_int_index, state);
+            } else if (full_scan == 1) {
+                scan_ports_raw_multi(loc_ip_arr, tar_ip_arr, loc_mac_add, 
+                        mac_dest, 1, MAX_PORT, loc_int_index, state);
+            } else {
+                scan_ports_raw_arr_multi(loc_ip_arr, tar_ip_arr, loc_mac_add, 
+                        mac_dest, ports, ports_len, loc_int_index, state);
+            }
+
+            stop_stats_thread(state);
+
+            // The results only stand once the cached MAC address they were
+            // scanned at is confirmed, otherwise the ports are scanned again
+            rescan = !scan_interrupted(state) && 
+                    confirm_cached_mac(args, route, &check, cached_mac);
+
+            if (rescan) {
+                printf("Cached MAC address was stale, scanning %s again at "
+                        "%s\n", get_family_ip_str(family, tar_ip_arr), 
+                        get_mac_str(mac_dest));
+
+                handshake_free(state->handshake);
+                state->handshake = NULL;
+                reset_scan_state(state);
             }
+        } while (rescan);
 
-            scan_ports_raw_arr_multi(get_ip_arr_rep(loc_ip_add),
-                    get_ip_arr_rep(dest_ip), loc_mac_add, mac_dest, 
-                    comm_ports, comm_ports_len, loc_int_index);
+        if (stateless_banners) {
+            print_banner_log(state->banners);
+
+            handshake_free(state->handshake);
+            state->handshake = NULL;
+        } else if (banners && !scan_interrupted(state) && 
+                run_banner_grab(tar_ip_arr, state) < 0) {
+            return finish_target(state, -1);
+        }
+
+        if (writer != NULL) {
+            if (write_bin_results(writer, state) < 0) {
+                fprintf(stderr, "ERROR: Cannot write result file!\n");
+
+                return finish_target(state, -1);
+            }
         }
     }
     else if (ping_ret_val == 0) {
     // ICMP reply not received
         if (DEBUG >= 0) {
             printf("Target IP (%s) is down or not responding to ping " 
-                    "requests\n", get_ip_str(dest_ip));
+                    "requests\n", get_family_ip_str(family, tar_ip_arr));
         }
     }
     // An error occurred
@@ -152,47 +745,219 @@ int main(int argc, const char *argv[]) {
         fprintf(stderr, 
                 "ERROR: An unknown error occurred with the ICMP request\n");
 
-        return -1;
-    }
-
-    if (DEBUG >= 2) {
-        printf("Exiting!\n");
+        return finish_target(state, -1);
     }
 
-    return 0;
+    return finish_target(state, 0);
 }
 
-struct input_args * parse_input_args(int argc, const char **argv) {
-    if (argc < 2) {
-        print_usage();
+/*
+ * Scans a group of UDP targets reached through one interface at once, then
+ * adds their results to the result file and frees their states.
+ */
+static int run_udp_group(const struct input_args *args, 
+        struct udp_host *hosts, int hosts_len, const unsigned short *ports, 
+        int ports_len, struct result_writer *writer) {
+    struct scan_state *states[UDP_PARALLEL_HOSTS];
 
-        return NULL;
+    for (int i = 0; i < hosts_len; i++) {
+        states[i] = hosts[i].state;
     }
 
-    struct input_args *in_args = malloc(sizeof(struct input_args));
-    memset(in_args, 0, sizeof(struct input_args));
+    // Flush partial results on SIGINT
+    install_group_interrupt_handler(states, hosts_len);
 
-    // Set defaults
-    in_args->tar_ip = NULL;
-    in_args->dev_name = NULL;
-    in_args->simp_scan = 1;
-    in_args->start_port = 1;
-    in_args->end_port = MAX_PORT;
+    // Groups hold a single target when the status line is shown
+    if (args->show_stats) {
+        start_stats_thread(states[0], args->stats_path);
+    }
 
-    const int MAX_TOK_LEN = 30;
+    int scan_ret = scan_udp_hosts_multi(hosts, hosts_len, ports, ports_len);
 
-    const char* IP_PARAM = "-ip";
-    const char* DEV_PARAM = "-dev";
-    const char* FULL_SCAN_FLAG = "-f";
+    stop_stats_thread(states[0]);
 
-    unsigned char ip_param_set = 0;
-    unsigned char dev_param_set = 0;
-    unsigned char full_scan_flag_set = 0;
+    int ret = 0;
 
-    // Loop through input parameters and identify parameters and flags
-    for (int i = 1; i < argc; i++) {
-        if (strncmp(argv[i], IP_PARAM, strlen(IP_PARAM)) == 0) {
-            if (ip_param_set) {
+    for (int i = 0; i < hosts_len; i++) {
+        int target_ret = scan_ret;
+
+        if (target_ret == 0 && writer != NULL && 
+                write_bin_results(writer, states[i]) < 0) {
+            fprintf(stderr, "ERROR: Cannot write result file!\n");
+            target_ret = -1;
+        }
+
+        target_ret = finish_target(states[i], target_ret);
+
+        if (ret == 0) {
+            ret = target_ret;
+        }
+    }
+
+    return ret;
+}
+
+int scan_udp_targets(const struct input_args *args, 
+        struct scan_state **states, const unsigned char **next_hop_macs, 
+        int states_len, const unsigned short *ports, int ports_len, 
+        struct result_writer *writer) {
+    struct udp_host hosts[UDP_PARALLEL_HOSTS];
+    int hosts_len = 0;
+    int ret = 0;
+
+    for (int i = 0; i < states_len; i++) {
+        struct scan_state *state = states[i];
+
+        // Targets after an error are not scanned
+        if (ret != 0) {
+            free_scan_state(state);
+
+            continue;
+        }
+
+        if (state == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+            ret = -1;
+
+            continue;
+        }
+
+        struct route *route = NULL;
+
+        if (route_target(args, state, &route) != 0) {
+            finish_target(state, 0);
+
+            continue;
+        }
+
+        struct udp_host host;
+        const char *dev_name = route != NULL ? route->if_name : 
+                args->dev_name;
+
+        host.tar_ip = (const unsigned char *)&state->tar_ip;
+        host.tar_mac = next_hop_macs[i];
+        host.state = state;
+
+        if (find_local_interface(dev_name, AF_INET, host.tar_ip, route, 
+                &host.inter_index, &host.src_mac, &host.src_ip) < 0) {
+            ret = finish_target(state, -1);
+
+            continue;
+        }
+
+        // The targets of a group share one listener, so one interface
+        if (hosts_len > 0 && (host.inter_index != hosts[0].inter_index || 
+                compare_ip_add(host.src_ip, hosts[0].src_ip) != 0)) {
+            ret = run_udp_group(args, hosts, hosts_len, ports, ports_len, 
+                    writer);
+            hosts_len = 0;
+
+            if (ret != 0) {
+                free_scan_state(state);
+
+                continue;
+            }
+        }
+
+        print_target_info(args, state, host.tar_ip, ports_len, host.tar_mac, 
+                dev_name, host.inter_index, host.src_mac, host.src_ip);
+
+        hosts[hosts_len++] = host;
+    }
+
+    if (hosts_len > 0 && ret == 0) {
+        ret = run_udp_group(args, hosts, hosts_len, ports, ports_len, writer);
+    } else {
+        for (int i = 0; i < hosts_len; i++) {
+            free_scan_state(hosts[i].state);
+        }
+    }
+
+    return ret;
+}
+
+struct input_args * parse_input_args(int argc, const char **argv) {
+    if (argc < 2) {
+        print_usage();
+
+        return NULL;
+    }
+
+    struct input_args *in_args = malloc(sizeof(struct input_args));
+    memset(in_args, 0, sizeof(struct input_args));
+
+    // Set defaults
+    interval_set_init(&in_args->targets);
+    in_args->tar_ip6 = NULL;
+    in_args->dev_name = NULL;
+    in_args->simp_scan = 1;
+    in_args->udp_scan = 0;
+    in_args->connect_scan = 0;
+    in_args->grab_banners = 0;
+    in_args->fingerprints_path = NULL;
+    in_args->stateless_banners = 0;
+    in_args->top_ports = DEFAULT_TOP_PORTS;
+    in_args->ports_spec = NULL;
+    in_args->exclusions = NULL;
+    in_args->routes = NULL;
+    in_args->neighbor_cache_path = NULL;
+    in_args->discovery_probes = DISCOVER_ALL;
+    in_args->discovery_rate = DISCOVERY_DEFAULT_PPS;
+    in_args->skip_discovery = 0;
+    interval_set_init(&in_args->ports);
+    in_args->checkpoint_path = NULL;
+    in_args->resume_path = NULL;
+    in_args->bin_output_path = NULL;
+    in_args->show_stats = 0;
+    in_args->stats_path = NULL;
+    in_args->show_timings = 0;
+    in_args->timings_path = NULL;
+    in_args->transport_spec = NULL;
+    in_args->dry_run_path = NULL;
+
+    const int MAX_TOK_LEN = 30;
+
+    const char* IP_PARAM = "-ip";
+    const char* DEV_PARAM = "-dev";
+    const char* FULL_SCAN_FLAG = "-f";
+    const char* TOP_PORTS_PARAM = "--top-ports";
+    const char* PORTS_PARAM = "-p";
+    const char* EXCLUDE_FILE_PARAM = "--exclude-file";
+    const char* EXCLUDE_PARAM = "--exclude";
+    const char* TARGET_FILE_PARAM = "-iL";
+    const char* DISCOVERY_RATE_PARAM = "--discovery-rate";
+    const char* DISCOVERY_PARAM = "--discovery";
+    const char* SKIP_DISCOVERY_FLAG = "-Pn";
+    const char* UDP_SCAN_FLAG = "-u";
+    const char* CONNECT_FLAG = "--connect";
+    const char* BANNERS_FLAG = "--banners";
+    const char* FINGERPRINTS_PARAM = "--fingerprints";
+    const char* STATELESS_BANNERS_FLAG = "--stateless-banners";
+    const char* CHECKPOINT_PARAM = "--checkpoint";
+    const char* RESUME_PARAM = "--resume";
+    const char* NEIGHBOR_CACHE_PARAM = "--neighbor-cache";
+    const char* BIN_OUTPUT_PARAM = "--bin-output";
+    const char* STATS_FILE_PARAM = "--stats-file";
+    const char* STATS_FLAG = "--stats";
+    const char* TIMINGS_JSON_PARAM = "--timings-json";
+    const char* TIMINGS_FLAG = "--timings";
+    const char* TRANSPORT_PARAM = "--transport";
+    const char* DRY_RUN_PARAM = "--dry-run-pcap";
+
+    unsigned char ip_param_set = 0;
+    unsigned char dev_param_set = 0;
+    unsigned char full_scan_flag_set = 0;
+    unsigned char top_ports_param_set = 0;
+    unsigned char target_file_set = 0;
+    unsigned char discovery_param_set = 0;
+    unsigned char discovery_rate_set = 0;
+    const char *exclude_spec = NULL;
+    const char *exclude_file = NULL;
+
+    // Loop through input parameters and identify parameters and flags
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], IP_PARAM, strlen(IP_PARAM)) == 0) {
+            if (ip_param_set) {
                 return NULL;
             }
 
@@ -201,12 +966,17 @@ struct input_args * parse_input_args(int argc, const char **argv) {
                 return NULL;
             }
 
-            // Validate IP address string
-            if (!validate_ip_str(argv[i + 1])) {
+            // Validate IP address string, an IPv6 address contains a colon
+            if (strchr(argv[i + 1], ':') != NULL) {
+                if (!validate_ip6_str(argv[i + 1])) {
+                    return NULL;
+                }
+
+                in_args->tar_ip6 = get_ip6_from_str(argv[i + 1]);
+            } else if (parse_target_spec(argv[i + 1], 
+                    &in_args->targets) < 0) {
                 return NULL;
             }
-                
-            in_args->tar_ip = get_ip_from_str(argv[i + 1]);
 
             ip_param_set = 1;
             i++;
@@ -233,19 +1003,335 @@ struct input_args * parse_input_args(int argc, const char **argv) {
 
             in_args->simp_scan = 0;
         } 
+        else if (strcmp(argv[i], TOP_PORTS_PARAM) == 0) {
+            if (top_ports_param_set || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            char *end;
+            long top_ports = strtol(argv[i + 1], &end, 10);
+
+            if (*end != '\0' || top_ports < 1 || 
+                    top_ports > TOP_TCP_PORTS_LEN) {
+                fprintf(stderr, "ERROR: --top-ports must be between 1 and "
+                        "%d\n", TOP_TCP_PORTS_LEN);
+
+                return NULL;
+            }
+
+            in_args->top_ports = (int)top_ports;
+            top_ports_param_set = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], PORTS_PARAM) == 0) {
+            if (in_args->ports_spec != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            if (parse_port_spec(argv[i + 1], &in_args->ports) < 0) {
+                return NULL;
+            }
+
+            in_args->ports_spec = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], TARGET_FILE_PARAM) == 0) {
+            if (target_file_set || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            if (load_target_file(argv[i + 1], &in_args->targets) < 0) {
+                return NULL;
+            }
+
+            target_file_set = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], DISCOVERY_RATE_PARAM) == 0) {
+            if (discovery_rate_set || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            char *end;
+            long rate = strtol(argv[i + 1], &end, 10);
+
+            if (*end != '\0' || rate < 1 || rate > 10000000) {
+                fprintf(stderr, "ERROR: --discovery-rate must be between 1 "
+                        "and 10000000\n");
+
+                return NULL;
+            }
+
+            in_args->discovery_rate = (unsigned int)rate;
+            discovery_rate_set = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], DISCOVERY_PARAM) == 0) {
+            if (discovery_param_set || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->discovery_probes = parse_discovery_probes(argv[i + 1]);
+
+            if (in_args->discovery_probes < 0) {
+                return NULL;
+            }
+
+            discovery_param_set = 1;
+            i++;
+        }
+        else if (strcmp(argv[i], SKIP_DISCOVERY_FLAG) == 0) {
+            in_args->skip_discovery = 1;
+        }
+        else if (strcmp(argv[i], EXCLUDE_FILE_PARAM) == 0) {
+            if (exclude_file != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            exclude_file = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], EXCLUDE_PARAM) == 0) {
+            if (exclude_spec != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            exclude_spec = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], UDP_SCAN_FLAG) == 0) {
+            in_args->udp_scan = 1;
+        }
+        else if (strcmp(argv[i], CONNECT_FLAG) == 0) {
+            in_args->connect_scan = 1;
+        }
+        else if (strcmp(argv[i], BANNERS_FLAG) == 0) {
+            in_args->grab_banners = 1;
+        }
+        else if (strcmp(argv[i], STATELESS_BANNERS_FLAG) == 0) {
+            in_args->stateless_banners = 1;
+            in_args->grab_banners = 1;
+        }
+        else if (strcmp(argv[i], FINGERPRINTS_PARAM) == 0) {
+            if (in_args->fingerprints_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->fingerprints_path = argv[i + 1];
+            in_args->grab_banners = 1;
+            i++;
+        }
+        else if (strncmp(argv[i], CHECKPOINT_PARAM, 
+                strlen(CHECKPOINT_PARAM)) == 0) {
+            if (in_args->checkpoint_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->checkpoint_path = argv[i + 1];
+            i++;
+        }
+        else if (strncmp(argv[i], RESUME_PARAM, strlen(RESUME_PARAM)) == 0) {
+            if (in_args->resume_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->resume_path = argv[i + 1];
+            i++;
+        }
+        else if (strcmp(argv[i], NEIGHBOR_CACHE_PARAM) == 0) {
+            if (in_args->neighbor_cache_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->neighbor_cache_path = argv[i + 1];
+            i++;
+        }
+        else if (strncmp(argv[i], BIN_OUTPUT_PARAM, 
+                strlen(BIN_OUTPUT_PARAM)) == 0) {
+            if (in_args->bin_output_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->bin_output_path = argv[i + 1];
+            i++;
+        }
+        else if (strncmp(argv[i], STATS_FILE_PARAM, 
+                strlen(STATS_FILE_PARAM)) == 0) {
+            if (in_args->stats_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->stats_path = argv[i + 1];
+            in_args->show_stats = 1;
+            i++;
+        }
+        else if (strncmp(argv[i], STATS_FLAG, strlen(STATS_FLAG)) == 0) {
+            in_args->show_stats = 1;
+        }
+        else if (strncmp(argv[i], TIMINGS_JSON_PARAM, 
+                strlen(TIMINGS_JSON_PARAM)) == 0) {
+            if (in_args->timings_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->timings_path = argv[i + 1];
+            i++;
+        }
+        else if (strncmp(argv[i], TIMINGS_FLAG, strlen(TIMINGS_FLAG)) == 0) {
+            in_args->show_timings = 1;
+        }
+        else if (strncmp(argv[i], TRANSPORT_PARAM, 
+                strlen(TRANSPORT_PARAM)) == 0) {
+            if (in_args->transport_spec != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->transport_spec = argv[i + 1];
+            i++;
+        }
+        else if (strncmp(argv[i], DRY_RUN_PARAM, strlen(DRY_RUN_PARAM)) == 0) {
+            if (in_args->dry_run_path != NULL || argv[i + 1] == NULL) {
+                return NULL;
+            }
+
+            in_args->dry_run_path = argv[i + 1];
+            i++;
+        }
         else {
             return NULL;
         }
     }
 
+    // Excluded ranges are cut out of the targets in bulk, and the tree
+    // guards every target scanned, including one resumed from a checkpoint
+    if (exclude_spec != NULL || exclude_file != NULL) {
+        struct interval_set excluded;
+        interval_set_init(&excluded);
+
+        unsigned long long targets_len = in_args->targets.size;
+
+        if ((exclude_spec != NULL && 
+                parse_target_spec(exclude_spec, &excluded) < 0) || 
+                (exclude_file != NULL && 
+                load_target_file(exclude_file, &excluded) < 0) || 
+                interval_set_subtract(&in_args->targets, &excluded) < 0) {
+            interval_set_free(&excluded);
+
+            return NULL;
+        }
+
+        in_args->exclusions = prefix_tree_build(&excluded);
+        interval_set_free(&excluded);
+
+        if (in_args->exclusions == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return NULL;
+        }
+
+        if (targets_len > 0 && in_args->targets.size == 0) {
+            fprintf(stderr, "ERROR: Every target is excluded!\n");
+
+            return NULL;
+        }
+    }
+
     unsigned char load_prog = 1;
     
-    if (in_args->tar_ip == NULL)
+    // The target IP is restored from the checkpoint when resuming
+    if (in_args->targets.size == 0 && in_args->tar_ip6 == NULL && 
+            in_args->resume_path == NULL)
+        load_prog = 0;
+
+    // A dry run writes the probes of a single target
+    if (in_args->targets.size > 1 && in_args->dry_run_path != NULL)
+        load_prog = 0;
+
+    // Exclusions and target files only apply to IPv4 target lists
+    if (in_args->tar_ip6 != NULL && (exclude_spec != NULL || 
+            exclude_file != NULL || 
+            in_args->targets.size > 0))
         load_prog = 0;
     
-    if (in_args->dev_name == NULL)
+    // A connect() scan leaves routing to the kernel, and IPv4 raw scans of a
+    // real network pick interfaces from the routing table.  IPv6, dry runs 
+    // and captured or simulated networks need -dev.
+    if (in_args->dev_name == NULL && !in_args->connect_scan && 
+            (in_args->tar_ip6 != NULL || in_args->dry_run_path != NULL || 
+            (in_args->transport_spec != NULL && 
+            strcmp(in_args->transport_spec, "raw") != 0 && 
+            strcmp(in_args->transport_spec, "ring") != 0)))
+        load_prog = 0;
+
+    // Connect() scans are TCP only and never build packets
+    if (in_args->connect_scan && (in_args->udp_scan || 
+            in_args->dry_run_path != NULL || in_args->transport_spec != NULL))
+        load_prog = 0;
+
+    // Banners are read over real TCP connections, so never from UDP ports,
+    // a dry run or a pcap or simulated network
+    if (in_args->grab_banners && !in_args->stateless_banners && 
+            (in_args->udp_scan || in_args->dry_run_path != NULL || 
+            (in_args->transport_spec != NULL && 
+            strcmp(in_args->transport_spec, "raw") != 0 && 
+            strcmp(in_args->transport_spec, "ring") != 0)))
+        load_prog = 0;
+
+    // Stateless handshakes answer IPv4 SYN-ACKs with raw frames, so they need
+    // a network that replies, either real or simulated
+    if (in_args->stateless_banners && (in_args->udp_scan || 
+            in_args->connect_scan || in_args->tar_ip6 != NULL || 
+            in_args->dry_run_path != NULL || 
+            (in_args->transport_spec != NULL && 
+            strncmp(in_args->transport_spec, "pcap", 4) == 0)))
+        load_prog = 0;
+
+    // The top ports are TCP ports and a full scan already covers them
+    if (top_ports_param_set && (in_args->udp_scan || !in_args->simp_scan))
+        load_prog = 0;
+
+    // A port list replaces the top ports or a full scan
+    if (in_args->ports_spec != NULL && (top_ports_param_set || 
+            !in_args->simp_scan))
+        load_prog = 0;
+
+    // Host discovery sweeps IPv4 target lists before a raw scan
+    if ((discovery_param_set || discovery_rate_set) && 
+            (in_args->tar_ip6 != NULL || in_args->connect_scan || 
+            in_args->resume_path != NULL || in_args->dry_run_path != NULL || 
+            in_args->skip_discovery))
+        load_prog = 0;
+
+    // The neighbor cache holds the MAC addresses IPv4 raw scans of a real 
+    // network are sent to
+    if (in_args->neighbor_cache_path != NULL && (in_args->tar_ip6 != NULL || 
+            in_args->connect_scan || in_args->dry_run_path != NULL || 
+            (in_args->transport_spec != NULL && 
+            strcmp(in_args->transport_spec, "raw") != 0 && 
+            strcmp(in_args->transport_spec, "ring") != 0)))
         load_prog = 0;
 
+    // A dry run always writes to a pcap file
+    if (in_args->dry_run_path != NULL && in_args->transport_spec != NULL)
+        load_prog = 0;
+
+    // UDP scans are not dry run
+    if (in_args->udp_scan && in_args->dry_run_path != NULL)
+        load_prog = 0;
+
+    // IPv6 scans are TCP only
+    if (in_args->tar_ip6 != NULL && in_args->udp_scan)
+        load_prog = 0;
+
+    // Checkpoints only record IPv4 TCP scans of the top ports or every port
+    if ((in_args->checkpoint_path != NULL || in_args->resume_path != NULL) && 
+            (in_args->udp_scan || in_args->tar_ip6 != NULL || 
+            in_args->ports_spec != NULL)) {
+        fprintf(stderr, "ERROR: Checkpoints do not support UDP, IPv6 or -p "
+                "port list scans!\n");
+        load_prog = 0;
+    }
+
     if (load_prog == 0)
         return NULL;
     else
@@ -256,79 +1342,380 @@ void print_usage() {
     printf("Matt's Port Scanner v%s\n", VERSION);
     printf("usage: mports [MANDATORY_PARAMS] [OPTIONAL_PARAMS]\n");
     printf("MANDATORY PARAMS:\n");
-    printf("  -ip       <target_ipv4_address>\n");
-    printf("  -dev      <network_interface_name>\n");
+    printf("  -ip       <targets>\n");
+    printf("            An IPv6 address, or comma separated IPv4 addresses, "
+            "CIDR\n");
+    printf("            blocks and ranges, e.g. "
+            "10.0.0.0/24,10.0.1.5-10.0.1.20\n");
     printf("OPTIONAL PARAMS:\n");
+    printf("  -dev      <network_interface_name>\n");
+    printf("            Scans through this interface only.  Needed for IPv6, "
+            "dry runs\n");
+    printf("            and pcap or simulated networks, otherwise each IPv4 "
+            "target is\n");
+    printf("            scanned through the interface it is routed out of\n");
     printf("  -f        Scans every TCP port between 1 and %d\n", MAX_PORT);
+    printf("  -p <ports>\n");
+    printf("            Scans a comma separated list of ports and ranges, "
+            "e.g.\n");
+    printf("            1-1024,3306,8000-9000\n");
+    printf("  -iL <file>\n");
+    printf("            Also scans the IPv4 targets listed in file, one or "
+            "more per line\n");
+    printf("  --exclude <targets>\n");
+    printf("            IPv4 addresses, CIDR blocks and ranges not to scan\n");
+    printf("  --exclude-file <file>\n");
+    printf("            Also excludes the targets listed in file, like -iL\n");
+    printf("  --discovery <pings>\n");
+    printf("            Finds live IPv4 targets before scanning with a comma "
+            "separated\n");
+    printf("            list of icmp, syn (to port %d) and ack (to port %d) "
+            "pings\n", DISCOVERY_SYN_PORT, DISCOVERY_ACK_PORT);
+    printf("            (default icmp,syn,ack)\n");
+    printf("  -Pn       Scans every target without host discovery or pings, "
+            "for hosts\n");
+    printf("            that drop every ping\n");
+    printf("  --discovery-rate <pps>\n");
+    printf("            Probes sent per second by host discovery (default "
+            "%d)\n", DISCOVERY_DEFAULT_PPS);
+    printf("  --top-ports <n>\n");
+    printf("            Scans the n TCP ports most likely to be open, most "
+            "likely first\n");
+    printf("            (default %d, at most %d)\n", DEFAULT_TOP_PORTS, 
+            TOP_TCP_PORTS_LEN);
+    printf("  -u        Scans UDP ports instead of TCP ports (common UDP "
+            "ports,\n");
+    printf("            or every UDP port with -f)\n");
+    printf("  --connect Scans with connect() calls, which needs no root or "
+            "-dev\n");
+    printf("  --banners Reads the first bytes each open TCP port sends after "
+            "the scan\n");
+    printf("  --fingerprints <file>\n");
+    printf("            Identifies services from banners with the "
+            "fingerprints in\n");
+    printf("            file instead of the built in ones, implies "
+            "--banners\n");
+    printf("  --stateless-banners\n");
+    printf("            Reads banners during an IPv4 scan by completing "
+            "handshakes\n");
+    printf("            from raw frames, without sockets (see README for the "
+            "firewall\n");
+    printf("            rule it needs), implies --banners\n");
+    printf("  --checkpoint <file>\n");
+    printf("            Periodically saves scan progress to file\n");
+    printf("  --resume  <file>\n");
+    printf("            Resumes an interrupted scan from a checkpoint file\n");
+    printf("  --neighbor-cache <file>\n");
+    printf("            Keeps the MAC addresses of targets and gateways in "
+            "file, so\n");
+    printf("            repeat scans start without waiting on ARP (entries "
+            "last %ds)\n", NEIGHBOR_CACHE_TTL_S);
+    printf("  --bin-output <file>\n");
+    printf("            Writes the results to a binary result file\n");
+    printf("  --stats   Prints scan progress and throughput every second\n");
+    printf("  --stats-file <file>\n");
+    printf("            Writes scan progress and throughput to file every "
+            "second\n");
+    printf("  --timings Prints phase timings and latency histograms at exit\n");
+    printf("  --timings-json <file>\n");
+    printf("            Writes phase timings and latency histograms to file as "
+            "JSON\n");
+    printf("  --transport raw|ring|pcap:<out>[,<in>]|sim:<options>\n");
+    printf("            Packet I/O backend (default raw).  ring uses mmap'd "
+            "packet\n");
+    printf("            rings, pcap writes probes to and reads replies from "
+            "pcap\n");
+    printf("            files and sim scans an in-memory simulated network "
+            "without\n");
+    printf("            root, e.g. \"sim:-host 10.0.0.0/24 -open 22,80\"\n");
+    printf("  --dry-run-pcap <file>\n");
+    printf("            Writes the probes to a pcap file at full speed instead "
+            "of\n");
+    printf("            scanning and reports the probe generation rate\n");
+    printf("QUERY RESULT FILES:\n");
+    printf("  mports query <file> summary|host <ip>|open <port>\n");
+    printf("  mports query diff <file_a> <file_b>\n");
+    printf("REPLAY A CAPTURE THROUGH THE REPLY PATH:\n");
+    printf("  mports replay <file.pcap> [-ip <target_ip>] "
+            "[-mac <local_mac>]\n");
     printf("EXAMPLE:\n");
     printf("mports -ip 192.168.12.1 -dev enp4s0\n");
+    printf("mports -ip 192.168.12.0/24 --exclude 192.168.12.1 -p 22,80 "
+            "-dev enp4s0\n");
+    printf("mports -ip fe80::1 -dev enp4s0\n");
+    printf("mports -ip 192.168.12.1 --connect\n");
+    printf("mports -ip 192.168.12.1 --connect --banners\n");
+}
+
+int run_dry_run(const char *path, unsigned char full_scan, 
+        const unsigned short *ports, int ports_len, 
+        const unsigned char *src_ip, const unsigned char *tar_ip, 
+        const unsigned char *src_mac, const unsigned char *tar_mac, 
+        struct scan_state *state) {
+    printf("Writing probes for target %s to %s\n", 
+            get_family_ip_str(state->family, tar_ip), path);
+
+    unsigned long long start_ns = get_time_ns();
+    int ret;
+
+    if (full_scan) {
+        state->probes_len = MAX_PORT;
+
+        ret = scan_ports_raw(src_ip, tar_ip, src_mac, tar_mac, 1, MAX_PORT, 
+                0, state);
+    } else {
+        state->probes_len = ports_len;
+
+        ret = scan_ports_raw_arr(src_ip, tar_ip, src_mac, tar_mac, 
+                ports, ports_len, 0, state);
+    }
+
+    // Include flushing the write buffer in the generation time
+    if (transport_shutdown() < 0) {
+        ret = -1;
+    }
+
+    double elapsed_s = (get_time_ns() - start_ns) / 1e9;
+    unsigned long probes = stats_read(&state->stats.sender.probes_sent);
+
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: Cannot write probes to %s\n", path);
+
+        return -1;
+    }
+
+    printf("\n");
+    printf("Dry Run\n");
+    printf("-------\n\n");
+    printf("Destination MAC address:    %s\n", get_mac_str(tar_mac));
+    printf("Probes generated:           %lu\n", probes);
+    printf("Elapsed:                    %.3f ms\n", elapsed_s * 1000.0);
+    printf("Probes/sec:                 %.0f\n", 
+            elapsed_s > 0 ? probes / elapsed_s : 0.0);
+
+    return 0;
+}
+
+int run_connect_scan(const unsigned short *ports, int ports_len, 
+        const unsigned char *tar_ip, struct scan_state *state) {
+    return scan_ports_connect(tar_ip, ports, ports_len, state);
+}
+
+int finish_target(struct scan_state *state, int ret) {
+    if (ret == 0 && scan_interrupted(state)) {
+        ret = 1;
+    }
+
+    free_scan_state(state);
+
+    return ret;
+}
+
+int get_scan_ports(const struct input_args *args, 
+        const unsigned short **ports, unsigned short **ports_buff) {
+    *ports_buff = NULL;
+
+    // The top ports are a prefix of the static table
+    if (args->ports_spec == NULL && !args->udp_scan && args->simp_scan) {
+        *ports = TOP_TCP_PORTS;
+
+        return args->top_ports;
+    }
+
+    unsigned short *buff = malloc(sizeof(unsigned short) * MAX_PORT);
+
+    if (buff == NULL) {
+        return -1;
+    }
+
+    int ports_len = 0;
+
+    if (args->ports_spec != NULL) {
+        for (int i = 0; i < args->ports.len; i++) {
+            for (unsigned int port = args->ports.intervals[i].first; 
+                    port <= args->ports.intervals[i].last; port++) {
+                buff[ports_len++] = (unsigned short)port;
+            }
+        }
+    } else if (args->simp_scan) {
+        ports_len = get_common_udp_ports_arr(buff);
+    } else {
+        for (int port = 1; port <= MAX_PORT; port++) {
+            buff[ports_len++] = (unsigned short)port;
+        }
+    }
+
+    *ports = buff;
+    *ports_buff = buff;
+
+    return ports_len;
+}
+
+static void print_banner(unsigned short port, const unsigned char *banner, 
+        int banner_len, const struct fingerprint *fp) {
+    char service[64];
+
+    if (fp == NULL) {
+        snprintf(service, sizeof(service), "unknown");
+    } else if (fp->product == NULL) {
+        snprintf(service, sizeof(service), "%s", fp->service);
+    } else {
+        snprintf(service, sizeof(service), "%s (%s)", fp->service, 
+                fp->product);
+    }
+
+    char str[BANNER_STR_LEN];
+
+    printf("Port: %-6d %-22s %s\n", port, service, 
+            format_banner(banner, banner_len, str));
+}
+
+// Keeps each banner for the result file and prints it as soon as it is read
+static void log_and_print_banner(unsigned short port, 
+        const unsigned char *banner, int banner_len, void *ctx) {
+    struct banner_log *log = (struct banner_log *)ctx;
+    const int len = log->len;
+
+    log_banner(port, banner, banner_len, log);
+
+    print_banner(port, banner, banner_len, log->len > len ? 
+            log->banners[len].fp : 
+            match_fingerprint(log->matcher, banner, banner_len));
+}
+
+void print_banner_log(struct banner_log *log) {
+    printf("\n");
+    printf("Banners\n");
+    printf("-------\n\n");
+
+    sort_banner_log(log);
+
+    for (int i = 0; i < log->len; i++) {
+        print_banner(log->banners[i].port, log->banners[i].data, 
+                log->banners[i].len, log->banners[i].fp);
+    }
+
+    if (log->len == 0) {
+        printf("No banners received\n");
+    }
+}
+
+struct fingerprint_matcher * make_fingerprint_matcher(
+        const char *fingerprints_path) {
+    if (fingerprints_path != NULL) {
+        return load_fingerprints(fingerprints_path);
+    }
+
+    int fps_len;
+    const struct fingerprint *fps = get_default_fingerprints(&fps_len);
+
+    return compile_fingerprints(fps, fps_len);
+}
+
+int run_banner_grab(const unsigned char *tar_ip, struct scan_state *state) {
+    printf("\n");
+    printf("Banners\n");
+    printf("-------\n\n");
+
+    int banners = grab_open_port_banners(tar_ip, state, log_and_print_banner, 
+            state->banners);
+
+    if (banners < 0) {
+        return -1;
+    }
+
+    if (banners == 0) {
+        printf("No banners received\n");
+    }
+
+    return 0;
 }
 
-int get_common_ports_arr(unsigned short int *arr_copy) {
-    const unsigned short int COMM_POR_TCP[] = {
-        20,         // FTP
-        21,         // FTP
-        22,         // SSH
-        23,         // TELNET
-        25,         // SMTP
-        42,         // WINS
-        43,         // WHOIS
-        49,         // TACACS
-        53,         // DNS
-        69,         // TFTP
-        70,         // GOPHER
-        79,         // FINGER
-        80,         // HTTP
-        88,         // KERBEROS
-        102,        // TSAP
-        110,        // POP3
-        113,        // IDENT
-        119,        // NNTP (Usenet)
-        123,        // NTP
-        135,        // Ms RPC EPMAP
-        137,        // NETBIOS NS
-        138,        // NETBIOS (Datagram service)
-        139,        // NETBIOS (Session service)
-        143,        // IMAP
-        161,        // SNMP
-        179,        // Border Gateway Protocol
-        194,        // IRC
-        201,        // AppleTalk
-        264,        // Border Gateway Multicast Protocol
-        389,        // LDAP
-        443,        // HTTPS
-        445,        // SMB
-        554,        // RTSP
-        993,        // IMAPS
-        995,        // POP3S
-        1025,       // MS RPC
-        1080,       // SOCKS
-        1720,       // H.323
-        2082,       // CPANEL
-        3128,       // HTTP PROXY
-        3306,       // MYSQL
-        3389,       // RDP
-        5060,       // SIP
-        5061,       // SIP over TLS
-        5432,       // POSTGRESQL
-        6379,       // REDIS
-        6970,       // QUICKTIME STREAMING SERVER
-        8000,       // INTERNET RADIO
-        8080,       // HTTP PROXY
-        8200,       // VMWARE SERVER
-        8222,       // VMWARE SERVER
-        9092,       // KAFKA
-        19226,      // ADMINSECURE
-        27017       // MONGODB
-    };
-
-    const int arr_len = sizeof(COMM_POR_TCP) / sizeof(unsigned short int);
-
-    // Copy array to arr_copy
-
-    for(int i = 0; i < arr_len; i++) {
-        arr_copy[i] = COMM_POR_TCP[i];
-    }
-
-    return arr_len;
+void dump_timings(unsigned char show_timings, const char *timings_path) {
+    if (show_timings) {
+        print_timings(stdout);
+    }
+
+    if (timings_path != NULL) {
+        write_timings_json(timings_path);
+    }
+}
+
+int write_bin_results(struct result_writer *writer, 
+        const struct scan_state *state) {
+    unsigned short *ports = malloc(sizeof(unsigned short) * (MAX_PORT + 1));
+    unsigned char *states = malloc(sizeof(char) * (MAX_PORT + 1));
+    int ports_len = 0;
+
+    if (ports == NULL || states == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+        free(ports);
+        free(states);
+
+        return -1;
+    }
+
+    for (int port = 1; port <= MAX_PORT; port++) {
+        if (state->port_states[port] != PORT_STATE_UNKNOWN) {
+            ports[ports_len] = (unsigned short)port;
+            states[ports_len] = state->port_states[port];
+            ports_len++;
+        }
+    }
+
+    // IPv4 addresses are stored IPv4-mapped
+    unsigned char addr[RESULT_ADDR_LEN];
+
+    if (state->family == AF_INET6) {
+        memcpy(addr, state->tar_ip6, RESULT_ADDR_LEN);
+    } else {
+        result_addr_from_ipv4(state->tar_ip, addr);
+    }
+
+    // Banners are stored in port order with the service matched from them
+    struct result_banner *banners = NULL;
+    int banners_len = 0;
+
+    if (state->banners != NULL && state->banners->len > 0) {
+        sort_banner_log(state->banners);
+
+        banners = malloc(sizeof(struct result_banner) * state->banners->len);
+
+        if (banners == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+            free(ports);
+            free(states);
+
+            return -1;
+        }
+
+        for (int i = 0; i < state->banners->len; i++) {
+            const struct logged_banner *entry = &state->banners->banners[i];
+            struct result_banner *banner = &banners[banners_len++];
+
+            memset(banner, 0, sizeof(struct result_banner));
+            banner->port = entry->port;
+            banner->data = entry->data;
+            banner->data_len = entry->len;
+
+            if (entry->fp != NULL) {
+                banner->service = entry->fp->service;
+                banner->service_len = strlen(entry->fp->service);
+            }
+
+            if (entry->fp != NULL && entry->fp->product != NULL) {
+                banner->product = entry->fp->product;
+                banner->product_len = strlen(entry->fp->product);
+            }
+        }
+    }
+
+    int ret = result_writer_add_host(writer, addr, ports, states, ports_len, 
+            banners, banners_len);
+
+    free(ports);
+    free(states);
+    free(banners);
+
+    return ret;
 }
\ No newline at end of file
@@ -1,24 +1,117 @@
+#include "services/checkpoint_service.h"
+#include "services/banner_service.h"
+#include "services/interval_set.h"
+
+struct fingerprint_matcher;
+struct result_writer;
+struct prefix_tree;
+struct route_table;
+
+// TCP ports scanned when neither -f nor --top-ports is given
+#define DEFAULT_TOP_PORTS 54
+
 /*
  * Struct: input_args
  * ------------------
  * A struct to represent program parameters.
  * 
- * tar_ip: Target IP address.
+ * targets: Target IPv4 addresses (host byte order) from -ip and -iL, empty
+ *          for an IPv6 target or when resuming without either.
+ * 
+ * tar_ip6: Target IPv6 address, or NULL for an IPv4 target.
  * 
- * dev_name: Network interface device name.
+ * dev_name: Network interface device name, or NULL to scan each target 
+ *           through the interface it is routed out of.
  * 
  * simp_scan: Boolean indicating to perform a simple scan or a full scan.
  * 
- * start_port: Starting TCP port.
+ * top_ports: The number of TCP ports a simple scan probes, the most likely
+ *            to be open first.
+ * 
+ * exclusions: The addresses never sent to, from --exclude and 
+ *             --exclude-file, or NULL.
+ * 
+ * discovery_probes: The DISCOVER_ flags of the pings host discovery sends.
+ * 
+ * discovery_rate: The probe rate of host discovery in probes per second.
+ * 
+ * skip_discovery: Boolean indicating to scan every target as if it were up,
+ *                 without host discovery or pings (-Pn).
+ * 
+ * routes: The routes IPv4 targets are scanned through on a real network, 
+ *         only those through dev_name if it is given, or NULL.
+ * 
+ * neighbor_cache_path: File to keep resolved MAC addresses in across runs,
+ *                      or NULL.
+ * 
+ * ports_spec: The -p port list, or NULL.
+ * 
+ * ports: The ports of ports_spec, empty without -p.
+ * 
+ * udp_scan: Boolean indicating to scan UDP ports instead of TCP ports.
+ * 
+ * connect_scan: Boolean indicating to scan with connect() calls, which needs
+ *               no privileges or network interface.
+ * 
+ * grab_banners: Boolean indicating to read the banners of the open ports
+ *               after the scan.
  * 
- * end_port: Ending TCP port.
+ * fingerprints_path: Fingerprint file to identify services from banners
+ *                    with, or NULL for the built in fingerprints.
+ * 
+ * stateless_banners: Boolean indicating to read the banners during the scan
+ *                    by completing handshakes from raw frames.
+ * 
+ * checkpoint_path: File to write periodic checkpoints to, or NULL.
+ * 
+ * resume_path: Checkpoint file to resume a scan from, or NULL.
+ * 
+ * bin_output_path: Binary result file to write, or NULL.
+ * 
+ * show_stats: Boolean indicating to report live scan statistics.
+ * 
+ * stats_path: File to write live scan statistics to, or NULL for stderr.
+ * 
+ * show_timings: Boolean indicating to print phase timings and latency
+ *               histograms at exit.
+ * 
+ * timings_path: File to write phase timings and latency histograms to as
+ *               JSON, or NULL.
+ * 
+ * transport_spec: Packet I/O backend (see transport_configure), or NULL for
+ *                 raw sockets.
+ * 
+ * dry_run_path: pcap file to write the probes to instead of scanning, or 
+ *               NULL.
  */
 struct input_args {
-    const struct in_addr *tar_ip;    
+    struct interval_set targets;
+    const struct in6_addr *tar_ip6;
     const char* dev_name;           
     unsigned char simp_scan;        
-    unsigned short start_port;      
-    unsigned short end_port;        
+    int top_ports;
+    struct prefix_tree *exclusions;
+    int discovery_probes;
+    unsigned int discovery_rate;
+    unsigned char skip_discovery;
+    struct route_table *routes;
+    const char *neighbor_cache_path;
+    const char *ports_spec;
+    struct interval_set ports;
+    unsigned char udp_scan;
+    unsigned char connect_scan;
+    unsigned char grab_banners;
+    const char *fingerprints_path;
+    unsigned char stateless_banners;
+    const char *checkpoint_path;
+    const char *resume_path;
+    const char *bin_output_path;
+    unsigned char show_stats;
+    const char *stats_path;
+    unsigned char show_timings;
+    const char *timings_path;
+    const char *transport_spec;
+    const char *dry_run_path;
 };
 
 /*
@@ -36,19 +129,228 @@ struct input_args {
 struct input_args * parse_input_args(int argc, const char **argv);
 
 /*
- * Function: print_usage
+ * Function: create_target_state
+ * -----------------------------
+ * Creates the scan state of a target, for the IPv6 target if there is one.
+ * 
+ * args: The program parameters.
+ * 
+ * tar_ip: The target IPv4 address (network byte order), 0 for IPv6.
+ * 
+ * return: A new scan state, or NULL on error.
+ */
+struct scan_state * create_target_state(const struct input_args *args, 
+        unsigned int tar_ip);
+
+/*
+ * Function: scan_target
  * ---------------------
- * Prints the program's usage message.
+ * Scans one target: picks the interface it is routed out of, resolves its 
+ * MAC address or its gateway's, pings it and scans its ports.
+ * 
+ * args: The program parameters.
+ * 
+ * state: The scan state of the target, freed on return.  NULL reports an
+ *        allocation error.
+ * 
+ * next_hop_mac: The MAC address host discovery found the target up at, or 
+ *               NULL to resolve and ping the target first.
+ * 
+ * ports: The ports to scan, unused by a full TCP scan.
+ * 
+ * ports_len: The number of ports.
+ * 
+ * matcher: The fingerprints to identify services with, or NULL.
+ * 
+ * writer: The binary result file to add the target's results to, or NULL.
+ * 
+ * return: 0 on success, 1 if the scan was interrupted, -1 on error.
+ */
+int scan_target(const struct input_args *args, struct scan_state *state, 
+        const unsigned char *next_hop_mac, const unsigned short *ports, 
+        int ports_len, struct fingerprint_matcher *matcher, 
+        struct result_writer *writer);
+
+/*
+ * Function: scan_udp_targets
+ * --------------------------
+ * UDP scans live targets found by host discovery several at a time: picks 
+ * the interface each is routed out of, then scans the targets reached 
+ * through the same interface at once, so their ICMP rate limits are waited 
+ * for together.
+ * 
+ * args: The program parameters.
+ * 
+ * states: The scan states of the targets, freed on return.  NULL entries
+ *         report an allocation error.
+ * 
+ * next_hop_macs: The MAC address host discovery found each target up at.
+ * 
+ * states_len: The number of targets, at most UDP_PARALLEL_HOSTS.
+ * 
+ * ports: The UDP ports to scan.
+ * 
+ * ports_len: The number of ports.
+ * 
+ * writer: The binary result file to add the targets' results to, or NULL.
+ * 
+ * return: 0 on success, 1 if the scan was interrupted, -1 on error.
+ */
+int scan_udp_targets(const struct input_args *args, 
+        struct scan_state **states, const unsigned char **next_hop_macs, 
+        int states_len, const unsigned short *ports, int ports_len, 
+        struct result_writer *writer);
+
+/*
+ * Function: finish_target
+ * -----------------------
+ * Frees the scan state of a scanned target.
+ * 
+ * state: The scan state.
+ * 
+ * ret: The result of the scan.
+ * 
+ * return: ret, or 1 if the scan succeeded but was interrupted.
  */
-void print_usage();
+int finish_target(struct scan_state *state, int ret);
 
 /*
- * Function: get_common_ports_arr
- * ------------------------------
- * Copies common port numbers into the arr_copy array parameter.
+ * Function: get_scan_ports
+ * ------------------------
+ * Lists the ports every target is scanned on: the -p ports, the top TCP 
+ * ports, the common UDP ports or every port.
  * 
- * arr_copy: A NULL pointer.
+ * args: The program parameters.
  * 
- * return: The length of the array copied.
+ * ports: Populated with the ports.
+ * 
+ * ports_buff: Populated with the buffer to free once the scan is over, or
+ *             NULL if the ports are static.
+ * 
+ * return: The number of ports, or -1 on error.
+ */
+int get_scan_ports(const struct input_args *args, 
+        const unsigned short **ports, unsigned short **ports_buff);
+
+/*
+ * Function: write_bin_results
+ * ---------------------------
+ * Adds the results of a target to a binary result file, with the banners
+ * read from its open ports.
+ * 
+ * writer: The result file.
+ * 
+ * state: The scan state holding the port state table and the banner log.
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int write_bin_results(struct result_writer *writer, 
+        const struct scan_state *state);
+
+/*
+ * Function: run_connect_scan
+ * --------------------------
+ * Scans the target with connect() calls instead of raw packets, which needs
+ * no privileges.
+ * 
+ * ports: The ports to scan.
+ * 
+ * ports_len: The number of ports.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * state: The scan state.
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int run_connect_scan(const unsigned short *ports, int ports_len, 
+        const unsigned char *tar_ip, struct scan_state *state);
+
+/*
+ * Function: run_banner_grab
+ * -------------------------
+ * Connects to every port the scan found open and prints the banner each one
+ * sends as soon as it has been read, with the service identified from it.
+ * The banners are also added to the scan state's banner log.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * state: The scan state holding the port state table and the banner log.
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int run_banner_grab(const unsigned char *tar_ip, struct scan_state *state);
+
+/*
+ * Function: print_banner_log
+ * --------------------------
+ * Prints the banners read during the scan in port order, with the service
+ * identified from each.  The log is left sorted for the result file.
+ * 
+ * log: The banners.
+ */
+void print_banner_log(struct banner_log *log);
+
+/*
+ * Function: make_fingerprint_matcher
+ * ----------------------------------
+ * Compiles the fingerprints banners are matched against.
+ * 
+ * fingerprints_path: Fingerprint file, or NULL for the built in fingerprints.
+ * 
+ * return: The matcher, or NULL on error.
+ */
+struct fingerprint_matcher * make_fingerprint_matcher(
+        const char *fingerprints_path);
+
+/*
+ * Function: run_dry_run
+ * ---------------------
+ * Generates the probes of a scan at full speed and writes them to a pcap file
+ * instead of sending them, then reports the generation rate.  Nothing is sent
+ * and no replies are waited for.
+ * 
+ * path: The pcap file to write.
+ * 
+ * full_scan: 1 for a full scan, 0 to scan the listed ports.
+ * 
+ * ports: The ports to scan when not a full scan.
+ * 
+ * ports_len: The number of ports.
+ * 
+ * src_ip: The local IP address in array format.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * src_mac: The local MAC address.
+ * 
+ * tar_mac: The destination MAC address of the probes.
+ * 
+ * state: The scan state, whose family gives the family of the addresses.
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int run_dry_run(const char *path, unsigned char full_scan, 
+        const unsigned short *ports, int ports_len, 
+        const unsigned char *src_ip, const unsigned char *tar_ip, 
+        const unsigned char *src_mac, const unsigned char *tar_mac, 
+        struct scan_state *state);
+
+/*
+ * Function: dump_timings
+ * ----------------------
+ * Prints the collected timings and writes them to the JSON file, if 
+ * requested.
+ * 
+ * show_timings: Boolean indicating to print the timings.
+ * 
+ * timings_path: JSON file to write the timings to, or NULL.
+ */
+void dump_timings(unsigned char show_timings, const char *timings_path);
+
+/*
+ * Function: print_usage
+ * ---------------------
+ * Prints the program's usage message.
  */
-int get_common_ports_arr(unsigned short int *arr_copy);
\ No newline at end of file
+void print_usage();
\ No newline at end of file
@@ -12,9 +12,10 @@
 #include <time.h>
 
 #include "arp_service.h"
-#include "packet_service.h"
+#include "transport_service.h"
 #include "network_helper.h"
 #include "process_service.h"
+#include "histogram_service.h"
 #include "../constants/constants.h"
 
 unsigned char * make_arp_packet(const unsigned char *src_mac, 
@@ -80,9 +81,8 @@ unsigned char * make_arp_packet(const unsigned char *src_mac,
     return sendbuff;
 }
 
-int send_arp_request(int sock_raw, const unsigned char *src_mac, 
-        const unsigned char *src_ip, const unsigned char *tar_ip, 
-        int dev_index) {
+int send_arp_request(struct transport *t, const unsigned char *src_mac, 
+        const unsigned char *src_ip, const unsigned char *tar_ip) {
     if (DEBUG >= 2) {
         printf("Sending ARP request for IP: %s\n", get_ip_arr_str(tar_ip));
     }
@@ -96,9 +96,7 @@ int send_arp_request(int sock_raw, const unsigned char *src_mac,
         return -1;
     }
 
-    int snd_len = send_packet(arp_buff, ARP_RQ_PSIZE, sock_raw, dev_index, 
-            src_mac);
-    if (snd_len < 0)  {
+    if (transport_send(t, arp_buff, ARP_RQ_PSIZE) < 0)  {
         free(arp_buff);
 
         return -1;
@@ -176,7 +174,7 @@ char * search_arp_table(const char *ip_address) {
     return NULL;
 }
 
-unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw, 
+unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, 
         const unsigned char *src_mac, const unsigned char *src_ip, 
         int dev_index, const char* dev_name) {
     if (DEBUG >= 0) {
@@ -186,13 +184,29 @@ unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw,
 
     unsigned char *mac_dest;
 
-    int result = send_arp_request(sock_raw, src_mac, src_ip, tar_ip, dev_index);
+    unsigned long long arp_start = get_time_ns();
+
+    // Listen before sending so a fast reply cannot be missed
+    struct transport *t = transport_open(dev_index, src_mac, ETH_P_ARP);
+
+    if (t == NULL) {
+        return NULL;
+    }
+
+    int result = send_arp_request(t, src_mac, src_ip, tar_ip);
 
     if (result < 0) {
+        transport_close(t);
+
         return NULL;
     }
 
-    mac_dest = listen_for_arp_response(src_mac, src_ip, tar_ip);
+    mac_dest = listen_for_arp_response(t, src_mac, src_ip, tar_ip, 
+            ARP_TIMEOUT_MS);
+
+    transport_close(t);
+
+    hist_record(&get_timings()->arp_resolve, get_time_ns() - arp_start);
 
     // If no ARP response detected, check ARP table just in case we have a 
     // cached entry.
@@ -214,13 +228,15 @@ unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw,
 
         struct in_addr *gw_ip_add = get_gw_ip_address(dev_name);
 
-        if (gw_ip_add == NULL) {
+        // No gateway, or the gateway itself did not answer
+        if (gw_ip_add == NULL || 
+                memcmp(&gw_ip_add->s_addr, tar_ip, IP_LEN) == 0) {
             return NULL;
         }
 
         // Recursive call
         mac_dest = get_mac_add_from_ip(get_ip_arr_rep(gw_ip_add), 
-                sock_raw, src_mac, src_ip, dev_index, dev_name);
+                src_mac, src_ip, dev_index, dev_name);
 
         if (mac_dest == NULL) {
             return NULL;
@@ -238,123 +254,95 @@ unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw,
     return mac_dest;
 }
 
-unsigned char * listen_for_arp_response(const unsigned char *loc_mac, 
-        const unsigned char *loc_ip, const unsigned char *tar_ip) {
+unsigned char * listen_for_arp_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip, int timeout_ms) {
     if (DEBUG >= 2) {
         printf("Listening for ARP response\n");
     }
 
-    const int PACKET_SIZE = 65536;
-
-    // Construct raw socket and listen to all ARP packets
-    int arp_sock_raw = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ARP));
+    struct transport_frame frames[TRANSPORT_BATCH];
 
-    if (arp_sock_raw < 0) {
-        return NULL;
-    }
+    // Wait time for each receive in milliseconds
+    const int RECV_TIMEOUT_MS = 100;
 
-    unsigned char *buffer = malloc(PACKET_SIZE * sizeof(char));
-    memset(buffer, 0, PACKET_SIZE * sizeof(char));
+    const unsigned long long timeout_ns = timeout_ms * 1000000ULL;
 
-    struct sockaddr saddr;
-    int saddr_len = sizeof(struct sockaddr);
-
-    // Sleep time in microseconds (currently 0.1 seconds)
-    const int SLEEP_TIME_MICS = 1000 * 1000 * 0.1;
-
-    // Timeout in seconds
-    const int TIMEOUT_SECS = 7;
-
-    long int start_time = time(0);
-    long int curr_time = time(0);
-    while ((curr_time - start_time) <= TIMEOUT_SECS) {
-        // Clear errno
-        errno = 0;
+    unsigned long long start_time = get_time_ns();
+    unsigned long long curr_time = start_time;
+    while ((curr_time - start_time) <= timeout_ns) {
+        // Receive a batch of frames, waiting up to RECV_TIMEOUT_MS
+        int frames_len = transport_recv_batch(t, frames, TRANSPORT_BATCH, 
+                RECV_TIMEOUT_MS);
 
         // Get current time
-        curr_time = time(0);
+        curr_time = get_time_ns();
 
-        // Receive a network packet and copy it into buffer (Non-blocking)
-        int buff_len = recvfrom(arp_sock_raw, buffer, PACKET_SIZE, MSG_DONTWAIT, 
-                &saddr, (socklen_t *)&saddr_len);
-        
-        if (buff_len == -1) {
-            // Would block
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(SLEEP_TIME_MICS);
+        if (frames_len < 0) {
+            // An error occurred
+            return NULL;
+        }
 
-                continue;
-            } else {
-                // An error occurred
-                close(arp_sock_raw);
-                free(buffer);
+        for (int i = 0; i < frames_len; i++) {
+            const unsigned char *buffer = frames[i].data;
 
-                return NULL;
+            if (frames[i].len < ARP_RQ_PSIZE) {
+                continue;
             }
-        }
 
-        // Extract ethernet header
-        struct ethhdr *eth = (struct ethhdr *)(buffer);
+            // Extract ethernet header
+            struct ethhdr *eth = (struct ethhdr *)(buffer);
 
-        if (DEBUG >= 3) {
-            printf("ARP packet received: ");
-            printf("src_mac: %s ", get_mac_str(eth->h_source));
-            printf("dst_mac: %s\n", get_mac_str(eth->h_dest));
-        }
+            if (DEBUG >= 3) {
+                printf("ARP packet received: ");
+                printf("src_mac: %s ", get_mac_str(eth->h_source));
+                printf("dst_mac: %s\n", get_mac_str(eth->h_dest));
+            }
 
-        // Check MAC source address matches local interface
-        if (compare_mac_add(loc_mac, eth->h_dest) != 0) {
-            continue;
-        }
+            // Check MAC source address matches local interface
+            if (compare_mac_add(loc_mac, eth->h_dest) != 0) {
+                continue;
+            }
 
-        // Extract ARP header
-        struct arphdr *arph = (struct arphdr *)(buffer + sizeof(struct ethhdr));
+            // Extract data payload
+            struct arp_payload *arppl = (struct arp_payload *)
+                    (buffer + sizeof(struct ethhdr) + sizeof(struct arphdr));
+            
+            if (DEBUG >= 3) {
+                printf("ARP payload: ");
+                printf("src_ip: %s ", get_ip_arr_str(arppl->src_ip));
+                printf("dst_ip: %s ", get_ip_arr_str(arppl->tar_ip));
+                printf("src_mac: %s ", get_mac_str(arppl->src_mac));
+                printf("dst_mac: %s\n", get_mac_str(arppl->tar_mac));
+            }
 
-        // Extract data payload
-        struct arp_payload *arppl = (struct arp_payload *)
-                (buffer + sizeof(struct ethhdr) + sizeof(struct arphdr));
+            // Check that payload contains target MAC address
+            if ((compare_ip_add(tar_ip, arppl->src_ip) != 0) || 
+                    (compare_ip_add(loc_ip, arppl->tar_ip) != 0) ||
+                    (compare_mac_add(loc_mac, arppl->tar_mac) != 0)) {
+                continue;
+            }
         
-        if (DEBUG >= 3) {
-            printf("ARP payload: ");
-            printf("src_ip: %s ", get_ip_arr_str(arppl->src_ip));
-            printf("dst_ip: %s ", get_ip_arr_str(arppl->tar_ip));
-            printf("src_mac: %s ", get_mac_str(arppl->src_mac));
-            printf("dst_mac: %s\n", get_mac_str(arppl->tar_mac));
-        }
-
-        // Check that payload contains target MAC address
-        if ((compare_ip_add(tar_ip, arppl->src_ip) != 0) || 
-                (compare_ip_add(loc_ip, arppl->tar_ip) != 0) ||
-                (compare_mac_add(loc_mac, arppl->tar_mac) != 0)) {
-            continue;
-        }
-    
-        if (DEBUG >= 2) {
-            printf("Correct ARP reply verified\n");
-        }
-
-        close(arp_sock_raw);
+            if (DEBUG >= 2) {
+                printf("Correct ARP reply verified\n");
+            }
 
-        // Copy MAC address of target to new buffer
-        unsigned char *mac_tar = malloc(sizeof(char) * MAC_LEN);
-        memset(mac_tar, 0, sizeof(char) * MAC_LEN);
+            // Copy MAC address of target to new buffer
+            unsigned char *mac_tar = malloc(sizeof(char) * MAC_LEN);
+            memset(mac_tar, 0, sizeof(char) * MAC_LEN);
 
-        for (int i = 0; i < MAC_LEN; i++) {
-            mac_tar[i] = arppl->src_mac[i];
-        }
+            for (int j = 0; j < MAC_LEN; j++) {
+                mac_tar[j] = arppl->src_mac[j];
+            }
 
-        free(buffer);
+            if (DEBUG >= 2) {
+                printf("Target MAC address: %s\n", get_mac_str(mac_tar));
+            }
 
-        if (DEBUG >= 2) {
-            printf("Target MAC address: %s\n", get_mac_str(mac_tar));
+            return mac_tar;
         }
-
-        return mac_tar;
     }
 
-    close(arp_sock_raw);
-    free (buffer);
-
     if (DEBUG >= 2) {
         printf("Timeout occurred whilst waiting for ARP reply.\n");
     }
@@ -1,8 +1,13 @@
 #include "../constants/constants.h"
 
+struct transport;
+
 // ARP request packet size
 #define ARP_RQ_PSIZE 42         
 
+// Time waited for the ARP reply when resolving an address in milliseconds
+#define ARP_TIMEOUT_MS 7000
+
 // Construct the ARP payload
 struct arp_payload {
     unsigned char src_mac[MAC_LEN];
@@ -35,7 +40,7 @@ unsigned char * make_arp_packet(const unsigned char *src_mac,
  * This will populate the ARP table on the client if the IP address exists on
  * the network.
  * 
- * sock_raw: A raw socket descriptor.
+ * t: The transport to send on.
  * 
  * src_mac: A source MAC address represented in array format.
  * 
@@ -43,13 +48,10 @@ unsigned char * make_arp_packet(const unsigned char *src_mac,
  * 
  * tar_ip: A target IP address represented in array format.
  * 
- * dev_index: The interface device index.
- * 
  * return: Returns 0 on success, -1 on error.
  */
-int send_arp_request(int sock_raw, const unsigned char *src_mac, 
-        const unsigned char *src_ip, const unsigned char *tar_ip, 
-        int dev_index);        
+int send_arp_request(struct transport *t, const unsigned char *src_mac, 
+        const unsigned char *src_ip, const unsigned char *tar_ip);
 
 /* 
  * Function: search_arp_table
@@ -73,8 +75,6 @@ char * search_arp_table(const char *ip_address);
  * 
  * tar_ip: An array representation of an IPv4 address to search for.
  * 
- * sock_raw: Raw socket descriptor.
- * 
  * src_mac: Source MAC address in array format.
  * 
  * src_ip: Source IPv4 address in array format.
@@ -86,7 +86,7 @@ char * search_arp_table(const char *ip_address);
  * return: Returns the MAC address found in array format, or NULL if not found
  *         or error.
  */
-unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw, 
+unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, 
         const unsigned char *src_mac, const unsigned char *src_ip, 
         int dev_index, const char* dev_name);
 
@@ -94,7 +94,8 @@ unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw,
  * Function: listen_for_arp_response
  * ---------------------------------
  * Listens for a ARP reply (op-code 2) for the target IP address.
- * NOTE: Function will timeout after 7 seconds.
+ * 
+ * t: The transport the request was sent on.
  * 
  * loc_mac: The local MAC address in array format.
  * 
@@ -102,8 +103,11 @@ unsigned char * get_mac_add_from_ip(const unsigned char *tar_ip, int sock_raw,
  * 
  * tar_ip: The target IP address in array format.
  * 
+ * timeout_ms: How long to wait for the reply in milliseconds.
+ * 
  * return: Returns the target MAC address on success or NULL on failure or 
  *         error.
  */
-unsigned char * listen_for_arp_response(const unsigned char *loc_mac, 
-        const unsigned char *loc_ip, const unsigned char *tar_ip);
\ No newline at end of file
+unsigned char * listen_for_arp_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip, int timeout_ms);
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include <errno.h>
+
+#include "banner_service.h"
+#include "connect_service.h"
+#include "fingerprint_service.h"
+#include "histogram_service.h"
+#include "../constants/constants.h"
+
+// Phases of a banner connection
+#define BANNER_CONNECTING 0
+#define BANNER_WAITING 1                // Connected, waiting for a buffer
+#define BANNER_READING 2
+
+int banner_pool_init(struct banner_pool *pool, int buffs_len, int buff_len) {
+    pool->buffs = malloc((size_t)buffs_len * buff_len);
+    pool->free = malloc(sizeof(int) * buffs_len);
+
+    if (pool->buffs == NULL || pool->free == NULL) {
+        free(pool->buffs);
+        free(pool->free);
+
+        return -1;
+    }
+
+    pool->buff_len = buff_len;
+    pool->free_len = buffs_len;
+
+    for (int i = 0; i < buffs_len; i++) {
+        pool->free[i] = buffs_len - 1 - i;
+    }
+
+    return 0;
+}
+
+int banner_pool_get(struct banner_pool *pool) {
+    if (pool->free_len == 0) {
+        return -1;
+    }
+
+    return pool->free[--pool->free_len];
+}
+
+void banner_pool_put(struct banner_pool *pool, int buff) {
+    pool->free[pool->free_len++] = buff;
+}
+
+unsigned char * banner_pool_buff(struct banner_pool *pool, int buff) {
+    return pool->buffs + (size_t)buff * pool->buff_len;
+}
+
+void banner_pool_free(struct banner_pool *pool) {
+    free(pool->buffs);
+    free(pool->free);
+}
+
+char * format_banner(const unsigned char *banner, int banner_len, char *str) {
+    while (banner_len > 0 && (banner[banner_len - 1] == '\n' ||
+            banner[banner_len - 1] == '\r')) {
+        banner_len--;
+    }
+
+    char *pos = str;
+
+    for (int i = 0; i < banner_len; i++) {
+        unsigned char c = banner[i];
+
+        if (c == '\r') {
+            pos += sprintf(pos, "\\r");
+        } else if (c == '\n') {
+            pos += sprintf(pos, "\\n");
+        } else if (c == '\t') {
+            pos += sprintf(pos, "\\t");
+        } else if (c == '\\') {
+            pos += sprintf(pos, "\\\\");
+        } else if (c < 0x20 || c >= 0x7f) {
+            pos += sprintf(pos, "\\x%02x", c);
+        } else {
+            *pos++ = (char)c;
+        }
+    }
+
+    *pos = '\0';
+
+    return str;
+}
+
+void log_banner(unsigned short port, const unsigned char *banner,
+        int banner_len, void *ctx) {
+    struct banner_log *log = (struct banner_log *)ctx;
+
+    if (log->len == log->cap) {
+        int cap = log->cap > 0 ? log->cap * 2 : 64;
+        struct logged_banner *banners = realloc(log->banners,
+                sizeof(struct logged_banner) * cap);
+
+        if (banners == NULL) {
+            return;
+        }
+
+        log->banners = banners;
+        log->cap = cap;
+    }
+
+    struct logged_banner *entry = &log->banners[log->len++];
+    entry->port = port;
+    entry->len = banner_len < BANNER_MAX_LEN ? banner_len : BANNER_MAX_LEN;
+    memcpy(entry->data, banner, entry->len);
+    entry->fp = log->matcher != NULL ? match_fingerprint(log->matcher,
+            entry->data, entry->len) : NULL;
+}
+
+static int compare_logged_banners(const void *a, const void *b) {
+    return ((const struct logged_banner *)a)->port -
+            ((const struct logged_banner *)b)->port;
+}
+
+void sort_banner_log(struct banner_log *log) {
+    qsort(log->banners, log->len, sizeof(struct logged_banner),
+            compare_logged_banners);
+}
+
+void free_banner_log(struct banner_log *log) {
+    if (log == NULL) {
+        return;
+    }
+
+    free(log->banners);
+    free(log);
+}
+
+/*
+ * The connections of a banner grab.  Connections are connect_slots ordered
+ * by deadline in a connect_timer, with their phase and buffer alongside.
+ */
+struct banner_grab {
+    int epoll_fd;
+    struct connect_slot slots[BANNER_MAX_CONNS];
+    unsigned char phase[BANNER_MAX_CONNS];
+    int buff[BANNER_MAX_CONNS];
+    int len[BANNER_MAX_CONNS];
+    struct connect_timer timer;
+    int idle_head;
+    struct banner_pool pool;
+    banner_handler handler;
+    void *ctx;
+    int banners;
+};
+
+static void arm_banner_slot(struct banner_grab *grab, int slot,
+        unsigned int events) {
+    // One shot, so a connection waiting for a buffer is not woken again
+    struct epoll_event ev;
+    ev.events = events | EPOLLONESHOT;
+    ev.data.u32 = (unsigned int)slot;
+
+    epoll_ctl(grab->epoll_fd, EPOLL_CTL_MOD, grab->slots[slot].fd, &ev);
+}
+
+/*
+ * Gives a connected slot a buffer and starts reading, if a buffer is free.
+ */
+static void start_reading(struct banner_grab *grab, int slot) {
+    int buff = banner_pool_get(&grab->pool);
+
+    if (buff < 0) {
+        return;
+    }
+
+    grab->phase[slot] = BANNER_READING;
+    grab->buff[slot] = buff;
+    grab->len[slot] = 0;
+
+    arm_banner_slot(grab, slot, EPOLLIN);
+}
+
+static void finish_banner(struct banner_grab *grab, int slot) {
+    struct connect_slot *s = &grab->slots[slot];
+
+    if (grab->phase[slot] == BANNER_READING) {
+        if (grab->len[slot] > 0) {
+            grab->handler(s->port, banner_pool_buff(&grab->pool,
+                    grab->buff[slot]), grab->len[slot], grab->ctx);
+            grab->banners++;
+        }
+
+        banner_pool_put(&grab->pool, grab->buff[slot]);
+    }
+
+    close(s->fd);
+    s->fd = -1;
+    s->port = 0;
+
+    connect_timer_remove(&grab->timer, grab->slots, slot);
+
+    s->next = grab->idle_head;
+    grab->idle_head = slot;
+
+    // The freed buffer goes to the connection waiting longest
+    for (int i = grab->timer.head; i >= 0; i = grab->slots[i].next) {
+        if (grab->phase[i] == BANNER_WAITING) {
+            start_reading(grab, i);
+
+            break;
+        }
+    }
+}
+
+/*
+ * Starts a connection to a port on an idle slot.  Returns -1 if no socket
+ * could be opened.
+ */
+static int start_banner(struct banner_grab *grab, unsigned short port,
+        int family, struct sockaddr_storage *addr, socklen_t addr_len) {
+    int slot = grab->idle_head;
+    struct connect_slot *s = &grab->slots[slot];
+
+    s->fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+    if (s->fd < 0) {
+        return -1;
+    }
+
+    grab->idle_head = s->next;
+
+    s->port = port;
+    s->sent_ns = get_time_ns();
+    s->deadline_ns = s->sent_ns + BANNER_TIMEOUT_MS * 1000000ULL;
+    grab->phase[slot] = BANNER_CONNECTING;
+
+    connect_timer_push(&grab->timer, grab->slots, slot);
+
+    set_connect_port(addr, port);
+
+    int ret = connect(s->fd, (struct sockaddr *)addr, addr_len);
+
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLONESHOT;
+    ev.data.u32 = (unsigned int)slot;
+
+    if ((ret < 0 && errno != EINPROGRESS) ||
+            epoll_ctl(grab->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev) < 0) {
+        finish_banner(grab, slot);
+    }
+
+    return 0;
+}
+
+static void handle_banner_event(struct banner_grab *grab, int slot) {
+    struct connect_slot *s = &grab->slots[slot];
+
+    if (grab->phase[slot] == BANNER_CONNECTING) {
+        int err = 0;
+        socklen_t err_len = sizeof(int);
+        getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+
+        if (err != 0) {
+            finish_banner(grab, slot);
+
+            return;
+        }
+
+        grab->phase[slot] = BANNER_WAITING;
+        start_reading(grab, slot);
+
+        return;
+    }
+
+    if (grab->phase[slot] != BANNER_READING) {
+        return;
+    }
+
+    unsigned char *buff = banner_pool_buff(&grab->pool, grab->buff[slot]);
+    int read_len = read(s->fd, buff + grab->len[slot],
+            BANNER_MAX_LEN - grab->len[slot]);
+
+    if (read_len < 0 && (errno == EAGAIN || errno == EINTR)) {
+        arm_banner_slot(grab, slot, EPOLLIN);
+
+        return;
+    }
+
+    if (read_len > 0) {
+        grab->len[slot] += read_len;
+
+        if (grab->len[slot] < BANNER_MAX_LEN) {
+            arm_banner_slot(grab, slot, EPOLLIN);
+
+            return;
+        }
+    }
+
+    // Full, closed by the port or failed
+    finish_banner(grab, slot);
+}
+
+int grab_banners(const unsigned char *tar_ip, int family,
+        const unsigned short *ports, int ports_len, banner_handler handler,
+        void *ctx) {
+    struct banner_grab *grab = malloc(sizeof(struct banner_grab));
+
+    if (grab == NULL) {
+        return -1;
+    }
+
+    memset(grab, 0, sizeof(struct banner_grab));
+
+    grab->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (grab->epoll_fd < 0 || banner_pool_init(&grab->pool, BANNER_POOL_SIZE,
+            BANNER_MAX_LEN) < 0) {
+        fprintf(stderr, "ERROR: Unable to start grabbing banners!\n");
+
+        if (grab->epoll_fd >= 0) {
+            close(grab->epoll_fd);
+        }
+
+        free(grab);
+
+        return -1;
+    }
+
+    int max_conns = raise_nofile_limit(BANNER_MAX_CONNS);
+
+    grab->handler = handler;
+    grab->ctx = ctx;
+    grab->timer.head = -1;
+    grab->timer.tail = -1;
+    grab->idle_head = 0;
+
+    for (int i = 0; i < max_conns; i++) {
+        grab->slots[i].fd = -1;
+        grab->slots[i].prev = -1;
+        grab->slots[i].next = (i + 1 < max_conns) ? i + 1 : -1;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = make_connect_addr(tar_ip, family, &addr);
+
+    // Longest wait between checks of the deadlines
+    const int MAX_WAIT_MS = 100;
+
+    struct epoll_event events[CONNECT_MAX_EVENTS];
+    int next = 0;
+
+    while (next < ports_len || grab->timer.len > 0) {
+        while (grab->idle_head >= 0 && next < ports_len) {
+            if (start_banner(grab, ports[next], family, &addr,
+                    addr_len) < 0) {
+                break;
+            }
+
+            next++;
+        }
+
+        if (grab->timer.len == 0) {
+            // No socket could be opened with none in use
+            if (next < ports_len) {
+                fprintf(stderr, "ERROR: Unable to open a socket!\n");
+            }
+
+            break;
+        }
+
+        unsigned long long now = get_time_ns();
+        unsigned long long deadline = grab->slots[grab->timer.head].deadline_ns;
+
+        int wait_ms = (deadline <= now) ? 0 :
+                (int)((deadline - now + 999999) / 1000000);
+
+        if (wait_ms > MAX_WAIT_MS) {
+            wait_ms = MAX_WAIT_MS;
+        }
+
+        int events_len = epoll_wait(grab->epoll_fd, events,
+                CONNECT_MAX_EVENTS, wait_ms);
+
+        for (int i = 0; i < events_len; i++) {
+            handle_banner_event(grab, (int)events[i].data.u32);
+        }
+
+        // Banners cut off by their deadline keep what was read so far
+        now = get_time_ns();
+
+        while (grab->timer.head >= 0 &&
+                grab->slots[grab->timer.head].deadline_ns <= now) {
+            finish_banner(grab, grab->timer.head);
+        }
+    }
+
+    int banners = grab->banners;
+
+    close(grab->epoll_fd);
+    banner_pool_free(&grab->pool);
+    free(grab);
+
+    return banners;
+}
+
+int grab_open_port_banners(const unsigned char *tar_ip,
+        const struct scan_state *state, banner_handler handler, void *ctx) {
+    unsigned short *ports = malloc(sizeof(unsigned short) * MAX_PORT);
+    int ports_len = 0;
+
+    if (ports == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    for (int port = 1; port <= MAX_PORT; port++) {
+        if (state->port_states[port] == PORT_STATE_OPEN) {
+            ports[ports_len++] = (unsigned short)port;
+        }
+    }
+
+    int ret = grab_banners(tar_ip, state->family, ports, ports_len, handler,
+            ctx);
+
+    free(ports);
+
+    return ret;
+}
@@ -0,0 +1,206 @@
+#ifndef BANNER_SERVICE_H
+#define BANNER_SERVICE_H
+
+#include "checkpoint_service.h"
+
+struct fingerprint;
+struct fingerprint_matcher;
+
+// Bytes read from each open port
+#define BANNER_MAX_LEN 256
+
+// Buffers in the pool, the most banners being read at once
+#define BANNER_POOL_SIZE 256
+
+// Connections in flight at once, connected ones wait for a free buffer
+#define BANNER_MAX_CONNS 1024
+
+// Time from connecting to a port until its banner is cut off in milliseconds
+#define BANNER_TIMEOUT_MS 3000
+
+// Length of a banner formatted for printing, with every byte escaped
+#define BANNER_STR_LEN (BANNER_MAX_LEN * 4 + 1)
+
+// Called with the banner of a port as soon as it has been read
+typedef void (*banner_handler)(unsigned short port,
+        const unsigned char *banner, int banner_len, void *ctx);
+
+/*
+ * Struct: logged_banner
+ * ---------------------
+ * A banner read from an open port.
+ *
+ * fp: The fingerprint identifying the service, or NULL if none matched.
+ */
+struct logged_banner {
+    unsigned short port;
+    int len;
+    unsigned char data[BANNER_MAX_LEN];
+    const struct fingerprint *fp;
+};
+
+/*
+ * Struct: banner_log
+ * ------------------
+ * The banners read from a target, kept with its scan state so they are
+ * printed after the scan rather than in the middle of its output, and
+ * written to the results.
+ *
+ * banners: The banners, in the order they were read.
+ *
+ * len: The number of banners.
+ *
+ * cap: The capacity of banners.
+ *
+ * matcher: The fingerprints the banners are identified with.
+ */
+struct banner_log {
+    struct logged_banner *banners;
+    int len;
+    int cap;
+    const struct fingerprint_matcher *matcher;
+};
+
+/*
+ * Struct: banner_pool
+ * -------------------
+ * A fixed set of equally sized buffers allocated up front, so memory does not
+ * grow with the number of ports.
+ *
+ * buffs: The buffers, stored back to back.
+ *
+ * buff_len: The length of each buffer.
+ *
+ * free: A stack of the indices of the free buffers.
+ *
+ * free_len: The number of free buffers.
+ */
+struct banner_pool {
+    unsigned char *buffs;
+    int buff_len;
+    int *free;
+    int free_len;
+};
+
+/*
+ * Function: banner_pool_init
+ * --------------------------
+ * Allocates a buffer pool.
+ *
+ * pool: The pool to initialise.
+ *
+ * buffs_len: The number of buffers.
+ *
+ * buff_len: The length of each buffer.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int banner_pool_init(struct banner_pool *pool, int buffs_len, int buff_len);
+
+/*
+ * Function: banner_pool_get
+ * -------------------------
+ * return: The index of a free buffer, or -1 if every buffer is in use.
+ */
+int banner_pool_get(struct banner_pool *pool);
+
+/*
+ * Function: banner_pool_put
+ * -------------------------
+ * Returns a buffer to the pool.
+ */
+void banner_pool_put(struct banner_pool *pool, int buff);
+
+/*
+ * Function: banner_pool_buff
+ * --------------------------
+ * return: The buffer with an index.
+ */
+unsigned char * banner_pool_buff(struct banner_pool *pool, int buff);
+
+/*
+ * Function: banner_pool_free
+ * --------------------------
+ * Frees the buffers of a pool.
+ */
+void banner_pool_free(struct banner_pool *pool);
+
+/*
+ * Function: format_banner
+ * -----------------------
+ * Formats a banner for printing on one line.  Trailing line breaks are
+ * dropped and other non-printable bytes are escaped as \r, \n, \t or \xNN.
+ *
+ * banner: The banner.
+ *
+ * banner_len: The length of the banner.
+ *
+ * str: A buffer of at least BANNER_STR_LEN bytes.
+ *
+ * return: str.
+ */
+char * format_banner(const unsigned char *banner, int banner_len, char *str);
+
+/*
+ * Function: log_banner
+ * --------------------
+ * A banner_handler adding each banner, with the fingerprint it matches, to
+ * the banner_log passed as ctx.
+ */
+void log_banner(unsigned short port, const unsigned char *banner,
+        int banner_len, void *ctx);
+
+/*
+ * Function: sort_banner_log
+ * -------------------------
+ * Orders the banners of a log by port.
+ */
+void sort_banner_log(struct banner_log *log);
+
+/*
+ * Function: free_banner_log
+ * -------------------------
+ * Frees a banner log allocated with malloc and its banners.
+ */
+void free_banner_log(struct banner_log *log);
+
+/*
+ * Function: grab_banners
+ * ----------------------
+ * Connects to many ports at once with non-blocking sockets multiplexed with
+ * epoll and reads the first BANNER_MAX_LEN bytes each one sends.  A banner
+ * ends when the buffer is full, the port closes the connection or
+ * BANNER_TIMEOUT_MS has passed since connecting.  Connected sockets wait for
+ * a buffer from a pool of BANNER_POOL_SIZE, so memory stays bounded however
+ * many ports are open.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * family: AF_INET, or AF_INET6 for an IPv6 target.
+ *
+ * ports: The ports to grab banners from.
+ *
+ * ports_len: The length of the ports array.
+ *
+ * handler: Called with every banner that is not empty, as it completes.
+ *
+ * ctx: Passed to the handler.
+ *
+ * return: The number of banners read, or -1 on error.
+ */
+int grab_banners(const unsigned char *tar_ip, int family,
+        const unsigned short *ports, int ports_len, banner_handler handler,
+        void *ctx);
+
+/*
+ * Function: grab_open_port_banners
+ * --------------------------------
+ * Grabs the banners of every port a scan found open.  Arguments are as for
+ * grab_banners.
+ *
+ * return: The number of banners read, or -1 on error.
+ */
+int grab_open_port_banners(const unsigned char *tar_ip,
+        const struct scan_state *state, banner_handler handler, void *ctx);
+
+#endif
\ No newline at end of file
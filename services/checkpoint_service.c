@@ -0,0 +1,377 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#include "checkpoint_service.h"
+#include "banner_service.h"
+#include "histogram_service.h"
+#include "../constants/constants.h"
+
+// Scan states marked by the SIGINT handler
+static struct scan_state *interrupt_states[MAX_INTERRUPT_STATES];
+static int interrupt_states_len = 0;
+
+struct scan_state * create_scan_state(unsigned int tar_ip, 
+        unsigned char full_scan, unsigned int seed, 
+        const char *checkpoint_path) {
+    // Keep the per-thread stats counters on their own cache lines
+    struct scan_state *state = aligned_alloc(CACHE_LINE_SIZE, 
+            sizeof(struct scan_state));
+
+    if (state == NULL) {
+        return NULL;
+    }
+
+    memset(state, 0, sizeof(struct scan_state));
+    init_scan_stats(&state->stats);
+
+    state->tar_ip = tar_ip;
+    state->family = AF_INET;
+    state->full_scan = full_scan;
+    state->seed = seed;
+    state->checkpoint_path = checkpoint_path;
+    state->last_save = time(0);
+
+    atomic_init(&state->cursor, 0);
+    atomic_init(&state->interrupted, 0);
+
+    state->probe_src_ports = calloc(MAX_PORT + 1, sizeof(atomic_ushort));
+
+    if (state->probe_src_ports == NULL) {
+        free(state);
+
+        return NULL;
+    }
+
+    // Send times are only kept to measure probe round trip times
+    if (get_timings()->enabled) {
+        state->probe_sent_ns = calloc(MAX_PORT + 1, sizeof(atomic_ullong));
+    }
+
+    return state;
+}
+
+void free_scan_state(struct scan_state *state) {
+    if (state == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < interrupt_states_len; i++) {
+        if (interrupt_states[i] == state) {
+            interrupt_states[i] = NULL;
+        }
+    }
+
+    free(state->probe_sent_ns);
+    free(state->probe_src_ports);
+    free_banner_log(state->banners);
+    free(state);
+}
+
+void reset_scan_state(struct scan_state *state) {
+    memset(state->port_states, PORT_STATE_UNKNOWN, 
+            sizeof(state->port_states));
+    memset(state->probe_src_ports, 0, 
+            sizeof(atomic_ushort) * (MAX_PORT + 1));
+
+    if (state->probe_sent_ns != NULL) {
+        memset(state->probe_sent_ns, 0, 
+                sizeof(atomic_ullong) * (MAX_PORT + 1));
+    }
+
+    if (state->banners != NULL) {
+        state->banners->len = 0;
+    }
+
+    reset_scan_stats(&state->stats);
+
+    atomic_store(&state->cursor, 0);
+    state->last_cursor = 0;
+}
+
+struct scan_state * load_checkpoint(const char *path, 
+        const struct interval_set *targets, unsigned int top_ports_len) {
+    if (DEBUG >= 2) {
+        printf("Loading checkpoint: %s\n", path);
+    }
+
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot open checkpoint file: %s\n", path);
+
+        return NULL;
+    }
+
+    struct checkpoint_header header;
+
+    if (fread(&header, sizeof(struct checkpoint_header), 1, fp) != 1 ||
+            header.magic != CHECKPOINT_MAGIC || 
+            header.version != CHECKPOINT_VERSION ||
+            header.cursor > header.probes_len || 
+            (header.full_scan && header.probes_len != MAX_PORT) || 
+            (!header.full_scan && (header.probes_len == 0 || 
+            header.probes_len > top_ports_len)) || 
+            header.target_index >= header.targets_len) {
+        fprintf(stderr, "ERROR: Invalid checkpoint file: %s\n", path);
+        fclose(fp);
+
+        return NULL;
+    }
+
+    // A target list is resumed at the target of the checkpoint
+    if ((targets->size == 0 && header.targets_len != 1) || 
+            (targets->size > 0 && (targets->size != header.targets_len || 
+            htonl(interval_set_at(targets, header.target_index)) != 
+            header.tar_ip))) {
+        fprintf(stderr, "ERROR: Target IP does not match checkpoint!\n");
+        fclose(fp);
+
+        return NULL;
+    }
+
+    struct scan_state *state = create_scan_state(header.tar_ip, 
+            header.full_scan, header.seed, path);
+
+    if (state == NULL) {
+        fclose(fp);
+
+        return NULL;
+    }
+
+    struct checkpoint_entry entry;
+
+    for (unsigned int i = 0; i < header.entries_len; i++) {
+        if (fread(&entry, sizeof(struct checkpoint_entry), 1, fp) != 1) {
+            fprintf(stderr, "ERROR: Truncated checkpoint file: %s\n", path);
+            fclose(fp);
+            free_scan_state(state);
+
+            return NULL;
+        }
+
+        if (entry.state > PORT_STATE_FILTERED) {
+            fprintf(stderr, "ERROR: Invalid checkpoint file: %s\n", path);
+            fclose(fp);
+            free_scan_state(state);
+
+            return NULL;
+        }
+
+        state->port_states[entry.port] = entry.state;
+    }
+
+    fclose(fp);
+
+    state->targets = targets->size > 1 ? targets : NULL;
+    state->target_index = header.target_index;
+    state->probes_len = header.probes_len;
+    state->last_cursor = header.cursor;
+    atomic_store(&state->cursor, header.cursor);
+
+    return state;
+}
+
+/*
+ * Atomically replaces the checkpoint file with the header, followed by the
+ * ports of port_states with a known state, or none if port_states is NULL.
+ */
+static int write_checkpoint(const char *path, 
+        struct checkpoint_header *header, const unsigned char *port_states) {
+    const int MAX_PATH = 4096;
+    char *tmp_path = malloc(sizeof(char) * MAX_PATH);
+    snprintf(tmp_path, MAX_PATH, "%s.tmp", path);
+
+    FILE *fp = fopen(tmp_path, "wb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot write checkpoint file: %s\n", tmp_path);
+        free(tmp_path);
+
+        return -1;
+    }
+
+    header->magic = CHECKPOINT_MAGIC;
+    header->version = CHECKPOINT_VERSION;
+    header->entries_len = 0;
+
+    for (int port = 0; port_states != NULL && port <= MAX_PORT; port++) {
+        if (port_states[port] != PORT_STATE_UNKNOWN) {
+            header->entries_len++;
+        }
+    }
+
+    int ok = (fwrite(header, sizeof(struct checkpoint_header), 1, fp) == 1);
+
+    struct checkpoint_entry entry;
+    memset(&entry, 0, sizeof(struct checkpoint_entry));
+
+    for (int port = 0; ok && port_states != NULL && port <= MAX_PORT; 
+            port++) {
+        if (port_states[port] == PORT_STATE_UNKNOWN) {
+            continue;
+        }
+
+        entry.port = (unsigned short)port;
+        entry.state = port_states[port];
+
+        ok = (fwrite(&entry, sizeof(struct checkpoint_entry), 1, fp) == 1);
+    }
+
+    // Make sure the data is on disk before it replaces the old checkpoint
+    ok = ok && (fflush(fp) == 0) && (fsync(fileno(fp)) == 0);
+    ok = (fclose(fp) == 0) && ok;
+    ok = ok && (rename(tmp_path, path) == 0);
+
+    if (!ok) {
+        fprintf(stderr, "ERROR: Cannot write checkpoint file: %s\n", tmp_path);
+        unlink(tmp_path);
+        free(tmp_path);
+
+        return -1;
+    }
+
+    free(tmp_path);
+
+    return 0;
+}
+
+/*
+ * Fills in the header fields shared by every checkpoint of a scan.
+ */
+static void init_checkpoint_header(const struct scan_state *state, 
+        struct checkpoint_header *header) {
+    memset(header, 0, sizeof(struct checkpoint_header));
+
+    header->full_scan = state->full_scan;
+    header->tar_ip = state->tar_ip;
+    header->seed = state->seed;
+    header->probes_len = state->probes_len;
+    header->target_index = state->target_index;
+    header->targets_len = state->targets != NULL ? state->targets->size : 1;
+}
+
+int save_checkpoint(struct scan_state *state, unsigned int cursor) {
+    if (state->checkpoint_path == NULL) {
+        return 0;
+    }
+
+    struct checkpoint_header header;
+    init_checkpoint_header(state, &header);
+
+    header.cursor = cursor;
+
+    if (write_checkpoint(state->checkpoint_path, &header, 
+            state->port_states) < 0) {
+        return -1;
+    }
+
+    if (DEBUG >= 2) {
+        printf("Checkpoint saved at probe %u of %u\n", cursor, 
+                state->probes_len);
+    }
+
+    return 0;
+}
+
+void checkpoint_tick(struct scan_state *state) {
+    if (state->checkpoint_path == NULL) {
+        return;
+    }
+
+    long int curr_time = time(0);
+
+    if ((curr_time - state->last_save) < CHECKPOINT_INTERVAL_S) {
+        return;
+    }
+
+    unsigned int cursor = atomic_load_explicit(&state->cursor, 
+            memory_order_relaxed);
+
+    save_checkpoint(state, state->last_cursor);
+
+    state->last_cursor = cursor;
+    state->last_save = curr_time;
+}
+
+void finish_checkpoint(struct scan_state *state) {
+    if (state->checkpoint_path == NULL) {
+        return;
+    }
+
+    if (scan_interrupted(state)) {
+        unsigned int cursor = atomic_load_explicit(&state->cursor, 
+                memory_order_relaxed);
+
+        if (save_checkpoint(state, cursor) == 0) {
+            printf("Scan interrupted, resume with: --resume %s\n", 
+                    state->checkpoint_path);
+        }
+    } else if (state->targets != NULL && 
+            state->target_index + 1 < state->targets->size) {
+        // The next target of the list starts from its first probe
+        struct checkpoint_header header;
+        init_checkpoint_header(state, &header);
+
+        header.target_index++;
+        header.tar_ip = htonl(interval_set_at(state->targets, 
+                header.target_index));
+
+        write_checkpoint(state->checkpoint_path, &header, NULL);
+    } else {
+        unlink(state->checkpoint_path);
+    }
+}
+
+static void handle_interrupt(int sig) {
+    (void)sig;
+
+    for (int i = 0; i < interrupt_states_len; i++) {
+        if (interrupt_states[i] != NULL) {
+            atomic_store_explicit(&interrupt_states[i]->interrupted, 1, 
+                    memory_order_release);
+        }
+    }
+}
+
+int install_interrupt_handler(struct scan_state *state) {
+    return install_group_interrupt_handler(&state, 1);
+}
+
+int install_group_interrupt_handler(struct scan_state **states, 
+        int states_len) {
+    if (states_len > MAX_INTERRUPT_STATES) {
+        return -1;
+    }
+
+    memcpy(interrupt_states, states, sizeof(struct scan_state *) * 
+            states_len);
+    interrupt_states_len = states_len;
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(struct sigaction));
+
+    act.sa_handler = handle_interrupt;
+
+    // Restore the default handler so a second SIGINT kills the process
+    act.sa_flags = SA_RESETHAND;
+    sigemptyset(&act.sa_mask);
+
+    if (sigaction(SIGINT, &act, NULL) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int scan_interrupted(struct scan_state *state) {
+    return atomic_load_explicit(&state->interrupted, memory_order_acquire);
+}
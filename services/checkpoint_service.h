@@ -0,0 +1,252 @@
+#ifndef CHECKPOINT_SERVICE_H
+#define CHECKPOINT_SERVICE_H
+
+#include <stdatomic.h>
+
+#include "interval_set.h"
+#include "stats_service.h"
+#include "../constants/constants.h"
+
+#define CHECKPOINT_MAGIC 0x4b43504d     // "MPCK"
+#define CHECKPOINT_VERSION 3            // Target cursor of target lists
+
+// Seconds between periodic checkpoints
+#define CHECKPOINT_INTERVAL_S 2
+
+// Seconds to wait for outstanding replies after an interrupt
+#define INTERRUPT_GRACE_S 1
+
+// Most scan states the SIGINT handler marks at once
+#define MAX_INTERRUPT_STATES 16
+
+struct handshake;
+struct banner_log;
+
+/*
+ * Struct: scan_state
+ * ------------------
+ * The resumable state of a port scan, shared between the sending thread, the
+ * consumer and the SIGINT handler.
+ *
+ * tar_ip: The target IP address (network byte order).
+ *
+ * family: AF_INET, or AF_INET6 for an IPv6 target.
+ *
+ * tar_ip6: The target IPv6 address when family is AF_INET6.  IPv6 scans are
+ *          not checkpointed.
+ *
+ * full_scan: 1 if every port is being scanned, 0 for the common ports.
+ *
+ * targets: The target list the target is scanned as part of, or NULL for a
+ *          single target.  Not owned by the scan state.
+ *
+ * target_index: The index of the target in targets (see interval_set_at).
+ *
+ * seed: The seed used for the source port RNG.
+ *
+ * cursor: Index of the next probe to send.  Only written by the sender.
+ *
+ * probes_len: The total number of probes in the scan.
+ *
+ * last_cursor: The cursor observed at the previous checkpoint tick.
+ *
+ * last_save: Time of the last checkpoint.
+ *
+ * port_states: Per-port PORT_STATE_* table.  Only written by the consumer.
+ *
+ * interrupted: Set by the SIGINT handler.
+ *
+ * checkpoint_path: File to write checkpoints to, or NULL to disable them.
+ *
+ * stats: Live statistics of the scan.
+ *
+ * probe_sent_ns: When the probe to each port was sent, or NULL if timings are
+ *                disabled.
+ *
+ * probe_src_ports: The source port the probe to each port was sent from, or
+ *                  0 if none was sent, to check the probes ICMP errors quote.
+ *
+ * handshake: Completes handshakes with open ports to read their banners, or
+ *            NULL.  Not owned by the scan state.
+ *
+ * banners: The banners read from the open ports, or NULL if banners are not
+ *          read.  Freed with the scan state.
+ */
+struct scan_state {
+    unsigned int tar_ip;
+    unsigned short family;
+    unsigned char tar_ip6[IP6_LEN];
+    unsigned char full_scan;
+    const struct interval_set *targets;
+    unsigned long long target_index;
+    unsigned int seed;
+    atomic_uint cursor;
+    unsigned int probes_len;
+    unsigned int last_cursor;
+    long int last_save;
+    unsigned char port_states[MAX_PORT + 1];
+    atomic_uchar interrupted;
+    const char *checkpoint_path;
+    struct scan_stats stats;
+    atomic_ullong *probe_sent_ns;
+    atomic_ushort *probe_src_ports;
+    struct handshake *handshake;
+    struct banner_log *banners;
+};
+
+/*
+ * Struct: checkpoint_header
+ * -------------------------
+ * The fixed size header at the start of a checkpoint file.  It is followed by
+ * entries_len checkpoint_entry records, one per port with a known state.
+ *
+ * target_index and targets_len are the target cursor of a target list: the 
+ * index of tar_ip in the list and the size of the list, 1 for a single 
+ * target.
+ */
+struct checkpoint_header {
+    unsigned int magic;
+    unsigned short version;
+    unsigned char full_scan;
+    unsigned char reserved;
+    unsigned int tar_ip;
+    unsigned int seed;
+    unsigned int cursor;
+    unsigned int probes_len;
+    unsigned int entries_len;
+    unsigned long long target_index;
+    unsigned long long targets_len;
+};
+
+struct checkpoint_entry {
+    unsigned short port;
+    unsigned char state;
+    unsigned char reserved;
+};
+
+/*
+ * Function: create_scan_state
+ * ---------------------------
+ * Allocates a zeroed scan state for a new IPv4 scan.  IPv6 scans set the
+ * family and tar_ip6 afterwards.
+ *
+ * tar_ip: The target IP address (network byte order).
+ *
+ * full_scan: 1 for a full scan, 0 for a common ports scan.
+ *
+ * seed: The source port RNG seed.
+ *
+ * checkpoint_path: File to write checkpoints to, or NULL to disable them.
+ *
+ * return: A new scan state, or NULL on error.
+ */
+struct scan_state * create_scan_state(unsigned int tar_ip, 
+        unsigned char full_scan, unsigned int seed, 
+        const char *checkpoint_path);
+
+/*
+ * Function: free_scan_state
+ * -------------------------
+ * Frees a scan state, unmarking it for the SIGINT handler first.
+ */
+void free_scan_state(struct scan_state *state);
+
+/*
+ * Function: reset_scan_state
+ * --------------------------
+ * Forgets the probes sent, the results and the counters of a scan, so its
+ * ports can be scanned again from the start.
+ */
+void reset_scan_state(struct scan_state *state);
+
+/*
+ * Function: load_checkpoint
+ * -------------------------
+ * Loads a scan state from a checkpoint file so the scan can be resumed.
+ * Further checkpoints are written back to the same file.
+ *
+ * path: The checkpoint file.
+ *
+ * targets: The target list, which must be the one the checkpointed scan was
+ *          run with, or empty to resume the target of the checkpoint alone.
+ *
+ * top_ports_len: The length of the top ports table, the most probes a common
+ *                ports scan can have.
+ *
+ * return: The restored scan state, or NULL on error.
+ */
+struct scan_state * load_checkpoint(const char *path, 
+        const struct interval_set *targets, unsigned int top_ports_len);
+
+/*
+ * Function: save_checkpoint
+ * -------------------------
+ * Atomically replaces the checkpoint file with the current scan state.  The
+ * state is written to a temporary file which is synced and renamed over the
+ * checkpoint.
+ *
+ * state: The scan state.
+ *
+ * cursor: The probe cursor to record.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int save_checkpoint(struct scan_state *state, unsigned int cursor);
+
+/*
+ * Function: checkpoint_tick
+ * -------------------------
+ * Writes a periodic checkpoint if CHECKPOINT_INTERVAL_S has elapsed.  The
+ * cursor recorded is the one observed at the previous tick, so probes that
+ * may still have replies in flight are sent again on resume.
+ *
+ * state: The scan state.
+ */
+void checkpoint_tick(struct scan_state *state);
+
+/*
+ * Function: finish_checkpoint
+ * ---------------------------
+ * Called when a scan stops.  If the scan was interrupted the final state is
+ * flushed to the checkpoint file.  Otherwise the checkpoint moves on to the 
+ * next target of a target list, or is removed after the last target.
+ *
+ * state: The scan state.
+ */
+void finish_checkpoint(struct scan_state *state);
+
+/*
+ * Function: install_interrupt_handler
+ * -----------------------------------
+ * Installs a SIGINT handler that marks the scan as interrupted so partial
+ * results and the checkpoint can be flushed.  A second SIGINT kills the 
+ * process.
+ *
+ * state: The scan state to mark.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int install_interrupt_handler(struct scan_state *state);
+
+/*
+ * Function: install_group_interrupt_handler
+ * -----------------------------------------
+ * As install_interrupt_handler, for several targets scanned at once.
+ *
+ * states: The scan states to mark.
+ *
+ * states_len: The number of scan states, at most MAX_INTERRUPT_STATES.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int install_group_interrupt_handler(struct scan_state **states, 
+        int states_len);
+
+/*
+ * Function: scan_interrupted
+ * --------------------------
+ * return: 1 if the scan was interrupted, otherwise 0.
+ */
+int scan_interrupted(struct scan_state *state);
+
+#endif
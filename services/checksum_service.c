@@ -2,6 +2,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <arpa/inet.h>
+
 #include "checksum_service.h"
 #include "../constants/constants.h"
 
@@ -138,4 +140,47 @@ unsigned short icmp_checksum(const unsigned short* start_of_header) {
     }
 
     return result;
+}
+
+unsigned long checksum_add(unsigned long sum, const void *data, int len) {
+    const unsigned char *bytes = (const unsigned char *)data;
+
+    while (len > 1) {
+        unsigned short word;
+        memcpy(&word, bytes, sizeof(unsigned short));
+
+        sum += word;
+        bytes += 2;
+        len -= 2;
+    }
+
+    if (len == 1) {
+        unsigned short word = 0;
+        memcpy(&word, bytes, 1);
+
+        sum += word;
+    }
+
+    return sum;
+}
+
+unsigned short checksum_fold(unsigned long sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+
+    return (unsigned short)~sum;
+}
+unsigned long ip6_pseudo_sum(const unsigned char *saddr, 
+        const unsigned char *daddr, unsigned int len, 
+        unsigned char next_header) {
+    // Upper layer length and next header, each as a 32 bit field
+    unsigned int trailer[2];
+    trailer[0] = htonl(len);
+    trailer[1] = htonl(next_header);
+
+    unsigned long sum = checksum_add(0, saddr, IP6_LEN);
+    sum = checksum_add(sum, daddr, IP6_LEN);
+
+    return checksum_add(sum, trailer, sizeof(trailer));
 }
\ No newline at end of file
@@ -56,4 +56,51 @@ unsigned short tcp_checksum(const unsigned short* start_of_header,
  * 
  * return: The checksum result.
  */
-unsigned short icmp_checksum(const unsigned short* start_of_header);
\ No newline at end of file
+unsigned short icmp_checksum(const unsigned short* start_of_header);
+
+/*
+ * Function: checksum_add
+ * ----------------------
+ * Adds a buffer to a running ones complement sum.  Used for checksums over
+ * variable length data.  A trailing odd byte is padded with zero.
+ * 
+ * sum: The running sum (0 to start).
+ * 
+ * data: The data to add.
+ * 
+ * len: The length of data in bytes.
+ * 
+ * return: The new running sum.
+ */
+unsigned long checksum_add(unsigned long sum, const void *data, int len);
+
+/*
+ * Function: checksum_fold
+ * -----------------------
+ * Folds a running sum in to 16 bits and returns its ones complement.
+ * 
+ * sum: The running sum.
+ * 
+ * return: The checksum result.
+ */
+unsigned short checksum_fold(unsigned long sum);
+
+/*
+ * Function: ip6_pseudo_sum
+ * ------------------------
+ * Starts a running sum with the IPv6 pseudo header used by the TCP, UDP and
+ * ICMPv6 checksums over IPv6.
+ * 
+ * saddr: The IPv6 source address.
+ * 
+ * daddr: The IPv6 destination address.
+ * 
+ * len: The length of the upper layer packet (header and data) in bytes.
+ * 
+ * next_header: The upper layer protocol number.
+ * 
+ * return: The running sum.
+ */
+unsigned long ip6_pseudo_sum(const unsigned char *saddr, 
+        const unsigned char *daddr, unsigned int len, 
+        unsigned char next_header);
\ No newline at end of file
@@ -0,0 +1,456 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <errno.h>
+
+#include "connect_service.h"
+#include "tcp_service.h"
+#include "histogram_service.h"
+#include "network_helper.h"
+#include "../constants/constants.h"
+
+int raise_nofile_limit(int wanted) {
+    struct rlimit lim;
+
+    if (getrlimit(RLIMIT_NOFILE, &lim) < 0) {
+        return 1;
+    }
+
+    rlim_t needed = (rlim_t)wanted + CONNECT_RESERVED_FDS;
+
+    if (lim.rlim_cur < needed) {
+        lim.rlim_cur = (lim.rlim_max < needed) ? lim.rlim_max : needed;
+
+        if (setrlimit(RLIMIT_NOFILE, &lim) < 0) {
+            getrlimit(RLIMIT_NOFILE, &lim);
+        }
+    }
+
+    long int usable = (long int)lim.rlim_cur - CONNECT_RESERVED_FDS;
+
+    if (usable > wanted) {
+        usable = wanted;
+    }
+
+    if (DEBUG >= 2) {
+        printf("RLIMIT_NOFILE is %lu, using %ld sockets\n",
+                (unsigned long)lim.rlim_cur, usable);
+    }
+
+    return usable < 1 ? 1 : (int)usable;
+}
+
+void connect_timer_push(struct connect_timer *timer,
+        struct connect_slot *slots, int slot) {
+    slots[slot].prev = timer->tail;
+    slots[slot].next = -1;
+
+    if (timer->tail >= 0) {
+        slots[timer->tail].next = slot;
+    } else {
+        timer->head = slot;
+    }
+
+    timer->tail = slot;
+    timer->len++;
+}
+
+void connect_timer_remove(struct connect_timer *timer,
+        struct connect_slot *slots, int slot) {
+    struct connect_slot *s = &slots[slot];
+
+    if (s->prev >= 0) {
+        slots[s->prev].next = s->next;
+    } else {
+        timer->head = s->next;
+    }
+
+    if (s->next >= 0) {
+        slots[s->next].prev = s->prev;
+    } else {
+        timer->tail = s->prev;
+    }
+
+    s->prev = -1;
+    s->next = -1;
+    timer->len--;
+}
+
+socklen_t make_connect_addr(const unsigned char *tar_ip, int family,
+        struct sockaddr_storage *addr) {
+    memset(addr, 0, sizeof(struct sockaddr_storage));
+
+    if (family == AF_INET6) {
+        struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+        sin6->sin6_family = AF_INET6;
+        memcpy(&sin6->sin6_addr, tar_ip, IP6_LEN);
+
+        return sizeof(struct sockaddr_in6);
+    }
+
+    struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+    sin->sin_family = AF_INET;
+    memcpy(&sin->sin_addr, tar_ip, IP_LEN);
+
+    return sizeof(struct sockaddr_in);
+}
+
+void set_connect_port(struct sockaddr_storage *addr, unsigned short port) {
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)addr)->sin6_port = htons(port);
+    } else {
+        ((struct sockaddr_in *)addr)->sin_port = htons(port);
+    }
+}
+
+/*
+ * Maps the result of a connection to a PORT_STATE_*, or PORT_STATE_UNKNOWN if
+ * it says nothing about the port.
+ */
+static unsigned char classify_connect_error(int err) {
+    switch (err) {
+        case 0:
+            return PORT_STATE_OPEN;
+        case ECONNREFUSED:
+            return PORT_STATE_CLOSED;
+        case EHOSTUNREACH:
+        case ENETUNREACH:
+        case EACCES:
+        case EPERM:
+            return PORT_STATE_FILTERED;
+        default:
+            return PORT_STATE_UNKNOWN;
+    }
+}
+
+/*
+ * Records the state of a port.  Returns 1 if the port is newly open.
+ */
+static int record_connect_result(struct scan_state *state,
+        unsigned short port, int err, unsigned long long sent_ns) {
+    unsigned char port_state = classify_connect_error(err);
+
+    if (port_state == PORT_STATE_UNKNOWN ||
+            state->port_states[port] != PORT_STATE_UNKNOWN) {
+        return 0;
+    }
+
+    stats_inc(&state->stats.receiver.replies_received);
+    hist_record(&get_timings()->probe_rtt, get_time_ns() - sent_ns);
+
+    state->port_states[port] = port_state;
+
+    if (port_state == PORT_STATE_OPEN) {
+        stats_inc(&state->stats.consumer.open);
+
+        if (DEBUG >= 2) {
+            printf("Open TCP port detected: %d\n", port);
+        }
+
+        return 1;
+    }
+
+    if (port_state == PORT_STATE_CLOSED) {
+        stats_inc(&state->stats.consumer.closed);
+    } else {
+        stats_inc(&state->stats.consumer.filtered);
+    }
+
+    return 0;
+}
+
+/*
+ * Re-arms a slot so it wakes when its connection finishes.
+ */
+static int arm_slot(int epoll_fd, int op, int fd, int slot) {
+    // One shot, so a slot only wakes once per connection
+    struct epoll_event ev;
+    ev.events = EPOLLOUT | EPOLLONESHOT;
+    ev.data.u32 = (unsigned int)slot;
+
+    return epoll_ctl(epoll_fd, op, fd, &ev);
+}
+
+/*
+ * Starts a connection on an idle slot.  A socket already used is reset with
+ * an AF_UNSPEC connect and re-armed rather than closed and created again.
+ *
+ * Returns 1 if the connection is in flight, 0 if it finished at once with
+ * *err holding its result, or -1 if the slot could not be used.
+ */
+static int start_connect(int epoll_fd, struct connect_slot *slots, int slot,
+        int family, struct sockaddr_storage *addr, socklen_t addr_len,
+        int *err) {
+    struct connect_slot *s = &slots[slot];
+    int op = EPOLL_CTL_MOD;
+
+    if (s->fd < 0) {
+        s->fd = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+        if (s->fd < 0) {
+            return -1;
+        }
+
+        op = EPOLL_CTL_ADD;
+    } else {
+        struct sockaddr unspec;
+        memset(&unspec, 0, sizeof(struct sockaddr));
+        unspec.sa_family = AF_UNSPEC;
+
+        connect(s->fd, &unspec, sizeof(struct sockaddr));
+
+        // Drop the error the reset left, so it is not taken for the result
+        // of the next connection
+        int err_stale;
+        socklen_t err_len = sizeof(int);
+        getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err_stale, &err_len);
+    }
+
+    set_connect_port(addr, s->port);
+
+    if (connect(s->fd, (struct sockaddr *)addr, addr_len) == 0) {
+        *err = 0;
+
+        return 0;
+    }
+
+    if (errno != EINPROGRESS) {
+        *err = errno;
+
+        return 0;
+    }
+
+    if (arm_slot(epoll_fd, op, s->fd, slot) < 0) {
+        close(s->fd);
+        s->fd = -1;
+
+        return -1;
+    }
+
+    return 1;
+}
+
+struct open_ports_dto * connect_scan_ports(const unsigned char *tar_ip,
+        const unsigned short *ports, int ports_len, int max_sockets,
+        struct scan_state *state) {
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epoll_fd < 0) {
+        fprintf(stderr, "ERROR: Unable to create epoll instance!\n");
+
+        return NULL;
+    }
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len = make_connect_addr(tar_ip, state->family, &addr);
+
+    struct connect_slot *slots = malloc(sizeof(struct connect_slot) *
+            max_sockets);
+
+    // Every slot starts on the idle list
+    int idle_head = 0;
+
+    for (int i = 0; i < max_sockets; i++) {
+        slots[i].fd = -1;
+        slots[i].port = 0;
+        slots[i].prev = -1;
+        slots[i].next = (i + 1 < max_sockets) ? i + 1 : -1;
+    }
+
+    struct connect_timer timer = { .head = -1, .tail = -1, .len = 0 };
+
+    unsigned short int *open_ports = malloc(sizeof(short int) * MAX_PORT);
+    int open_ports_len = 0;
+
+    // Carry over open ports restored from a checkpoint
+    for (int port = 0; port <= MAX_PORT; port++) {
+        if (state->port_states[port] == PORT_STATE_OPEN) {
+            open_ports[open_ports_len++] = (unsigned short int)port;
+        }
+    }
+
+    const unsigned long long TIMEOUT_NS = CONNECT_TIMEOUT_MS * 1000000ULL;
+
+    // Longest wait so checkpoints and interrupts are handled promptly
+    const int MAX_WAIT_MS = 100;
+
+    struct epoll_event events[CONNECT_MAX_EVENTS];
+
+    int next = (int)atomic_load(&state->cursor);
+    int error = 0;
+
+    unsigned long long send_start = get_time_ns();
+    unsigned char sending = 1;
+
+    while (!error) {
+        // Start connections on every idle slot
+        while (idle_head >= 0 && next < ports_len && !scan_interrupted(state)) {
+            int slot = idle_head;
+            int err;
+
+            slots[slot].port = ports[next];
+            slots[slot].sent_ns = get_time_ns();
+
+            int ret = start_connect(epoll_fd, slots, slot, state->family,
+                    &addr, addr_len, &err);
+
+            // Out of local ports or file descriptors, wait for connections
+            // to finish
+            if (ret < 0 || (ret == 0 && (err == EAGAIN || 
+                    err == EADDRNOTAVAIL))) {
+                slots[slot].port = 0;
+
+                if (timer.len == 0) {
+                    fprintf(stderr, "ERROR: Unable to open a socket!\n");
+                    error = 1;
+                }
+
+                break;
+            }
+
+            idle_head = slots[slot].next;
+
+            stats_inc(&state->stats.sender.probes_sent);
+            next++;
+            atomic_store_explicit(&state->cursor, next, memory_order_relaxed);
+
+            if (ret == 1) {
+                slots[slot].deadline_ns = slots[slot].sent_ns + TIMEOUT_NS;
+                connect_timer_push(&timer, slots, slot);
+
+                continue;
+            }
+
+            // Finished at once, as connections to a local host do
+            if (record_connect_result(state, slots[slot].port, err,
+                    slots[slot].sent_ns)) {
+                open_ports[open_ports_len++] = slots[slot].port;
+            }
+
+            slots[slot].port = 0;
+            slots[slot].next = idle_head;
+            idle_head = slot;
+        }
+
+        if (sending && (next >= ports_len || scan_interrupted(state))) {
+            record_phase(PHASE_SEND, send_start);
+            send_start = get_time_ns();
+            sending = 0;
+        }
+
+        if (timer.len == 0 && (next >= ports_len || scan_interrupted(state) ||
+                error)) {
+            break;
+        }
+
+        int wait_ms = MAX_WAIT_MS;
+
+        if (timer.head >= 0) {
+            unsigned long long now = get_time_ns();
+            unsigned long long deadline = slots[timer.head].deadline_ns;
+
+            wait_ms = (deadline <= now) ? 0 :
+                    (int)((deadline - now + 999999) / 1000000);
+
+            if (wait_ms > MAX_WAIT_MS) {
+                wait_ms = MAX_WAIT_MS;
+            }
+        }
+
+        int events_len = epoll_wait(epoll_fd, events, CONNECT_MAX_EVENTS,
+                wait_ms);
+
+        if (events_len < 0 && errno != EINTR) {
+            fprintf(stderr, "ERROR: epoll_wait failed!\n");
+            error = 1;
+
+            break;
+        }
+
+        for (int i = 0; i < events_len; i++) {
+            int slot = (int)events[i].data.u32;
+
+            // Woken by the reset of a timed out connection
+            if (slots[slot].port == 0) {
+                continue;
+            }
+
+            int err = 0;
+            socklen_t err_len = sizeof(int);
+            getsockopt(slots[slot].fd, SOL_SOCKET, SO_ERROR, &err, &err_len);
+
+            // Woken without a result while the SYN is still unanswered
+            struct sockaddr_storage peer;
+            socklen_t peer_len = sizeof(struct sockaddr_storage);
+
+            if (err == 0 && getpeername(slots[slot].fd, 
+                    (struct sockaddr *)&peer, &peer_len) < 0) {
+                arm_slot(epoll_fd, EPOLL_CTL_MOD, slots[slot].fd, slot);
+
+                continue;
+            }
+
+            if (record_connect_result(state, slots[slot].port, err,
+                    slots[slot].sent_ns)) {
+                open_ports[open_ports_len++] = slots[slot].port;
+            }
+
+            connect_timer_remove(&timer, slots, slot);
+
+            slots[slot].port = 0;
+            slots[slot].next = idle_head;
+            idle_head = slot;
+        }
+
+        // Ports of expired connections stay unanswered
+        unsigned long long now = get_time_ns();
+
+        while (timer.head >= 0 && slots[timer.head].deadline_ns <= now) {
+            int slot = timer.head;
+
+            connect_timer_remove(&timer, slots, slot);
+
+            slots[slot].port = 0;
+            slots[slot].next = idle_head;
+            idle_head = slot;
+        }
+
+        checkpoint_tick(state);
+    }
+
+    record_phase(sending ? PHASE_SEND : PHASE_DRAIN, send_start);
+
+    for (int i = 0; i < max_sockets; i++) {
+        if (slots[i].fd >= 0) {
+            close(slots[i].fd);
+        }
+    }
+
+    close(epoll_fd);
+    free(slots);
+
+    if (error) {
+        free(open_ports);
+
+        return NULL;
+    }
+
+    if (open_ports_len > 0) {
+        open_ports = realloc(open_ports, open_ports_len * sizeof(short int));
+    }
+
+    struct open_ports_dto *open_ports_struct = malloc(
+            sizeof(struct open_ports_dto));
+    open_ports_struct->open_ports = open_ports;
+    open_ports_struct->open_ports_len = open_ports_len;
+
+    return open_ports_struct;
+}
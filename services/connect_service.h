@@ -0,0 +1,150 @@
+#ifndef CONNECT_SERVICE_H
+#define CONNECT_SERVICE_H
+
+#include <sys/socket.h>
+
+#include "checkpoint_service.h"
+
+struct open_ports_dto;
+
+// Connections kept in flight at once, lowered to fit RLIMIT_NOFILE
+#define CONNECT_MAX_SOCKETS 4096
+
+// File descriptors left for everything but the scan sockets
+#define CONNECT_RESERVED_FDS 64
+
+// Time a connection may take before the port is unanswered in milliseconds.
+// Long enough for the kernel to retransmit the SYN once after 1 second.
+#define CONNECT_TIMEOUT_MS 1500
+
+// Maximum number of epoll events handled per wait
+#define CONNECT_MAX_EVENTS 512
+
+/*
+ * Struct: connect_slot
+ * --------------------
+ * A socket that is recycled for one connection after another.
+ *
+ * fd: The socket, or -1 until the slot is first used.
+ *
+ * port: The port being connected to, or 0 if the slot is idle.
+ *
+ * deadline_ns: When the connection times out.
+ *
+ * sent_ns: When the connection was started.
+ *
+ * prev: The slot before this one in the timer, or -1.
+ *
+ * next: The slot after this one in the timer or idle list, or -1.
+ */
+struct connect_slot {
+    int fd;
+    unsigned short port;
+    unsigned long long deadline_ns;
+    unsigned long long sent_ns;
+    int prev;
+    int next;
+};
+
+/*
+ * Struct: connect_timer
+ * ---------------------
+ * The connections in flight ordered by deadline, as a list threaded through
+ * the slots.  Every connection gets the same timeout, so a connection is
+ * appended at the tail and the earliest deadline is always at the head.  A
+ * connection that completes is unlinked in constant time.
+ *
+ * head: The slot with the earliest deadline, or -1.
+ *
+ * tail: The slot with the latest deadline, or -1.
+ *
+ * len: The number of connections in flight.
+ */
+struct connect_timer {
+    int head;
+    int tail;
+    int len;
+};
+
+/*
+ * Function: raise_nofile_limit
+ * ----------------------------
+ * Raises the soft RLIMIT_NOFILE towards wanted + CONNECT_RESERVED_FDS, up to
+ * the hard limit, so many sockets can be open at once.
+ *
+ * wanted: The number of sockets wanted.
+ *
+ * return: The number of sockets that may be opened, at least 1.
+ */
+int raise_nofile_limit(int wanted);
+
+/*
+ * Function: make_connect_addr
+ * ---------------------------
+ * Fills in a socket address for the target, with the port set later by
+ * set_connect_port.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * family: AF_INET, or AF_INET6 for an IPv6 target.
+ *
+ * addr: Populated with the address.
+ *
+ * return: The length of the address.
+ */
+socklen_t make_connect_addr(const unsigned char *tar_ip, int family,
+        struct sockaddr_storage *addr);
+
+/*
+ * Function: set_connect_port
+ * --------------------------
+ * Sets the port of a socket address made by make_connect_addr.
+ */
+void set_connect_port(struct sockaddr_storage *addr, unsigned short port);
+
+/*
+ * Function: connect_timer_push
+ * ----------------------------
+ * Appends a slot to the timer.  Its deadline must not be earlier than that of
+ * the tail.
+ */
+void connect_timer_push(struct connect_timer *timer,
+        struct connect_slot *slots, int slot);
+
+/*
+ * Function: connect_timer_remove
+ * ------------------------------
+ * Unlinks a slot from the timer.
+ */
+void connect_timer_remove(struct connect_timer *timer,
+        struct connect_slot *slots, int slot);
+
+/*
+ * Function: connect_scan_ports
+ * ----------------------------
+ * Scans TCP ports with non-blocking connect() calls on many sockets at once,
+ * multiplexed with epoll, which needs no privileges.  A connection that
+ * completes marks its port open and one that is refused marks it closed.
+ * Unreachable errors mark the port filtered, and connections that time out
+ * leave the port unanswered.  Sockets are recycled between connections by
+ * disconnecting them with AF_UNSPEC, which also resets open connections
+ * rather than closing them.
+ *
+ * tar_ip: The target IP address in array format, IPv6 when the scan state's
+ *         family is AF_INET6.
+ *
+ * ports: The ports to scan.  Scanning starts at the state's cursor.
+ *
+ * ports_len: The length of the ports array.
+ *
+ * max_sockets: The most connections in flight at once.
+ *
+ * state: The scan state.
+ *
+ * return: The open ports found, or NULL on error.
+ */
+struct open_ports_dto * connect_scan_ports(const unsigned char *tar_ip,
+        const unsigned short *ports, int ports_len, int max_sockets,
+        struct scan_state *state);
+
+#endif
\ No newline at end of file
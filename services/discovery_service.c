@@ -0,0 +1,1126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "discovery_service.h"
+#include "arp_service.h"
+#include "checksum_service.h"
+#include "histogram_service.h"
+#include "neighbor_cache.h"
+#include "network_helper.h"
+#include "route_service.h"
+#include "transport_service.h"
+#include "udp_service.h"
+
+// The probe of an ARP sweep, alongside the DISCOVER_ pings
+#define DISCOVER_ARP 8
+
+/*
+ * Struct: sweep_reply
+ * -------------------
+ * The ARP reply of a target, kept by the listener until the sweep is over.
+ *
+ * index: The target's index in the discovery.
+ *
+ * mac: The MAC address it answered with.
+ */
+struct sweep_reply {
+    unsigned long long index;
+    unsigned char mac[MAC_LEN];
+};
+
+/*
+ * Struct: sweep_gateway
+ * ---------------------
+ * A gateway asked for its MAC address by an ARP sweep, with its reply.
+ *
+ * ip: The gateway's IP address (network byte order).
+ *
+ * mac: The MAC address it answered with.
+ *
+ * resolved: Set to 1 by the listener once it answered.
+ */
+struct sweep_gateway {
+    unsigned int ip;
+    unsigned char mac[MAC_LEN];
+    unsigned char resolved;
+};
+
+/*
+ * Struct: discovery_sweep
+ * -----------------------
+ * One pass over the targets, of ARP requests or of pings.  The caller sends
+ * while a listener thread matches replies to targets.  The listener only
+ * writes the replies of the sweep, which are applied to the discovery once
+ * it has stopped, so the sender reads the discovery unchanged.
+ *
+ * disc: The discovery the sweep is part of.
+ *
+ * t: The transport the sweep is sent and received on.
+ *
+ * arp: 1 for an ARP sweep, 0 for pings.
+ *
+ * retry: 1 to sweep only the targets without a MAC address, or for pings
+ *        those not yet live.
+ *
+ * routes: The routing table, or NULL if every target is on-link.
+ *
+ * if_index: The interface swept.  With a routing table only the targets
+ *           routed out of it are swept.
+ *
+ * loc_mac: The local MAC address.
+ *
+ * loc_ip: The local IP address (network byte order).
+ *
+ * gw_ip: Without a routing table, the default gateway's IP address (network
+ *        byte order), or 0.
+ *
+ * gw_mac: The default gateway's MAC address, once resolved.
+ *
+ * gw_resolved: 1 once the gateway answered ARP.
+ *
+ * gateways: The gateways an ARP sweep asks for their MAC addresses, the
+ *           default gateway or those of the routes out of the interface.
+ *           Their replies are applied to the routes once the sweep is over.
+ *
+ * gateways_len: The number of gateways asked.
+ *
+ * secret: Keys the sequence numbers of the TCP pings.
+ *
+ * replied: A bitmap of the targets that answered the sweep.
+ *
+ * replies: The ARP replies of the targets, in the order they arrived.
+ *
+ * replies_len: The number of ARP replies.
+ *
+ * replies_cap: The number of ARP replies there is room for.
+ *
+ * answered: The number of targets that answered the sweep.
+ *
+ * stop: Set (with release semantics) once the sweep is over.
+ *
+ * error: Set to 1 by the listener if the transport failed or a reply could
+ *        not be kept.
+ */
+struct discovery_sweep {
+    struct host_discovery *disc;
+    struct transport *t;
+    unsigned char arp;
+    unsigned char retry;
+    struct route_table *routes;
+    int if_index;
+    const unsigned char *loc_mac;
+    unsigned int loc_ip;
+    unsigned int gw_ip;
+    unsigned char gw_mac[MAC_LEN];
+    unsigned char gw_resolved;
+    struct sweep_gateway *gateways;
+    int gateways_len;
+    unsigned int secret;
+    unsigned long long *replied;
+    struct sweep_reply *replies;
+    unsigned long long replies_len;
+    unsigned long long replies_cap;
+    atomic_ullong answered;
+    atomic_uchar stop;
+    int error;
+};
+
+int parse_discovery_probes(const char *spec) {
+    int probes = 0;
+    const char *entry = spec;
+
+    for (;;) {
+        const char *comma = strchr(entry, ',');
+        int entry_len = comma != NULL ? (int)(comma - entry) :
+                (int)strlen(entry);
+
+        if (entry_len == 4 && strncmp(entry, "icmp", 4) == 0) {
+            probes |= DISCOVER_ICMP;
+        } else if (entry_len == 3 && strncmp(entry, "syn", 3) == 0) {
+            probes |= DISCOVER_SYN;
+        } else if (entry_len == 3 && strncmp(entry, "ack", 3) == 0) {
+            probes |= DISCOVER_ACK;
+        } else {
+            fprintf(stderr, "ERROR: Invalid discovery probe: %.*s\n",
+                    entry_len, entry);
+
+            return -1;
+        }
+
+        if (comma == NULL) {
+            break;
+        }
+
+        entry = comma + 1;
+    }
+
+    return probes;
+}
+
+/*
+ * The sequence number of the TCP pings to a target, so that replies are
+ * checked without keeping any state per ping.
+ */
+static unsigned int ping_cookie(unsigned int secret, unsigned int tar_ip) {
+    unsigned int x = tar_ip ^ secret;
+
+    x ^= x >> 16;
+    x *= 0x45d9f3b;
+    x ^= x >> 16;
+
+    return x;
+}
+
+static int is_zero_mac(const unsigned char *mac) {
+    for (int i = 0; i < MAC_LEN; i++) {
+        if (mac[i] != 0) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Builds a broadcast ARP request for a target (network byte order) in to
+ * frame.  Returns the length of the frame.
+ */
+static int build_arp_request(const struct discovery_sweep *sweep,
+        unsigned int tar_ip, unsigned char *frame) {
+    const unsigned char BRD_MAC[MAC_LEN] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff
+    };
+
+    unsigned char *packet = make_arp_packet(sweep->loc_mac, BRD_MAC,
+            (const unsigned char *)&sweep->loc_ip,
+            (const unsigned char *)&tar_ip);
+
+    memset(frame, 0, DISCOVERY_FRAME_LEN);
+    memcpy(frame, packet, ARP_RQ_PSIZE);
+    free(packet);
+
+    return ARP_RQ_PSIZE;
+}
+
+/*
+ * Builds a ping of a target (network byte order) in to frame.  Returns the
+ * length of the frame.
+ */
+static int build_ping(const struct discovery_sweep *sweep, int probe,
+        unsigned int tar_ip, const unsigned char *tar_mac,
+        unsigned char *frame) {
+    memset(frame, 0, DISCOVERY_FRAME_LEN);
+
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    memcpy(eth->h_source, sweep->loc_mac, MAC_LEN);
+    memcpy(eth->h_dest, tar_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *iph = (struct iphdr *)(frame + sizeof(struct ethhdr));
+    iph->version = 4;
+    iph->ihl = 5;
+    iph->id = htons(10201);
+    iph->frag_off = htons(IP_DF);
+    iph->ttl = 64;
+    iph->saddr = sweep->loc_ip;
+    iph->daddr = tar_ip;
+
+    unsigned char *l4 = (unsigned char *)iph + sizeof(struct iphdr);
+    int l4_len;
+
+    if (probe == DISCOVER_ICMP) {
+        struct icmphdr *icmph = (struct icmphdr *)l4;
+        icmph->type = ICMP_ECHO;
+        icmph->un.echo.id = htons(DISCOVERY_ECHO_ID);
+        icmph->checksum = checksum_fold(checksum_add(0, icmph,
+                sizeof(struct icmphdr)));
+
+        iph->protocol = IPPROTO_ICMP;
+        l4_len = sizeof(struct icmphdr);
+    } else {
+        unsigned int cookie = ping_cookie(sweep->secret, tar_ip);
+
+        struct tcphdr *th = (struct tcphdr *)l4;
+        th->source = htons(DISCOVERY_SRC_PORT);
+        th->doff = 5;
+        th->window = htons(5840);
+
+        // A SYN is acknowledged from its sequence number and an ACK is
+        // reset with its acknowledgment number
+        if (probe == DISCOVER_SYN) {
+            th->dest = htons(DISCOVERY_SYN_PORT);
+            th->seq = htonl(cookie);
+            th->syn = 1;
+        } else {
+            th->dest = htons(DISCOVERY_ACK_PORT);
+            th->ack_seq = htonl(cookie);
+            th->ack = 1;
+        }
+
+        struct psheader psh;
+        memset(&psh, 0, sizeof(struct psheader));
+        psh.saddr = iph->saddr;
+        psh.daddr = iph->daddr;
+        psh.protocol = IPPROTO_TCP;
+        psh.tcpseglen = htons(sizeof(struct tcphdr));
+
+        th->check = checksum_fold(checksum_add(checksum_add(0, &psh,
+                sizeof(struct psheader)), th, sizeof(struct tcphdr)));
+
+        iph->protocol = IPPROTO_TCP;
+        l4_len = sizeof(struct tcphdr);
+    }
+
+    iph->tot_len = htons(sizeof(struct iphdr) + l4_len);
+    iph->check = checksum_fold(checksum_add(0, iph, sizeof(struct iphdr)));
+
+    return DISCOVERY_FRAME_LEN;
+}
+
+/*
+ * Marks a target as having answered the sweep.  Returns 1 for its first
+ * reply, otherwise 0.
+ */
+static int mark_replied(struct discovery_sweep *sweep,
+        unsigned long long index) {
+    const unsigned long long bit = 1ULL << (index % 64);
+
+    if (sweep->replied[index / 64] & bit) {
+        return 0;
+    }
+
+    sweep->replied[index / 64] |= bit;
+
+    return 1;
+}
+
+static void handle_arp_reply(struct discovery_sweep *sweep,
+        const unsigned char *frame, int frame_len) {
+    if (frame_len < ARP_RQ_PSIZE) {
+        return;
+    }
+
+    const struct ethhdr *eth = (const struct ethhdr *)frame;
+    const struct arphdr *arph = (const struct arphdr *)
+            (frame + sizeof(struct ethhdr));
+    const struct arp_payload *arppl = (const struct arp_payload *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct arphdr));
+
+    if (compare_mac_add(sweep->loc_mac, eth->h_dest) != 0 ||
+            ntohs(arph->ar_op) != ARPOP_REPLY ||
+            memcmp(arppl->tar_ip, &sweep->loc_ip, IP_LEN) != 0 ||
+            is_zero_mac(arppl->src_mac)) {
+        return;
+    }
+
+    unsigned int src_ip;
+    memcpy(&src_ip, arppl->src_ip, IP_LEN);
+
+    for (int i = 0; i < sweep->gateways_len; i++) {
+        if (sweep->gateways[i].ip == src_ip) {
+            memcpy(sweep->gateways[i].mac, arppl->src_mac, MAC_LEN);
+            sweep->gateways[i].resolved = 1;
+        }
+    }
+
+    struct host_discovery *disc = sweep->disc;
+    long long index = interval_set_index(disc->targets, ntohl(src_ip));
+
+    // Only the first reply of a target is kept
+    if (index < 0 || !mark_replied(sweep, index)) {
+        return;
+    }
+
+    if (sweep->replies_len == sweep->replies_cap) {
+        unsigned long long cap = sweep->replies_cap > 0 ?
+                sweep->replies_cap * 2 : 1024;
+        struct sweep_reply *replies = realloc(sweep->replies,
+                sizeof(struct sweep_reply) * cap);
+
+        if (replies == NULL) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+            sweep->error = 1;
+
+            return;
+        }
+
+        sweep->replies = replies;
+        sweep->replies_cap = cap;
+    }
+
+    struct sweep_reply *reply = &sweep->replies[sweep->replies_len++];
+    reply->index = index;
+    memcpy(reply->mac, arppl->src_mac, MAC_LEN);
+
+    // A cached target was not waited for, but its reply corrects its address
+    if (is_zero_mac(disc->macs[index])) {
+        atomic_fetch_add_explicit(&sweep->answered, 1, memory_order_relaxed);
+    }
+}
+
+static void handle_ping_reply(struct discovery_sweep *sweep,
+        const unsigned char *frame, int frame_len) {
+    if (frame_len < (int)(sizeof(struct ethhdr) + sizeof(struct iphdr))) {
+        return;
+    }
+
+    const struct ethhdr *eth = (const struct ethhdr *)frame;
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    const int ip_hdr_len = iph->ihl * 4;
+    const unsigned char *l4 = (const unsigned char *)iph + ip_hdr_len;
+    const int l4_len = frame_len - (int)sizeof(struct ethhdr) - ip_hdr_len;
+
+    if (compare_mac_add(sweep->loc_mac, eth->h_dest) != 0 ||
+            iph->daddr != sweep->loc_ip) {
+        return;
+    }
+
+    if (iph->protocol == IPPROTO_ICMP) {
+        const struct icmphdr *icmph = (const struct icmphdr *)l4;
+
+        if (l4_len < (int)sizeof(struct icmphdr) ||
+                icmph->type != ICMP_ECHOREPLY ||
+                icmph->un.echo.id != htons(DISCOVERY_ECHO_ID)) {
+            return;
+        }
+    } else if (iph->protocol == IPPROTO_TCP) {
+        const struct tcphdr *th = (const struct tcphdr *)l4;
+
+        if (l4_len < (int)sizeof(struct tcphdr) ||
+                th->dest != htons(DISCOVERY_SRC_PORT)) {
+            return;
+        }
+
+        unsigned int cookie = ping_cookie(sweep->secret, iph->saddr);
+
+        // Open ports answer the SYN with a SYN-ACK and closed ones with a
+        // reset, either way acknowledging it
+        unsigned char syn_reply = th->source == htons(DISCOVERY_SYN_PORT) &&
+                th->ack && (th->syn || th->rst) &&
+                ntohl(th->ack_seq) == cookie + 1;
+        unsigned char ack_reply = th->source == htons(DISCOVERY_ACK_PORT) &&
+                th->rst && ntohl(th->seq) == cookie;
+
+        if (!syn_reply && !ack_reply) {
+            return;
+        }
+    } else {
+        return;
+    }
+
+    struct host_discovery *disc = sweep->disc;
+    long long index = interval_set_index(disc->targets, ntohl(iph->saddr));
+
+    // Only the first reply of a target is counted
+    if (index < 0 || discovery_is_live(disc, index) ||
+            !mark_replied(sweep, index)) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&sweep->answered, 1, memory_order_relaxed);
+
+    if (DEBUG >= 2) {
+        printf("Host %s is up\n", get_ip_32_str(iph->saddr));
+    }
+}
+
+/*
+ * Matches the replies to a sweep to its targets until it is stopped.
+ */
+static void * listen_for_sweep_replies(void *arg) {
+    struct discovery_sweep *sweep = (struct discovery_sweep *)arg;
+    struct transport_frame frames[TRANSPORT_BATCH];
+
+    // Wait time for each receive in milliseconds
+    const int RECV_TIMEOUT_MS = 10;
+
+    while (!atomic_load_explicit(&sweep->stop, memory_order_acquire)) {
+        int frames_len = transport_recv_batch(sweep->t, frames,
+                TRANSPORT_BATCH, RECV_TIMEOUT_MS);
+
+        if (frames_len < 0) {
+            sweep->error = 1;
+
+            break;
+        }
+
+        for (int i = 0; i < frames_len; i++) {
+            if (sweep->arp) {
+                handle_arp_reply(sweep, frames[i].data, frames[i].len);
+            } else {
+                handle_ping_reply(sweep, frames[i].data, frames[i].len);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int send_sweep_batch(struct transport *t,
+        const struct transport_frame *frames, int frames_len) {
+    if (frames_len > 0 &&
+            transport_send_batch(t, frames, frames_len) < frames_len) {
+        fprintf(stderr, "ERROR: Problem sending discovery probes!\n");
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Returns 1 if a target leaves by the sweep's interface, so it is swept, and
+ * sets route to its route.  Without a routing table every target is swept
+ * and route is NULL.
+ */
+static int sweep_covers(const struct discovery_sweep *sweep, unsigned int ip,
+        struct route **route) {
+    *route = NULL;
+
+    if (sweep->routes == NULL) {
+        return 1;
+    }
+
+    *route = route_lookup(sweep->routes, ip);
+
+    return *route != NULL && (*route)->if_index == sweep->if_index;
+}
+
+/*
+ * Lists the gateways of the sweep's interface that are not yet resolved, for
+ * the targets that are not on-link or do not answer.  Returns 0 on success,
+ * -1 on error.
+ */
+static int collect_gateways(struct discovery_sweep *sweep) {
+    sweep->gateways_len = 0;
+    sweep->gateways = malloc(sizeof(struct sweep_gateway) *
+            (sweep->routes != NULL ? sweep->routes->len + 1 : 1));
+
+    if (sweep->gateways == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    if (sweep->routes == NULL) {
+        if (sweep->gw_ip != 0) {
+            memset(&sweep->gateways[0], 0, sizeof(struct sweep_gateway));
+            sweep->gateways[0].ip = sweep->gw_ip;
+            sweep->gateways_len = 1;
+        }
+
+        return 0;
+    }
+
+    const struct route *routes = sweep->routes->routes;
+
+    for (int i = 0; i < sweep->routes->len; i++) {
+        if (routes[i].if_index != sweep->if_index || routes[i].gateway == 0 ||
+                routes[i].gw_resolved) {
+            continue;
+        }
+
+        int listed = 0;
+
+        for (int j = 0; j < sweep->gateways_len && !listed; j++) {
+            listed = sweep->gateways[j].ip == routes[i].gateway;
+        }
+
+        if (!listed) {
+            struct sweep_gateway *gateway =
+                    &sweep->gateways[sweep->gateways_len++];
+
+            memset(gateway, 0, sizeof(struct sweep_gateway));
+            gateway->ip = routes[i].gateway;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Asks the gateways of the sweep for their MAC addresses.  Returns 0 on
+ * success, -1 on error.
+ */
+static int send_gateway_requests(const struct discovery_sweep *sweep) {
+    unsigned char frame[DISCOVERY_FRAME_LEN];
+
+    for (int i = 0; i < sweep->gateways_len; i++) {
+        if (transport_send(sweep->t, frame, build_arp_request(sweep,
+                sweep->gateways[i].ip, frame)) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Applies the replies of a sweep to the discovery, once its listener has
+ * stopped: an ARP sweep sets the MAC addresses of the targets and gateways
+ * that answered and a ping sweep marks the targets live.
+ */
+static void merge_sweep_replies(struct discovery_sweep *sweep) {
+    struct host_discovery *disc = sweep->disc;
+
+    for (int i = 0; i < sweep->gateways_len; i++) {
+        const struct sweep_gateway *gateway = &sweep->gateways[i];
+
+        if (!gateway->resolved) {
+            continue;
+        }
+
+        if (sweep->routes != NULL) {
+            route_learn_gateway(sweep->routes, sweep->if_index, gateway->ip,
+                    gateway->mac);
+        } else {
+            memcpy(sweep->gw_mac, gateway->mac, MAC_LEN);
+            sweep->gw_resolved = 1;
+        }
+    }
+
+    for (unsigned long long i = 0; i < sweep->replies_len; i++) {
+        memcpy(disc->macs[sweep->replies[i].index], sweep->replies[i].mac,
+                MAC_LEN);
+    }
+
+    if (sweep->arp) {
+        return;
+    }
+
+    for (unsigned long long i = 0; i < (disc->targets->size + 63) / 64;
+            i++) {
+        disc->live_len += __builtin_popcountll(sweep->replied[i] &
+                ~disc->live[i]);
+        disc->live[i] |= sweep->replied[i];
+    }
+}
+
+/*
+ * Sends a sweep at rate_pps and waits for its replies, until every target
+ * swept answered or DISCOVERY_WAIT_MS after the last probe.  An ARP sweep
+ * asks for every on-link target but only waits for those without a cached
+ * MAC address, a ping sweep pings the targets with a MAC address.  Returns 0
+ * on success, -1 on error.
+ */
+static int run_sweep(struct discovery_sweep *sweep, int probes,
+        unsigned int rate_pps) {
+    const struct interval_set *targets = sweep->disc->targets;
+
+    int kinds[4];
+    int kinds_len = 0;
+
+    if (sweep->arp) {
+        kinds[kinds_len++] = DISCOVER_ARP;
+    }
+
+    for (int probe = DISCOVER_ICMP; probe <= DISCOVER_ACK && !sweep->arp;
+            probe <<= 1) {
+        if (probes & probe) {
+            kinds[kinds_len++] = probe;
+        }
+    }
+
+    sweep->replied = calloc((targets->size + 63) / 64,
+            sizeof(unsigned long long));
+    sweep->replies = NULL;
+    sweep->replies_len = 0;
+    sweep->replies_cap = 0;
+    sweep->gateways = NULL;
+    sweep->gateways_len = 0;
+
+    if (sweep->replied == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    // Gateways are listed before the listener starts, which only reads them
+    if (sweep->arp && collect_gateways(sweep) < 0) {
+        free(sweep->replied);
+
+        return -1;
+    }
+
+    // Listen before sending so a fast reply cannot be missed
+    sweep->t = transport_open(sweep->if_index, sweep->loc_mac,
+            sweep->arp ? ETH_P_ARP : ETH_P_IP);
+
+    if (sweep->t == NULL) {
+        free(sweep->replied);
+        free(sweep->gateways);
+
+        return -1;
+    }
+
+    atomic_store(&sweep->answered, 0);
+    atomic_store(&sweep->stop, 0);
+    sweep->error = 0;
+
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, listen_for_sweep_replies,
+            (void *)sweep) != 0) {
+        fprintf(stderr, "ERROR: Cannot start discovery listener!\n");
+        transport_close(sweep->t);
+        free(sweep->replied);
+        free(sweep->gateways);
+
+        return -1;
+    }
+
+    int ret = 0;
+
+    // Gateways are asked first, for the targets that will not answer
+    if (sweep->arp && send_gateway_requests(sweep) < 0) {
+        fprintf(stderr, "ERROR: Problem sending discovery probes!\n");
+        ret = -1;
+    }
+
+    unsigned char buffs[TRANSPORT_BATCH][DISCOVERY_FRAME_LEN];
+    struct transport_frame frames[TRANSPORT_BATCH];
+    int frames_len = 0;
+    int batch_len = 0;
+    unsigned long long swept = 0;
+    unsigned long long index = 0;
+
+    struct udp_pacer pacer;
+    udp_pacer_init_rate(&pacer, rate_pps);
+    udp_pacer_start_round(&pacer);
+
+    for (int i = 0; i < targets->len && ret == 0; i++) {
+        unsigned long long last = targets->intervals[i].last;
+
+        for (unsigned long long ip = targets->intervals[i].first;
+                ip <= last && ret == 0; ip++, index++) {
+            const unsigned char *mac = sweep->disc->macs[index];
+            struct route *route;
+
+            if (!sweep_covers(sweep, (unsigned int)ip, &route) ||
+                    (sweep->arp && route != NULL && route->gateway != 0) ||
+                    (!sweep->arp && is_zero_mac(mac)) ||
+                    (sweep->retry && (sweep->arp ? !is_zero_mac(mac) :
+                    discovery_is_live(sweep->disc, index)))) {
+                continue;
+            }
+
+            if (!sweep->arp || is_zero_mac(mac)) {
+                swept++;
+            }
+
+            for (int k = 0; k < kinds_len && ret == 0; k++) {
+                // Batches are as large as the rate allows right now
+                if (frames_len == batch_len) {
+                    ret = send_sweep_batch(sweep->t, frames, frames_len);
+                    frames_len = 0;
+                    batch_len = udp_pacer_take(&pacer, TRANSPORT_BATCH);
+                }
+
+                unsigned int tar_ip = htonl((unsigned int)ip);
+
+                frames[frames_len].data = buffs[frames_len];
+                frames[frames_len].len = sweep->arp ?
+                        build_arp_request(sweep, tar_ip, buffs[frames_len]) :
+                        build_ping(sweep, kinds[k], tar_ip, mac,
+                        buffs[frames_len]);
+                frames_len++;
+            }
+        }
+    }
+
+    if (ret == 0) {
+        ret = send_sweep_batch(sweep->t, frames, frames_len);
+    }
+
+    // Wait for the last replies, no longer than it takes all to arrive
+    for (int waited_ms = 0; ret == 0 && waited_ms < DISCOVERY_WAIT_MS &&
+            atomic_load(&sweep->answered) < swept; waited_ms += 10) {
+        usleep(10 * 1000);
+    }
+
+    atomic_store_explicit(&sweep->stop, 1, memory_order_release);
+    pthread_join(tid, NULL);
+
+    transport_close(sweep->t);
+    sweep->t = NULL;
+
+    // Only now that the listener has stopped are the targets updated
+    merge_sweep_replies(sweep);
+
+    free(sweep->replied);
+    free(sweep->replies);
+    free(sweep->gateways);
+    sweep->replied = NULL;
+    sweep->replies = NULL;
+    sweep->gateways = NULL;
+    sweep->gateways_len = 0;
+
+    if (sweep->error) {
+        fprintf(stderr, "ERROR: Problem receiving discovery replies!\n");
+
+        return -1;
+    }
+
+    return ret;
+}
+
+/*
+ * Fills in the cached MAC addresses of the on-link targets of the sweep's
+ * interface.  Returns the number of targets filled in.
+ */
+static unsigned long long load_cached_neighbors(
+        const struct discovery_sweep *sweep) {
+    struct neighbor_cache *cache = sweep->routes->neighbors;
+    struct host_discovery *disc = sweep->disc;
+    unsigned long long cached = 0;
+
+    for (unsigned long long i = 0; i < disc->targets->size; i++) {
+        unsigned int ip = (unsigned int)interval_set_at(disc->targets, i);
+        struct route *route;
+
+        if (is_zero_mac(disc->macs[i]) && sweep_covers(sweep, ip, &route) &&
+                route->gateway == 0 && neighbor_cache_lookup(cache,
+                htonl(ip), sweep->if_index, disc->macs[i]) == 0) {
+            cached++;
+        }
+    }
+
+    return cached;
+}
+
+/*
+ * Clears the cached MAC addresses that on-link targets did not answer a ping
+ * at, as they may be stale.  Returns the number of targets cleared.
+ */
+static unsigned long long drop_stale_neighbors(
+        const struct discovery_sweep *sweep) {
+    struct neighbor_cache *cache = sweep->routes->neighbors;
+    struct host_discovery *disc = sweep->disc;
+    unsigned long long stale = 0;
+
+    for (unsigned long long i = 0; i < disc->targets->size; i++) {
+        unsigned int ip = (unsigned int)interval_set_at(disc->targets, i);
+        unsigned char mac[MAC_LEN];
+        struct route *route;
+
+        if (discovery_is_live(disc, i) || is_zero_mac(disc->macs[i]) ||
+                !sweep_covers(sweep, ip, &route) || route->gateway != 0 ||
+                neighbor_cache_lookup(cache, htonl(ip), sweep->if_index,
+                mac) < 0 || memcmp(mac, disc->macs[i], MAC_LEN) != 0) {
+            continue;
+        }
+
+        neighbor_cache_forget(cache, htonl(ip), sweep->if_index);
+        memset(disc->macs[i], 0, MAC_LEN);
+        stale++;
+    }
+
+    return stale;
+}
+
+/*
+ * Records the MAC addresses of the on-link targets that answered a ping in
+ * the neighbor cache, and drops the entries of those that did not.
+ */
+static void store_neighbors(const struct discovery_sweep *sweep) {
+    struct neighbor_cache *cache = sweep->routes->neighbors;
+    struct host_discovery *disc = sweep->disc;
+
+    for (unsigned long long i = 0; i < disc->targets->size; i++) {
+        unsigned int ip = (unsigned int)interval_set_at(disc->targets, i);
+        struct route *route;
+
+        if (is_zero_mac(disc->macs[i]) || !sweep_covers(sweep, ip, &route) ||
+                route->gateway != 0) {
+            continue;
+        }
+
+        if (discovery_is_live(disc, i)) {
+            neighbor_cache_store(cache, htonl(ip), sweep->if_index,
+                    disc->macs[i]);
+        } else {
+            neighbor_cache_forget(cache, htonl(ip), sweep->if_index);
+        }
+    }
+}
+
+/*
+ * Sweeps the targets reached through one interface: the on-link targets are
+ * asked for their MAC addresses, then pinged at theirs and the rest at their
+ * gateway's.  Targets with a cached MAC address are asked too, but not
+ * waited for, and are asked and pinged again if they do not answer the ping
+ * at it.  Without a routing table every target is on-link, and those
+ * that do not answer ARP are pinged through the default gateway.  Returns 0
+ * on success, -1 on error.
+ */
+static int sweep_interface(struct discovery_sweep *sweep, int probes,
+        unsigned int rate_pps, const char *dev_name) {
+    struct host_discovery *disc = sweep->disc;
+    const struct interval_set *targets = disc->targets;
+
+    const struct in_addr *gw_ip = sweep->routes == NULL ?
+            get_gw_ip_address(dev_name) : NULL;
+
+    sweep->gw_ip = gw_ip != NULL ? gw_ip->s_addr : 0;
+    sweep->gw_resolved = 0;
+
+    unsigned long long phase_start = get_time_ns();
+    unsigned char use_cache = sweep->routes != NULL &&
+            sweep->routes->neighbors != NULL;
+    unsigned long long cached = use_cache ? load_cached_neighbors(sweep) : 0;
+
+    // Every target is asked for its MAC address in one sweep
+    sweep->arp = 1;
+
+    if (run_sweep(sweep, probes, rate_pps) < 0) {
+        return -1;
+    }
+
+    record_phase(PHASE_ARP, phase_start);
+
+    unsigned long long resolved = atomic_load(&sweep->answered);
+
+    if (!sweep->gw_resolved && gw_ip != NULL) {
+        char *mac_str = search_arp_table(get_ip_str(gw_ip));
+
+        if (mac_str != NULL) {
+            memcpy(sweep->gw_mac, get_mac_from_str(mac_str), MAC_LEN);
+            sweep->gw_resolved = 1;
+        }
+    }
+
+    // Targets that did not answer are reached through their gateway
+    unsigned long long gatewayed = 0;
+
+    for (unsigned long long i = 0; i < targets->size; i++) {
+        if (!is_zero_mac(disc->macs[i])) {
+            continue;
+        }
+
+        struct route *route;
+        const unsigned char *gw_mac = NULL;
+
+        if (!sweep_covers(sweep, (unsigned int)interval_set_at(targets, i),
+                &route)) {
+            continue;
+        }
+
+        if (route != NULL) {
+            gw_mac = route_gateway_mac(sweep->routes, route);
+        } else if (sweep->gw_resolved) {
+            gw_mac = sweep->gw_mac;
+        }
+
+        if (gw_mac != NULL) {
+            memcpy(disc->macs[i], gw_mac, MAC_LEN);
+            gatewayed++;
+        }
+    }
+
+    if (DEBUG >= 1) {
+        printf("%s: %llu targets answered ARP, %llu were cached, %llu are "
+                "pinged through a gateway\n", dev_name, resolved, cached,
+                gatewayed);
+    }
+
+    phase_start = get_time_ns();
+    sweep->arp = 0;
+
+    if ((resolved > 0 || cached > 0 || gatewayed > 0) &&
+            run_sweep(sweep, probes, rate_pps) < 0) {
+        return -1;
+    }
+
+    record_phase(PHASE_PING, phase_start);
+
+    unsigned long long stale = use_cache ? drop_stale_neighbors(sweep) : 0;
+
+    // The ARP replies that would have corrected a stale address came after
+    // the sweep stopped waiting, so the sweeps are repeated for those targets
+    if (stale > 0) {
+        if (DEBUG >= 1) {
+            printf("%s: %llu cached targets did not answer, asking again\n",
+                    dev_name, stale);
+        }
+
+        sweep->retry = 1;
+        sweep->arp = 1;
+        phase_start = get_time_ns();
+
+        int ret = run_sweep(sweep, probes, rate_pps);
+
+        record_phase(PHASE_ARP, phase_start);
+
+        sweep->arp = 0;
+        phase_start = get_time_ns();
+
+        if (ret == 0 && atomic_load(&sweep->answered) > 0) {
+            ret = run_sweep(sweep, probes, rate_pps);
+        }
+
+        record_phase(PHASE_PING, phase_start);
+        sweep->retry = 0;
+
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    if (use_cache) {
+        store_neighbors(sweep);
+    }
+
+    return 0;
+}
+
+// Prints how many hosts are up, returns 0
+static int print_discovery(const struct host_discovery *disc,
+        unsigned long long discovery_start) {
+    printf("Host discovery: %llu of %llu hosts up in %.2f seconds\n",
+            disc->live_len, disc->targets->size,
+            (get_time_ns() - discovery_start) / 1e9);
+
+    return 0;
+}
+
+int discover_hosts(struct host_discovery *disc,
+        const struct interval_set *targets, int probes, unsigned int rate_pps,
+        struct route_table *routes, const char *dev_name) {
+    memset(disc, 0, sizeof(struct host_discovery));
+    disc->targets = targets;
+
+    if (targets->size > DISCOVERY_MAX_TARGETS) {
+        fprintf(stderr, "ERROR: Host discovery covers at most %d targets!\n",
+                DISCOVERY_MAX_TARGETS);
+
+        return -1;
+    }
+
+    disc->live = calloc((targets->size + 63) / 64,
+            sizeof(unsigned long long));
+    disc->macs = calloc(targets->size, MAC_LEN);
+
+    if (disc->live == NULL || disc->macs == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    printf("Discovering live hosts among %llu targets...\n", targets->size);
+
+    unsigned long long discovery_start = get_time_ns();
+
+    struct discovery_sweep sweep;
+    memset(&sweep, 0, sizeof(struct discovery_sweep));
+    sweep.disc = disc;
+    sweep.routes = routes;
+    sweep.secret = (unsigned int)(time(0) ^ getpid());
+
+    if (routes == NULL) {
+        // Only used to query the interface, which needs no privileges
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+        if (sock == -1) {
+            fprintf(stderr, "ERROR: Cannot open socket!\n");
+
+            return -1;
+        }
+
+        sweep.if_index = get_interface_index(&sock, dev_name);
+        sweep.loc_mac = get_mac_address(&sock, dev_name);
+        const struct in_addr *loc_ip = get_ip_address(&sock, dev_name);
+
+        close(sock);
+
+        if (sweep.if_index == -1 || sweep.loc_mac == NULL || loc_ip == NULL) {
+            fprintf(stderr, "ERROR: Cannot get interface address.\n");
+
+            return -1;
+        }
+
+        sweep.loc_ip = loc_ip->s_addr;
+
+        return sweep_interface(&sweep, probes, rate_pps, dev_name) < 0 ? -1 :
+                print_discovery(disc, discovery_start);
+    }
+
+    // Each interface the targets are routed out of is swept in turn
+    int *swept = malloc(sizeof(int) * (routes->len + 1));
+    int swept_len = 0;
+    unsigned long long unrouted = 0;
+
+    if (swept == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+        return -1;
+    }
+
+    for (unsigned long long i = 0; i < targets->size; i++) {
+        struct route *route = route_lookup(routes,
+                (unsigned int)interval_set_at(targets, i));
+
+        if (route == NULL) {
+            unrouted++;
+
+            continue;
+        }
+
+        int seen = 0;
+
+        for (int j = 0; j < swept_len && !seen; j++) {
+            seen = swept[j] == route->if_index;
+        }
+
+        if (seen) {
+            continue;
+        }
+
+        swept[swept_len++] = route->if_index;
+
+        sweep.if_index = route->if_index;
+        sweep.loc_mac = route->loc_mac;
+        sweep.loc_ip = route->loc_ip;
+
+        if (sweep_interface(&sweep, probes, rate_pps, route->if_name) < 0) {
+            free(swept);
+
+            return -1;
+        }
+    }
+
+    free(swept);
+
+    if (unrouted > 0) {
+        printf("%llu targets have no route and are skipped\n", unrouted);
+    }
+
+    return print_discovery(disc, discovery_start);
+}
+
+int discovery_is_live(const struct host_discovery *disc,
+        unsigned long long index) {
+    return (disc->live[index / 64] >> (index % 64)) & 1;
+}
+
+void free_discovery(struct host_discovery *disc) {
+    free(disc->live);
+    free(disc->macs);
+
+    disc->live = NULL;
+    disc->macs = NULL;
+}
@@ -0,0 +1,116 @@
+#ifndef DISCOVERY_SERVICE_H
+#define DISCOVERY_SERVICE_H
+
+#include "interval_set.h"
+#include "route_service.h"
+#include "../constants/constants.h"
+
+// Pings a host discovery sweep may send, see parse_discovery_probes
+#define DISCOVER_ICMP 1
+#define DISCOVER_SYN 2
+#define DISCOVER_ACK 4
+#define DISCOVER_ALL (DISCOVER_ICMP | DISCOVER_SYN | DISCOVER_ACK)
+
+// A SYN to a web port finds hosts that drop echo requests, and an ACK gets a
+// reset through firewalls that only drop new connections
+#define DISCOVERY_SYN_PORT 443
+#define DISCOVERY_ACK_PORT 80
+
+// Source port of the TCP pings, below the stateless handshake ports, and
+// identifier of the echo requests, so replies to the sweep are told apart
+#define DISCOVERY_SRC_PORT 60999
+#define DISCOVERY_ECHO_ID 1001
+
+// Default rate of ARP requests and pings in probes per second
+#define DISCOVERY_DEFAULT_PPS 10000
+
+// Time waited for the last replies of each sweep in milliseconds
+#define DISCOVERY_WAIT_MS 1000
+
+// Most targets swept at once, each keeps the MAC address it is reached at
+#define DISCOVERY_MAX_TARGETS (1 << 22)
+
+// Room for the largest probe, padded to the minimum ethernet frame
+#define DISCOVERY_FRAME_LEN 64
+
+/*
+ * Struct: host_discovery
+ * ----------------------
+ * The live hosts among a set of targets, indexed like the set (see
+ * interval_set_at).
+ *
+ * targets: The targets swept.
+ *
+ * live: A bitmap of the targets that answered a ping.
+ *
+ * macs: The MAC address each target is reached at: its own if it answered
+ *       ARP, otherwise its gateway's, or zero if neither is known.
+ *
+ * live_len: The number of live targets.
+ */
+struct host_discovery {
+    const struct interval_set *targets;
+    unsigned long long *live;
+    unsigned char (*macs)[MAC_LEN];
+    unsigned long long live_len;
+};
+
+/*
+ * Function: parse_discovery_probes
+ * --------------------------------
+ * Parses a comma separated list of pings, e.g. "icmp,syn,ack".
+ *
+ * spec: The list.
+ *
+ * return: The DISCOVER_ flags of the pings, or -1 if the list is invalid.
+ */
+int parse_discovery_probes(const char *spec);
+
+/*
+ * Function: discover_hosts
+ * ------------------------
+ * Finds the live targets with two sweeps per interface, each sent at a fixed
+ * rate while a listener thread matches replies to targets.  ARP requests 
+ * resolve the MAC address of every on-link target and the gateways, then the
+ * targets are pinged at theirs, or their gateway's if they are off-link or 
+ * did not answer.  Any reply to a ping marks its target live.  With a
+ * neighbor cache, cached targets are not waited for in the ARP sweep, and the
+ * pings decide which entries are kept.
+ *
+ * disc: Populated with the live targets.  Free it with free_discovery, also
+ *       on error.
+ *
+ * targets: The normalized IPv4 targets (host byte order).
+ *
+ * probes: The DISCOVER_ flags of the pings to send each target.
+ *
+ * rate_pps: The most probes sent per second.
+ *
+ * routes: The routing table, whose routes pick the interface and gateway of
+ *         each target, or NULL to sweep every target from dev_name as if it
+ *         were on-link, through its default gateway if it does not answer.
+ *
+ * dev_name: The network interface to sweep from without a routing table.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int discover_hosts(struct host_discovery *disc,
+        const struct interval_set *targets, int probes, unsigned int rate_pps,
+        struct route_table *routes, const char *dev_name);
+
+/*
+ * Function: discovery_is_live
+ * ---------------------------
+ * return: 1 if the target at an index answered a ping, otherwise 0.
+ */
+int discovery_is_live(const struct host_discovery *disc,
+        unsigned long long index);
+
+/*
+ * Function: free_discovery
+ * ------------------------
+ * Frees the live bitmap and MAC addresses of a discovery.
+ */
+void free_discovery(struct host_discovery *disc);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,470 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "fingerprint_service.h"
+#include "../constants/constants.h"
+
+#define FP(service, product, pattern, flags) \
+        { service, product, (const unsigned char *)pattern, \
+        sizeof(pattern) - 1, flags }
+
+// Specific fingerprints come before the generic ones of the same service
+static const struct fingerprint DEFAULT_FPS[] = {
+    FP("ssh", "OpenSSH", "SSH-2.0-OpenSSH", FP_ANCHORED),
+    FP("ssh", "Dropbear", "SSH-2.0-dropbear", FP_ANCHORED),
+    FP("ssh", "libssh", "SSH-2.0-libssh", FP_ANCHORED),
+    FP("ssh", NULL, "SSH-", FP_ANCHORED),
+    FP("http", NULL, "HTTP/1.", FP_ANCHORED),
+    FP("pop3", "Dovecot", "+OK Dovecot", FP_ANCHORED),
+    FP("pop3", NULL, "+OK", FP_ANCHORED),
+    FP("imap", "Dovecot", "Dovecot ready", 0),
+    FP("imap", "Courier", "Courier-IMAP", 0),
+    FP("imap", NULL, "* OK", FP_ANCHORED),
+    FP("imap", NULL, "* PREAUTH", FP_ANCHORED),
+    FP("smtp", "Postfix", "ESMTP Postfix", 0),
+    FP("smtp", "Exim", " ESMTP Exim ", 0),
+    FP("smtp", "Sendmail", "ESMTP Sendmail", 0),
+    FP("smtp", "Microsoft ESMTP", "Microsoft ESMTP MAIL Service", 0),
+    FP("smtp", NULL, "ESMTP", FP_NOCASE),
+    FP("ftp", "vsftpd", "vsFTPd", FP_NOCASE),
+    FP("ftp", "ProFTPD", "ProFTPD", 0),
+    FP("ftp", "Pure-FTPd", "Pure-FTPd", 0),
+    FP("ftp", "FileZilla", "FileZilla Server", 0),
+    FP("ftp", NULL, "FTP", FP_NOCASE),
+    FP("smtp", NULL, "SMTP", FP_NOCASE),
+    FP("nntp", NULL, "NNTP", FP_NOCASE),
+    FP("mysql", "MariaDB", "MariaDB", 0),
+    FP("mysql", NULL, "mysql_native_password", 0),
+    FP("mysql", NULL, "caching_sha2_password", 0),
+    FP("vnc", NULL, "RFB 00", FP_ANCHORED),
+    FP("rsync", NULL, "@RSYNCD:", FP_ANCHORED),
+    FP("xmpp", NULL, "<stream:stream", FP_NOCASE),
+    FP("amqp", NULL, "AMQP", FP_ANCHORED),
+    FP("irc", NULL, "NOTICE AUTH", FP_NOCASE),
+    FP("irc", NULL, "*** Looking up your hostname", FP_NOCASE),
+    FP("telnet", NULL, "\xff\xfb", FP_ANCHORED),
+    FP("telnet", NULL, "\xff\xfd", FP_ANCHORED),
+    FP("redis", NULL, "-NOAUTH", FP_ANCHORED),
+    FP("redis", NULL, "-DENIED Redis", FP_ANCHORED)
+};
+
+static const int DEFAULT_FPS_LEN =
+        sizeof(DEFAULT_FPS) / sizeof(struct fingerprint);
+
+const struct fingerprint * get_default_fingerprints(int *fps_len) {
+    *fps_len = DEFAULT_FPS_LEN;
+
+    return DEFAULT_FPS;
+}
+
+static unsigned char fold_byte(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+void free_fingerprints(struct fingerprint_matcher *matcher) {
+    if (matcher == NULL) {
+        return;
+    }
+
+    free(matcher->fps);
+    free(matcher->delta);
+    free(matcher->fail);
+    free(matcher->out);
+    free(matcher->out_link);
+    free(matcher->out_next);
+    free(matcher->owned);
+    free(matcher);
+}
+
+/*
+ * Builds the failure links breadth first, completing the transitions of each
+ * state from those of its failure state, which is shallower and so already
+ * complete.  The trie transitions of a state are still unfilled when it is
+ * dequeued, so a non-zero entry is a child.
+ */
+static void build_failure_links(struct fingerprint_matcher *m) {
+    int *queue = malloc(sizeof(int) * m->states_len);
+    int queue_head = 0;
+    int queue_len = 0;
+
+    m->fail[0] = 0;
+    m->out_link[0] = -1;
+
+    for (int c = 0; c < 256; c++) {
+        int t = m->delta[c];
+
+        if (t != 0) {
+            m->fail[t] = 0;
+            m->out_link[t] = m->out[t] >= 0 ? t : -1;
+            queue[queue_len++] = t;
+        }
+    }
+
+    while (queue_head < queue_len) {
+        int s = queue[queue_head++];
+        unsigned short *row = m->delta + (size_t)s * 256;
+        const unsigned short *fail_row = m->delta + (size_t)m->fail[s] * 256;
+
+        for (int c = 0; c < 256; c++) {
+            int t = row[c];
+
+            if (t == 0) {
+                row[c] = fail_row[c];
+
+                continue;
+            }
+
+            m->fail[t] = fail_row[c];
+            m->out_link[t] = m->out[t] >= 0 ? t : m->out_link[m->fail[t]];
+            queue[queue_len++] = t;
+        }
+    }
+
+    free(queue);
+}
+
+struct fingerprint_matcher * compile_fingerprints(
+        const struct fingerprint *fps, int fps_len) {
+    int max_states = 1;
+
+    for (int i = 0; i < fps_len; i++) {
+        if (fps[i].pattern_len < 1 || fps[i].pattern_len > FP_MAX_PATTERN) {
+            fprintf(stderr, "ERROR: Invalid pattern for fingerprint %s!\n",
+                    fps[i].service);
+
+            return NULL;
+        }
+
+        max_states += fps[i].pattern_len;
+    }
+
+    if (max_states > FP_MAX_STATES) {
+        fprintf(stderr, "ERROR: Too many fingerprint patterns!\n");
+
+        return NULL;
+    }
+
+    struct fingerprint_matcher *m = calloc(1,
+            sizeof(struct fingerprint_matcher));
+
+    if (m == NULL) {
+        return NULL;
+    }
+
+    m->fps = malloc(sizeof(struct fingerprint) * (fps_len > 0 ? fps_len : 1));
+    m->delta = calloc((size_t)max_states * 256, sizeof(unsigned short));
+    m->fail = malloc(sizeof(int) * max_states);
+    m->out = malloc(sizeof(int) * max_states);
+    m->out_link = malloc(sizeof(int) * max_states);
+    m->out_next = malloc(sizeof(int) * (fps_len > 0 ? fps_len : 1));
+
+    if (m->fps == NULL || m->delta == NULL || m->fail == NULL ||
+            m->out == NULL || m->out_link == NULL || m->out_next == NULL) {
+        free_fingerprints(m);
+
+        return NULL;
+    }
+
+    memcpy(m->fps, fps, sizeof(struct fingerprint) * fps_len);
+    m->fps_len = fps_len;
+    m->states_len = 1;
+
+    for (int s = 0; s < max_states; s++) {
+        m->out[s] = -1;
+    }
+
+    // Build the trie of the lowercased patterns
+    for (int i = 0; i < fps_len; i++) {
+        int s = 0;
+
+        for (int j = 0; j < fps[i].pattern_len; j++) {
+            unsigned short *next = m->delta + (size_t)s * 256 +
+                    fold_byte(fps[i].pattern[j]);
+
+            if (*next == 0) {
+                *next = (unsigned short)m->states_len++;
+            }
+
+            s = *next;
+        }
+
+        // Keep the fingerprints ending at a state in priority order
+        m->out_next[i] = -1;
+
+        if (m->out[s] < 0) {
+            m->out[s] = i;
+        } else {
+            int last = m->out[s];
+
+            while (m->out_next[last] >= 0) {
+                last = m->out_next[last];
+            }
+
+            m->out_next[last] = i;
+        }
+    }
+
+    build_failure_links(m);
+
+    // Uppercase letters go wherever their lowercase letter goes
+    for (int s = 0; s < m->states_len; s++) {
+        unsigned short *row = m->delta + (size_t)s * 256;
+
+        for (int c = 'A'; c <= 'Z'; c++) {
+            row[c] = row[c + ('a' - 'A')];
+        }
+    }
+
+    unsigned short *delta = realloc(m->delta,
+            (size_t)m->states_len * 256 * sizeof(unsigned short));
+
+    if (delta != NULL) {
+        m->delta = delta;
+    }
+
+    if (DEBUG >= 2) {
+        printf("Compiled %d fingerprints into %d states\n", fps_len,
+                m->states_len);
+    }
+
+    return m;
+}
+
+/*
+ * Decodes the escapes of a pattern in place.  Returns the length of the
+ * pattern, or -1 on an invalid escape.
+ */
+static int unescape_pattern(char *pattern) {
+    unsigned char *dst = (unsigned char *)pattern;
+
+    for (const char *src = pattern; *src != '\0'; src++) {
+        if (*src != '\\') {
+            *dst++ = (unsigned char)*src;
+
+            continue;
+        }
+
+        src++;
+
+        if (*src == 'r') {
+            *dst++ = '\r';
+        } else if (*src == 'n') {
+            *dst++ = '\n';
+        } else if (*src == 't') {
+            *dst++ = '\t';
+        } else if (*src == '\\') {
+            *dst++ = '\\';
+        } else if (*src == 'x') {
+            if (!isxdigit((unsigned char)src[1]) ||
+                    !isxdigit((unsigned char)src[2])) {
+                return -1;
+            }
+
+            char hex[3] = { src[1], src[2], '\0' };
+
+            *dst++ = (unsigned char)strtol(hex, NULL, 16);
+            src += 2;
+        } else {
+            return -1;
+        }
+    }
+
+    return (int)(dst - (unsigned char *)pattern);
+}
+
+/*
+ * Parses a line of a fingerprint file in place.  Returns 1 for a
+ * fingerprint, 0 for a blank or comment line and -1 for an invalid line.
+ */
+static int parse_fingerprint_line(char *line, struct fingerprint *fp) {
+    const char *SPACE = " \t";
+
+    line += strspn(line, SPACE);
+
+    if (*line == '\0' || *line == '#') {
+        return 0;
+    }
+
+    char *service = line;
+    line += strcspn(line, SPACE);
+
+    if (*line == '\0') {
+        return -1;
+    }
+
+    *line++ = '\0';
+    line += strspn(line, SPACE);
+
+    char *flags = line;
+    line += strcspn(line, SPACE);
+
+    if (*line == '\0') {
+        return -1;
+    }
+
+    *line++ = '\0';
+    line += strspn(line, SPACE);
+
+    fp->flags = 0;
+
+    for (const char *f = flags; *f != '\0'; f++) {
+        if (*f == '^') {
+            fp->flags |= FP_ANCHORED;
+        } else if (*f == 'i') {
+            fp->flags |= FP_NOCASE;
+        } else if (*f != '-') {
+            return -1;
+        }
+    }
+
+    char *slash = strchr(service, '/');
+
+    if (slash != NULL) {
+        *slash = '\0';
+    }
+
+    fp->service = service;
+    fp->product = slash != NULL && slash[1] != '\0' ? slash + 1 : NULL;
+    fp->pattern = (const unsigned char *)line;
+    fp->pattern_len = unescape_pattern(line);
+
+    return fp->pattern_len > 0 ? 1 : -1;
+}
+
+struct fingerprint_matcher * load_fingerprints(const char *path) {
+    FILE *fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot open fingerprint file %s!\n", path);
+
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_len = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    char *buff = malloc(file_len + 1);
+
+    if (buff == NULL || file_len < 0 ||
+            fread(buff, 1, file_len, fp) != (size_t)file_len) {
+        fprintf(stderr, "ERROR: Cannot read fingerprint file %s!\n", path);
+        fclose(fp);
+        free(buff);
+
+        return NULL;
+    }
+
+    fclose(fp);
+    buff[file_len] = '\0';
+
+    // Every fingerprint takes at least one line
+    int max_fps = 1;
+
+    for (long i = 0; i < file_len; i++) {
+        if (buff[i] == '\n') {
+            max_fps++;
+        }
+    }
+
+    struct fingerprint *fps = malloc(sizeof(struct fingerprint) * max_fps);
+    int fps_len = 0;
+    int line_num = 0;
+
+    for (char *line = buff; line != NULL; ) {
+        char *next = strchr(line, '\n');
+
+        if (next != NULL) {
+            *next++ = '\0';
+        }
+
+        size_t line_len = strlen(line);
+
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line[line_len - 1] = '\0';
+        }
+
+        line_num++;
+
+        int ret = parse_fingerprint_line(line, &fps[fps_len]);
+
+        if (ret < 0) {
+            fprintf(stderr, "ERROR: Invalid fingerprint on line %d of %s!\n",
+                    line_num, path);
+            free(fps);
+            free(buff);
+
+            return NULL;
+        }
+
+        fps_len += ret;
+        line = next;
+    }
+
+    struct fingerprint_matcher *matcher = compile_fingerprints(fps, fps_len);
+
+    free(fps);
+
+    if (matcher == NULL) {
+        free(buff);
+
+        return NULL;
+    }
+
+    matcher->owned = buff;
+
+    return matcher;
+}
+
+/*
+ * Checks the parts of a pattern the automaton cannot: the case of case
+ * sensitive patterns and the position of anchored ones.
+ */
+static int confirm_match(const struct fingerprint *fp,
+        const unsigned char *banner, int end) {
+    int start = end + 1 - fp->pattern_len;
+
+    if ((fp->flags & FP_ANCHORED) && start != 0) {
+        return 0;
+    }
+
+    if (fp->flags & FP_NOCASE) {
+        return 1;
+    }
+
+    return memcmp(banner + start, fp->pattern, fp->pattern_len) == 0;
+}
+
+const struct fingerprint * match_fingerprint(
+        const struct fingerprint_matcher *matcher,
+        const unsigned char *banner, int banner_len) {
+    const unsigned short *delta = matcher->delta;
+    const int *out_link = matcher->out_link;
+    int best = -1;
+    unsigned int s = 0;
+
+    for (int i = 0; i < banner_len; i++) {
+        s = delta[(s << 8) | banner[i]];
+
+        // Most bytes end no pattern, so this is a single load
+        for (int st = out_link[s]; st >= 0;
+                st = out_link[matcher->fail[st]]) {
+            for (int fp = matcher->out[st]; fp >= 0 &&
+                    (best < 0 || fp < best); fp = matcher->out_next[fp]) {
+                if (confirm_match(&matcher->fps[fp], banner, i)) {
+                    best = fp;
+
+                    break;
+                }
+            }
+        }
+
+        if (best == 0) {
+            break;
+        }
+    }
+
+    return best >= 0 ? &matcher->fps[best] : NULL;
+}
@@ -0,0 +1,143 @@
+#ifndef FINGERPRINT_SERVICE_H
+#define FINGERPRINT_SERVICE_H
+
+// Fingerprint flags
+#define FP_ANCHORED 0x01                // Pattern must start the banner
+#define FP_NOCASE 0x02                  // Pattern matches in any case
+
+// Longest pattern in bytes
+#define FP_MAX_PATTERN 128
+
+// Most states in a compiled matcher, so transitions fit in 16 bits
+#define FP_MAX_STATES 65535
+
+/*
+ * Struct: fingerprint
+ * -------------------
+ * A service signature: a byte string found in the banners the service sends.
+ *
+ * service: The service, e.g. "ssh".
+ *
+ * product: The software, e.g. "OpenSSH", or NULL.
+ *
+ * pattern: The bytes to find in the banner.
+ *
+ * pattern_len: The length of the pattern.
+ *
+ * flags: FP_ANCHORED and FP_NOCASE.
+ */
+struct fingerprint {
+    const char *service;
+    const char *product;
+    const unsigned char *pattern;
+    int pattern_len;
+    int flags;
+};
+
+/*
+ * Struct: fingerprint_matcher
+ * ---------------------------
+ * An Aho-Corasick automaton of every pattern, compiled into a DFA over
+ * lowercased bytes, so a banner is classified in a single pass with one
+ * table lookup per byte however many fingerprints there are.  Case sensitive
+ * and anchored patterns are confirmed where the automaton reports them.
+ *
+ * fps: The fingerprints, in order of priority.
+ *
+ * fps_len: The number of fingerprints.
+ *
+ * delta: The transitions, 256 per state.
+ *
+ * fail: The failure link of each state, the state of the longest proper
+ *       suffix of its path that is also a path.
+ *
+ * out: The first fingerprint whose pattern ends at each state, or -1.
+ *
+ * out_link: The state itself or the nearest state on its failure chain that
+ *           has a fingerprint ending at it, or -1.
+ *
+ * out_next: The next fingerprint ending at the same state, or -1.
+ *
+ * states_len: The number of states.
+ *
+ * owned: Buffer owning the strings of loaded fingerprints, or NULL.
+ */
+struct fingerprint_matcher {
+    struct fingerprint *fps;
+    int fps_len;
+    unsigned short *delta;
+    int *fail;
+    int *out;
+    int *out_link;
+    int *out_next;
+    int states_len;
+    char *owned;
+};
+
+/*
+ * Function: get_default_fingerprints
+ * ----------------------------------
+ * fps_len: Populated with the number of fingerprints.
+ *
+ * return: The built in fingerprints, in order of priority.
+ */
+const struct fingerprint * get_default_fingerprints(int *fps_len);
+
+/*
+ * Function: compile_fingerprints
+ * ------------------------------
+ * Compiles fingerprints into a matcher.  The fingerprints are copied, but
+ * their strings are not.
+ *
+ * fps: The fingerprints, in order of priority.
+ *
+ * fps_len: The number of fingerprints.
+ *
+ * return: The matcher, or NULL on error.
+ */
+struct fingerprint_matcher * compile_fingerprints(
+        const struct fingerprint *fps, int fps_len);
+
+/*
+ * Function: load_fingerprints
+ * ---------------------------
+ * Loads fingerprints from a file and compiles them.  Each line holds a
+ * service, optionally followed by a slash and the product, then the flags
+ * ("-", or "^" for anchored and "i" for any case) and the rest of the line
+ * is the pattern, in which \r, \n, \t, \\ and \xNN are escapes:
+ *
+ *     ssh/OpenSSH  ^  SSH-2.0-OpenSSH
+ *
+ * Blank lines and lines starting with # are skipped.
+ *
+ * path: The file.
+ *
+ * return: The matcher, or NULL on error.
+ */
+struct fingerprint_matcher * load_fingerprints(const char *path);
+
+/*
+ * Function: match_fingerprint
+ * ---------------------------
+ * Finds the fingerprint of a banner.
+ *
+ * matcher: The matcher.
+ *
+ * banner: The banner.
+ *
+ * banner_len: The length of the banner.
+ *
+ * return: The matching fingerprint earliest in priority order, or NULL.
+ */
+const struct fingerprint * match_fingerprint(
+        const struct fingerprint_matcher *matcher,
+        const unsigned char *banner, int banner_len);
+
+/*
+ * Function: free_fingerprints
+ * ---------------------------
+ * Frees a matcher.
+ */
+void free_fingerprints(struct fingerprint_matcher *matcher);
+
+#endif
\ No newline at end of file
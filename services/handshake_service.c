@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/random.h>
+
+#include "handshake_service.h"
+#include "checksum_service.h"
+#include "histogram_service.h"
+#include "tcp_service.h"
+#include "transport_service.h"
+#include "../constants/constants.h"
+
+// Sent to ports where the client speaks first
+static const unsigned char HTTP_HELLO[] = "GET / HTTP/1.0\r\n\r\n";
+
+static const unsigned short HTTP_PORTS[] = { 80, 8000, 8008, 8080, 8888 };
+
+static const unsigned char * get_tcp_hello(unsigned short port, int *len) {
+    for (int i = 0; i < (int)(sizeof(HTTP_PORTS) / sizeof(short)); i++) {
+        if (HTTP_PORTS[i] == port) {
+            *len = sizeof(HTTP_HELLO) - 1;
+
+            return HTTP_HELLO;
+        }
+    }
+
+    *len = 0;
+
+    return NULL;
+}
+
+struct handshake * handshake_create(const unsigned char *src_ip,
+        const unsigned char *tar_ip, const unsigned char *src_mac,
+        const unsigned char *tar_mac, int inter_index,
+        banner_handler handler, void *ctx) {
+    struct handshake *hs = calloc(1, sizeof(struct handshake));
+
+    if (hs == NULL) {
+        return NULL;
+    }
+
+    // A predictable key only weakens the check against forged replies
+    if (getrandom(hs->key, sizeof(hs->key), 0) != sizeof(hs->key)) {
+        hs->key[0] = get_time_ns();
+        hs->key[1] = ((unsigned long long)getpid() << 32) ^ get_time_ns();
+    }
+
+    memcpy(hs->src_ip, src_ip, IP_LEN);
+    memcpy(hs->tar_ip, tar_ip, IP_LEN);
+    memcpy(hs->src_mac, src_mac, MAC_LEN);
+    memcpy(hs->tar_mac, tar_mac, MAC_LEN);
+    hs->handler = handler;
+    hs->ctx = ctx;
+
+    hs->t = transport_open(inter_index, src_mac, 0);
+
+    if (hs->t == NULL) {
+        free(hs);
+
+        return NULL;
+    }
+
+    return hs;
+}
+
+void handshake_free(struct handshake *hs) {
+    if (hs == NULL) {
+        return;
+    }
+
+    transport_close(hs->t);
+    free(hs);
+}
+
+unsigned short handshake_src_port(unsigned short src_port) {
+    return HANDSHAKE_SRC_PORT_MIN + src_port % HANDSHAKE_SRC_PORTS;
+}
+
+static unsigned long long mix64(unsigned long long x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+
+    return x;
+}
+
+unsigned int syn_cookie(const struct handshake *hs, unsigned short src_port,
+        unsigned short dst_port) {
+    unsigned int tar_ip;
+    memcpy(&tar_ip, hs->tar_ip, IP_LEN);
+
+    unsigned long long x = ((unsigned long long)tar_ip << 32) |
+            ((unsigned int)src_port << 16) | dst_port;
+
+    return (unsigned int)mix64(mix64(x ^ hs->key[0]) ^ hs->key[1]);
+}
+
+void stamp_syn_cookie(unsigned char *frame, unsigned int cookie) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    struct tcphdr *th = (struct tcphdr *)
+            (frame + sizeof(struct ethhdr) + iph->ihl * 4);
+
+    // The zero sequence number added nothing to the checksum
+    th->seq = htonl(cookie);
+    th->check = checksum_fold(checksum_add((unsigned short)~th->check,
+            &th->seq, sizeof(th->seq)));
+}
+
+/*
+ * Sends a segment of the connection between a pair of ports.
+ */
+static int send_segment(struct handshake *hs, unsigned short src_port,
+        unsigned short dst_port, unsigned int seq, unsigned int ack,
+        unsigned char flags, const unsigned char *data, int data_len) {
+    unsigned char frame[HANDSHAKE_MAX_FRAME];
+    memset(frame, 0, sizeof(frame));
+
+    const int TCP_LEN = sizeof(struct tcphdr) + data_len;
+    const int FRAME_LEN = sizeof(struct ethhdr) + sizeof(struct iphdr) +
+            TCP_LEN;
+
+    struct ethhdr *eth = (struct ethhdr *)frame;
+    memcpy(eth->h_source, hs->src_mac, MAC_LEN);
+    memcpy(eth->h_dest, hs->tar_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *iph = (struct iphdr *)(frame + sizeof(struct ethhdr));
+    iph->version = 4;
+    iph->ihl = 5;
+    iph->tot_len = htons(sizeof(struct iphdr) + TCP_LEN);
+    iph->frag_off = htons(IP_DF);
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_TCP;
+    memcpy(&iph->saddr, hs->src_ip, IP_LEN);
+    memcpy(&iph->daddr, hs->tar_ip, IP_LEN);
+    iph->check = checksum_fold(checksum_add(0, iph, sizeof(struct iphdr)));
+
+    struct tcphdr *th = (struct tcphdr *)
+            ((unsigned char *)iph + sizeof(struct iphdr));
+    th->source = htons(src_port);
+    th->dest = htons(dst_port);
+    th->seq = htonl(seq);
+    th->ack_seq = htonl(ack);
+    th->doff = 5;
+    ((unsigned char *)th)[TCP_FLAGS_OFFSET] = flags;
+    th->window = htons(5840);
+
+    if (data_len > 0) {
+        memcpy((unsigned char *)th + sizeof(struct tcphdr), data, data_len);
+    }
+
+    struct psheader psh;
+    memset(&psh, 0, sizeof(struct psheader));
+    psh.saddr = iph->saddr;
+    psh.daddr = iph->daddr;
+    psh.protocol = IPPROTO_TCP;
+    psh.tcpseglen = htons(TCP_LEN);
+
+    th->check = checksum_fold(checksum_add(checksum_add(0, &psh,
+            sizeof(struct psheader)), th, TCP_LEN));
+
+    return transport_send(hs->t, frame, FRAME_LEN);
+}
+
+int handshake_handle_reply(struct handshake *hs,
+        const struct reply_record *rec, const unsigned char *payload) {
+    unsigned short port = rec->src_port;
+    unsigned int cookie = syn_cookie(hs, rec->dst_port, port);
+
+    int hello_len;
+    const unsigned char *hello = get_tcp_hello(port, &hello_len);
+
+    // A reset answering a probe acknowledges the cookie like a SYN-ACK
+    if (rec->tcp_flags & TH_RST) {
+        return !(rec->tcp_flags & TH_ACK) || rec->ack == cookie + 1;
+    }
+
+    if ((rec->tcp_flags & (TH_SYN | TH_ACK)) == (TH_SYN | TH_ACK)) {
+        if (rec->ack != cookie + 1) {
+            hs->bad_cookies++;
+
+            return 0;
+        }
+
+        // Retransmitted SYN-ACKs are answered again in case the ACK was lost
+        if (hs->states[port] != HANDSHAKE_DONE) {
+            hs->server_isn[port] = rec->seq;
+            hs->states[port] = HANDSHAKE_ACKED;
+
+            send_segment(hs, rec->dst_port, port, cookie + 1, rec->seq + 1,
+                    hello_len > 0 ? TH_ACK | TH_PUSH : TH_ACK, hello,
+                    hello_len);
+        }
+
+        return 1;
+    }
+
+    // Only the first segment of data, acknowledging some or all of the hello
+    if (rec->payload_len == 0 || hs->states[port] != HANDSHAKE_ACKED ||
+            rec->seq != hs->server_isn[port] + 1 ||
+            rec->ack - (cookie + 1) > (unsigned int)hello_len) {
+        return 0;
+    }
+
+    hs->states[port] = HANDSHAKE_DONE;
+    hs->banners++;
+
+    hs->handler(port, payload, rec->payload_len, hs->ctx);
+
+    send_segment(hs, rec->dst_port, port, cookie + 1 + hello_len, 0, TH_RST,
+            NULL, 0);
+
+    if (DEBUG >= 2) {
+        printf("Banner of %d bytes read from port %d\n", rec->payload_len,
+                port);
+    }
+
+    return 0;
+}
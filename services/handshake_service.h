@@ -0,0 +1,151 @@
+#ifndef HANDSHAKE_SERVICE_H
+#define HANDSHAKE_SERVICE_H
+
+#include "banner_service.h"
+#include "../constants/constants.h"
+
+struct transport;
+struct reply_record;
+
+// Source ports of stateless probes, above Linux's default ephemeral port
+// range (32768 - 60999) so a firewall rule can drop the kernel's resets
+#define HANDSHAKE_SRC_PORT_MIN 61000
+#define HANDSHAKE_SRC_PORTS 1000
+
+// Largest segment sent: ethernet, IP and TCP headers and a hello
+#define HANDSHAKE_MAX_FRAME 128
+
+// Progress of the handshake with each port
+#define HANDSHAKE_NONE 0
+#define HANDSHAKE_ACKED 1               // SYN-ACK answered, awaiting data
+#define HANDSHAKE_DONE 2                // Banner read and connection reset
+
+/*
+ * Struct: handshake
+ * -----------------
+ * Completes TCP handshakes with open ports from raw frames, without kernel
+ * sockets.  Each probe's initial sequence number is a SYN cookie, a keyed
+ * hash of its ports, so a SYN-ACK is verified by its acknowledgment number
+ * alone.  Only the server's initial sequence number is kept per port.
+ *
+ * key: The secret key of the SYN cookies.
+ *
+ * src_ip: The local IP address in array format.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * src_mac: The local MAC address.
+ *
+ * tar_mac: The MAC address segments are sent to.
+ *
+ * t: The transport segments are sent on.
+ *
+ * server_isn: The initial sequence number of each port's SYN-ACK.
+ *
+ * states: The HANDSHAKE_* progress of each port.
+ *
+ * handler: Called with the first segment of data each port sends.
+ *
+ * ctx: Passed to the handler.
+ *
+ * banners: The number of banners read.
+ *
+ * bad_cookies: The number of replies dropped for a wrong cookie.
+ */
+struct handshake {
+    unsigned long long key[2];
+    unsigned char src_ip[IP_LEN];
+    unsigned char tar_ip[IP_LEN];
+    unsigned char src_mac[MAC_LEN];
+    unsigned char tar_mac[MAC_LEN];
+    struct transport *t;
+    unsigned int server_isn[MAX_PORT + 1];
+    unsigned char states[MAX_PORT + 1];
+    banner_handler handler;
+    void *ctx;
+    int banners;
+    unsigned long bad_cookies;
+};
+
+/*
+ * Function: handshake_create
+ * --------------------------
+ * Creates the handshake state of an IPv4 scan with a random cookie key.
+ *
+ * src_ip: The local IP address in array format.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * src_mac: The local MAC address.
+ *
+ * tar_mac: The MAC address segments are sent to.
+ *
+ * inter_index: The interface to send on.
+ *
+ * handler: Called with the first segment of data each port sends.
+ *
+ * ctx: Passed to the handler.
+ *
+ * return: The handshake state, or NULL on error.
+ */
+struct handshake * handshake_create(const unsigned char *src_ip,
+        const unsigned char *tar_ip, const unsigned char *src_mac,
+        const unsigned char *tar_mac, int inter_index,
+        banner_handler handler, void *ctx);
+
+/*
+ * Function: handshake_free
+ * ------------------------
+ * Closes the transport and frees the handshake state.
+ */
+void handshake_free(struct handshake *hs);
+
+/*
+ * Function: handshake_src_port
+ * ----------------------------
+ * Maps a random source port in to the stateless source port range.
+ */
+unsigned short handshake_src_port(unsigned short src_port);
+
+/*
+ * Function: syn_cookie
+ * --------------------
+ * return: The initial sequence number of the probe between a pair of ports.
+ */
+unsigned int syn_cookie(const struct handshake *hs, unsigned short src_port,
+        unsigned short dst_port);
+
+/*
+ * Function: stamp_syn_cookie
+ * --------------------------
+ * Sets the sequence number of an IPv4 SYN probe built with a zero sequence
+ * number, updating its TCP checksum in place.
+ *
+ * frame: The probe.
+ *
+ * cookie: The sequence number.
+ */
+void stamp_syn_cookie(unsigned char *frame, unsigned int cookie);
+
+/*
+ * Function: handshake_handle_reply
+ * --------------------------------
+ * Handles a TCP segment from the target.  A SYN-ACK with a valid cookie is
+ * answered with an ACK, carrying a protocol hello for ports where the client
+ * speaks first.  The server's first segment of data is passed to the handler
+ * and the connection is reset.  Segments out of order are ignored, the
+ * server retransmits them as nothing past the SYN-ACK is acknowledged.
+ *
+ * hs: The handshake state.
+ *
+ * rec: The segment.
+ *
+ * payload: The payload of the segment, rec->payload_len bytes.
+ *
+ * return: 1 if the segment classifies the port (a SYN-ACK or reset with a
+ *         valid cookie), or 0 if it was consumed or dropped.
+ */
+int handshake_handle_reply(struct handshake *hs,
+        const struct reply_record *rec, const unsigned char *payload);
+
+#endif
\ No newline at end of file
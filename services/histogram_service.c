@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <time.h>
+
+#include "histogram_service.h"
+#include "../constants/constants.h"
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+    "interface_lookup",
+    "arp",
+    "ping",
+    "send",
+    "drain"
+};
+
+static struct timing_report timings = {
+    .enabled = 0,
+    .probe_rtt = { .name = "probe_rtt", .min = ~0ULL },
+    .arp_resolve = { .name = "arp_resolve", .min = ~0ULL },
+    .icmp_ping = { .name = "icmp_ping", .min = ~0ULL }
+};
+
+unsigned long long get_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct timing_report * get_timings() {
+    return &timings;
+}
+
+void enable_timings() {
+    timings.enabled = 1;
+}
+
+static int get_bucket_index(unsigned long long value) {
+    if (value < HIST_SUB_BUCKETS) {
+        return (int)value;
+    }
+
+    int exp = 63 - __builtin_clzll(value);
+    int sub = (int)((value >> (exp - HIST_SUB_BITS)) & (HIST_SUB_BUCKETS - 1));
+
+    return HIST_SUB_BUCKETS + (exp - HIST_SUB_BITS) * HIST_SUB_BUCKETS + sub;
+}
+
+static unsigned long long get_bucket_value(int index) {
+    if (index < HIST_SUB_BUCKETS) {
+        return (unsigned long long)index;
+    }
+
+    int exp = (index - HIST_SUB_BUCKETS) / HIST_SUB_BUCKETS + HIST_SUB_BITS;
+    unsigned long long sub = (index - HIST_SUB_BUCKETS) % HIST_SUB_BUCKETS;
+
+    return (1ULL << exp) | (sub << (exp - HIST_SUB_BITS));
+}
+
+void hist_record(struct histogram *hist, unsigned long long value_ns) {
+    if (!timings.enabled) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&hist->counts[get_bucket_index(value_ns)], 1,
+            memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->total, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sum, value_ns, memory_order_relaxed);
+
+    unsigned long long curr = atomic_load_explicit(&hist->min, 
+            memory_order_relaxed);
+
+    while (value_ns < curr && !atomic_compare_exchange_weak_explicit(
+            &hist->min, &curr, value_ns, memory_order_relaxed, 
+            memory_order_relaxed));
+
+    curr = atomic_load_explicit(&hist->max, memory_order_relaxed);
+
+    while (value_ns > curr && !atomic_compare_exchange_weak_explicit(
+            &hist->max, &curr, value_ns, memory_order_relaxed, 
+            memory_order_relaxed));
+}
+
+unsigned long long hist_percentile(struct histogram *hist, double percentile) {
+    unsigned long total = atomic_load(&hist->total);
+
+    if (total == 0) {
+        return 0;
+    }
+
+    // Rank of the value, rounded up so p100 is the last value
+    unsigned long rank = (unsigned long)((percentile / 100.0) * total + 0.5);
+
+    if (rank < 1) {
+        rank = 1;
+    }
+
+    unsigned long seen = 0;
+    unsigned long long value = atomic_load(&hist->max);
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += atomic_load(&hist->counts[i]);
+
+        if (seen >= rank) {
+            value = get_bucket_value(i);
+
+            break;
+        }
+    }
+
+    // The bucket's lower bound can be below the smallest recorded value
+    if (value < atomic_load(&hist->min)) {
+        value = atomic_load(&hist->min);
+    }
+
+    return value;
+}
+
+void record_phase(enum timing_phase phase, unsigned long long start_ns) {
+    if (!timings.enabled) {
+        return;
+    }
+
+    atomic_fetch_add_explicit(&timings.phase_ns[phase], 
+            get_time_ns() - start_ns, memory_order_relaxed);
+}
+
+static void print_histogram(FILE *fp, struct histogram *hist) {
+    unsigned long total = atomic_load(&hist->total);
+
+    if (total == 0) {
+        fprintf(fp, "%-16s %8d\n", hist->name, 0);
+
+        return;
+    }
+
+    fprintf(fp, "%-16s %8lu %10.3f %10.3f %10.3f %10.3f %10.3f %10.3f\n", 
+            hist->name, total,
+            atomic_load(&hist->min) / 1000000.0,
+            hist_percentile(hist, 50) / 1000000.0,
+            hist_percentile(hist, 90) / 1000000.0,
+            hist_percentile(hist, 99) / 1000000.0,
+            hist_percentile(hist, 99.9) / 1000000.0,
+            atomic_load(&hist->max) / 1000000.0);
+}
+
+void print_timings(FILE *fp) {
+    fprintf(fp, "\n");
+    fprintf(fp, "Phase Timings\n");
+    fprintf(fp, "-------------\n\n");
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(fp, "%-20s %12.3f ms\n", PHASE_NAMES[i], 
+                atomic_load(&timings.phase_ns[i]) / 1000000.0);
+    }
+
+    fprintf(fp, "\n");
+    fprintf(fp, "Latency Histograms (ms)\n");
+    fprintf(fp, "-----------------------\n\n");
+    fprintf(fp, "%-16s %8s %10s %10s %10s %10s %10s %10s\n", "name", "count",
+            "min", "p50", "p90", "p99", "p99.9", "max");
+
+    print_histogram(fp, &timings.probe_rtt);
+    print_histogram(fp, &timings.arp_resolve);
+    print_histogram(fp, &timings.icmp_ping);
+}
+
+static void write_histogram_json(FILE *fp, struct histogram *hist) {
+    unsigned long total = atomic_load(&hist->total);
+
+    fprintf(fp, "    \"%s\": {\n", hist->name);
+    fprintf(fp, "      \"count\": %lu,\n", total);
+    fprintf(fp, "      \"sum_ns\": %llu,\n", atomic_load(&hist->sum));
+    fprintf(fp, "      \"min_ns\": %llu,\n", 
+            total ? atomic_load(&hist->min) : 0);
+    fprintf(fp, "      \"p50_ns\": %llu,\n", hist_percentile(hist, 50));
+    fprintf(fp, "      \"p90_ns\": %llu,\n", hist_percentile(hist, 90));
+    fprintf(fp, "      \"p99_ns\": %llu,\n", hist_percentile(hist, 99));
+    fprintf(fp, "      \"p999_ns\": %llu,\n", hist_percentile(hist, 99.9));
+    fprintf(fp, "      \"max_ns\": %llu,\n", atomic_load(&hist->max));
+    fprintf(fp, "      \"buckets\": [");
+
+    // Non-empty buckets as [lower bound, count] pairs
+    int first = 1;
+
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        unsigned long count = atomic_load(&hist->counts[i]);
+
+        if (count == 0) {
+            continue;
+        }
+
+        fprintf(fp, "%s[%llu, %lu]", first ? "" : ", ", get_bucket_value(i), 
+                count);
+        first = 0;
+    }
+
+    fprintf(fp, "]\n");
+    fprintf(fp, "    }");
+}
+
+int write_timings_json(const char *path) {
+    FILE *fp = fopen(path, "w");
+
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot write timings file: %s\n", path);
+
+        return -1;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"phases_ns\": {\n");
+
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        fprintf(fp, "    \"%s\": %llu%s\n", PHASE_NAMES[i], 
+                atomic_load(&timings.phase_ns[i]), 
+                (i < PHASE_COUNT - 1) ? "," : "");
+    }
+
+    fprintf(fp, "  },\n");
+    fprintf(fp, "  \"histograms\": {\n");
+
+    write_histogram_json(fp, &timings.probe_rtt);
+    fprintf(fp, ",\n");
+    write_histogram_json(fp, &timings.arp_resolve);
+    fprintf(fp, ",\n");
+    write_histogram_json(fp, &timings.icmp_ping);
+    fprintf(fp, "\n");
+
+    fprintf(fp, "  }\n");
+    fprintf(fp, "}\n");
+
+    return (fclose(fp) == 0) ? 0 : -1;
+}
@@ -0,0 +1,146 @@
+#ifndef HISTOGRAM_SERVICE_H
+#define HISTOGRAM_SERVICE_H
+
+#include <stdatomic.h>
+#include <stdio.h>
+
+/*
+ * Histograms are log-linear in the style of HDR histograms.  Values below 
+ * HIST_SUB_BUCKETS get a bucket each, larger values are split in to 
+ * HIST_SUB_BUCKETS buckets per power of 2, which bounds the relative error of
+ * any reported value to 1 / HIST_SUB_BUCKETS (6.25%).
+ */
+#define HIST_SUB_BITS 4
+#define HIST_SUB_BUCKETS (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS (HIST_SUB_BUCKETS + (64 - HIST_SUB_BITS) * HIST_SUB_BUCKETS)
+
+/*
+ * Phases of main() which are timed.
+ */
+enum timing_phase {
+    PHASE_INTERFACE,        // Interface index, MAC and IP lookup
+    PHASE_ARP,              // Destination MAC resolution
+    PHASE_PING,             // ICMP ping of the target
+    PHASE_SEND,             // Sending every probe
+    PHASE_DRAIN,            // Waiting for replies after the last probe
+    PHASE_COUNT
+};
+
+/*
+ * Struct: histogram
+ * -----------------
+ * A histogram of nanosecond values.  Safe to record from several threads.
+ */
+struct histogram {
+    const char *name;
+    atomic_ulong counts[HIST_BUCKETS];
+    atomic_ulong total;
+    atomic_ullong sum;
+    atomic_ullong min;
+    atomic_ullong max;
+};
+
+/*
+ * Struct: timing_report
+ * ---------------------
+ * Every timing collected during a run.
+ *
+ * enabled: 1 if timings are being collected.
+ *
+ * probe_rtt: Time from a SYN being sent to its reply being received.
+ *
+ * arp_resolve: Time from an ARP request or IPv6 Neighbor Solicitation to its
+ *              reply or timeout.
+ *
+ * icmp_ping: Time from an ICMP or ICMPv6 echo request to its reply or
+ *            timeout.
+ *
+ * phase_ns: Duration of each timing_phase.
+ */
+struct timing_report {
+    unsigned char enabled;
+    struct histogram probe_rtt;
+    struct histogram arp_resolve;
+    struct histogram icmp_ping;
+    atomic_ullong phase_ns[PHASE_COUNT];
+};
+
+/*
+ * Function: get_time_ns
+ * ---------------------
+ * return: The current CLOCK_MONOTONIC time in nanoseconds.
+ */
+unsigned long long get_time_ns();
+
+/*
+ * Function: get_timings
+ * ---------------------
+ * return: The timing report of this run.
+ */
+struct timing_report * get_timings();
+
+/*
+ * Function: enable_timings
+ * ------------------------
+ * Enables collection of timings.  Until called, recording is a no-op.
+ */
+void enable_timings();
+
+/*
+ * Function: hist_record
+ * ---------------------
+ * Records a value in a histogram if timings are enabled.
+ *
+ * hist: The histogram.
+ *
+ * value_ns: The value in nanoseconds.
+ */
+void hist_record(struct histogram *hist, unsigned long long value_ns);
+
+/*
+ * Function: hist_percentile
+ * -------------------------
+ * Returns the lower bound of the bucket holding a percentile, but no less 
+ * than the smallest recorded value.
+ *
+ * hist: The histogram.
+ *
+ * percentile: The percentile, between 0 and 100.
+ *
+ * return: The percentile value in nanoseconds, or 0 if the histogram is empty.
+ */
+unsigned long long hist_percentile(struct histogram *hist, double percentile);
+
+/*
+ * Function: record_phase
+ * ----------------------
+ * Adds time spent in a phase of main() if timings are enabled.
+ *
+ * phase: The phase.
+ *
+ * start_ns: When the phase started, from get_time_ns().
+ */
+void record_phase(enum timing_phase phase, unsigned long long start_ns);
+
+/*
+ * Function: print_timings
+ * -----------------------
+ * Prints the phase durations and histogram percentiles as text.
+ *
+ * fp: The stream to print to.
+ */
+void print_timings(FILE *fp);
+
+/*
+ * Function: write_timings_json
+ * ----------------------------
+ * Writes the phase durations, histogram percentiles and non-empty buckets
+ * as JSON.
+ *
+ * path: The file to write.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int write_timings_json(const char *path);
+
+#endif
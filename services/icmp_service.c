@@ -7,19 +7,21 @@
 #include <net/ethernet.h>
 #include <netinet/ip.h>
 #include <netinet/ip_icmp.h>
+#include <netinet/ip6.h>
 
 #include <errno.h>
 #include <time.h>
 
 #include "icmp_service.h"
 #include "checksum_service.h"
-#include "packet_service.h"
+#include "transport_service.h"
 #include "network_helper.h"
+#include "histogram_service.h"
 #include "../constants/constants.h"
 
 int send_icmp_request(const char* src_ip, const char* dst_ip, 
         const unsigned char *src_mac, const unsigned char *dst_mac, 
-        int sock_raw, int inter_index) {
+        struct transport *t) {
 
     if (DEBUG >= 2) {
         printf("Sending ICMP request for target IP: %s\n", dst_ip);
@@ -32,10 +34,11 @@ int send_icmp_request(const char* src_ip, const char* dst_ip,
         return -1;
     }
     
-    int send_len = send_packet(packet, ICMP_PACK_LENGTH, sock_raw, inter_index,
-            src_mac);
+    int send_ret = transport_send(t, packet, ICMP_PACK_LENGTH);
+
+    free(packet);
     
-    if (send_len < 0) {
+    if (send_ret < 0) {
         return -1;
     }
 
@@ -48,21 +51,36 @@ int send_icmp_request(const char* src_ip, const char* dst_ip,
 
 int ping_target(const unsigned char* src_ip, const unsigned char* dst_ip, 
         const unsigned char *src_mac, const unsigned char *dst_mac, 
-        int sock_raw, int inter_index) {
+        int inter_index) {
     if (DEBUG >= 2) {
         printf("Pinging target IP: %s\n", get_ip_arr_str(dst_ip));
     }
 
+    unsigned long long ping_start = get_time_ns();
+
+    // Listen before sending so a fast reply cannot be missed
+    struct transport *t = transport_open(inter_index, src_mac, ETH_P_IP);
+
+    if (t == NULL) {
+        return -1;
+    }
+
     // Construct and send ICMP packet
     int icmp_req_val = send_icmp_request(get_ip_arr_str(src_ip), 
-            get_ip_arr_str(dst_ip), src_mac, dst_mac, sock_raw, inter_index);
+            get_ip_arr_str(dst_ip), src_mac, dst_mac, t);
     
     if (icmp_req_val < 0) {
+        transport_close(t);
+
         return -1;
     }
     
     // Wait for ICMP reply
-    int icmp_res_val = listen_for_icmp_response(src_mac, src_ip, dst_ip);
+    int icmp_res_val = listen_for_icmp_response(t, src_mac, src_ip, dst_ip);
+
+    transport_close(t);
+
+    hist_record(&get_timings()->icmp_ping, get_time_ns() - ping_start);
 
     // If timeout occurred
     if (icmp_res_val == 0) {
@@ -147,29 +165,17 @@ unsigned char * construct_icmp_packet(const char *src_ip, const char *dst_ip,
     return sendbuff;
 }  
 
-int listen_for_icmp_response(const unsigned char *loc_mac, 
-        const unsigned char *loc_ip, const unsigned char *tar_ip) {
+int listen_for_icmp_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip) {
     if (DEBUG >= 2) {
         printf("Listening for ICMP response\n");
     }
 
-    const int PACKET_SIZE = 65536;
-
-    // Construct raw socket and listen to all IPv4 packets
-    int icmp_sock_raw = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
-
-    if (icmp_sock_raw < 0) {
-        return -1;
-    }
+    struct transport_frame frames[TRANSPORT_BATCH];
 
-    unsigned char *buffer = malloc(PACKET_SIZE * sizeof(char));
-    memset(buffer, 0, PACKET_SIZE);
-
-    struct sockaddr saddr;
-    int saddr_len = sizeof(struct sockaddr);
-
-    // Sleep time in microseconds (currently 0.1 seconds)
-    const int SLEEP_TIME_MICS = 1000 * 1000 * 0.1;
+    // Wait time for each receive in milliseconds
+    const int RECV_TIMEOUT_MS = 100;
 
     // Timeout in seconds
     const int TIMEOUT_SECS = 7;             
@@ -177,82 +183,224 @@ int listen_for_icmp_response(const unsigned char *loc_mac,
     long int start_time = time(0);
     long int curr_time = time(0);
     while ((curr_time - start_time) <= TIMEOUT_SECS) {
-        // Clear errno
-        errno = 0;
+        // Receive a batch of frames, waiting up to RECV_TIMEOUT_MS
+        int frames_len = transport_recv_batch(t, frames, TRANSPORT_BATCH, 
+                RECV_TIMEOUT_MS);
 
         // Get current time
         curr_time = time(0);        
 
-        // Receive a network packet and copy into buffer (Non-blocking)
-        int buff_len = recvfrom(icmp_sock_raw, buffer, PACKET_SIZE, MSG_DONTWAIT,
-                &saddr, (socklen_t *)&saddr_len);
+        if (frames_len < 0) {
+            // An error occurred
+            return -1;
+        }
 
-        if (buff_len == -1) {
-            // Would block
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                usleep(SLEEP_TIME_MICS);
+        for (int i = 0; i < frames_len; i++) {
+            const unsigned char *buffer = frames[i].data;
 
+            if (frames[i].len < (int)(sizeof(struct ethhdr) + 
+                    sizeof(struct iphdr))) {
                 continue;
-            } else {
-                // An error occurred
-                close(icmp_sock_raw);
-                free(buffer);
+            }
+
+            // Extract ethernet header
+            struct ethhdr *eth = (struct ethhdr *)(buffer);
 
-                return -1;
+            if (DEBUG >= 3) {
+                printf("Packet received: ");
+                printf("src_mac: %s", get_mac_str(eth->h_source));
+                printf("dst_mac: %s\n", get_mac_str(eth->h_dest));
             }
-        }
 
-        // Extract ethernet header
-        struct ethhdr *eth = (struct ethhdr *)(buffer);
+            // Check MAC source address matches local interface
+            if (compare_mac_add(loc_mac, eth->h_dest) != 0) {
+                continue;
+            }
 
-        if (DEBUG >= 3) {
-            printf("Packet received: ");
-            printf("src_mac: %s", get_mac_str(eth->h_source));
-            printf("dst_mac: %s\n", get_mac_str(eth->h_dest));
-        }
+            // Extract IP header
+            struct iphdr *iph = (struct iphdr *)
+                    (buffer + sizeof(struct ethhdr));
 
-        // Check MAC source address matches local interface
-        if (compare_mac_add(loc_mac, eth->h_dest) != 0) {
-            continue;
-        }
+            // Filter ICMP packets (Protocol 0x01)
+            if (iph->protocol != 0x01) {
+                continue;
+            }
 
-        // Extract IP header
-        struct iphdr *iph = (struct iphdr *)(buffer + sizeof(struct ethhdr));
+            unsigned char* ip_src_pack = get_ip_32_arr(iph->saddr);
+            unsigned char* ip_dst_pack = get_ip_32_arr(iph->daddr);
 
-        // Filter ICMP packets (Protocol 0x01)
-        if (iph->protocol != 0x01) {
-            continue;
-        }
+            if (DEBUG >= 2) {
+                printf("ICMP packet: ");
+                printf("src_ip: %s ", get_ip_arr_str(ip_src_pack));
+                printf("dst_ip: %s\n", get_ip_arr_str(ip_dst_pack));
+            }
 
-        unsigned char* ip_src_pack = get_ip_32_arr(iph->saddr);
-        unsigned char* ip_dst_pack = get_ip_32_arr(iph->daddr);
+            // Check that ICMP response is from the target
+            if ((compare_ip_add(loc_ip, ip_dst_pack) != 0) || 
+                    (compare_ip_add(tar_ip, ip_src_pack) != 0)) {
+                continue;
+            }
 
-        if (DEBUG >= 2) {
-            printf("ICMP packet: ");
-            printf("src_ip: %s ", get_ip_arr_str(ip_src_pack));
-            printf("dst_ip: %s\n", get_ip_arr_str(ip_dst_pack));
-        }
+            if (DEBUG >= 2) {
+                printf("Target ICMP request received\n");
+            }
 
-        // Check that ICMP response is from the target
-        if ((compare_ip_add(loc_ip, ip_dst_pack) != 0) || 
-                (compare_ip_add(tar_ip, ip_src_pack) != 0)) {
-            continue;
+            return 1;
         }
+    }
 
-        if (DEBUG >= 2) {
-            printf("Target ICMP request received\n");
-        }
+    if (DEBUG >= 2) {
+        printf("Timeout occurred whilst waiting for ICMP response.\n");
+    }
 
-        close(icmp_sock_raw);
+    return 0;
+}
 
-        return 1;
+unsigned char * construct_icmp6_packet(const unsigned char *src_ip, 
+        const unsigned char *dst_ip, const unsigned char *src_mac, 
+        const unsigned char *dst_mac) {
+    unsigned char *sendbuff = malloc(ICMP6_PACK_LENGTH);
+    memset(sendbuff, 0, ICMP6_PACK_LENGTH);
+
+    // Construct the ethernet header
+    struct ethhdr *eth = (struct ethhdr *)(sendbuff);
+
+    memcpy(eth->h_source, src_mac, MAC_LEN);
+    memcpy(eth->h_dest, dst_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_IPV6);
+
+    // Construct the IPv6 header
+    struct ip6_hdr *ip6h = (struct ip6_hdr *)
+            (sendbuff + sizeof(struct ethhdr));
+
+    ip6h->ip6_flow = htonl(6 << 28);
+    ip6h->ip6_plen = htons(sizeof(struct icmphdr));
+    ip6h->ip6_nxt = IPPROTO_ICMPV6;
+    ip6h->ip6_hlim = 64;
+
+    memcpy(&ip6h->ip6_src, src_ip, IP6_LEN);
+    memcpy(&ip6h->ip6_dst, dst_ip, IP6_LEN);
+
+    // The echo header has the same layout as ICMPv4's
+    struct icmphdr *icmph = (struct icmphdr *)
+            ((unsigned char *)ip6h + sizeof(struct ip6_hdr));
+
+    icmph->type = ICMP6_ECHO_REQUEST_TYPE;
+    icmph->un.echo.id = htons(1000);
+    icmph->un.echo.sequence = htons(0);
+
+    // Unlike ICMPv4 the checksum covers the pseudo header
+    unsigned long sum = ip6_pseudo_sum(src_ip, dst_ip, 
+            sizeof(struct icmphdr), IPPROTO_ICMPV6);
+    icmph->checksum = checksum_fold(checksum_add(sum, icmph, 
+            sizeof(struct icmphdr)));
+
+    return sendbuff;
+}
+
+int ping_target6(const unsigned char* src_ip, const unsigned char* dst_ip, 
+        const unsigned char *src_mac, const unsigned char *dst_mac, 
+        int inter_index) {
+    if (DEBUG >= 2) {
+        printf("Pinging target IP: %s\n", get_ip6_arr_str(dst_ip));
     }
 
+    unsigned long long ping_start = get_time_ns();
+
+    // Listen before sending so a fast reply cannot be missed
+    struct transport *t = transport_open(inter_index, src_mac, ETH_P_IPV6);
+
+    if (t == NULL) {
+        return -1;
+    }
+
+    unsigned char *packet = construct_icmp6_packet(src_ip, dst_ip, src_mac, 
+            dst_mac);
+
+    int send_ret = transport_send(t, packet, ICMP6_PACK_LENGTH);
+
+    free(packet);
+
+    if (send_ret < 0) {
+        transport_close(t);
+
+        return -1;
+    }
+
+    int icmp_res_val = listen_for_icmp6_response(t, src_mac, src_ip, dst_ip);
+
+    transport_close(t);
+
+    hist_record(&get_timings()->icmp_ping, get_time_ns() - ping_start);
+
+    return icmp_res_val;
+}
+
+int listen_for_icmp6_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip) {
     if (DEBUG >= 2) {
-        printf("Timeout occurred whilst waiting for ICMP response.\n");
+        printf("Listening for ICMPv6 response\n");
     }
 
-    close(icmp_sock_raw);
+    struct transport_frame frames[TRANSPORT_BATCH];
+
+    // Wait time for each receive in milliseconds
+    const int RECV_TIMEOUT_MS = 100;
+
+    // Timeout in seconds
+    const int TIMEOUT_SECS = 7;
+
+    const int MIN_LEN = sizeof(struct ethhdr) + sizeof(struct ip6_hdr) + 
+            sizeof(struct icmphdr);
+
+    long int start_time = time(0);
+    long int curr_time = time(0);
+    while ((curr_time - start_time) <= TIMEOUT_SECS) {
+        int frames_len = transport_recv_batch(t, frames, TRANSPORT_BATCH, 
+                RECV_TIMEOUT_MS);
+
+        curr_time = time(0);
+
+        if (frames_len < 0) {
+            return -1;
+        }
+
+        for (int i = 0; i < frames_len; i++) {
+            const unsigned char *buffer = frames[i].data;
+
+            if (frames[i].len < MIN_LEN) {
+                continue;
+            }
+
+            const struct ethhdr *eth = (const struct ethhdr *)(buffer);
+            const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+                    (buffer + sizeof(struct ethhdr));
+            const struct icmphdr *icmph = (const struct icmphdr *)
+                    (buffer + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+            // Check that the echo reply is from the target to us
+            if (compare_mac_add(loc_mac, eth->h_dest) != 0 || 
+                    ip6h->ip6_nxt != IPPROTO_ICMPV6 || 
+                    icmph->type != ICMP6_ECHO_REPLY_TYPE ||
+                    compare_ip6_add((const unsigned char *)&ip6h->ip6_dst, 
+                    loc_ip) != 0 || 
+                    compare_ip6_add((const unsigned char *)&ip6h->ip6_src, 
+                    tar_ip) != 0) {
+                continue;
+            }
+
+            if (DEBUG >= 2) {
+                printf("Target ICMPv6 echo reply received\n");
+            }
+
+            return 1;
+        }
+    }
+
+    if (DEBUG >= 2) {
+        printf("Timeout occurred whilst waiting for ICMPv6 response.\n");
+    }
 
     return 0;
 }
\ No newline at end of file
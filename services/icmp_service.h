@@ -1,4 +1,11 @@
 #define ICMP_PACK_LENGTH 64     // 64 byte packet size
+#define ICMP6_PACK_LENGTH 62    // Ethernet, IPv6 and ICMPv6 echo headers
+
+// ICMPv6 echo message types
+#define ICMP6_ECHO_REQUEST_TYPE 128
+#define ICMP6_ECHO_REPLY_TYPE 129
+
+struct transport;
 
 /*
  * Function: send_icmp_request
@@ -13,15 +20,13 @@
  * 
  * dst_mac: Destination MAC address represented as an array
  * 
- * sock_raw: Raw Socket descriptor
- * 
- * inter_index: Interface index for the network device to use
+ * t: The transport to send on
  * 
  * returns: 0 on success, -1 on error.
  */
 int send_icmp_request(const char* src_ip, const char* dst_ip, 
         const unsigned char *src_mac, const unsigned char *dst_mac, 
-        int sock_raw, int inter_index);
+        struct transport *t);
 
 /*
  * Function: ping_target
@@ -37,8 +42,6 @@ int send_icmp_request(const char* src_ip, const char* dst_ip,
  * 
  * dst_mac: The destination MAC address in array representation.
  * 
- * sock_raw: The raw socket descriptor.
- * 
  * inter_index: The network interface index.
  * 
  * return: 1 indicates reply was received, 0 indicates reply timed out, -1
@@ -46,7 +49,7 @@ int send_icmp_request(const char* src_ip, const char* dst_ip,
  */
 int ping_target(const unsigned char* src_ip, const unsigned char* dst_ip, 
         const unsigned char *src_mac, const unsigned char *dst_mac, 
-        int sock_raw, int inter_index);
+        int inter_index);
 
 /*
  * Function: construct_icmp_packet
@@ -69,11 +72,13 @@ unsigned char * construct_icmp_packet(const char *src_ip, const char *dst_ip,
 /*
  * Function: listen_for_icmp_response
  * ----------------------------------
- * Constructs a raw socket and listens for a ICMP response with the relevant
- * source MAC address, source IP address and destination IP address.
+ * Listens for a ICMP response with the relevant source MAC address, source 
+ * IP address and destination IP address.
  * 
  * NOTE: Will timeout after 7 seconds.
  * 
+ * t: The transport the request was sent on.
+ * 
  * loc_mac: The local MAC address represented as an array.
  * 
  * loc_ip: The local IP address represented as an array.
@@ -82,5 +87,59 @@ unsigned char * construct_icmp_packet(const char *src_ip, const char *dst_ip,
  * 
  * return: 1 if ICMP response was received, 0 if not, or -1 if error.
  */
-int listen_for_icmp_response(const unsigned char *loc_mac, 
-        const unsigned char *loc_ip, const unsigned char *tar_ip);
\ No newline at end of file
+int listen_for_icmp_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip);
+
+/*
+ * Function: construct_icmp6_packet
+ * --------------------------------
+ * Constructs an ICMPv6 echo request.
+ * 
+ * src_ip: Source IPv6 address represented as an array
+ * 
+ * dst_ip: Destination IPv6 address represented as an array
+ * 
+ * src_mac: Source MAC address represented as an array
+ * 
+ * dst_mac: Destination MAC address represented as an array
+ * 
+ * returns: The constructed packet of ICMP6_PACK_LENGTH bytes
+ */
+unsigned char * construct_icmp6_packet(const unsigned char *src_ip, 
+        const unsigned char *dst_ip, const unsigned char *src_mac, 
+        const unsigned char *dst_mac);
+
+/*
+ * Function: ping_target6
+ * ----------------------
+ * The IPv6 counterpart of ping_target, sending an ICMPv6 echo request.
+ * NOTE: Timeout occurs after 7 seconds.
+ * 
+ * return: 1 indicates reply was received, 0 indicates reply timed out, -1
+ *         indicates an error occurred.
+ */
+int ping_target6(const unsigned char* src_ip, const unsigned char* dst_ip, 
+        const unsigned char *src_mac, const unsigned char *dst_mac, 
+        int inter_index);
+
+/*
+ * Function: listen_for_icmp6_response
+ * -----------------------------------
+ * Listens for an ICMPv6 echo reply from the target to the local address.
+ * 
+ * NOTE: Will timeout after 7 seconds.
+ * 
+ * t: The transport the request was sent on.
+ * 
+ * loc_mac: The local MAC address represented as an array.
+ * 
+ * loc_ip: The local IPv6 address represented as an array.
+ * 
+ * tar_ip: The target IPv6 address represented as an array.
+ * 
+ * return: 1 if ICMPv6 response was received, 0 if not, or -1 if error.
+ */
+int listen_for_icmp6_response(struct transport *t, 
+        const unsigned char *loc_mac, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip);
\ No newline at end of file
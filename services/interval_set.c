@@ -0,0 +1,321 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "interval_set.h"
+
+// Fewer intervals are sorted with qsort
+#define RADIX_SORT_MIN 256
+
+void interval_set_init(struct interval_set *set) {
+    memset(set, 0, sizeof(struct interval_set));
+}
+
+static int interval_set_reserve(struct interval_set *set, int cap) {
+    if (cap <= set->cap) {
+        return 0;
+    }
+
+    struct interval *intervals = realloc(set->intervals,
+            sizeof(struct interval) * cap);
+
+    if (intervals == NULL) {
+        return -1;
+    }
+
+    set->intervals = intervals;
+
+    unsigned long long *offsets = realloc(set->offsets,
+            sizeof(unsigned long long) * cap);
+
+    if (offsets == NULL) {
+        return -1;
+    }
+
+    set->offsets = offsets;
+    set->cap = cap;
+
+    return 0;
+}
+
+int interval_set_add(struct interval_set *set, unsigned int first,
+        unsigned int last) {
+    if (set->len == set->cap && interval_set_reserve(set,
+            set->cap > 0 ? set->cap * 2 : 16) < 0) {
+        return -1;
+    }
+
+    set->intervals[set->len].first = first;
+    set->intervals[set->len].last = last;
+    set->len++;
+
+    return 0;
+}
+
+static int compare_intervals(const void *a, const void *b) {
+    unsigned int a_first = ((const struct interval *)a)->first;
+    unsigned int b_first = ((const struct interval *)b)->first;
+
+    return (a_first > b_first) - (a_first < b_first);
+}
+
+/*
+ * Counts the elements before each interval of a sorted, merged set.
+ */
+static void interval_set_count(struct interval_set *set) {
+    set->size = 0;
+
+    for (int i = 0; i < set->len; i++) {
+        set->offsets[i] = set->size;
+        set->size += (unsigned long long)set->intervals[i].last -
+                set->intervals[i].first + 1;
+    }
+}
+
+/*
+ * Sorts intervals by their first value with a least significant byte first
+ * radix sort, which takes linear time for the millions of intervals of a
+ * large target list.  Bytes that are the same in every interval are
+ * skipped.  Returns -1 if the scratch buffer cannot be allocated.
+ */
+static int radix_sort_intervals(struct interval *intervals, int len) {
+    struct interval *scratch = malloc(sizeof(struct interval) * len);
+
+    if (scratch == NULL) {
+        return -1;
+    }
+
+    int counts[4][256];
+    memset(counts, 0, sizeof(counts));
+
+    // Histograms of all four bytes in one pass
+    for (int i = 0; i < len; i++) {
+        unsigned int first = intervals[i].first;
+
+        counts[0][first & 0xFF]++;
+        counts[1][(first >> 8) & 0xFF]++;
+        counts[2][(first >> 16) & 0xFF]++;
+        counts[3][first >> 24]++;
+    }
+
+    struct interval *src = intervals;
+    struct interval *dst = scratch;
+
+    for (int byte = 0; byte < 4; byte++) {
+        int shift = byte * 8;
+
+        if (counts[byte][(src[0].first >> shift) & 0xFF] == len) {
+            continue;
+        }
+
+        int offset = 0;
+
+        for (int b = 0; b < 256; b++) {
+            int count = counts[byte][b];
+            counts[byte][b] = offset;
+            offset += count;
+        }
+
+        for (int i = 0; i < len; i++) {
+            dst[counts[byte][(src[i].first >> shift) & 0xFF]++] = src[i];
+        }
+
+        struct interval *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != intervals) {
+        memcpy(intervals, src, sizeof(struct interval) * len);
+    }
+
+    free(scratch);
+
+    return 0;
+}
+
+void interval_set_normalize(struct interval_set *set) {
+    if (set->len < RADIX_SORT_MIN || 
+            radix_sort_intervals(set->intervals, set->len) < 0) {
+        qsort(set->intervals, set->len, sizeof(struct interval),
+                compare_intervals);
+    }
+
+    int merged_len = 0;
+
+    for (int i = 0; i < set->len; i++) {
+        const struct interval curr = set->intervals[i];
+
+        // Touching intervals merge too, so every set has one representation
+        if (merged_len > 0 && (unsigned long long)curr.first <=
+                (unsigned long long)set->intervals[merged_len - 1].last + 1) {
+            if (curr.last > set->intervals[merged_len - 1].last) {
+                set->intervals[merged_len - 1].last = curr.last;
+            }
+
+            continue;
+        }
+
+        set->intervals[merged_len++] = curr;
+    }
+
+    set->len = merged_len;
+
+    interval_set_count(set);
+}
+
+int interval_set_merge(struct interval_set *set,
+        const struct interval_set *other) {
+    int max_len = set->len + other->len;
+    struct interval *result = malloc(sizeof(struct interval) *
+            (max_len > 0 ? max_len : 1));
+
+    if (result == NULL || interval_set_reserve(set, max_len) < 0) {
+        free(result);
+
+        return -1;
+    }
+
+    int result_len = 0;
+    int i = 0;
+    int j = 0;
+
+    // Take the interval starting first and extend the last one it touches
+    while (i < set->len || j < other->len) {
+        struct interval curr;
+
+        if (j == other->len || (i < set->len &&
+                set->intervals[i].first <= other->intervals[j].first)) {
+            curr = set->intervals[i++];
+        } else {
+            curr = other->intervals[j++];
+        }
+
+        if (result_len > 0 && (unsigned long long)curr.first <=
+                (unsigned long long)result[result_len - 1].last + 1) {
+            if (curr.last > result[result_len - 1].last) {
+                result[result_len - 1].last = curr.last;
+            }
+
+            continue;
+        }
+
+        result[result_len++] = curr;
+    }
+
+    memcpy(set->intervals, result, sizeof(struct interval) * result_len);
+    set->len = result_len;
+    free(result);
+
+    interval_set_count(set);
+
+    return 0;
+}
+
+int interval_set_subtract(struct interval_set *set,
+        const struct interval_set *excluded) {
+    // Each excluded interval splits at most one interval in two
+    int max_len = set->len + excluded->len;
+    struct interval *result = malloc(sizeof(struct interval) *
+            (max_len > 0 ? max_len : 1));
+
+    if (result == NULL || interval_set_reserve(set, max_len) < 0) {
+        free(result);
+
+        return -1;
+    }
+
+    int result_len = 0;
+    int j = 0;
+
+    for (int i = 0; i < set->len; i++) {
+        unsigned long long first = set->intervals[i].first;
+        unsigned long long last = set->intervals[i].last;
+
+        // Skip excluded intervals entirely before this one
+        while (j < excluded->len && excluded->intervals[j].last < first) {
+            j++;
+        }
+
+        // Cut every excluded interval overlapping this one out of it
+        for (int k = j; k < excluded->len &&
+                excluded->intervals[k].first <= last; k++) {
+            if (excluded->intervals[k].first > first) {
+                result[result_len].first = (unsigned int)first;
+                result[result_len].last = excluded->intervals[k].first - 1;
+                result_len++;
+            }
+
+            first = (unsigned long long)excluded->intervals[k].last + 1;
+
+            if (first > last) {
+                break;
+            }
+        }
+
+        if (first <= last) {
+            result[result_len].first = (unsigned int)first;
+            result[result_len].last = (unsigned int)last;
+            result_len++;
+        }
+    }
+
+    memcpy(set->intervals, result, sizeof(struct interval) * result_len);
+    set->len = result_len;
+    free(result);
+
+    interval_set_count(set);
+
+    return 0;
+}
+
+unsigned int interval_set_at(const struct interval_set *set,
+        unsigned long long index) {
+    // The last interval starting at or before the index
+    int low = 0;
+    int high = set->len - 1;
+
+    while (low < high) {
+        int mid = low + (high - low + 1) / 2;
+
+        if (set->offsets[mid] <= index) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return set->intervals[low].first +
+            (unsigned int)(index - set->offsets[low]);
+}
+
+long long interval_set_index(const struct interval_set *set,
+        unsigned int value) {
+    int low = 0;
+    int high = set->len - 1;
+
+    while (low <= high) {
+        int mid = low + (high - low) / 2;
+
+        if (value < set->intervals[mid].first) {
+            high = mid - 1;
+        } else if (value > set->intervals[mid].last) {
+            low = mid + 1;
+        } else {
+            return (long long)(set->offsets[mid] + 
+                    (value - set->intervals[mid].first));
+        }
+    }
+
+    return -1;
+}
+
+int interval_set_contains(const struct interval_set *set, unsigned int value) {
+    return interval_set_index(set, value) >= 0;
+}
+
+void interval_set_free(struct interval_set *set) {
+    free(set->intervals);
+    free(set->offsets);
+
+    interval_set_init(set);
+}
@@ -0,0 +1,142 @@
+#ifndef INTERVAL_SET_H
+#define INTERVAL_SET_H
+
+/*
+ * Struct: interval
+ * ----------------
+ * The values first to last inclusive.
+ */
+struct interval {
+    unsigned int first;
+    unsigned int last;
+};
+
+/*
+ * Struct: interval_set
+ * --------------------
+ * A set of unsigned ints as sorted, disjoint, non adjacent intervals, so
+ * ranges of any size cost one interval.  Once normalized, the element at any
+ * index and membership of any value are found by binary search.
+ *
+ * intervals: The intervals.
+ *
+ * offsets: The number of elements before each interval.
+ *
+ * len: The number of intervals.
+ *
+ * cap: The capacity of intervals and offsets.
+ *
+ * size: The number of elements.
+ */
+struct interval_set {
+    struct interval *intervals;
+    unsigned long long *offsets;
+    int len;
+    int cap;
+    unsigned long long size;
+};
+
+/*
+ * Function: interval_set_init
+ * ---------------------------
+ * Initialises an empty set.
+ */
+void interval_set_init(struct interval_set *set);
+
+/*
+ * Function: interval_set_add
+ * --------------------------
+ * Adds the values first to last.  The set must be normalized before it is
+ * queried.
+ *
+ * set: The set.
+ *
+ * first: The first value.
+ *
+ * last: The last value, at least first.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int interval_set_add(struct interval_set *set, unsigned int first,
+        unsigned int last);
+
+/*
+ * Function: interval_set_normalize
+ * --------------------------------
+ * Sorts the intervals, merges those that overlap or touch and counts the
+ * elements before each one.
+ */
+void interval_set_normalize(struct interval_set *set);
+
+/*
+ * Function: interval_set_merge
+ * ----------------------------
+ * Adds every value of another set in one pass over both, which is cheaper
+ * than adding its intervals and normalizing again.
+ *
+ * set: The normalized set to add values to.
+ *
+ * other: The normalized set of values to add.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int interval_set_merge(struct interval_set *set,
+        const struct interval_set *other);
+
+/*
+ * Function: interval_set_subtract
+ * -------------------------------
+ * Removes every value of another set in one pass over both.
+ *
+ * set: The normalized set to remove values from.
+ *
+ * excluded: The normalized set of values to remove.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int interval_set_subtract(struct interval_set *set,
+        const struct interval_set *excluded);
+
+/*
+ * Function: interval_set_at
+ * -------------------------
+ * Maps an index to its element in O(log n) of the number of intervals.
+ *
+ * set: The normalized set.
+ *
+ * index: The index, less than the set's size.
+ *
+ * return: The index'th smallest element.
+ */
+unsigned int interval_set_at(const struct interval_set *set,
+        unsigned long long index);
+
+/*
+ * Function: interval_set_index
+ * ----------------------------
+ * Maps an element to its index, the inverse of interval_set_at.
+ *
+ * set: The normalized set.
+ *
+ * value: The element.
+ *
+ * return: The index of the value, or -1 if the set does not contain it.
+ */
+long long interval_set_index(const struct interval_set *set,
+        unsigned int value);
+
+/*
+ * Function: interval_set_contains
+ * -------------------------------
+ * return: 1 if the normalized set contains the value, otherwise 0.
+ */
+int interval_set_contains(const struct interval_set *set, unsigned int value);
+
+/*
+ * Function: interval_set_free
+ * ---------------------------
+ * Frees the intervals, leaving an empty set.
+ */
+void interval_set_free(struct interval_set *set);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,288 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip6.h>
+#include <net/ethernet.h>
+
+#include <time.h>
+
+#include "ndp_service.h"
+#include "transport_service.h"
+#include "checksum_service.h"
+#include "network_helper.h"
+#include "process_service.h"
+#include "histogram_service.h"
+#include "../constants/constants.h"
+
+unsigned char * make_ns_packet(const unsigned char *src_mac,
+        const unsigned char *src_ip, const unsigned char *tar_ip) {
+    if (DEBUG >= 2) {
+        printf("Constructing Neighbor Solicitation for IP: %s\n",
+                get_ip6_arr_str(tar_ip));
+    }
+
+    unsigned char *sendbuff = malloc(NDP_NS_PSIZE);
+    memset(sendbuff, 0, NDP_NS_PSIZE);
+
+    // Solicited-node multicast address ff02::1:ffXX:XXXX of the target
+    unsigned char dst_ip[IP6_LEN] = { 0xff, 0x02, 0, 0, 0, 0, 0, 0,
+            0, 0, 0, 0x01, 0xff, tar_ip[13], tar_ip[14], tar_ip[15] };
+
+    // Construct the ethernet header, to the multicast MAC 33:33:ffXX:XXXX
+    struct ethhdr *eth = (struct ethhdr *)(sendbuff);
+
+    memcpy(eth->h_source, src_mac, MAC_LEN);
+    eth->h_dest[0] = 0x33;
+    eth->h_dest[1] = 0x33;
+    memcpy(eth->h_dest + 2, dst_ip + 12, 4);
+    eth->h_proto = htons(ETH_P_IPV6);
+
+    // Construct the IPv6 header
+    struct ip6_hdr *ip6h = (struct ip6_hdr *)
+            (sendbuff + sizeof(struct ethhdr));
+
+    ip6h->ip6_flow = htonl(6 << 28);
+    ip6h->ip6_plen = htons(sizeof(struct ndp_message));
+    ip6h->ip6_nxt = IPPROTO_ICMPV6;
+    ip6h->ip6_hlim = 255;               // Required by neighbor discovery
+
+    memcpy(&ip6h->ip6_src, src_ip, IP6_LEN);
+    memcpy(&ip6h->ip6_dst, dst_ip, IP6_LEN);
+
+    // Construct the solicitation with our MAC address as an option
+    struct ndp_message *ns = (struct ndp_message *)
+            ((unsigned char *)ip6h + sizeof(struct ip6_hdr));
+
+    ns->type = NDP_NEIGHBOR_SOLICIT;
+    memcpy(ns->target, tar_ip, IP6_LEN);
+    ns->opt_type = NDP_OPT_SOURCE_LLADDR;
+    ns->opt_len = 1;                    // In units of 8 bytes
+    memcpy(ns->opt_mac, src_mac, MAC_LEN);
+
+    unsigned long sum = ip6_pseudo_sum(src_ip, dst_ip,
+            sizeof(struct ndp_message), IPPROTO_ICMPV6);
+    ns->checksum = checksum_fold(checksum_add(sum, ns,
+            sizeof(struct ndp_message)));
+
+    return sendbuff;
+}
+
+int send_neighbor_solicitation(struct transport *t,
+        const unsigned char *src_mac, const unsigned char *src_ip,
+        const unsigned char *tar_ip) {
+    unsigned char *ns_buff = make_ns_packet(src_mac, src_ip, tar_ip);
+
+    if (transport_send(t, ns_buff, NDP_NS_PSIZE) < 0)  {
+        free(ns_buff);
+
+        return -1;
+    }
+
+    free(ns_buff);
+
+    if (DEBUG >= 2) {
+        printf("Neighbor Solicitation for IP: %s successfully sent\n",
+                get_ip6_arr_str(tar_ip));
+    }
+
+    return 0;
+}
+
+char * search_neighbor_table(const char *ip_address) {
+    if (DEBUG >= 2)
+        printf("Searching neighbor table for IP address: %s\n", ip_address);
+
+    const char *COMMAND = "ip -6 neigh show ";
+
+    const int MAX_PATH = 200;
+    char *path = malloc(sizeof(char) * MAX_PATH);
+    memset(path, 0, sizeof(char) * MAX_PATH);
+
+    strncpy(path, COMMAND, 100);
+    strncat(path, ip_address, 99);
+
+    char **output = load_process(path);
+
+    free(path);
+
+    if (output == NULL) {
+        return NULL;
+    }
+
+    // Rows look like "fe80::1 dev eth0 lladdr 52:54:00:12:34:56 REACHABLE"
+    char *token;
+    for (int i = 0; output[i] != NULL; i++) {
+        token = strtok(output[i], " ");
+
+        while (token != NULL && strcmp(token, "lladdr") != 0) {
+            token = strtok(NULL, " ");
+        }
+
+        if (token != NULL && (token = strtok(NULL, " ")) != NULL) {
+            if (DEBUG >= 2) {
+                printf("MAC address found: %s\n", token);
+            }
+
+            free(output);
+
+            return token;
+        }
+    }
+
+    free(output);
+
+    return NULL;
+}
+
+unsigned char * get_mac_add_from_ip6(const unsigned char *tar_ip,
+        const unsigned char *src_mac, const unsigned char *src_ip,
+        int dev_index, const char* dev_name) {
+    if (DEBUG >= 0) {
+        printf("Attempting to obtain MAC address for IP address: %s\n",
+                get_ip6_arr_str(tar_ip));
+    }
+
+    unsigned long long ndp_start = get_time_ns();
+
+    // Listen before sending so a fast reply cannot be missed
+    struct transport *t = transport_open(dev_index, src_mac, ETH_P_IPV6);
+
+    if (t == NULL) {
+        return NULL;
+    }
+
+    if (send_neighbor_solicitation(t, src_mac, src_ip, tar_ip) < 0) {
+        transport_close(t);
+
+        return NULL;
+    }
+
+    unsigned char *mac_dest = listen_for_neighbor_advert(t, src_mac, tar_ip);
+
+    transport_close(t);
+
+    hist_record(&get_timings()->arp_resolve, get_time_ns() - ndp_start);
+
+    // The kernel may already know the neighbor
+    if (mac_dest == NULL) {
+        char *mac_str = search_neighbor_table(get_ip6_arr_str(tar_ip));
+
+        if (mac_str != NULL) {
+            mac_dest = get_mac_from_str(mac_str);
+        }
+    }
+
+    if (mac_dest != NULL) {
+        if (DEBUG >= 0) {
+            printf("Successfully obtained MAC address!\n");
+        }
+
+        return mac_dest;
+    }
+
+    if (DEBUG >= 0) {
+        printf("Cannot get neighbor entry for IP address: %s\n",
+                get_ip6_arr_str(tar_ip));
+        printf("Obtaining default gateway MAC address...\n");
+    }
+
+    struct in6_addr *gw_ip_add = get_gw_ip6_address(dev_name);
+
+    // Do not recurse when the gateway itself did not answer
+    if (gw_ip_add == NULL ||
+            compare_ip6_add((const unsigned char *)gw_ip_add, tar_ip) == 0) {
+        free(gw_ip_add);
+
+        return NULL;
+    }
+
+    mac_dest = get_mac_add_from_ip6((const unsigned char *)gw_ip_add,
+            src_mac, src_ip, dev_index, dev_name);
+
+    free(gw_ip_add);
+
+    return mac_dest;
+}
+
+unsigned char * listen_for_neighbor_advert(struct transport *t,
+        const unsigned char *loc_mac, const unsigned char *tar_ip) {
+    if (DEBUG >= 2) {
+        printf("Listening for Neighbor Advertisement\n");
+    }
+
+    struct transport_frame frames[TRANSPORT_BATCH];
+
+    // Wait time for each receive in milliseconds
+    const int RECV_TIMEOUT_MS = 100;
+
+    // Timeout in seconds
+    const int TIMEOUT_SECS = 7;
+
+    // An advertisement without the target link-layer address option
+    const int MIN_LEN = sizeof(struct ethhdr) + sizeof(struct ip6_hdr) +
+            offsetof(struct ndp_message, opt_type);
+
+    long int start_time = time(0);
+    long int curr_time = time(0);
+    while ((curr_time - start_time) <= TIMEOUT_SECS) {
+        int frames_len = transport_recv_batch(t, frames, TRANSPORT_BATCH,
+                RECV_TIMEOUT_MS);
+
+        curr_time = time(0);
+
+        if (frames_len < 0) {
+            return NULL;
+        }
+
+        for (int i = 0; i < frames_len; i++) {
+            const unsigned char *buffer = frames[i].data;
+
+            if (frames[i].len < MIN_LEN) {
+                continue;
+            }
+
+            const struct ethhdr *eth = (const struct ethhdr *)(buffer);
+            const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+                    (buffer + sizeof(struct ethhdr));
+            const struct ndp_message *na = (const struct ndp_message *)
+                    (buffer + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+            // Advertisements are only accepted from on-link neighbors
+            if (compare_mac_add(loc_mac, eth->h_dest) != 0 ||
+                    ip6h->ip6_nxt != IPPROTO_ICMPV6 ||
+                    ip6h->ip6_hlim != 255 ||
+                    na->type != NDP_NEIGHBOR_ADVERT ||
+                    compare_ip6_add(na->target, tar_ip) != 0) {
+                continue;
+            }
+
+            unsigned char *mac_tar = malloc(sizeof(char) * MAC_LEN);
+
+            // Prefer the target link-layer address option to the sender
+            if (frames[i].len >= MIN_LEN + 8 &&
+                    na->opt_type == NDP_OPT_TARGET_LLADDR) {
+                memcpy(mac_tar, na->opt_mac, MAC_LEN);
+            } else {
+                memcpy(mac_tar, eth->h_source, MAC_LEN);
+            }
+
+            if (DEBUG >= 2) {
+                printf("Target MAC address: %s\n", get_mac_str(mac_tar));
+            }
+
+            return mac_tar;
+        }
+    }
+
+    if (DEBUG >= 2) {
+        printf("Timeout occurred whilst waiting for Neighbor "
+                "Advertisement.\n");
+    }
+
+    return NULL;
+}
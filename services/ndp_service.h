@@ -0,0 +1,126 @@
+#ifndef NDP_SERVICE_H
+#define NDP_SERVICE_H
+
+#include "../constants/constants.h"
+
+struct transport;
+
+// Neighbor Solicitation packet size (ethernet, IPv6, ICMPv6 NS and the
+// source link-layer address option)
+#define NDP_NS_PSIZE 86
+
+// ICMPv6 message types of neighbor discovery
+#define NDP_NEIGHBOR_SOLICIT 135
+#define NDP_NEIGHBOR_ADVERT 136
+
+// Neighbor discovery option types
+#define NDP_OPT_SOURCE_LLADDR 1
+#define NDP_OPT_TARGET_LLADDR 2
+
+/*
+ * Struct: ndp_message
+ * -------------------
+ * A Neighbor Solicitation or Advertisement (RFC 4861) with one link-layer
+ * address option.
+ */
+struct ndp_message {
+    unsigned char type;
+    unsigned char code;
+    unsigned short checksum;
+    unsigned int flags;
+    unsigned char target[IP6_LEN];
+    unsigned char opt_type;
+    unsigned char opt_len;
+    unsigned char opt_mac[MAC_LEN];
+};
+
+/*
+ * Function: make_ns_packet
+ * ------------------------
+ * Constructs a Neighbor Solicitation sent to the solicited-node multicast
+ * address of the target.
+ *
+ * src_mac: Source MAC address represented in array format.
+ *
+ * src_ip: A source IPv6 address represented in array format.
+ *
+ * tar_ip: A target IPv6 address represented in array format.
+ *
+ * return: A packet of NDP_NS_PSIZE bytes.
+ */
+unsigned char * make_ns_packet(const unsigned char *src_mac,
+        const unsigned char *src_ip, const unsigned char *tar_ip);
+
+/*
+ * Function: send_neighbor_solicitation
+ * ------------------------------------
+ * Multicasts a Neighbor Solicitation for the target to the local network.
+ *
+ * t: The transport to send on.
+ *
+ * src_mac: A source MAC address represented in array format.
+ *
+ * src_ip: A source IPv6 address represented in array format.
+ *
+ * tar_ip: A target IPv6 address represented in array format.
+ *
+ * return: Returns 0 on success, -1 on error.
+ */
+int send_neighbor_solicitation(struct transport *t,
+        const unsigned char *src_mac, const unsigned char *src_ip,
+        const unsigned char *tar_ip);
+
+/*
+ * Function: search_neighbor_table
+ * -------------------------------
+ * Queries the kernel's IPv6 neighbor table for the MAC address of the IP.
+ *
+ * ip_address: A string representation of an IPv6 address.
+ *
+ * return: A string representation of the MAC address, or NULL if not found.
+ */
+char * search_neighbor_table(const char *ip_address);
+
+/*
+ * Function: get_mac_add_from_ip6
+ * ------------------------------
+ * The IPv6 counterpart of get_mac_add_from_ip, resolving the MAC address
+ * with neighbor discovery.  If the target does not answer and has no neighbor
+ * table entry, the MAC address of the IPv6 default gateway is returned.
+ *
+ * tar_ip: An array representation of an IPv6 address to search for.
+ *
+ * src_mac: Source MAC address in array format.
+ *
+ * src_ip: Source IPv6 address in array format.
+ *
+ * dev_index: An integer representing the local network interface id.
+ *
+ * dev_name: Local network interface name.
+ *
+ * return: Returns the MAC address found in array format, or NULL if not found
+ *         or error.
+ */
+unsigned char * get_mac_add_from_ip6(const unsigned char *tar_ip,
+        const unsigned char *src_mac, const unsigned char *src_ip,
+        int dev_index, const char* dev_name);
+
+/*
+ * Function: listen_for_neighbor_advert
+ * ------------------------------------
+ * Listens for a Neighbor Advertisement for the target IPv6 address.
+ * NOTE: Function will timeout after 7 seconds.
+ *
+ * t: The transport the solicitation was sent on.
+ *
+ * loc_mac: The local MAC address in array format.
+ *
+ * tar_ip: The target IPv6 address in array format.
+ *
+ * return: Returns the target MAC address on success or NULL on failure or
+ *         error.
+ */
+unsigned char * listen_for_neighbor_advert(struct transport *t,
+        const unsigned char *loc_mac, const unsigned char *tar_ip);
+
+#endif
\ No newline at end of file
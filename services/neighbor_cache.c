@@ -0,0 +1,374 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "neighbor_cache.h"
+#include "arp_service.h"
+#include "transport_service.h"
+
+/*
+ * Struct: neighbor_check
+ * ----------------------
+ * The arguments and result of a background check, owned by the cache.
+ * answered and reply_mac are written by the check's thread and only read
+ * once it was joined.
+ */
+struct neighbor_check {
+    struct neighbor_cache *cache;
+    unsigned int ip;
+    int if_index;
+    unsigned char loc_mac[MAC_LEN];
+    unsigned int loc_ip;
+    unsigned char mac[MAC_LEN];
+    unsigned char answered;
+    unsigned char reply_mac[MAC_LEN];
+    unsigned char joined;
+};
+
+// The first slot an address may be stored in
+static unsigned int neighbor_slot(unsigned int ip) {
+    return (ip * 0x9e3779b1U) >> 18 & (NEIGHBOR_CACHE_SLOTS - 1);
+}
+
+// Returns the entry of an address, or NULL if it has none.  Only used by
+// writers, which hold the file lock.
+static struct neighbor_entry * find_entry(struct neighbor_cache *cache,
+        unsigned int ip, int if_index) {
+    unsigned int slot = neighbor_slot(ip);
+
+    // Emptied slots do not end the probe, so entries are never moved
+    for (int i = 0; i < NEIGHBOR_CACHE_PROBES; i++) {
+        struct neighbor_entry *entry = &cache->entries[
+                (slot + i) & (NEIGHBOR_CACHE_SLOTS - 1)];
+
+        if (entry->updated != 0 && entry->ip == ip &&
+                entry->if_index == if_index) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Copies an entry another run may be rewriting.  Returns 0 once a copy was
+ * taken that no write overlapped, or -1 if the entry kept changing.
+ */
+static int read_entry(const struct neighbor_entry *entry,
+        struct neighbor_entry *copy) {
+    for (int i = 0; i < NEIGHBOR_READ_RETRIES; i++) {
+        uint16_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+
+        if (seq & 1) {
+            continue;
+        }
+
+        copy->ip = __atomic_load_n(&entry->ip, __ATOMIC_RELAXED);
+        copy->if_index = __atomic_load_n(&entry->if_index, __ATOMIC_RELAXED);
+        copy->updated = __atomic_load_n(&entry->updated, __ATOMIC_RELAXED);
+        memcpy(copy->mac, entry->mac, MAC_LEN);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == seq) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+// Locks the entries against the scan's other threads and other runs
+static void begin_write(struct neighbor_cache *cache) {
+    pthread_mutex_lock(&cache->lock);
+    flock(cache->fd, LOCK_EX);
+}
+
+static void end_write(struct neighbor_cache *cache) {
+    flock(cache->fd, LOCK_UN);
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Rewrites an entry, readers retry a copy taken meanwhile
+static void write_entry(struct neighbor_entry *entry, unsigned int ip,
+        int if_index, const unsigned char *mac, uint64_t updated) {
+    uint16_t seq = entry->seq;
+
+    __atomic_store_n(&entry->seq, (uint16_t)(seq + 1), __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&entry->ip, ip, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->if_index, if_index, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->updated, updated, __ATOMIC_RELAXED);
+    memmove(entry->mac, mac, MAC_LEN);
+
+    __atomic_store_n(&entry->seq, (uint16_t)(seq + 2), __ATOMIC_RELEASE);
+}
+
+struct neighbor_cache * neighbor_cache_open(const char *path) {
+    const size_t map_len = sizeof(struct neighbor_cache_header) +
+            sizeof(struct neighbor_entry) * NEIGHBOR_CACHE_SLOTS;
+
+    int fd = open(path, O_RDWR | O_CREAT, 0600);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot open neighbor cache: %s\n", path);
+
+        return NULL;
+    }
+
+    // Sizing and starting the file over are done under the lock, so a run
+    // opening the file meanwhile never shrinks the mapping of another
+    flock(fd, LOCK_EX);
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || (st.st_size < (off_t)map_len &&
+            ftruncate(fd, map_len) < 0)) {
+        fprintf(stderr, "ERROR: Cannot size neighbor cache: %s\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    void *map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+            0);
+
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Cannot map neighbor cache: %s\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    struct neighbor_cache_header *header = map;
+
+    // A new file, or one of another version, is started over
+    if (header->magic != NEIGHBOR_CACHE_MAGIC ||
+            header->version != NEIGHBOR_CACHE_VERSION ||
+            header->slots != NEIGHBOR_CACHE_SLOTS) {
+        memset(map, 0, map_len);
+
+        header->magic = NEIGHBOR_CACHE_MAGIC;
+        header->version = NEIGHBOR_CACHE_VERSION;
+        header->slots = NEIGHBOR_CACHE_SLOTS;
+    }
+
+    flock(fd, LOCK_UN);
+
+    struct neighbor_cache *cache = malloc(sizeof(struct neighbor_cache));
+
+    if (cache == NULL) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+        munmap(map, map_len);
+        close(fd);
+
+        return NULL;
+    }
+
+    memset(cache, 0, sizeof(struct neighbor_cache));
+    cache->map = map;
+    cache->map_len = map_len;
+    cache->fd = fd;
+    cache->entries = (struct neighbor_entry *)((unsigned char *)map +
+            sizeof(struct neighbor_cache_header));
+    pthread_mutex_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+int neighbor_cache_lookup(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, unsigned char *mac) {
+    const unsigned int slot = neighbor_slot(ip);
+    const uint64_t now = (uint64_t)time(0);
+
+    // Entries are copied without a lock, other runs may be writing them
+    for (int i = 0; i < NEIGHBOR_CACHE_PROBES; i++) {
+        struct neighbor_entry entry;
+
+        if (read_entry(&cache->entries[(slot + i) &
+                (NEIGHBOR_CACHE_SLOTS - 1)], &entry) < 0 ||
+                entry.updated == 0 || entry.ip != ip ||
+                entry.if_index != if_index) {
+            continue;
+        }
+
+        if (now - entry.updated > NEIGHBOR_CACHE_TTL_S) {
+            return -1;
+        }
+
+        memcpy(mac, entry.mac, MAC_LEN);
+
+        return 0;
+    }
+
+    return -1;
+}
+
+void neighbor_cache_store(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, const unsigned char *mac) {
+    begin_write(cache);
+
+    struct neighbor_entry *entry = find_entry(cache, ip, if_index);
+
+    // Else the first empty slot, or the oldest entry
+    if (entry == NULL) {
+        unsigned int slot = neighbor_slot(ip);
+
+        for (int i = 0; i < NEIGHBOR_CACHE_PROBES; i++) {
+            struct neighbor_entry *candidate = &cache->entries[
+                    (slot + i) & (NEIGHBOR_CACHE_SLOTS - 1)];
+
+            if (entry == NULL || candidate->updated < entry->updated) {
+                entry = candidate;
+            }
+        }
+    }
+
+    write_entry(entry, ip, if_index, mac, (uint64_t)time(0));
+
+    end_write(cache);
+}
+
+void neighbor_cache_forget(struct neighbor_cache *cache, unsigned int ip,
+        int if_index) {
+    begin_write(cache);
+
+    struct neighbor_entry *entry = find_entry(cache, ip, if_index);
+
+    if (entry != NULL) {
+        write_entry(entry, entry->ip, entry->if_index, entry->mac, 0);
+    }
+
+    end_write(cache);
+}
+
+/*
+ * Sends one ARP request for a cached address and updates its entry with the
+ * reply, or empties it if there is none.
+ */
+static void * run_neighbor_check(void *arg) {
+    struct neighbor_check *check = (struct neighbor_check *)arg;
+    unsigned char *mac = NULL;
+
+    // Listen before sending so a fast reply cannot be missed
+    struct transport *t = transport_open(check->if_index, check->loc_mac,
+            ETH_P_ARP);
+
+    if (t != NULL) {
+        if (send_arp_request(t, check->loc_mac,
+                (const unsigned char *)&check->loc_ip,
+                (const unsigned char *)&check->ip) == 0) {
+            mac = listen_for_arp_response(t, check->loc_mac,
+                    (const unsigned char *)&check->loc_ip,
+                    (const unsigned char *)&check->ip, NEIGHBOR_CHECK_MS);
+        }
+
+        transport_close(t);
+    }
+
+    char ip_str[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &check->ip, ip_str, sizeof(ip_str));
+
+    if (mac == NULL) {
+        neighbor_cache_forget(check->cache, check->ip, check->if_index);
+
+        if (DEBUG >= 1) {
+            printf("Cached neighbor %s did not answer ARP, entry dropped\n",
+                    ip_str);
+        }
+    } else {
+        neighbor_cache_store(check->cache, check->ip, check->if_index, mac);
+
+        memcpy(check->reply_mac, mac, MAC_LEN);
+        check->answered = 1;
+
+        if (memcmp(mac, check->mac, MAC_LEN) != 0) {
+            printf("WARNING: Cached MAC address of %s was stale, it is now "
+                    "%02x:%02x:%02x:%02x:%02x:%02x\n", ip_str, mac[0],
+                    mac[1], mac[2], mac[3], mac[4], mac[5]);
+        }
+    }
+
+    free(mac);
+
+    return NULL;
+}
+
+int neighbor_cache_check(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, const unsigned char *loc_mac, unsigned int loc_ip) {
+    struct neighbor_check *check = malloc(sizeof(struct neighbor_check));
+
+    if (cache->checks_len == NEIGHBOR_MAX_CHECKS || check == NULL ||
+            neighbor_cache_lookup(cache, ip, if_index, check->mac) < 0) {
+        free(check);
+
+        return -1;
+    }
+
+    memset(check->reply_mac, 0, MAC_LEN);
+    check->answered = 0;
+    check->joined = 0;
+    check->cache = cache;
+    check->ip = ip;
+    check->if_index = if_index;
+    memcpy(check->loc_mac, loc_mac, MAC_LEN);
+    check->loc_ip = loc_ip;
+
+    if (pthread_create(&cache->checks[cache->checks_len], NULL,
+            run_neighbor_check, (void *)check) != 0) {
+        free(check);
+
+        return -1;
+    }
+
+    cache->check_args[cache->checks_len] = check;
+
+    return cache->checks_len++;
+}
+
+int neighbor_cache_wait(struct neighbor_cache *cache, int check,
+        unsigned char *mac) {
+    struct neighbor_check *args = cache->check_args[check];
+
+    if (!args->joined) {
+        pthread_join(cache->checks[check], NULL);
+        args->joined = 1;
+    }
+
+    if (!args->answered || memcmp(args->reply_mac, mac, MAC_LEN) == 0) {
+        return 0;
+    }
+
+    memcpy(mac, args->reply_mac, MAC_LEN);
+
+    return 1;
+}
+
+void neighbor_cache_close(struct neighbor_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < cache->checks_len; i++) {
+        if (!cache->check_args[i]->joined) {
+            pthread_join(cache->checks[i], NULL);
+        }
+
+        free(cache->check_args[i]);
+    }
+
+    munmap(cache->map, cache->map_len);
+    close(cache->fd);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
@@ -0,0 +1,216 @@
+#ifndef NEIGHBOR_CACHE_H
+#define NEIGHBOR_CACHE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../constants/constants.h"
+
+#define NEIGHBOR_CACHE_MAGIC 0x434e504d   // "MPNC"
+#define NEIGHBOR_CACHE_VERSION 1
+
+// Slots of the table, a power of two, and how many slots an address may be
+// stored in from its hash onwards
+#define NEIGHBOR_CACHE_SLOTS 16384
+#define NEIGHBOR_CACHE_PROBES 8
+
+// Age in seconds after which an entry is no longer used
+#define NEIGHBOR_CACHE_TTL_S 3600
+
+// Time an entry's background check waits for the ARP reply in milliseconds
+#define NEIGHBOR_CHECK_MS 500
+
+// Most background checks per run, further entries are used unchecked
+#define NEIGHBOR_MAX_CHECKS 16
+
+// Times a lookup retries an entry another run is rewriting before skipping it
+#define NEIGHBOR_READ_RETRIES 1000
+
+struct neighbor_check;
+
+/*
+ * Neighbor cache file layout
+ * --------------------------
+ * neighbor_cache_header
+ * neighbor_entry * slots, an open addressed hash table of IPv4 addresses
+ *
+ * The file is mapped shared, so entries are written by runs as they learn
+ * them.  Runs write entries under an exclusive flock of the file, and an
+ * entry's sequence number is odd while it is rewritten, so lookups copy the
+ * entry without a lock and retry if the sequence number changed.  Entries
+ * with no timestamp are empty.
+ */
+struct neighbor_cache_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t slots;
+    uint32_t reserved_2;
+};
+
+/*
+ * Struct: neighbor_entry
+ * ----------------------
+ * ip: The neighbor's IPv4 address (network byte order).
+ *
+ * if_index: The interface the neighbor is reached through.
+ *
+ * mac: The neighbor's MAC address.
+ *
+ * seq: Incremented before and after each rewrite of the entry.
+ *
+ * updated: When the address was last confirmed, in seconds since the epoch,
+ *          or 0 if the slot is empty.
+ */
+struct neighbor_entry {
+    uint32_t ip;
+    int32_t if_index;
+    unsigned char mac[MAC_LEN];
+    uint16_t seq;
+    uint64_t updated;
+};
+
+/*
+ * Struct: neighbor_cache
+ * ----------------------
+ * An open neighbor cache file.
+ *
+ * map: The mapped file.
+ *
+ * map_len: The length of the mapping.
+ *
+ * entries: The hash table, inside the mapping.
+ *
+ * fd: The cache file, locked while entries are written.
+ *
+ * lock: Serializes the entries between the scan and the checks.
+ *
+ * checks: The threads checking cached entries in the background.
+ *
+ * check_args: The address and result of each check.
+ *
+ * checks_len: The number of checks started.
+ */
+struct neighbor_cache {
+    void *map;
+    size_t map_len;
+    struct neighbor_entry *entries;
+    int fd;
+    pthread_mutex_t lock;
+    pthread_t checks[NEIGHBOR_MAX_CHECKS];
+    struct neighbor_check *check_args[NEIGHBOR_MAX_CHECKS];
+    int checks_len;
+};
+
+/*
+ * Function: neighbor_cache_open
+ * -----------------------------
+ * Opens a neighbor cache file, creating it if it does not exist and starting
+ * over if it is not a cache of this version.
+ *
+ * path: The cache file.
+ *
+ * return: The cache, or NULL on error.
+ */
+struct neighbor_cache * neighbor_cache_open(const char *path);
+
+/*
+ * Function: neighbor_cache_lookup
+ * -------------------------------
+ * cache: The cache.
+ *
+ * ip: The IPv4 address (network byte order).
+ *
+ * if_index: The interface the address is reached through.
+ *
+ * mac: Populated with the MAC address on a hit.
+ *
+ * return: 0 if the address has an entry younger than NEIGHBOR_CACHE_TTL_S,
+ *         otherwise -1.
+ */
+int neighbor_cache_lookup(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, unsigned char *mac);
+
+/*
+ * Function: neighbor_cache_store
+ * ------------------------------
+ * Records a MAC address as confirmed now, in its entry or an empty slot, or
+ * else over the oldest entry it could be stored in.
+ *
+ * cache: The cache.
+ *
+ * ip: The IPv4 address (network byte order).
+ *
+ * if_index: The interface the address is reached through.
+ *
+ * mac: The MAC address.
+ */
+void neighbor_cache_store(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, const unsigned char *mac);
+
+/*
+ * Function: neighbor_cache_forget
+ * -------------------------------
+ * Empties the entry of an address, if it has one, so the next run resolves
+ * it again.
+ *
+ * cache: The cache.
+ *
+ * ip: The IPv4 address (network byte order).
+ *
+ * if_index: The interface the address is reached through.
+ */
+void neighbor_cache_forget(struct neighbor_cache *cache, unsigned int ip,
+        int if_index);
+
+/*
+ * Function: neighbor_cache_check
+ * ------------------------------
+ * Checks an entry that was just used with one ARP request, on a thread of
+ * its own so the scan does not wait for it.  A reply refreshes the entry or
+ * corrects it, and silence empties it.  At most NEIGHBOR_MAX_CHECKS are
+ * started per run.
+ *
+ * cache: The cache.
+ *
+ * ip: The IPv4 address (network byte order).
+ *
+ * if_index: The interface the address is reached through.
+ *
+ * loc_mac: The MAC address of the interface.
+ *
+ * loc_ip: The IP address of the interface (network byte order).
+ *
+ * return: The check, to wait for with neighbor_cache_wait, or -1 if no check
+ *         was started.
+ */
+int neighbor_cache_check(struct neighbor_cache *cache, unsigned int ip,
+        int if_index, const unsigned char *loc_mac, unsigned int loc_ip);
+
+/*
+ * Function: neighbor_cache_wait
+ * -----------------------------
+ * Waits for a background check, so results gathered at a cached address are
+ * only trusted once it is confirmed.
+ *
+ * cache: The cache.
+ *
+ * check: A check returned by neighbor_cache_check.
+ *
+ * mac: The MAC address that was used, replaced with the one the neighbor
+ *      answered with if they differ.
+ *
+ * return: 1 if the neighbor answered at another MAC address, otherwise 0.
+ */
+int neighbor_cache_wait(struct neighbor_cache *cache, int check,
+        unsigned char *mac);
+
+/*
+ * Function: neighbor_cache_close
+ * ------------------------------
+ * Waits for the background checks and unmaps the cache.  Entries were
+ * already written to the file as they were stored.
+ */
+void neighbor_cache_close(struct neighbor_cache *cache);
+
+#endif
\ No newline at end of file
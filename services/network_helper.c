@@ -7,6 +7,7 @@
 #include <net/if.h>
 #include <sys/ioctl.h>
 #include <arpa/inet.h>
+#include <ifaddrs.h>
 
 #include "network_helper.h"
 #include "process_service.h"
@@ -60,14 +61,57 @@ char * get_ip_arr_str(const unsigned char *ip_add) {
     return ip_str;
 }
 
+int parse_ip_str(const char *ip_str, int len, unsigned int *ip) {
+    if (len < 7 || len > 15) {
+        return -1;
+    }
+
+    unsigned int addr = 0;
+    unsigned int octet = 0;
+    int digits = 0;
+    int dots = 0;
+    int bad = 0;
+
+    // Errors are accumulated so the loop only branches on digit or dot
+    for (int i = 0; i < len; i++) {
+        unsigned int digit = (unsigned char)ip_str[i] - '0';
+
+        if (digit <= 9) {
+            bad |= (digits > 0) & (octet == 0);
+            octet = octet * 10 + digit;
+            digits++;
+        } else if (ip_str[i] == '.') {
+            bad |= (digits == 0) | (digits > 3) | (octet > 255);
+            addr = (addr << 8) | (octet & 0xFF);
+            octet = 0;
+            digits = 0;
+            dots++;
+        } else {
+            return -1;
+        }
+    }
+
+    bad |= (digits == 0) | (digits > 3) | (octet > 255) | (dots != 3);
+
+    if (bad) {
+        return -1;
+    }
+
+    *ip = (addr << 8) | octet;
+
+    return 0;
+}
+
 struct in_addr * get_ip_from_str(const char *ip_str){
-    struct in_addr *ip_add = malloc(sizeof(struct in_addr));
-    memset(ip_add, 0, sizeof(struct in_addr));
+    unsigned int ip;
 
-    if (inet_pton(AF_INET, ip_str, ip_add) < 1) {
+    if (ip_str == NULL || parse_ip_str(ip_str, (int)strlen(ip_str), &ip) < 0) {
         return NULL;
     }
 
+    struct in_addr *ip_add = malloc(sizeof(struct in_addr));
+    ip_add->s_addr = htonl(ip);
+
     return ip_add;
 }
 
@@ -188,7 +232,9 @@ struct in_addr * get_gw_ip_address(const char *dev_name) {
         token = strtok(output[i], " ");
 
         for (int j = 0; token != NULL; j++) {
-            if(strcmp("0.0.0.0", token) == 0) {
+            // The default route's destination, not an on-link route's 
+            // 0.0.0.0 gateway
+            if(j == 0 && strcmp("0.0.0.0", token) == 0) {
                 if (DEBUG >= 2) {
                     printf("Default gateway row identified\n");
                 }
@@ -266,4 +312,132 @@ int compare_mac_add(const unsigned char *mac_add_a,
     }
 
     return equal;
+}
+
+char * get_ip6_arr_str(const unsigned char *ip_add) {
+    const int STR_SIZE = INET6_ADDRSTRLEN * sizeof(char);
+    char *ip_str = malloc(STR_SIZE);
+    memset(ip_str, 0, STR_SIZE);
+
+    if (inet_ntop(AF_INET6, ip_add, ip_str, INET6_ADDRSTRLEN) == NULL) {
+        free(ip_str);
+
+        return NULL;
+    }
+
+    return ip_str;
+}
+
+char * get_family_ip_str(int family, const unsigned char *ip_add) {
+    if (family == AF_INET6) {
+        return get_ip6_arr_str(ip_add);
+    }
+
+    return get_ip_arr_str(ip_add);
+}
+
+struct in6_addr * get_ip6_from_str(const char *ip_str) {
+    struct in6_addr *ip_add = malloc(sizeof(struct in6_addr));
+    memset(ip_add, 0, sizeof(struct in6_addr));
+
+    if (inet_pton(AF_INET6, ip_str, ip_add) < 1) {
+        free(ip_add);
+
+        return NULL;
+    }
+
+    return ip_add;
+}
+
+struct in6_addr * get_ip6_address(const char *dev_name, 
+        const struct in6_addr *tar_ip) {
+    struct ifaddrs *addrs;
+
+    if (getifaddrs(&addrs) < 0) {
+        return NULL;
+    }
+
+    const int want_link_local = IN6_IS_ADDR_LINKLOCAL(tar_ip);
+    struct in6_addr *ip_add = NULL;
+
+    for (struct ifaddrs *a = addrs; a != NULL && ip_add == NULL; 
+            a = a->ifa_next) {
+        if (a->ifa_addr == NULL || a->ifa_addr->sa_family != AF_INET6 ||
+                strcmp(a->ifa_name, dev_name) != 0) {
+            continue;
+        }
+
+        const struct in6_addr *addr = 
+                &((const struct sockaddr_in6 *)a->ifa_addr)->sin6_addr;
+
+        if (IN6_IS_ADDR_LINKLOCAL(addr) != want_link_local || 
+                IN6_IS_ADDR_LOOPBACK(addr)) {
+            continue;
+        }
+
+        ip_add = malloc(sizeof(struct in6_addr));
+        memcpy(ip_add, addr, sizeof(struct in6_addr));
+    }
+
+    freeifaddrs(addrs);
+
+    if (ip_add != NULL && DEBUG >= 2) {
+        printf("Local IPv6 address: %s\n", 
+                get_ip6_arr_str((const unsigned char *)ip_add));
+    }
+
+    return ip_add;
+}
+
+struct in6_addr * get_gw_ip6_address(const char *dev_name) {
+    if (DEBUG >= 2) {
+        printf("Trying to find IPv6 address of default gateway\n");
+    }
+
+    const char* path = "ip -6 route show default dev ";
+
+    const int MAX_PATH_BUFF = 200;
+    char* path_buff = malloc(sizeof(char) * MAX_PATH_BUFF);
+    memset(path_buff, 0, MAX_PATH_BUFF * sizeof(char));
+
+    strncpy(path_buff, path, 100);
+    strncat(path_buff, dev_name, 99);
+
+    char **output = load_process(path_buff);
+
+    free(path_buff);
+
+    if (output == NULL) {
+        return NULL;
+    }
+
+    struct in6_addr *ip_add = NULL;
+    char *token;
+
+    // Rows look like "default via fe80::1 metric 1024 pref medium"
+    for (int i = 0; output[i] != NULL && ip_add == NULL; i++) {
+        token = strtok(output[i], " ");
+
+        while (token != NULL && strcmp("via", token) != 0) {
+            token = strtok(NULL, " ");
+        }
+
+        if (token != NULL && (token = strtok(NULL, " ")) != NULL) {
+            ip_add = get_ip6_from_str(token);
+        }
+    }
+
+    free(output);
+
+    if (ip_add != NULL && DEBUG >= 2) {
+        printf("Default gateway IPv6 address found: %s\n", 
+                get_ip6_arr_str((const unsigned char *)ip_add));
+    }
+
+    return ip_add;
+}
+
+int compare_ip6_add(const unsigned char *ip_add_a, 
+        const unsigned char *ip_add_b) {
+    return memcmp(ip_add_a, ip_add_b, IP6_LEN) == 0 ? 0 : -1;
 }
\ No newline at end of file
@@ -31,6 +31,22 @@ char * get_ip_str(const struct in_addr *ip_add);
  */
 char * get_ip_arr_str(const unsigned char *ip_add);
 
+/*
+ * Function: parse_ip_str
+ * ----------------------
+ * Parses a dotted decimal IPv4 address in one pass without copying it.
+ * Leading zeros are rejected like inet_pton does.
+ * 
+ * ip_str: The address, not necessarily NUL terminated.
+ * 
+ * len: The length of the address.
+ * 
+ * ip: Populated with the address (host byte order).
+ * 
+ * return: 0 on success, -1 if the address is invalid.
+ */
+int parse_ip_str(const char *ip_str, int len, unsigned int *ip);
+
 /*
  * Function: get_ip_from_str
  * -------------------------
@@ -185,4 +201,82 @@ int compare_ip_add(const unsigned char *ip_add_a,
  * return: 0 if the two addresses are equal, or -1 if not equal.
  */
 int compare_mac_add(const unsigned char *mac_add_a,
-        const unsigned char *mac_add_b);
\ No newline at end of file
+        const unsigned char *mac_add_b);
+
+/*
+ * Function: get_ip6_arr_str
+ * -------------------------
+ * Converts an IPv6 address represented as an array into a string.
+ * 
+ * ip_add: IPv6 address represented in array format.
+ * 
+ * return: Returns a string representation of the IPv6 address or NULL on 
+ *         error.
+ */
+char * get_ip6_arr_str(const unsigned char *ip_add);
+
+/*
+ * Function: get_family_ip_str
+ * ---------------------------
+ * Converts an IPv4 or IPv6 address represented as an array into a string.
+ * 
+ * family: AF_INET or AF_INET6.
+ * 
+ * ip_add: IP address represented in array format.
+ * 
+ * return: Returns a string representation of the IP address or NULL on error.
+ */
+char * get_family_ip_str(int family, const unsigned char *ip_add);
+
+/*
+ * Function: get_ip6_from_str
+ * --------------------------
+ * Converts an IPv6 address string to an in6_addr struct.
+ * 
+ * ip_str: An IPv6 address represented as a string.
+ * 
+ * return: Returns the converted IPv6 address or NULL on error.
+ */
+struct in6_addr * get_ip6_from_str(const char *ip_str);
+
+/*
+ * Function: get_ip6_address
+ * -------------------------
+ * Gets an IPv6 address of the supplied interface to send to a target from.
+ * Link-local targets get the interface's link-local address, others its 
+ * first global address.
+ * 
+ * dev_name: The network interface name.
+ * 
+ * tar_ip: The target IPv6 address.
+ * 
+ * return: Returns an IPv6 address, or NULL if the interface has no suitable
+ *         address.
+ */
+struct in6_addr * get_ip6_address(const char *dev_name, 
+        const struct in6_addr *tar_ip);
+
+/*
+ * Function: get_gw_ip6_address
+ * ----------------------------
+ * Returns the IPv6 default gateway of the supplied interface.
+ * 
+ * dev_name: The network interface name.
+ * 
+ * return: An IPv6 address or NULL on error.
+ */
+struct in6_addr * get_gw_ip6_address(const char *dev_name);
+
+/*
+ * Function: compare_ip6_add
+ * -------------------------
+ * Compares 2 IPv6 addresses.
+ * 
+ * ip_add_a: IPv6 address A represented as a array.
+ * 
+ * ip_add_b: IPv6 address B represented as a array.
+ * 
+ * return: 0 if the two addresses are equal, or -1 if not equal.
+ */
+int compare_ip6_add(const unsigned char *ip_add_a, 
+        const unsigned char *ip_add_b);
\ No newline at end of file
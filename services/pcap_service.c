@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "pcap_service.h"
+#include "../constants/constants.h"
+
+struct pcap_writer * pcap_writer_open(const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot create pcap file: %s\n", path);
+
+        return NULL;
+    }
+
+    struct pcap_writer *writer = malloc(sizeof(struct pcap_writer));
+    memset(writer, 0, sizeof(struct pcap_writer));
+
+    writer->fd = fd;
+    writer->buff = malloc(PCAP_WRITE_BUFF_SZ);
+
+    struct pcap_file_header header;
+    memset(&header, 0, sizeof(struct pcap_file_header));
+
+    header.magic = PCAP_MAGIC_US;
+    header.version_major = 2;
+    header.version_minor = 4;
+    header.snaplen = PCAP_SNAPLEN;
+    header.linktype = PCAP_LINKTYPE_ETHERNET;
+
+    memcpy(writer->buff, &header, sizeof(struct pcap_file_header));
+    writer->buff_len = sizeof(struct pcap_file_header);
+    writer->bytes = writer->buff_len;
+
+    return writer;
+}
+
+int pcap_writer_flush(struct pcap_writer *writer) {
+    size_t written = 0;
+
+    while (written < writer->buff_len) {
+        ssize_t ret = write(writer->fd, writer->buff + written, 
+                writer->buff_len - written);
+
+        if (ret < 0) {
+            fprintf(stderr, "ERROR: Cannot write pcap file!\n");
+
+            return -1;
+        }
+
+        written += ret;
+    }
+
+    writer->buff_len = 0;
+
+    return 0;
+}
+
+int pcap_writer_write(struct pcap_writer *writer, const unsigned char *frame,
+        int frame_len, unsigned long long ts_ns) {
+    size_t record_len = sizeof(struct pcap_record_header) + frame_len;
+
+    if (frame_len < 0 || frame_len > PCAP_SNAPLEN) {
+        return -1;
+    }
+
+    if (writer->buff_len + record_len > PCAP_WRITE_BUFF_SZ && 
+            pcap_writer_flush(writer) < 0) {
+        return -1;
+    }
+
+    struct pcap_record_header record;
+    record.ts_sec = (uint32_t)(ts_ns / 1000000000ULL);
+    record.ts_frac = (uint32_t)((ts_ns % 1000000000ULL) / 1000);
+    record.incl_len = frame_len;
+    record.orig_len = frame_len;
+
+    memcpy(writer->buff + writer->buff_len, &record, 
+            sizeof(struct pcap_record_header));
+    memcpy(writer->buff + writer->buff_len + sizeof(struct pcap_record_header),
+            frame, frame_len);
+
+    writer->buff_len += record_len;
+    writer->bytes += record_len;
+    writer->frames++;
+
+    return 0;
+}
+
+int pcap_writer_close(struct pcap_writer *writer) {
+    if (writer == NULL) {
+        return 0;
+    }
+
+    int ret = pcap_writer_flush(writer);
+
+    if (close(writer->fd) < 0) {
+        ret = -1;
+    }
+
+    free(writer->buff);
+    free(writer);
+
+    return ret;
+}
+
+static uint32_t pcap_u32(const struct pcap_reader *reader, uint32_t val) {
+    return reader->swapped ? __builtin_bswap32(val) : val;
+}
+
+struct pcap_reader * pcap_reader_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot open pcap file: %s\n", path);
+
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || 
+            st.st_size < (off_t)sizeof(struct pcap_file_header)) {
+        fprintf(stderr, "ERROR: Invalid pcap file: %s\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Cannot map pcap file: %s\n", path);
+
+        return NULL;
+    }
+
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    struct pcap_reader *reader = malloc(sizeof(struct pcap_reader));
+    memset(reader, 0, sizeof(struct pcap_reader));
+
+    reader->data = data;
+    reader->size = st.st_size;
+    reader->offset = sizeof(struct pcap_file_header);
+
+    const struct pcap_file_header *header = data;
+
+    if (header->magic == PCAP_MAGIC_US || header->magic == PCAP_MAGIC_NS) {
+        reader->swapped = 0;
+    } else if (__builtin_bswap32(header->magic) == PCAP_MAGIC_US || 
+            __builtin_bswap32(header->magic) == PCAP_MAGIC_NS) {
+        reader->swapped = 1;
+    } else {
+        fprintf(stderr, "ERROR: Invalid pcap file: %s\n", path);
+        pcap_reader_close(reader);
+
+        return NULL;
+    }
+
+    reader->nanosecond = (pcap_u32(reader, header->magic) == PCAP_MAGIC_NS);
+
+    if (pcap_u32(reader, header->linktype) != PCAP_LINKTYPE_ETHERNET) {
+        fprintf(stderr, "ERROR: pcap file is not an ethernet capture: %s\n", 
+                path);
+        pcap_reader_close(reader);
+
+        return NULL;
+    }
+
+    return reader;
+}
+
+int pcap_reader_next(struct pcap_reader *reader, const unsigned char **frame,
+        int *frame_len, unsigned long long *ts_ns) {
+    if (reader->offset == reader->size) {
+        return 0;
+    }
+
+    if (reader->offset + sizeof(struct pcap_record_header) > reader->size) {
+        return -1;
+    }
+
+    const struct pcap_record_header *record =
+            (const struct pcap_record_header *)(reader->data + reader->offset);
+    uint32_t incl_len = pcap_u32(reader, record->incl_len);
+
+    if (incl_len > reader->size - reader->offset - 
+            sizeof(struct pcap_record_header)) {
+        return -1;
+    }
+
+    *frame = reader->data + reader->offset + sizeof(struct pcap_record_header);
+    *frame_len = incl_len;
+
+    if (ts_ns != NULL) {
+        unsigned long long frac = pcap_u32(reader, record->ts_frac);
+
+        *ts_ns = pcap_u32(reader, record->ts_sec) * 1000000000ULL + 
+                (reader->nanosecond ? frac : frac * 1000);
+    }
+
+    reader->offset += sizeof(struct pcap_record_header) + incl_len;
+
+    return 1;
+}
+
+void pcap_reader_rewind(struct pcap_reader *reader) {
+    reader->offset = sizeof(struct pcap_file_header);
+}
+
+void pcap_reader_close(struct pcap_reader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+
+    munmap((void *)reader->data, reader->size);
+    free(reader);
+}
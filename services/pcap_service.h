@@ -0,0 +1,176 @@
+#ifndef PCAP_SERVICE_H
+#define PCAP_SERVICE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PCAP_MAGIC_US 0xa1b2c3d4        // Microsecond timestamps
+#define PCAP_MAGIC_NS 0xa1b23c4d        // Nanosecond timestamps
+#define PCAP_LINKTYPE_ETHERNET 1
+#define PCAP_SNAPLEN 65535
+
+// Size of the pcap writer's output buffer
+#define PCAP_WRITE_BUFF_SZ (4 * 1024 * 1024)
+
+/*
+ * pcap file layout
+ * ----------------
+ * pcap_file_header
+ * (pcap_record_header, frame) * n
+ */
+struct pcap_file_header {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+};
+
+struct pcap_record_header {
+    uint32_t ts_sec;
+    uint32_t ts_frac;
+    uint32_t incl_len;
+    uint32_t orig_len;
+};
+
+/*
+ * Struct: pcap_writer
+ * -------------------
+ * Writes frames to a pcap file through a large output buffer.
+ *
+ * fd: The pcap file.
+ *
+ * buff: The output buffer.
+ *
+ * buff_len: The number of bytes in the output buffer.
+ *
+ * frames: The number of frames written.
+ *
+ * bytes: The number of bytes written, including headers.
+ */
+struct pcap_writer {
+    int fd;
+    unsigned char *buff;
+    size_t buff_len;
+    unsigned long frames;
+    unsigned long long bytes;
+};
+
+/*
+ * Struct: pcap_reader
+ * -------------------
+ * A pcap file mapped in to memory.
+ *
+ * data: The mapped file.
+ *
+ * size: The size of the file.
+ *
+ * offset: Offset of the next record.
+ *
+ * swapped: 1 if the file was written with the opposite byte order.
+ *
+ * nanosecond: 1 if the timestamps are in nanoseconds.
+ */
+struct pcap_reader {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;
+    int swapped;
+    int nanosecond;
+};
+
+/*
+ * Function: pcap_writer_open
+ * --------------------------
+ * Creates a pcap file of ethernet frames with microsecond timestamps.
+ *
+ * path: Path of the pcap file.
+ *
+ * return: A new writer, or NULL on error.
+ */
+struct pcap_writer * pcap_writer_open(const char *path);
+
+/*
+ * Function: pcap_writer_write
+ * ---------------------------
+ * Appends a frame.
+ *
+ * writer: The writer.
+ *
+ * frame: The ethernet frame.
+ *
+ * frame_len: The length of the frame.
+ *
+ * ts_ns: The frame's timestamp in nanoseconds since the epoch.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int pcap_writer_write(struct pcap_writer *writer, const unsigned char *frame,
+        int frame_len, unsigned long long ts_ns);
+
+/*
+ * Function: pcap_writer_flush
+ * ---------------------------
+ * Writes the output buffer to the file.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int pcap_writer_flush(struct pcap_writer *writer);
+
+/*
+ * Function: pcap_writer_close
+ * ---------------------------
+ * Flushes and closes the pcap file and frees the writer.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int pcap_writer_close(struct pcap_writer *writer);
+
+/*
+ * Function: pcap_reader_open
+ * --------------------------
+ * Maps a pcap file of ethernet frames in to memory.
+ *
+ * path: Path of the pcap file.
+ *
+ * return: A new reader, or NULL on error.
+ */
+struct pcap_reader * pcap_reader_open(const char *path);
+
+/*
+ * Function: pcap_reader_next
+ * --------------------------
+ * Returns the next frame.  The frame points in to the mapped file and remains
+ * valid until the reader is closed.
+ *
+ * reader: The reader.
+ *
+ * frame: Set to the frame.
+ *
+ * frame_len: Set to the captured length of the frame.
+ *
+ * ts_ns: Set to the frame's timestamp in nanoseconds, may be NULL.
+ *
+ * return: 1 if a frame was read, 0 at the end of the file, or -1 if the file
+ *         is truncated.
+ */
+int pcap_reader_next(struct pcap_reader *reader, const unsigned char **frame,
+        int *frame_len, unsigned long long *ts_ns);
+
+/*
+ * Function: pcap_reader_rewind
+ * ----------------------------
+ * Moves the reader back to the first frame.
+ */
+void pcap_reader_rewind(struct pcap_reader *reader);
+
+/*
+ * Function: pcap_reader_close
+ * ---------------------------
+ * Unmaps the pcap file and frees the reader.
+ */
+void pcap_reader_close(struct pcap_reader *reader);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,221 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "prefix_tree.h"
+#include "../constants/constants.h"
+
+#define PREFIX_TREE_ROOTS (1 << PREFIX_TREE_ROOT_BITS)
+
+struct prefix {
+    unsigned int prefix;
+    unsigned int mask;
+};
+
+/*
+ * Splits a normalized set of addresses in to the fewest aligned prefixes
+ * covering it, in address order.  Returns the number of prefixes, or -1 on
+ * error.
+ */
+static int split_prefixes(const struct interval_set *addrs,
+        struct prefix **prefixes) {
+    int len = 0;
+    int cap = addrs->len > 0 ? addrs->len : 1;
+
+    *prefixes = malloc(sizeof(struct prefix) * cap);
+
+    if (*prefixes == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < addrs->len; i++) {
+        unsigned long long first = addrs->intervals[i].first;
+        unsigned long long last = addrs->intervals[i].last;
+
+        while (first <= last) {
+            // The largest block aligned at first that does not pass last
+            unsigned long long size = first == 0 ? 1ULL << 32 :
+                    first & -first;
+
+            while (first + size - 1 > last) {
+                size >>= 1;
+            }
+
+            if (len == cap) {
+                cap *= 2;
+
+                struct prefix *grown = realloc(*prefixes,
+                        sizeof(struct prefix) * cap);
+
+                if (grown == NULL) {
+                    free(*prefixes);
+
+                    return -1;
+                }
+
+                *prefixes = grown;
+            }
+
+            (*prefixes)[len].prefix = (unsigned int)first;
+            (*prefixes)[len].mask = (unsigned int)~(size - 1);
+            len++;
+
+            first += size;
+        }
+    }
+
+    return len;
+}
+
+/*
+ * Builds the tree of prefixes lo to hi, which share a root table slot, and
+ * returns the index of its root.
+ */
+static int build_node(struct prefix_tree *tree, const struct prefix *prefixes,
+        int lo, int hi) {
+    int index = tree->nodes_len++;
+    struct prefix_node *node = &tree->nodes[index];
+
+    if (hi - lo == 1) {
+        node->prefix = prefixes[lo].prefix;
+        node->mask = prefixes[lo].mask;
+        node->leaf = 1;
+        node->children[0] = PREFIX_TREE_NONE;
+        node->children[1] = PREFIX_TREE_NONE;
+
+        return index;
+    }
+
+    // The prefixes are disjoint and sorted, so the first and last differ at
+    // the first bit any two of them do
+    int shared_bits = __builtin_clz(prefixes[lo].prefix ^
+            prefixes[hi - 1].prefix);
+    unsigned int mask = shared_bits == 0 ? 0 : ~0U << (32 - shared_bits);
+    unsigned int branch_bit = 1U << (31 - shared_bits);
+
+    int split = lo + 1;
+
+    while ((prefixes[split].prefix & branch_bit) == 0) {
+        split++;
+    }
+
+    node->prefix = prefixes[lo].prefix & mask;
+    node->mask = mask;
+    node->leaf = 0;
+
+    // The node array never moves, it is sized for every node up front
+    int child_0 = build_node(tree, prefixes, lo, split);
+    int child_1 = build_node(tree, prefixes, split, hi);
+
+    tree->nodes[index].children[0] = child_0;
+    tree->nodes[index].children[1] = child_1;
+
+    return index;
+}
+
+struct prefix_tree * prefix_tree_build(const struct interval_set *addrs) {
+    struct prefix *prefixes;
+    int prefixes_len = split_prefixes(addrs, &prefixes);
+
+    if (prefixes_len < 0) {
+        return NULL;
+    }
+
+    struct prefix_tree *tree = malloc(sizeof(struct prefix_tree));
+
+    if (tree == NULL) {
+        free(prefixes);
+
+        return NULL;
+    }
+
+    // A tree of n leaves has n - 1 inner nodes
+    tree->roots = malloc(sizeof(int) * PREFIX_TREE_ROOTS);
+    tree->nodes = malloc(sizeof(struct prefix_node) *
+            (prefixes_len > 0 ? prefixes_len * 2 : 1));
+    tree->nodes_len = 0;
+    tree->prefixes_len = prefixes_len;
+
+    if (tree->roots == NULL || tree->nodes == NULL) {
+        free(prefixes);
+        prefix_tree_free(tree);
+
+        return NULL;
+    }
+
+    for (int i = 0; i < PREFIX_TREE_ROOTS; i++) {
+        tree->roots[i] = PREFIX_TREE_NONE;
+    }
+
+    const int SLOT_SHIFT = 32 - PREFIX_TREE_ROOT_BITS;
+    int i = 0;
+
+    while (i < prefixes_len) {
+        unsigned int slot = prefixes[i].prefix >> SLOT_SHIFT;
+
+        // Prefixes no longer than the slot bits cover whole slots
+        if ((prefixes[i].mask << PREFIX_TREE_ROOT_BITS) == 0) {
+            unsigned int last_slot = (prefixes[i].prefix |
+                    ~prefixes[i].mask) >> SLOT_SHIFT;
+
+            for (unsigned int s = slot; s <= last_slot; s++) {
+                tree->roots[s] = PREFIX_TREE_COVERED;
+            }
+
+            i++;
+
+            continue;
+        }
+
+        int end = i + 1;
+
+        while (end < prefixes_len &&
+                (prefixes[end].prefix >> SLOT_SHIFT) == slot) {
+            end++;
+        }
+
+        tree->roots[slot] = build_node(tree, prefixes, i, end);
+        i = end;
+    }
+
+    free(prefixes);
+
+    if (DEBUG >= 1) {
+        printf("Built prefix tree of %d prefixes, %d nodes\n",
+                tree->prefixes_len, tree->nodes_len);
+    }
+
+    return tree;
+}
+
+int prefix_tree_contains(const struct prefix_tree *tree, unsigned int ip) {
+    int index = tree->roots[ip >> (32 - PREFIX_TREE_ROOT_BITS)];
+
+    while (index >= 0) {
+        const struct prefix_node *node = &tree->nodes[index];
+
+        // Path compression skips bits, so the address may leave the tree
+        if (((ip ^ node->prefix) & node->mask) != 0) {
+            return 0;
+        }
+
+        if (node->leaf) {
+            return 1;
+        }
+
+        index = node->children[(ip & ~node->mask &
+                ~(~node->mask >> 1)) != 0];
+    }
+
+    return index == PREFIX_TREE_COVERED;
+}
+
+void prefix_tree_free(struct prefix_tree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+
+    free(tree->roots);
+    free(tree->nodes);
+    free(tree);
+}
@@ -0,0 +1,85 @@
+#ifndef PREFIX_TREE_H
+#define PREFIX_TREE_H
+
+#include "interval_set.h"
+
+// Bits of an address indexing the root table, the rest are searched in trees
+#define PREFIX_TREE_ROOT_BITS 16
+
+// Root table entries that are not the index of a node
+#define PREFIX_TREE_NONE -1
+#define PREFIX_TREE_COVERED -2
+
+/*
+ * Struct: prefix_node
+ * -------------------
+ * A node of a path compressed binary tree (Patricia tree) of disjoint IPv4
+ * prefixes.  Leaves are prefixes, inner nodes the longest prefix their
+ * children share, branching on the bit after it.
+ *
+ * prefix: The prefix (host byte order), bits past it zero.
+ *
+ * mask: The netmask of the prefix.
+ *
+ * leaf: 1 if the node is a prefix of the tree.
+ *
+ * children: The nodes of addresses whose next bit is 0 and 1.
+ */
+struct prefix_node {
+    unsigned int prefix;
+    unsigned int mask;
+    unsigned char leaf;
+    int children[2];
+};
+
+/*
+ * Struct: prefix_tree
+ * -------------------
+ * A read only set of IPv4 prefixes built once for fast membership checks.
+ * The first PREFIX_TREE_ROOT_BITS bits of an address index a table, so
+ * most lookups touch the table and one or two nodes.
+ *
+ * roots: For each root table slot, PREFIX_TREE_NONE, PREFIX_TREE_COVERED if
+ *        a prefix covers the whole slot, or the index of its tree's root.
+ *
+ * nodes: The nodes of every tree.
+ *
+ * nodes_len: The number of nodes.
+ *
+ * prefixes_len: The number of prefixes.
+ */
+struct prefix_tree {
+    int *roots;
+    struct prefix_node *nodes;
+    int nodes_len;
+    int prefixes_len;
+};
+
+/*
+ * Function: prefix_tree_build
+ * ---------------------------
+ * Builds a tree of the smallest set of prefixes covering a set of
+ * addresses.
+ *
+ * addrs: A normalized set of IPv4 addresses (host byte order).
+ *
+ * return: The tree, or NULL on error.
+ */
+struct prefix_tree * prefix_tree_build(const struct interval_set *addrs);
+
+/*
+ * Function: prefix_tree_contains
+ * ------------------------------
+ * return: 1 if a prefix of the tree covers the address (host byte order),
+ *         otherwise 0.
+ */
+int prefix_tree_contains(const struct prefix_tree *tree, unsigned int ip);
+
+/*
+ * Function: prefix_tree_free
+ * --------------------------
+ * Frees a tree.
+ */
+void prefix_tree_free(struct prefix_tree *tree);
+
+#endif
\ No newline at end of file
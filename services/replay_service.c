@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+
+#include "replay_service.h"
+#include "pcap_service.h"
+#include "transport_service.h"
+#include "tcp_service.h"
+#include "checkpoint_service.h"
+#include "stats_service.h"
+#include "histogram_service.h"
+#include "network_helper.h"
+#include "../constants/constants.h"
+
+/*
+ * For any endpoint not already set, takes the target and local MAC address
+ * from the first SYN-ACK or RST.  Reading the whole capture here also pulls it
+ * in to the page cache so the timed replay measures the reply path rather than
+ * disk reads.
+ */
+static int scan_capture(const char *path, unsigned char *tar_ip,
+        unsigned char *loc_mac, unsigned char *found) {
+    struct pcap_reader *reader = pcap_reader_open(path);
+
+    if (reader == NULL) {
+        return -1;
+    }
+
+    const unsigned char *frame;
+    int frame_len;
+    int ret;
+
+    while ((ret = pcap_reader_next(reader, &frame, &frame_len, NULL)) == 1) {
+        if (*found || frame_len < (int)(sizeof(struct ethhdr) +
+                sizeof(struct iphdr) + sizeof(struct tcphdr))) {
+            continue;
+        }
+
+        const struct ethhdr *eth = (const struct ethhdr *)frame;
+        const struct iphdr *iph = (const struct iphdr *)
+                (frame + sizeof(struct ethhdr));
+
+        if (ntohs(eth->h_proto) != ETH_P_IP || iph->protocol != 6) {
+            continue;
+        }
+
+        unsigned char flags = (frame + sizeof(struct ethhdr) +
+                iph->ihl * 4)[TCP_FLAGS_OFFSET];
+
+        if (!(flags & TH_RST) &&
+                (flags & (TH_SYN | TH_ACK)) != (TH_SYN | TH_ACK)) {
+            continue;
+        }
+
+        if (!(*found & 1)) {
+            memcpy(tar_ip, &iph->saddr, IP_LEN);
+        }
+
+        if (!(*found & 2)) {
+            memcpy(loc_mac, eth->h_dest, MAC_LEN);
+        }
+
+        *found = 3;
+    }
+
+    pcap_reader_close(reader);
+
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: Truncated pcap file: %s\n", path);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int replay_capture(const char *path, const unsigned char *tar_ip,
+        const unsigned char *loc_mac, struct replay_result *result) {
+    memset(result, 0, sizeof(struct replay_result));
+
+    // Replay frames through the pcap backend with nothing to write
+    char *spec = malloc(strlen(path) + strlen("pcap:,") + 1);
+    sprintf(spec, "pcap:,%s", path);
+
+    int ret = transport_configure(spec);
+    free(spec);
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    unsigned int tar_ip_32;
+    memcpy(&tar_ip_32, tar_ip, IP_LEN);
+
+    struct scan_state *state = create_scan_state(tar_ip_32, 1, 0, NULL);
+    struct transport *t = transport_open(0, loc_mac, ETH_P_ALL);
+
+    if (state == NULL || t == NULL) {
+        transport_close(t);
+        free_scan_state(state);
+        transport_shutdown();
+
+        return -1;
+    }
+
+    // Every probe was "sent", so the receiver drains the capture and stops
+    atomic_uchar stop_listening;
+    atomic_init(&stop_listening, 1);
+
+    unsigned long long start_ns = get_time_ns();
+
+    // No probes were sent, so there are no ICMP errors to match to them
+    struct open_ports_dto *open_ports = listen_for_ACK_replies(NULL, tar_ip,
+            loc_mac, t, &stop_listening, state);
+
+    result->elapsed_ns = get_time_ns() - start_ns;
+
+    struct transport_stats t_stats;
+    transport_get_stats(t, &t_stats);
+
+    result->frames = t_stats.received;
+    result->decoded = stats_read(&state->stats.receiver.replies_received);
+    result->open = stats_read(&state->stats.consumer.open);
+    result->closed = stats_read(&state->stats.consumer.closed);
+
+    transport_close(t);
+    transport_shutdown();
+    free_scan_state(state);
+
+    if (open_ports == NULL) {
+        return -1;
+    }
+
+    free(open_ports->open_ports);
+    free(open_ports);
+
+    return 0;
+}
+
+void print_replay_usage() {
+    printf("usage: mports replay <file.pcap> [-ip <target_ip>] "
+            "[-mac <local_mac>]\n");
+}
+
+int run_replay(int argc, const char **argv) {
+    if (argc < 2 || argc % 2 != 0) {
+        print_replay_usage();
+
+        return -1;
+    }
+
+    unsigned char tar_ip[IP_LEN];
+    unsigned char loc_mac[MAC_LEN];
+
+    // Bit 0: target IP given, bit 1: local MAC given
+    unsigned char found = 0;
+
+    for (int i = 2; i < argc; i += 2) {
+        if (strcmp(argv[i], "-ip") == 0) {
+            if (inet_pton(AF_INET, argv[i + 1], tar_ip) < 1) {
+                fprintf(stderr, "ERROR: Invalid IP address: %s\n",
+                        argv[i + 1]);
+
+                return -1;
+            }
+
+            found |= 1;
+        } else if (strcmp(argv[i], "-mac") == 0) {
+            unsigned int mac[MAC_LEN];
+
+            if (sscanf(argv[i + 1], "%2x:%2x:%2x:%2x:%2x:%2x", &mac[0],
+                    &mac[1], &mac[2], &mac[3], &mac[4], &mac[5]) != MAC_LEN) {
+                fprintf(stderr, "ERROR: Invalid MAC address: %s\n",
+                        argv[i + 1]);
+
+                return -1;
+            }
+
+            for (int j = 0; j < MAC_LEN; j++) {
+                loc_mac[j] = (unsigned char)mac[j];
+            }
+
+            found |= 2;
+        } else {
+            print_replay_usage();
+
+            return -1;
+        }
+    }
+
+    if (scan_capture(argv[1], tar_ip, loc_mac, &found) < 0) {
+        return -1;
+    }
+
+    if (found != 3) {
+        fprintf(stderr, "ERROR: No SYN-ACK or RST in capture, pass -ip and "
+                "-mac\n");
+
+        return -1;
+    }
+
+    struct replay_result result;
+
+    if (replay_capture(argv[1], tar_ip, loc_mac, &result) < 0) {
+        fprintf(stderr, "ERROR: Replay failed\n");
+
+        return -1;
+    }
+
+    double elapsed_s = result.elapsed_ns / 1e9;
+
+    printf("Target IP address:  %s\n", get_ip_arr_str(tar_ip));
+    printf("Local MAC address:  %s\n", get_mac_str(loc_mac));
+    printf("Frames:             %lu\n", result.frames);
+    printf("Decoded replies:    %lu\n", result.decoded);
+    printf("Ignored frames:     %lu\n", result.frames - result.decoded);
+    printf("Open:               %lu\n", result.open);
+    printf("Closed:             %lu\n", result.closed);
+    printf("Duplicate/other:    %lu\n",
+            result.decoded - result.open - result.closed);
+    printf("Elapsed:            %.3f ms\n", elapsed_s * 1000.0);
+    printf("Frames/sec:         %.0f\n",
+            elapsed_s > 0 ? result.frames / elapsed_s : 0.0);
+
+    return 0;
+}
\ No newline at end of file
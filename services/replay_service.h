@@ -0,0 +1,70 @@
+#ifndef REPLAY_SERVICE_H
+#define REPLAY_SERVICE_H
+
+/*
+ * Struct: replay_result
+ * ---------------------
+ * frames: Frames read from the capture.
+ *
+ * decoded: TCP replies from the target decoded by the receiver.
+ *
+ * open: Ports classified as open.
+ *
+ * closed: Ports classified as closed.
+ *
+ * elapsed_ns: Time spent in the receive and classification path.
+ */
+struct replay_result {
+    unsigned long frames;
+    unsigned long decoded;
+    unsigned long open;
+    unsigned long closed;
+    unsigned long long elapsed_ns;
+};
+
+/*
+ * Function: replay_capture
+ * ------------------------
+ * Feeds every frame of a pcap capture through the reply path of a scan
+ * (receive_tcp_replies and the classification in listen_for_ACK_replies) as
+ * fast as possible.
+ *
+ * path: The pcap capture.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * loc_mac: The local MAC address replies are addressed to.
+ *
+ * result: Populated with the frame and classification counts.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int replay_capture(const char *path, const unsigned char *tar_ip,
+        const unsigned char *loc_mac, struct replay_result *result);
+
+/*
+ * Function: run_replay
+ * --------------------
+ * Runs the "replay" subcommand:
+ *
+ *   replay <file.pcap> [-ip <target_ip>] [-mac <local_mac>]
+ *
+ * When the target or local MAC address is not given it is taken from the
+ * first SYN-ACK or RST in the capture.
+ *
+ * argc: The number of tokens in argv.
+ *
+ * argv: The subcommand tokens, starting with "replay".
+ *
+ * return: 0 on success, -1 on error.
+ */
+int run_replay(int argc, const char **argv);
+
+/*
+ * Function: print_replay_usage
+ * ----------------------------
+ * Prints the usage message of the replay subcommand.
+ */
+void print_replay_usage();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <arpa/inet.h>
+#include <time.h>
+
+#include "result_query.h"
+#include "result_store.h"
+#include "banner_service.h"
+#include "../constants/constants.h"
+
+static double get_elapsed_ms(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return (end.tv_sec - start->tv_sec) * 1000.0 + 
+            (end.tv_nsec - start->tv_nsec) / 1000000.0;
+}
+
+// Prints IPv4-mapped addresses as IPv4 addresses
+static void format_ip(const unsigned char *ip, char *buff) {
+    if (IN6_IS_ADDR_V4MAPPED((const struct in6_addr *)ip)) {
+        inet_ntop(AF_INET, ip + 12, buff, INET6_ADDRSTRLEN);
+    } else {
+        inet_ntop(AF_INET6, ip, buff, INET6_ADDRSTRLEN);
+    }
+}
+
+static int parse_ip(const char *ip_str, unsigned char *ip) {
+    struct in_addr ip_add;
+
+    if (inet_pton(AF_INET, ip_str, &ip_add) == 1) {
+        result_addr_from_ipv4(ip_add.s_addr, ip);
+
+        return 0;
+    }
+
+    return inet_pton(AF_INET6, ip_str, ip) == 1 ? 0 : -1;
+}
+
+const char * get_port_state_str(unsigned char state) {
+    switch (state) {
+        case PORT_STATE_OPEN:
+            return "open";
+        case PORT_STATE_CLOSED:
+            return "closed";
+        case PORT_STATE_FILTERED:
+            return "filtered";
+        default:
+            return "none";
+    }
+}
+
+static int query_summary(const struct result_reader *reader) {
+    unsigned long long state_counts[4] = {0, 0, 0, 0};
+    struct result_cursor cursor;
+    uint32_t port;
+    unsigned char state;
+
+    for (uint32_t i = 0; i < reader->header->host_count; i++) {
+        if (result_cursor_init(reader, i, &cursor) < 0) {
+            return -1;
+        }
+
+        int ret;
+        while ((ret = result_cursor_next(&cursor, &port, &state)) == 1) {
+            state_counts[state]++;
+        }
+
+        if (ret < 0) {
+            return -1;
+        }
+    }
+
+    printf("Hosts:      %u\n", reader->header->host_count);
+    printf("Open:       %llu\n", state_counts[PORT_STATE_OPEN]);
+    printf("Closed:     %llu\n", state_counts[PORT_STATE_CLOSED]);
+    printf("Filtered:   %llu\n", state_counts[PORT_STATE_FILTERED]);
+
+    return 0;
+}
+
+static int query_host(const struct result_reader *reader, const char *ip_str) {
+    unsigned char ip[RESULT_ADDR_LEN];
+
+    if (parse_ip(ip_str, ip) < 0) {
+        fprintf(stderr, "ERROR: Invalid IP address: %s\n", ip_str);
+
+        return -1;
+    }
+
+    int64_t entry_num = result_reader_find_host(reader, ip);
+
+    if (entry_num < 0) {
+        printf("Host %s is not in the result file\n", ip_str);
+
+        return 0;
+    }
+
+    struct result_cursor cursor;
+    uint32_t port;
+    unsigned char state;
+
+    if (result_cursor_init(reader, entry_num, &cursor) < 0) {
+        return -1;
+    }
+
+    int ret;
+    // IPv6 addresses are bracketed so the port stands apart
+    const char *fmt = strchr(ip_str, ':') != NULL ? "[%s]:%u %s\n" : 
+            "%s:%u %s\n";
+
+    while ((ret = result_cursor_next(&cursor, &port, &state)) == 1) {
+        printf(fmt, ip_str, port, get_port_state_str(state));
+    }
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    // Then the banners read from the open ports, after all of the ports
+    struct result_banner banner;
+    char banner_str[BANNER_STR_LEN];
+
+    fmt = strchr(ip_str, ':') != NULL ? "[%s]:%u banner %.*s%s%.*s%s %s\n" : 
+            "%s:%u banner %.*s%s%.*s%s %s\n";
+
+    while ((ret = result_cursor_next_banner(&cursor, &banner)) == 1) {
+        int data_len = banner.data_len < BANNER_MAX_LEN ? 
+                (int)banner.data_len : BANNER_MAX_LEN;
+
+        printf(fmt, ip_str, banner.port, 
+                banner.service_len > 0 ? (int)banner.service_len : 7, 
+                banner.service_len > 0 ? banner.service : "unknown", 
+                banner.product_len > 0 ? " (" : "", 
+                (int)banner.product_len, 
+                banner.product_len > 0 ? banner.product : "", 
+                banner.product_len > 0 ? ")" : "", 
+                format_banner(banner.data, data_len, banner_str));
+    }
+
+    return ret;
+}
+
+static int query_open_port(const struct result_reader *reader, 
+        const char *port_str) {
+    long int tar_port = strtol(port_str, NULL, 10);
+
+    if (tar_port < 1 || tar_port > MAX_PORT) {
+        fprintf(stderr, "ERROR: Invalid port: %s\n", port_str);
+
+        return -1;
+    }
+
+    char ip_str[INET6_ADDRSTRLEN];
+    struct result_cursor cursor;
+    uint32_t port;
+    unsigned char state;
+    unsigned int matches = 0;
+
+    for (uint32_t i = 0; i < reader->header->host_count; i++) {
+        if (result_cursor_init(reader, i, &cursor) < 0) {
+            return -1;
+        }
+
+        int ret;
+        while ((ret = result_cursor_next(&cursor, &port, &state)) == 1) {
+            // Ports are stored in ascending order
+            if (port >= tar_port) {
+                break;
+            }
+        }
+
+        if (ret < 0) {
+            return -1;
+        }
+
+        if (ret == 1 && port == tar_port && state == PORT_STATE_OPEN) {
+            format_ip(reader->index[i].ip, ip_str);
+            printf("%s\n", ip_str);
+            matches++;
+        }
+    }
+
+    fprintf(stderr, "%u hosts have port %ld open\n", matches, tar_port);
+
+    return 0;
+}
+
+// Reads the next port of a host, or sets port past MAX_PORT at the end
+static int next_diff_port(struct result_cursor *cursor, int valid, 
+        uint32_t *port, unsigned char *state) {
+    int ret = valid ? result_cursor_next(cursor, port, state) : 0;
+
+    if (ret == 0) {
+        *port = MAX_PORT + 1;
+        *state = PORT_STATE_UNKNOWN;
+    }
+
+    return ret;
+}
+
+static int diff_host(const struct result_reader *reader_a, int64_t entry_a,
+        const struct result_reader *reader_b, int64_t entry_b, 
+        const unsigned char *ip, unsigned long long *changes) {
+    struct result_cursor cursor_a;
+    struct result_cursor cursor_b;
+    uint32_t port_a;
+    uint32_t port_b;
+    unsigned char state_a;
+    unsigned char state_b;
+
+    if ((entry_a >= 0 && result_cursor_init(reader_a, entry_a, &cursor_a) < 0) 
+            || (entry_b >= 0 && 
+            result_cursor_init(reader_b, entry_b, &cursor_b) < 0)) {
+        return -1;
+    }
+
+    char ip_str[INET6_ADDRSTRLEN];
+    format_ip(ip, ip_str);
+
+    const char *fmt = strchr(ip_str, ':') != NULL ? "[%s]:%u %s -> %s\n" : 
+            "%s:%u %s -> %s\n";
+
+    if (next_diff_port(&cursor_a, entry_a >= 0, &port_a, &state_a) < 0 ||
+            next_diff_port(&cursor_b, entry_b >= 0, &port_b, &state_b) < 0) {
+        return -1;
+    }
+
+    // Merge the two ascending port lists
+    while (port_a <= MAX_PORT || port_b <= MAX_PORT) {
+        uint32_t port = port_a < port_b ? port_a : port_b;
+        unsigned char old_state = (port == port_a) ? state_a : 
+                PORT_STATE_UNKNOWN;
+        unsigned char new_state = (port == port_b) ? state_b : 
+                PORT_STATE_UNKNOWN;
+
+        if (old_state != new_state) {
+            printf(fmt, ip_str, port, 
+                    get_port_state_str(old_state), 
+                    get_port_state_str(new_state));
+            (*changes)++;
+        }
+
+        if (port == port_a && 
+                next_diff_port(&cursor_a, 1, &port_a, &state_a) < 0) {
+            return -1;
+        }
+
+        if (port == port_b && 
+                next_diff_port(&cursor_b, 1, &port_b, &state_b) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int query_diff(const struct result_reader *reader_a, 
+        const struct result_reader *reader_b) {
+    uint32_t len_a = reader_a->header->host_count;
+    uint32_t len_b = reader_b->header->host_count;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    unsigned long long changes = 0;
+
+    // Merge the two sorted host indexes
+    while (i < len_a || j < len_b) {
+        const unsigned char *ip_a = (i < len_a) ? reader_a->index[i].ip : NULL;
+        const unsigned char *ip_b = (j < len_b) ? reader_b->index[j].ip : NULL;
+        int cmp = (ip_a == NULL) ? 1 : (ip_b == NULL) ? -1 : 
+                memcmp(ip_a, ip_b, RESULT_ADDR_LEN);
+        int64_t entry_a = -1;
+        int64_t entry_b = -1;
+        const unsigned char *ip = NULL;
+
+        if (cmp <= 0) {
+            entry_a = i++;
+            ip = ip_a;
+        }
+
+        if (cmp >= 0) {
+            entry_b = j++;
+            ip = ip_b;
+        }
+
+        if (diff_host(reader_a, entry_a, reader_b, entry_b, ip, 
+                &changes) < 0) {
+            return -1;
+        }
+    }
+
+    fprintf(stderr, "%llu port states changed\n", changes);
+
+    return 0;
+}
+
+void print_query_usage() {
+    printf("usage: mports query <file> summary\n");
+    printf("       mports query <file> host <ip>\n");
+    printf("       mports query <file> open <port>\n");
+    printf("       mports query diff <file_a> <file_b>\n");
+}
+
+int run_result_query(int argc, const char **argv) {
+    if (argc < 3) {
+        print_query_usage();
+
+        return -1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int ret = -1;
+
+    if (strcmp(argv[1], "diff") == 0) {
+        if (argc != 4) {
+            print_query_usage();
+
+            return -1;
+        }
+
+        struct result_reader *reader_a = result_reader_open(argv[2]);
+        struct result_reader *reader_b = result_reader_open(argv[3]);
+
+        if (reader_a != NULL && reader_b != NULL) {
+            ret = query_diff(reader_a, reader_b);
+        }
+
+        result_reader_close(reader_a);
+        result_reader_close(reader_b);
+    } else {
+        struct result_reader *reader = result_reader_open(argv[1]);
+
+        if (reader == NULL) {
+            return -1;
+        }
+
+        if (strcmp(argv[2], "summary") == 0 && argc == 3) {
+            ret = query_summary(reader);
+        } else if (strcmp(argv[2], "host") == 0 && argc == 4) {
+            ret = query_host(reader, argv[3]);
+        } else if (strcmp(argv[2], "open") == 0 && argc == 4) {
+            ret = query_open_port(reader, argv[3]);
+        } else {
+            print_query_usage();
+            result_reader_close(reader);
+
+            return -1;
+        }
+
+        result_reader_close(reader);
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: Query failed, result file may be corrupt\n");
+
+        return -1;
+    }
+
+    fprintf(stderr, "Query completed in %.3f ms\n", get_elapsed_ms(&start));
+
+    return 0;
+}
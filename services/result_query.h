@@ -0,0 +1,37 @@
+#ifndef RESULT_QUERY_H
+#define RESULT_QUERY_H
+
+/*
+ * Function: run_result_query
+ * --------------------------
+ * Runs the "query" subcommand against binary result files:
+ * 
+ *   query <file> summary            Host and port state totals.
+ *   query <file> host <ip>          Every port recorded for a host, then
+ *                                   the banners read from its open ports.
+ *   query <file> open <port>        Every host with the port open.
+ *   query diff <file_a> <file_b>    Every port whose state changed.
+ * 
+ * argc: The number of tokens in argv.
+ * 
+ * argv: The subcommand tokens, starting with "query".
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int run_result_query(int argc, const char **argv);
+
+/*
+ * Function: print_query_usage
+ * ---------------------------
+ * Prints the usage message of the query subcommand.
+ */
+void print_query_usage();
+
+/*
+ * Function: get_port_state_str
+ * ----------------------------
+ * return: A string naming a PORT_STATE_* value.
+ */
+const char * get_port_state_str(unsigned char state);
+
+#endif
@@ -0,0 +1,422 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "result_store.h"
+#include "../constants/constants.h"
+
+// Maximum encoded length of a 32 bit varint
+#define VARINT_MAX_LEN 5
+
+static int encode_varint(uint32_t value, unsigned char *buff) {
+    int len = 0;
+
+    while (value >= 0x80) {
+        buff[len++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+
+    buff[len++] = (unsigned char)value;
+
+    return len;
+}
+
+static int decode_varint(const unsigned char **pos, const unsigned char *end,
+        uint32_t *value) {
+    uint32_t result = 0;
+
+    for (int shift = 0; shift < 7 * VARINT_MAX_LEN; shift += 7) {
+        if (*pos >= end) {
+            return -1;
+        }
+
+        unsigned char byte = *((*pos)++);
+        result |= (uint32_t)(byte & 0x7f) << shift;
+
+        if (!(byte & 0x80)) {
+            *value = result;
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static int compare_index_entries(const void *a, const void *b) {
+    const struct result_index_entry *entry_a = a;
+    const struct result_index_entry *entry_b = b;
+
+    return memcmp(entry_a->ip, entry_b->ip, RESULT_ADDR_LEN);
+}
+
+void result_addr_from_ipv4(uint32_t ip, unsigned char *addr) {
+    memset(addr, 0, RESULT_ADDR_LEN);
+
+    addr[10] = 0xff;
+    addr[11] = 0xff;
+    memcpy(addr + 12, &ip, sizeof(uint32_t));
+}
+
+struct result_writer * result_writer_open(const char *path) {
+    if (DEBUG >= 2) {
+        printf("Creating result file: %s\n", path);
+    }
+
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL) {
+        fprintf(stderr, "ERROR: Cannot create result file: %s\n", path);
+
+        return NULL;
+    }
+
+    struct result_writer *writer = malloc(sizeof(struct result_writer));
+    memset(writer, 0, sizeof(struct result_writer));
+
+    writer->fp = fp;
+
+    // Placeholder until the index offset is known
+    struct result_header header;
+    memset(&header, 0, sizeof(struct result_header));
+
+    if (fwrite(&header, sizeof(struct result_header), 1, fp) != 1) {
+        fclose(fp);
+        free(writer);
+
+        return NULL;
+    }
+
+    writer->offset = sizeof(struct result_header);
+
+    return writer;
+}
+
+int result_writer_add_host(struct result_writer *writer, 
+        const unsigned char *ip, 
+        const unsigned short *ports, const unsigned char *states, 
+        int ports_len, const struct result_banner *banners, 
+        int banners_len) {
+    uint32_t known_len = 0;
+
+    for (int i = 0; i < ports_len; i++) {
+        if (states[i] != PORT_STATE_UNKNOWN) {
+            known_len++;
+        }
+    }
+
+    // Worst case encoded size of the record
+    size_t max_record_len = RESULT_ADDR_LEN + 
+            VARINT_MAX_LEN * (known_len + 2);
+
+    for (int i = 0; i < banners_len; i++) {
+        max_record_len += VARINT_MAX_LEN * 4 + banners[i].service_len + 
+                banners[i].product_len + banners[i].data_len;
+    }
+
+    unsigned char *buff = malloc(max_record_len);
+    int len = 0;
+
+    if (buff == NULL) {
+        return -1;
+    }
+
+    memcpy(buff, ip, RESULT_ADDR_LEN);
+    len += RESULT_ADDR_LEN;
+
+    len += encode_varint(known_len, buff + len);
+
+    uint32_t prev_port = 0;
+
+    for (int i = 0; i < ports_len; i++) {
+        if (states[i] == PORT_STATE_UNKNOWN) {
+            continue;
+        }
+
+        uint32_t value = ((ports[i] - prev_port) << RESULT_STATE_BITS) | 
+                (states[i] & RESULT_STATE_MASK);
+
+        len += encode_varint(value, buff + len);
+        prev_port = ports[i];
+    }
+
+    len += encode_varint((uint32_t)banners_len, buff + len);
+
+    for (int i = 0; i < banners_len; i++) {
+        const struct result_banner *banner = &banners[i];
+
+        len += encode_varint(banner->port, buff + len);
+        len += encode_varint(banner->service_len, buff + len);
+        memcpy(buff + len, banner->service, banner->service_len);
+        len += banner->service_len;
+        len += encode_varint(banner->product_len, buff + len);
+        memcpy(buff + len, banner->product, banner->product_len);
+        len += banner->product_len;
+        len += encode_varint(banner->data_len, buff + len);
+        memcpy(buff + len, banner->data, banner->data_len);
+        len += banner->data_len;
+    }
+
+    if (fwrite(buff, len, 1, writer->fp) != 1) {
+        free(buff);
+
+        return -1;
+    }
+
+    free(buff);
+
+    if (writer->index_len == writer->index_cap) {
+        writer->index_cap = writer->index_cap ? writer->index_cap * 2 : 256;
+        writer->index = realloc(writer->index, 
+                sizeof(struct result_index_entry) * writer->index_cap);
+
+        if (writer->index == NULL) {
+            return -1;
+        }
+    }
+
+    struct result_index_entry *entry = &writer->index[writer->index_len++];
+    memcpy(entry->ip, ip, RESULT_ADDR_LEN);
+    entry->offset = writer->offset;
+
+    writer->offset += len;
+
+    return 0;
+}
+
+int result_writer_close(struct result_writer *writer) {
+    qsort(writer->index, writer->index_len, 
+            sizeof(struct result_index_entry), compare_index_entries);
+
+    // The index is read in place from the mapped file, so it starts at an
+    // offset aligned for its 64-bit record offsets
+    const unsigned char padding[sizeof(uint64_t)] = { 0 };
+    size_t padding_len = (sizeof(uint64_t) - writer->offset % 
+            sizeof(uint64_t)) % sizeof(uint64_t);
+
+    int ok = (fwrite(padding, 1, padding_len, writer->fp) == padding_len);
+
+    writer->offset += padding_len;
+
+    if (ok && writer->index_len > 0) {
+        ok = (fwrite(writer->index, sizeof(struct result_index_entry), 
+                writer->index_len, writer->fp) == writer->index_len);
+    }
+
+    struct result_header header;
+    memset(&header, 0, sizeof(struct result_header));
+
+    header.magic = RESULT_STORE_MAGIC;
+    header.version = RESULT_STORE_VERSION;
+    header.host_count = writer->index_len;
+    header.index_offset = writer->offset;
+    header.created = (uint64_t)time(0);
+
+    ok = ok && (fseek(writer->fp, 0, SEEK_SET) == 0);
+    ok = ok && (fwrite(&header, sizeof(struct result_header), 1, 
+            writer->fp) == 1);
+    ok = (fclose(writer->fp) == 0) && ok;
+
+    free(writer->index);
+    free(writer);
+
+    return ok ? 0 : -1;
+}
+
+struct result_reader * result_reader_open(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot open result file: %s\n", path);
+
+        return NULL;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || 
+            (uint64_t)st.st_size < sizeof(struct result_header)) {
+        fprintf(stderr, "ERROR: Invalid result file: %s\n", path);
+        close(fd);
+
+        return NULL;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Cannot map result file: %s\n", path);
+
+        return NULL;
+    }
+
+    const struct result_header *header = data;
+
+    uint64_t index_len = (uint64_t)header->host_count * 
+            sizeof(struct result_index_entry);
+
+    if (header->magic != RESULT_STORE_MAGIC || 
+            header->version != RESULT_STORE_VERSION ||
+            header->index_offset % _Alignof(struct result_index_entry) ||
+            header->index_offset > (uint64_t)st.st_size ||
+            index_len > (uint64_t)st.st_size - header->index_offset) {
+        fprintf(stderr, "ERROR: Invalid result file: %s\n", path);
+        munmap(data, st.st_size);
+
+        return NULL;
+    }
+
+    // Scans read every record once, front to back
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    struct result_reader *reader = malloc(sizeof(struct result_reader));
+
+    if (reader == NULL) {
+        munmap(data, st.st_size);
+
+        return NULL;
+    }
+
+    reader->data = data;
+    reader->size = st.st_size;
+    reader->header = header;
+    reader->index = (const struct result_index_entry *)
+            (reader->data + header->index_offset);
+
+    return reader;
+}
+
+void result_reader_close(struct result_reader *reader) {
+    if (reader == NULL) {
+        return;
+    }
+
+    munmap((void *)reader->data, reader->size);
+    free(reader);
+}
+
+int64_t result_reader_find_host(const struct result_reader *reader, 
+        const unsigned char *ip) {
+    int64_t low = 0;
+    int64_t high = (int64_t)reader->header->host_count - 1;
+
+    while (low <= high) {
+        int64_t mid = low + (high - low) / 2;
+        int cmp = memcmp(reader->index[mid].ip, ip, RESULT_ADDR_LEN);
+
+        if (cmp == 0) {
+            return mid;
+        } else if (cmp < 0) {
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return -1;
+}
+
+int result_cursor_init(const struct result_reader *reader, uint32_t entry_num,
+        struct result_cursor *cursor) {
+    uint64_t offset = reader->index[entry_num].offset;
+
+    cursor->end = reader->data + reader->header->index_offset;
+
+    if (offset + RESULT_ADDR_LEN > reader->header->index_offset) {
+        return -1;
+    }
+
+    cursor->pos = reader->data + offset + RESULT_ADDR_LEN;
+    cursor->port = 0;
+    cursor->banners_remaining = 0;
+    cursor->banners_started = 0;
+
+    return decode_varint(&cursor->pos, cursor->end, &cursor->remaining);
+}
+
+int result_cursor_next(struct result_cursor *cursor, uint32_t *port, 
+        unsigned char *state) {
+    if (cursor->remaining == 0) {
+        return 0;
+    }
+
+    uint32_t value;
+
+    if (decode_varint(&cursor->pos, cursor->end, &value) < 0) {
+        return -1;
+    }
+
+    cursor->port += value >> RESULT_STATE_BITS;
+    cursor->remaining--;
+
+    if (cursor->port > MAX_PORT) {
+        return -1;
+    }
+
+    *port = cursor->port;
+    *state = value & RESULT_STATE_MASK;
+
+    return 1;
+}
+
+// Decodes a length prefixed field of a banner record
+static int decode_bytes(struct result_cursor *cursor, 
+        const unsigned char **bytes, uint32_t *len) {
+    if (decode_varint(&cursor->pos, cursor->end, len) < 0 || 
+            *len > (uint64_t)(cursor->end - cursor->pos)) {
+        return -1;
+    }
+
+    *bytes = cursor->pos;
+    cursor->pos += *len;
+
+    return 0;
+}
+
+int result_cursor_next_banner(struct result_cursor *cursor, 
+        struct result_banner *banner) {
+    if (!cursor->banners_started) {
+        uint32_t port;
+        unsigned char state;
+        int ret;
+
+        while ((ret = result_cursor_next(cursor, &port, &state)) == 1) {
+        }
+
+        if (ret < 0 || decode_varint(&cursor->pos, cursor->end, 
+                &cursor->banners_remaining) < 0) {
+            return -1;
+        }
+
+        cursor->banners_started = 1;
+    }
+
+    if (cursor->banners_remaining == 0) {
+        return 0;
+    }
+
+    const unsigned char *service;
+    const unsigned char *product;
+
+    if (decode_varint(&cursor->pos, cursor->end, &banner->port) < 0 || 
+            banner->port > MAX_PORT ||
+            decode_bytes(cursor, &service, &banner->service_len) < 0 ||
+            decode_bytes(cursor, &product, &banner->product_len) < 0 ||
+            decode_bytes(cursor, &banner->data, &banner->data_len) < 0) {
+        return -1;
+    }
+
+    banner->service = (const char *)service;
+    banner->product = (const char *)product;
+    cursor->banners_remaining--;
+
+    return 1;
+}
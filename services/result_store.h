@@ -0,0 +1,271 @@
+#ifndef RESULT_STORE_H
+#define RESULT_STORE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define RESULT_STORE_MAGIC 0x5352504d   // "MPRS"
+#define RESULT_STORE_VERSION 1
+
+// Length of a host address.  IPv4 hosts are stored as IPv4-mapped IPv6
+// addresses (::ffff:a.b.c.d).
+#define RESULT_ADDR_LEN 16
+
+// Number of bits the port delta is shifted by to make room for the state
+#define RESULT_STATE_BITS 2
+#define RESULT_STATE_MASK 0x03
+
+/*
+ * Binary result file layout
+ * -------------------------
+ * result_header
+ * host record * host_count, in the order they were written:
+ *     ip           RESULT_ADDR_LEN bytes, network byte order
+ *     ports_len    varint
+ *     ports        ports_len varints of 
+ *                  ((port - previous port) << RESULT_STATE_BITS) | state
+ *                  with ports in ascending order
+ *     banners_len  varint
+ *     banners      banners_len records, in ascending port order, of:
+ *         port         varint
+ *         service_len  varint, 0 if no fingerprint matched
+ *         service      service_len bytes
+ *         product_len  varint, 0 if the fingerprint names no product
+ *         product      product_len bytes
+ *         data_len     varint
+ *         data         data_len bytes, the banner as read
+ * padding      zero bytes up to the next multiple of 8
+ * result_index_entry * host_count, sorted by IP address, at index_offset
+ *
+ * Varints are unsigned LEB128.
+ */
+struct result_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t host_count;
+    uint32_t reserved_2;
+    uint64_t index_offset;
+    uint64_t created;
+};
+
+/*
+ * Struct: result_index_entry
+ * --------------------------
+ * ip: Host address in network byte order, so the index sorts numerically 
+ *     with memcmp.
+ *
+ * offset: File offset of the host record.
+ */
+struct result_index_entry {
+    unsigned char ip[RESULT_ADDR_LEN];
+    uint64_t offset;
+};
+
+/*
+ * Struct: result_banner
+ * ---------------------
+ * The banner of a port and the service identified from it.  Strings are not
+ * NUL terminated, and when read they point in to the mapped file.
+ *
+ * port: The port the banner was read from.
+ *
+ * service: The service, service_len bytes long, or empty if unknown.
+ *
+ * product: The product, product_len bytes long, or empty if unknown.
+ *
+ * data: The banner, data_len bytes long.
+ */
+struct result_banner {
+    uint32_t port;
+    const char *service;
+    uint32_t service_len;
+    const char *product;
+    uint32_t product_len;
+    const unsigned char *data;
+    uint32_t data_len;
+};
+
+/*
+ * Struct: result_writer
+ * ---------------------
+ * Streams host records to a result file.  Only the index is kept in memory.
+ */
+struct result_writer {
+    FILE *fp;
+    uint64_t offset;
+    struct result_index_entry *index;
+    uint32_t index_len;
+    uint32_t index_cap;
+};
+
+/*
+ * Struct: result_reader
+ * ---------------------
+ * A result file mapped in to memory.
+ *
+ * index: The host index, inside the mapping.
+ */
+struct result_reader {
+    const unsigned char *data;
+    size_t size;
+    const struct result_header *header;
+    const struct result_index_entry *index;
+};
+
+/*
+ * Struct: result_cursor
+ * ---------------------
+ * Iterates over the ports of one host record, then its banners.
+ *
+ * remaining: The ports left to decode.
+ *
+ * banners_remaining: The banners left to decode, once banners_started.
+ */
+struct result_cursor {
+    const unsigned char *pos;
+    const unsigned char *end;
+    uint32_t remaining;
+    uint32_t port;
+    uint32_t banners_remaining;
+    unsigned char banners_started;
+};
+
+/*
+ * Function: result_writer_open
+ * ----------------------------
+ * Creates a result file and writes a placeholder header.
+ *
+ * path: The file to create.
+ *
+ * return: A new writer, or NULL on error.
+ */
+struct result_writer * result_writer_open(const char *path);
+
+/*
+ * Function: result_writer_add_host
+ * --------------------------------
+ * Appends the results for one host.  Ports with PORT_STATE_UNKNOWN are not
+ * written.
+ *
+ * writer: The result writer.
+ *
+ * ip: The RESULT_ADDR_LEN byte host address (see result_addr_from_ipv4).
+ *
+ * ports: The scanned ports in ascending order.
+ *
+ * states: The PORT_STATE_* of each port in ports.
+ *
+ * ports_len: The length of the ports and states arrays.
+ *
+ * banners: The banners read from the host in ascending port order, or NULL.
+ *
+ * banners_len: The length of the banners array.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int result_writer_add_host(struct result_writer *writer, 
+        const unsigned char *ip, 
+        const unsigned short *ports, const unsigned char *states, 
+        int ports_len, const struct result_banner *banners, 
+        int banners_len);
+
+/*
+ * Function: result_addr_from_ipv4
+ * -------------------------------
+ * Converts an IPv4 address in to the IPv4-mapped address it is stored as.
+ *
+ * ip: The IPv4 address (network byte order).
+ *
+ * addr: Populated with the RESULT_ADDR_LEN byte address.
+ */
+void result_addr_from_ipv4(uint32_t ip, unsigned char *addr);
+
+/*
+ * Function: result_writer_close
+ * -----------------------------
+ * Writes the sorted host index, patches the header and closes the file.
+ * The writer is freed.
+ *
+ * writer: The result writer.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int result_writer_close(struct result_writer *writer);
+
+/*
+ * Function: result_reader_open
+ * ----------------------------
+ * Maps a result file in to memory and validates its header and index.
+ *
+ * path: The result file.
+ *
+ * return: A new reader, or NULL on error.
+ */
+struct result_reader * result_reader_open(const char *path);
+
+/*
+ * Function: result_reader_close
+ * -----------------------------
+ * Unmaps the result file and frees the reader.
+ */
+void result_reader_close(struct result_reader *reader);
+
+/*
+ * Function: result_reader_find_host
+ * ---------------------------------
+ * Binary searches the index for a host.
+ *
+ * reader: The result reader.
+ *
+ * ip: The RESULT_ADDR_LEN byte host address.
+ *
+ * return: The index entry number, or -1 if the host is not in the file.
+ */
+int64_t result_reader_find_host(const struct result_reader *reader, 
+        const unsigned char *ip);
+
+/*
+ * Function: result_cursor_init
+ * ----------------------------
+ * Positions a cursor at the start of the host record referenced by index 
+ * entry entry_num.
+ *
+ * return: 0 on success, -1 if the record is corrupt.
+ */
+int result_cursor_init(const struct result_reader *reader, uint32_t entry_num,
+        struct result_cursor *cursor);
+
+/*
+ * Function: result_cursor_next
+ * ----------------------------
+ * Decodes the next port of a host record.
+ *
+ * cursor: The cursor.
+ *
+ * port: Populated with the port number.
+ *
+ * state: Populated with the PORT_STATE_* of the port.
+ *
+ * return: 1 if a port was decoded, 0 at the end of the record, -1 if the
+ *         record is corrupt.
+ */
+int result_cursor_next(struct result_cursor *cursor, uint32_t *port, 
+        unsigned char *state);
+
+/*
+ * Function: result_cursor_next_banner
+ * -----------------------------------
+ * Decodes the next banner of a host record, skipping any ports not yet read.
+ *
+ * cursor: The cursor.
+ *
+ * banner: Populated with the banner.
+ *
+ * return: 1 if a banner was decoded, 0 at the end of the record, -1 if the
+ *         record is corrupt.
+ */
+int result_cursor_next_banner(struct result_cursor *cursor, 
+        struct result_banner *banner);
+
+#endif
@@ -0,0 +1,151 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ring_buffer.h"
+#include "../constants/constants.h"
+
+struct reply_ring * reply_ring_create() {
+    struct reply_ring *ring = aligned_alloc(CACHE_LINE_SIZE, 
+            sizeof(struct reply_ring));
+
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    memset(ring, 0, sizeof(struct reply_ring));
+
+    ring->slots = malloc(sizeof(struct reply_record) * REPLY_RING_SIZE);
+
+    if (ring->slots == NULL) {
+        free(ring);
+
+        return NULL;
+    }
+
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->closed, 0);
+
+    ring->mask = REPLY_RING_SIZE - 1;
+
+    return ring;
+}
+
+struct reply_ring * reply_ring_create_payloads(int payload_size) {
+    struct reply_ring *ring = reply_ring_create();
+
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->payloads = malloc((size_t)payload_size * REPLY_RING_SIZE);
+
+    if (ring->payloads == NULL) {
+        reply_ring_free(ring);
+
+        return NULL;
+    }
+
+    ring->payload_size = payload_size;
+
+    return ring;
+}
+
+void reply_ring_free(struct reply_ring *ring) {
+    if (ring == NULL) {
+        return;
+    }
+
+    free(ring->slots);
+    free(ring->payloads);
+    free(ring);
+}
+
+int reply_ring_push(struct reply_ring *ring, const struct reply_record *rec) {
+    return reply_ring_push_payload(ring, rec, NULL);
+}
+
+int reply_ring_push_payload(struct reply_ring *ring, 
+        const struct reply_record *rec, const unsigned char *payload) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    // Only re-read the consumer's index when the ring looks full
+    if (head - ring->tail_cache > ring->mask) {
+        ring->tail_cache = atomic_load_explicit(&ring->tail, 
+                memory_order_acquire);
+
+        if (head - ring->tail_cache > ring->mask) {
+            return 0;
+        }
+    }
+
+    struct reply_record *slot = &ring->slots[head & ring->mask];
+    *slot = *rec;
+
+    if (ring->payloads == NULL || payload == NULL) {
+        slot->payload_len = 0;
+    } else {
+        if (slot->payload_len > ring->payload_size) {
+            slot->payload_len = ring->payload_size;
+        }
+
+        memcpy(ring->payloads + (head & ring->mask) * ring->payload_size, 
+                payload, slot->payload_len);
+    }
+
+    // Publish the record to the consumer
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return 1;
+}
+
+int reply_ring_pop(struct reply_ring *ring, struct reply_record *rec) {
+    return reply_ring_pop_payload(ring, rec, NULL);
+}
+
+int reply_ring_pop_payload(struct reply_ring *ring, struct reply_record *rec, 
+        unsigned char *payload) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    // Only re-read the producer's index when the ring looks empty
+    if (tail == ring->head_cache) {
+        ring->head_cache = atomic_load_explicit(&ring->head, 
+                memory_order_acquire);
+
+        if (tail == ring->head_cache) {
+            return 0;
+        }
+    }
+
+    *rec = ring->slots[tail & ring->mask];
+
+    // Copied out before the slot can be reused
+    if (payload != NULL && rec->payload_len > 0) {
+        memcpy(payload, ring->payloads + (tail & ring->mask) * 
+                ring->payload_size, rec->payload_len);
+    }
+
+    // Hand the slot back to the producer
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return 1;
+}
+
+void reply_ring_close(struct reply_ring *ring) {
+    atomic_store_explicit(&ring->closed, 1, memory_order_release);
+}
+
+int reply_ring_consume(struct reply_ring *ring, struct reply_record *rec, 
+        unsigned char *payload) {
+    // Read closed before popping so a record pushed before the ring was
+    // closed cannot be missed
+    unsigned char closed = atomic_load_explicit(&ring->closed, 
+            memory_order_acquire);
+
+    if (reply_ring_pop_payload(ring, rec, payload)) {
+        return 1;
+    }
+
+    return closed ? -1 : 0;
+}
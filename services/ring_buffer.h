@@ -0,0 +1,211 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+#include "../constants/constants.h"
+
+// Number of slots in a reply ring (must be a power of 2)
+#define REPLY_RING_SIZE 8192
+
+/*
+ * Struct: reply_record
+ * --------------------
+ * A decoded reply frame passed from a receive thread to the consumer.
+ *
+ * src_ip: Source IP address of the reply (network byte order).
+ *
+ * src_port: Source port of the reply (host byte order).  For ICMP errors the
+ *           destination port of the quoted probe.
+ *
+ * dst_port: Destination port of the reply (host byte order).
+ *
+ * protocol: IP protocol number of the reply.
+ *
+ * tcp_flags: The TCP flags byte (FIN, SYN, RST, PSH, ACK, URG), or the code of
+ *            an ICMP error.
+ *
+ * payload_off: Offset of the TCP payload within the frame.
+ *
+ * payload_len: Length of the TCP payload.  Once pushed, the length stored
+ *              with the record, 0 unless the ring keeps payloads.
+ *
+ * seq: The TCP sequence number (host byte order).
+ *
+ * ack: The TCP acknowledgment number (host byte order).
+ *
+ * rx_ns: When the reply was received, or 0 if timings are disabled.
+ */
+struct reply_record {
+    unsigned int src_ip;
+    unsigned short src_port;
+    unsigned short dst_port;
+    unsigned char protocol;
+    unsigned char tcp_flags;
+    unsigned short payload_off;
+    unsigned short payload_len;
+    unsigned int seq;
+    unsigned int ack;
+    unsigned long long rx_ns;
+};
+
+/*
+ * Struct: reply_ring
+ * ------------------
+ * A lock-free single producer, single consumer ring buffer of reply records.
+ * The producer and consumer indexes live on separate cache lines so that the
+ * receive thread and the consumer never write to the same line.
+ *
+ * head: Next slot the producer writes to.  Only written by the producer.
+ *
+ * tail_cache: The producer's last observed value of tail.
+ *
+ * tail: Next slot the consumer reads from.  Only written by the consumer.
+ *
+ * head_cache: The consumer's last observed value of head.
+ *
+ * closed: Set by the producer once it will not push any more records.
+ *
+ * mask: REPLY_RING_SIZE - 1.
+ *
+ * slots: The record storage.
+ *
+ * payloads: Payload storage, payload_size bytes per slot, or NULL if only
+ *           records are kept.
+ *
+ * payload_size: The most payload bytes kept per record.
+ */
+struct reply_ring {
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head;
+    size_t tail_cache;
+
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail;
+    size_t head_cache;
+
+    _Alignas(CACHE_LINE_SIZE) atomic_uchar closed;
+
+    _Alignas(CACHE_LINE_SIZE) size_t mask;
+    struct reply_record *slots;
+    unsigned char *payloads;
+    int payload_size;
+};
+
+/*
+ * Function: reply_ring_create
+ * ---------------------------
+ * Allocates an empty reply ring of REPLY_RING_SIZE slots.
+ *
+ * return: A new reply ring, or NULL on error.
+ */
+struct reply_ring * reply_ring_create();
+
+/*
+ * Function: reply_ring_create_payloads
+ * ------------------------------------
+ * Allocates an empty reply ring that also keeps up to payload_size bytes of
+ * the TCP payload of each record.
+ *
+ * payload_size: The most payload bytes kept per record.
+ *
+ * return: A new reply ring, or NULL on error.
+ */
+struct reply_ring * reply_ring_create_payloads(int payload_size);
+
+/*
+ * Function: reply_ring_free
+ * -------------------------
+ * Frees a reply ring and its slots.
+ *
+ * ring: The ring to free.
+ */
+void reply_ring_free(struct reply_ring *ring);
+
+/*
+ * Function: reply_ring_push
+ * -------------------------
+ * Pushes a record on to the ring.  Must only be called by the producer.
+ *
+ * ring: The reply ring.
+ *
+ * rec: The record to copy in to the ring.
+ *
+ * return: 1 if the record was pushed, or 0 if the ring is full.
+ */
+int reply_ring_push(struct reply_ring *ring, const struct reply_record *rec);
+
+/*
+ * Function: reply_ring_push_payload
+ * ---------------------------------
+ * Pushes a record and, if the ring keeps payloads, up to payload_size bytes
+ * of its payload.  Must only be called by the producer.
+ *
+ * ring: The reply ring.
+ *
+ * rec: The record to copy in to the ring.
+ *
+ * payload: The rec->payload_len bytes of payload, or NULL.
+ *
+ * return: 1 if the record was pushed, or 0 if the ring is full.
+ */
+int reply_ring_push_payload(struct reply_ring *ring, 
+        const struct reply_record *rec, const unsigned char *payload);
+
+/*
+ * Function: reply_ring_pop
+ * ------------------------
+ * Pops the oldest record from the ring.  Must only be called by the consumer.
+ *
+ * ring: The reply ring.
+ *
+ * rec: Populated with the popped record.
+ *
+ * return: 1 if a record was popped, or 0 if the ring is empty.
+ */
+int reply_ring_pop(struct reply_ring *ring, struct reply_record *rec);
+
+/*
+ * Function: reply_ring_pop_payload
+ * --------------------------------
+ * Pops the oldest record and copies its stored payload.  Must only be called
+ * by the consumer.
+ *
+ * ring: The reply ring.
+ *
+ * rec: Populated with the popped record.
+ *
+ * payload: A buffer of at least payload_size bytes, or NULL.
+ *
+ * return: 1 if a record was popped, or 0 if the ring is empty.
+ */
+int reply_ring_pop_payload(struct reply_ring *ring, struct reply_record *rec, 
+        unsigned char *payload);
+
+/*
+ * Function: reply_ring_close
+ * --------------------------
+ * Signals (with release semantics) that the producer has finished pushing.
+ *
+ * ring: The reply ring.
+ */
+void reply_ring_close(struct reply_ring *ring);
+
+/*
+ * Function: reply_ring_consume
+ * ----------------------------
+ * Pops the oldest record and its payload, telling an empty ring apart from
+ * one the producer has closed.  Must only be called by the consumer.
+ *
+ * ring: The reply ring.
+ *
+ * rec: Populated with the popped record.
+ *
+ * payload: A buffer of at least payload_size bytes, or NULL.
+ *
+ * return: 1 if a record was popped, 0 if the ring is currently empty, or -1
+ *         if the ring has been closed and fully drained.
+ */
+int reply_ring_consume(struct reply_ring *ring, struct reply_record *rec, 
+        unsigned char *payload);
+
+#endif
@@ -0,0 +1,368 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <sys/socket.h>
+
+#include "route_service.h"
+#include "arp_service.h"
+#include "neighbor_cache.h"
+#include "network_helper.h"
+
+// Orders routes longest prefix first, then lowest metric
+static int compare_routes(const void *a, const void *b) {
+    const struct route *route_a = (const struct route *)a;
+    const struct route *route_b = (const struct route *)b;
+
+    if (route_a->prefix_len != route_b->prefix_len) {
+        return route_b->prefix_len - route_a->prefix_len;
+    }
+
+    return (route_a->metric > route_b->metric) -
+            (route_a->metric < route_b->metric);
+}
+
+/*
+ * Parses a route message of the dump in to a route.  Returns 1 if it is a
+ * unicast route of the main table, otherwise 0.
+ */
+static int parse_route(const struct nlmsghdr *nlh, struct route *route) {
+    const struct rtmsg *rtm = (const struct rtmsg *)NLMSG_DATA(nlh);
+
+    if (rtm->rtm_family != AF_INET || rtm->rtm_type != RTN_UNICAST) {
+        return 0;
+    }
+
+    memset(route, 0, sizeof(struct route));
+    route->gw_check = -1;
+    route->prefix_len = rtm->rtm_dst_len;
+
+    unsigned int table = rtm->rtm_table;
+    int attrs_len = RTM_PAYLOAD(nlh);
+
+    for (const struct rtattr *rta = RTM_RTA(rtm); RTA_OK(rta, attrs_len);
+            rta = RTA_NEXT(rta, attrs_len)) {
+        const void *data = RTA_DATA(rta);
+
+        switch (rta->rta_type) {
+            case RTA_TABLE:
+                table = *(const unsigned int *)data;
+                break;
+            case RTA_DST:
+                route->prefix = ntohl(*(const unsigned int *)data);
+                break;
+            case RTA_OIF:
+                route->if_index = *(const int *)data;
+                break;
+            case RTA_GATEWAY:
+                route->gateway = *(const unsigned int *)data;
+                break;
+            case RTA_PREFSRC:
+                route->pref_src = *(const unsigned int *)data;
+                break;
+            case RTA_PRIORITY:
+                route->metric = *(const unsigned int *)data;
+                break;
+            case RTA_MULTIPATH: {
+                // Only the first next hop of a multipath route is used
+                const struct rtnexthop *nh = (const struct rtnexthop *)data;
+                int nh_attrs_len = nh->rtnh_len - sizeof(struct rtnexthop);
+
+                route->if_index = nh->rtnh_ifindex;
+
+                for (const struct rtattr *nh_rta = RTNH_DATA(nh);
+                        RTA_OK(nh_rta, nh_attrs_len);
+                        nh_rta = RTA_NEXT(nh_rta, nh_attrs_len)) {
+                    if (nh_rta->rta_type == RTA_GATEWAY) {
+                        route->gateway = *(const unsigned int *)
+                                RTA_DATA(nh_rta);
+                    }
+                }
+
+                break;
+            }
+        }
+    }
+
+    route->mask = route->prefix_len == 0 ? 0 :
+            ~0U << (32 - route->prefix_len);
+    route->prefix &= route->mask;
+
+    return table == RT_TABLE_MAIN && route->if_index > 0;
+}
+
+int load_route_table(struct route_table *table, const char *dev_name) {
+    memset(table, 0, sizeof(struct route_table));
+
+    int dev_index = 0;
+
+    if (dev_name != NULL) {
+        dev_index = (int)if_nametoindex(dev_name);
+
+        if (dev_index == 0) {
+            fprintf(stderr, "ERROR: Cannot get interface index.\n");
+
+            return -1;
+        }
+    }
+
+    int sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+
+    if (sock == -1) {
+        fprintf(stderr, "ERROR: Cannot open netlink socket!\n");
+
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nlh;
+        struct rtmsg rtm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct rtmsg));
+    req.nlh.nlmsg_type = RTM_GETROUTE;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = 1;
+    req.rtm.rtm_family = AF_INET;
+
+    if (send(sock, &req, req.nlh.nlmsg_len, 0) < 0) {
+        fprintf(stderr, "ERROR: Cannot request routing table!\n");
+        close(sock);
+
+        return -1;
+    }
+
+    char *buff = malloc(ROUTE_RECV_BUFF_LEN);
+    int cap = 16;
+    table->routes = malloc(sizeof(struct route) * cap);
+
+    if (buff == NULL || table->routes == NULL) {
+        free(buff);
+        close(sock);
+
+        return -1;
+    }
+
+    int ret = 0;
+    int done = 0;
+
+    while (!done && ret == 0) {
+        int len = recv(sock, buff, ROUTE_RECV_BUFF_LEN, 0);
+
+        if (len <= 0) {
+            ret = -1;
+
+            break;
+        }
+
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *)buff;
+                NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = 1;
+
+                break;
+            }
+
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                ret = -1;
+
+                break;
+            }
+
+            struct route route;
+
+            if (nlh->nlmsg_type != RTM_NEWROUTE ||
+                    !parse_route(nlh, &route) ||
+                    (dev_index != 0 && route.if_index != dev_index)) {
+                continue;
+            }
+
+            if (table->len == cap) {
+                cap *= 2;
+
+                struct route *grown = realloc(table->routes,
+                        sizeof(struct route) * cap);
+
+                if (grown == NULL) {
+                    ret = -1;
+
+                    break;
+                }
+
+                table->routes = grown;
+            }
+
+            table->routes[table->len++] = route;
+        }
+    }
+
+    free(buff);
+    close(sock);
+
+    if (ret < 0) {
+        fprintf(stderr, "ERROR: Cannot read routing table!\n");
+
+        return -1;
+    }
+
+    qsort(table->routes, table->len, sizeof(struct route), compare_routes);
+
+    if (DEBUG >= 1) {
+        printf("Loaded %d routes\n", table->len);
+    }
+
+    return 0;
+}
+
+// Queries the egress interface of a route.  Returns 0 on success, -1 on error.
+static int load_egress(struct route *route) {
+    if (if_indextoname(route->if_index, route->if_name) == NULL) {
+        return -1;
+    }
+
+    // Only used to query the interface, which needs no privileges
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (sock == -1) {
+        return -1;
+    }
+
+    unsigned char *loc_mac = get_mac_address(&sock, route->if_name);
+    struct in_addr *loc_ip = get_ip_address(&sock, route->if_name);
+
+    close(sock);
+
+    if (loc_mac == NULL || (loc_ip == NULL && route->pref_src == 0)) {
+        free(loc_mac);
+        free(loc_ip);
+
+        return -1;
+    }
+
+    memcpy(route->loc_mac, loc_mac, MAC_LEN);
+    route->loc_ip = route->pref_src != 0 ? route->pref_src : loc_ip->s_addr;
+    route->egress_loaded = 1;
+
+    free(loc_mac);
+    free(loc_ip);
+
+    if (DEBUG >= 2) {
+        printf("Route %s/%d leaves %s from %s\n", get_ip_32_str(
+                htonl(route->prefix)), route->prefix_len, route->if_name,
+                get_ip_32_str(route->loc_ip));
+    }
+
+    return 0;
+}
+
+struct route * route_lookup(struct route_table *table, unsigned int ip) {
+    // Routing tables are short, and the routes are in priority order
+    for (int i = 0; i < table->len; i++) {
+        struct route *route = &table->routes[i];
+
+        if ((ip & route->mask) != route->prefix) {
+            continue;
+        }
+
+        if (!route->egress_loaded && load_egress(route) < 0) {
+            return NULL;
+        }
+
+        return route;
+    }
+
+    return NULL;
+}
+
+void route_learn_gateway(struct route_table *table, int if_index,
+        unsigned int gw_ip, const unsigned char *gw_mac) {
+    int learned = 0;
+
+    for (int i = 0; i < table->len; i++) {
+        struct route *route = &table->routes[i];
+
+        if (route->gateway == gw_ip && route->if_index == if_index) {
+            memcpy(route->gw_mac, gw_mac, MAC_LEN);
+            route->gw_resolved = 1;
+            learned = 1;
+        }
+    }
+
+    if (learned && table->neighbors != NULL) {
+        neighbor_cache_store(table->neighbors, gw_ip, if_index, gw_mac);
+    }
+}
+
+const unsigned char * route_gateway_mac(struct route_table *table,
+        struct route *route) {
+    if (route->gateway == 0) {
+        return NULL;
+    }
+
+    // Resolved, or failed to, once per route
+    if (route->gw_resolved != 0) {
+        return route->gw_resolved > 0 ? route->gw_mac : NULL;
+    }
+
+    // A previous run's address is used at once and checked meanwhile
+    if (table->neighbors != NULL && neighbor_cache_lookup(table->neighbors,
+            route->gateway, route->if_index, route->gw_mac) == 0) {
+        int check = neighbor_cache_check(table->neighbors, route->gateway,
+                route->if_index, route->loc_mac, route->loc_ip);
+
+        // Every route through the gateway shares the one check
+        for (int i = 0; i < table->len; i++) {
+            if (table->routes[i].gateway == route->gateway &&
+                    table->routes[i].if_index == route->if_index) {
+                memcpy(table->routes[i].gw_mac, route->gw_mac, MAC_LEN);
+                table->routes[i].gw_resolved = 1;
+                table->routes[i].gw_check = check;
+            }
+        }
+
+        return route->gw_mac;
+    }
+
+    unsigned char *gw_mac = NULL;
+
+    // The kernel keeps the entry of a gateway it routes through fresh
+    char *mac_str = search_arp_table(get_ip_32_str(route->gateway));
+
+    if (mac_str != NULL) {
+        gw_mac = get_mac_from_str(mac_str);
+    } else {
+        gw_mac = get_mac_add_from_ip((const unsigned char *)&route->gateway,
+                route->loc_mac, (const unsigned char *)&route->loc_ip,
+                route->if_index, route->if_name);
+    }
+
+    if (gw_mac == NULL) {
+        route->gw_resolved = -1;
+
+        return NULL;
+    }
+
+    memcpy(route->gw_mac, gw_mac, MAC_LEN);
+    route->gw_resolved = 1;
+
+    if (table->neighbors != NULL) {
+        neighbor_cache_store(table->neighbors, route->gateway,
+                route->if_index, gw_mac);
+    }
+
+    free(gw_mac);
+
+    return route->gw_mac;
+}
+
+void free_route_table(struct route_table *table) {
+    free(table->routes);
+
+    table->routes = NULL;
+    table->len = 0;
+}
@@ -0,0 +1,159 @@
+#ifndef ROUTE_SERVICE_H
+#define ROUTE_SERVICE_H
+
+#include <net/if.h>
+
+#include "../constants/constants.h"
+
+struct neighbor_cache;
+
+// Size of the buffer rtnetlink route dumps are received in
+#define ROUTE_RECV_BUFF_LEN 32768
+
+/*
+ * Struct: route
+ * -------------
+ * A unicast route of the main IPv4 routing table, and what is cached of how
+ * targets are reached through it, so the interface is queried and the
+ * gateway resolved once per prefix however many targets it covers.
+ *
+ * prefix: The destination prefix (host byte order).
+ *
+ * mask: The netmask of the prefix (host byte order).
+ *
+ * prefix_len: The length of the prefix in bits.
+ *
+ * metric: The priority of the route, lower is preferred.
+ *
+ * if_index: The index of the egress interface.
+ *
+ * gateway: The next hop (network byte order), or 0 if the prefix is on-link.
+ *
+ * pref_src: The preferred source address (network byte order), or 0.
+ *
+ * egress_loaded: 1 once if_name, loc_mac and loc_ip are loaded.
+ *
+ * if_name: The name of the egress interface.
+ *
+ * loc_mac: The MAC address of the egress interface.
+ *
+ * loc_ip: The source address of probes sent through the route (network byte
+ *         order), pref_src or else the interface's address.
+ *
+ * gw_resolved: 1 once gw_mac holds the gateway's MAC address, -1 if the
+ *              gateway could not be resolved.
+ *
+ * gw_mac: The MAC address of the gateway.
+ *
+ * gw_check: The background check of a gateway MAC address taken from the
+ *           neighbor cache, or -1.
+ */
+struct route {
+    unsigned int prefix;
+    unsigned int mask;
+    unsigned char prefix_len;
+    unsigned int metric;
+    int if_index;
+    unsigned int gateway;
+    unsigned int pref_src;
+    unsigned char egress_loaded;
+    char if_name[IF_NAMESIZE];
+    unsigned char loc_mac[MAC_LEN];
+    unsigned int loc_ip;
+    signed char gw_resolved;
+    unsigned char gw_mac[MAC_LEN];
+    int gw_check;
+};
+
+/*
+ * Struct: route_table
+ * -------------------
+ * The routes targets are scanned through, longest prefix first and then
+ * lowest metric, so the first route matching a target is the one the kernel
+ * would pick.
+ *
+ * routes: The routes.
+ *
+ * len: The number of routes.
+ *
+ * neighbors: The cache of MAC addresses kept across runs, or NULL.
+ */
+struct route_table {
+    struct route *routes;
+    int len;
+    struct neighbor_cache *neighbors;
+};
+
+/*
+ * Function: load_route_table
+ * --------------------------
+ * Dumps the main IPv4 routing table with rtnetlink.  Policy routing rules
+ * and other tables are not consulted.
+ *
+ * table: Populated with the routes.  Free it with free_route_table, also on
+ *        error.
+ *
+ * dev_name: Only routes through this interface are kept, or NULL for every
+ *           interface.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int load_route_table(struct route_table *table, const char *dev_name);
+
+/*
+ * Function: route_lookup
+ * ----------------------
+ * Finds the route of a target and loads its egress interface's addresses
+ * the first time it is used.
+ *
+ * table: The routing table.
+ *
+ * ip: The target IPv4 address (host byte order).
+ *
+ * return: The route, or NULL if no route reaches the target or its
+ *         interface cannot be queried.
+ */
+struct route * route_lookup(struct route_table *table, unsigned int ip);
+
+/*
+ * Function: route_learn_gateway
+ * -----------------------------
+ * Records the MAC address a gateway answered ARP with in every route
+ * through it, and in the neighbor cache.
+ *
+ * table: The routing table.
+ *
+ * if_index: The interface the reply was received on.
+ *
+ * gw_ip: The gateway's IP address (network byte order).
+ *
+ * gw_mac: The gateway's MAC address.
+ */
+void route_learn_gateway(struct route_table *table, int if_index,
+        unsigned int gw_ip, const unsigned char *gw_mac);
+
+/*
+ * Function: route_gateway_mac
+ * ---------------------------
+ * Resolves the gateway of a route once, from the neighbor cache, the ARP
+ * table or else with an ARP request, so off-link targets never wait on ARP
+ * requests of their own.  A cached address is checked in the background.
+ *
+ * table: The routing table.
+ *
+ * route: A route returned by route_lookup.
+ *
+ * return: The gateway's MAC address, or NULL if the route is on-link or the
+ *         gateway could not be resolved.
+ */
+const unsigned char * route_gateway_mac(struct route_table *table,
+        struct route *route);
+
+/*
+ * Function: free_route_table
+ * --------------------------
+ * Frees the routes of a table.
+ */
+void free_route_table(struct route_table *table);
+
+#endif
\ No newline at end of file
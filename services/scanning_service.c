@@ -7,19 +7,27 @@
 
 #include <math.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <time.h>
 #include <errno.h>
 
+#include <net/ethernet.h>
+
 #include "scanning_service.h"
 #include "network_helper.h"
-#include "packet_service.h"
+#include "transport_service.h"
 #include "tcp_service.h"
+#include "udp_service.h"
+#include "connect_service.h"
+#include "checkpoint_service.h"
+#include "handshake_service.h"
+#include "histogram_service.h"
 #include "../constants/constants.h"
 
 int scan_ports_raw_multi(const unsigned char *src_ip,
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, int start_port, int end_port, 
-        int inter_index) {
+        int inter_index, struct scan_state *state) {
     if (start_port < 1 || end_port > MAX_PORT) {
         fprintf(stderr, "ERROR: Ports must be between 0 and %d\n", MAX_PORT);
         
@@ -28,7 +36,7 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
 
     if (DEBUG >= 0) {
         printf("Commencing multithreaded scan of target: %s\n", 
-                get_ip_arr_str(tar_ip));
+                get_family_ip_str(state->family, tar_ip));
     }
 
     pthread_t tid;
@@ -36,7 +44,7 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
     struct scan_raw_port_args *args = malloc(sizeof(struct scan_raw_port_args));
     memset(args, 0, sizeof(struct scan_raw_port_args));
 
-    unsigned char finished = 0;
+    atomic_uchar finished = 0;
 
     args->src_ip = src_ip;
     args->tar_ip = tar_ip;
@@ -47,14 +55,44 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
     args->start_port = start_port;
     args->end_port = end_port;
     args->finished = &finished;
+    args->state = state;
 
     if (args->end_port > MAX_PORT)
         args->end_port = MAX_PORT;
 
+    state->probes_len = args->end_port - args->start_port + 1;
+
+    // Listen before the first probe is sent so no reply can be missed
+    struct transport *listen_t = transport_open(inter_index, src_mac, 
+            state->family == AF_INET6 ? ETH_P_IPV6 : ETH_P_IP);
+
+    if (listen_t == NULL) {
+        free(args);
+
+        return -1;
+    }
+
     pthread_create(&tid, NULL, scan_ports_raw_proxy, (void *)args);
 
     struct open_ports_dto *open_ports = 
-            listen_for_ACK_replies(tar_ip, src_mac, &finished);
+            listen_for_ACK_replies(src_ip, tar_ip, src_mac, listen_t, 
+            &finished, state);
+
+    pthread_join(tid, NULL);
+    transport_close(listen_t);
+
+    finish_checkpoint(state);
+
+    // Probes which were sent but never answered
+    if (!scan_interrupted(state)) {
+        for (int port = start_port; 
+                port < start_port + (int)atomic_load(&state->cursor); port++) {
+            if (state->port_states[port] == PORT_STATE_UNKNOWN) {
+                state->port_states[port] = PORT_STATE_FILTERED;
+                stats_inc(&state->stats.consumer.filtered);
+            }
+        }
+    }
 
     // An error occurred
     if (open_ports == NULL) {
@@ -69,15 +107,16 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
 int scan_ports_raw_arr_multi(const unsigned char *src_ip, 
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, const unsigned short *ports, 
-        int ports_len, int inter_index) {
+        int ports_len, int inter_index, struct scan_state *state) {
     if (DEBUG >= 0) {
-        printf("Commencing scan of target: %s\n", get_ip_arr_str(tar_ip));
+        printf("Commencing scan of target: %s\n", 
+                get_family_ip_str(state->family, tar_ip));
     }
 
     pthread_t tid;
 
     // Value shared between threads to indicate when the port scan has finished
-    unsigned char finished = 0;
+    atomic_uchar finished = 0;
 
     struct scan_raw_arr_args *args = malloc(sizeof(struct scan_raw_arr_args));
     memset(args, 0, sizeof(struct scan_raw_arr_args));
@@ -92,11 +131,40 @@ int scan_ports_raw_arr_multi(const unsigned char *src_ip,
     args->ports_len = ports_len;
 
     args->finished = &finished;
+    args->state = state;
+
+    state->probes_len = ports_len;
+
+    // Listen before the first probe is sent so no reply can be missed
+    struct transport *listen_t = transport_open(inter_index, src_mac, 
+            state->family == AF_INET6 ? ETH_P_IPV6 : ETH_P_IP);
+
+    if (listen_t == NULL) {
+        free(args);
+
+        return -1;
+    }
 
     pthread_create(&tid, NULL, scan_ports_raw_arr_proxy, (void *) args);
 
     struct open_ports_dto *open_ports = 
-            listen_for_ACK_replies(tar_ip, src_mac, &finished);
+            listen_for_ACK_replies(src_ip, tar_ip, src_mac, listen_t, 
+            &finished, state);
+
+    pthread_join(tid, NULL);
+    transport_close(listen_t);
+
+    finish_checkpoint(state);
+
+    // Probes which were sent but never answered
+    if (!scan_interrupted(state)) {
+        for (int i = 0; i < (int)atomic_load(&state->cursor); i++) {
+            if (state->port_states[ports[i]] == PORT_STATE_UNKNOWN) {
+                state->port_states[ports[i]] = PORT_STATE_FILTERED;
+                stats_inc(&state->stats.consumer.filtered);
+            }
+        }
+    }
 
     // Error occurred during scan
     if (open_ports == NULL) {
@@ -116,14 +184,19 @@ void * scan_ports_raw_arr_proxy(void *scan_args) {
     }
 
     scan_ports_raw_arr(args->src_ip, args->tar_ip, args->src_mac, args->tar_mac, 
-            args->ports, args->ports_len, args->inter_index);
+            args->ports, args->ports_len, args->inter_index, args->state);
 
     // Sleep for 5 seconds and then signal all packets were sent
-    sleep(SLEEP_S_AFTER_FINISH);
-    *(args->finished) = 1;
+    unsigned long long drain_start = get_time_ns();
+
+    sleep_after_finish(args->state);
+    record_phase(PHASE_DRAIN, drain_start);
+    atomic_store_explicit(args->finished, 1, memory_order_release);
 
     // Garbage collection
     free(scan_args);
+
+    return NULL;
 }
 
 void * scan_ports_raw_proxy(void *scan_args) {
@@ -134,18 +207,136 @@ void * scan_ports_raw_proxy(void *scan_args) {
     }
 
     scan_ports_raw(args->src_ip, args->tar_ip, args->src_mac, args->tar_mac,
-            args->start_port, args->end_port, args->inter_index);
+            args->start_port, args->end_port, args->inter_index, args->state);
 
-    sleep(SLEEP_S_AFTER_FINISH);
-    *(args->finished) = 1;
+    unsigned long long drain_start = get_time_ns();
+
+    sleep_after_finish(args->state);
+    record_phase(PHASE_DRAIN, drain_start);
+    atomic_store_explicit(args->finished, 1, memory_order_release);
 
     // Garbage collection
     free(scan_args);
+
+    return NULL;
+}
+
+/*
+ * Struct: syn_source
+ * ------------------
+ * Builds the SYN probes of a scan.  IPv4 probes are constructed from the 
+ * address strings and freed once sent.  IPv6 probes are stamped from a 
+ * template in to one buffer per batch slot.  With a handshake, IPv4 probes
+ * are sent from the stateless source ports with SYN cookie sequence numbers.
+ */
+struct syn_source {
+    char *src_ip_str;
+    char *tar_ip_str;
+    const unsigned char *src_mac;
+    const unsigned char *tar_mac;
+    struct syn6_template *tmpl6;
+    unsigned char (*buffs6)[SYN6_FRAME_LEN];
+    const struct handshake *hs;
+    atomic_ushort *src_ports;
+};
+
+static void syn_source_init(struct syn_source *src, 
+        const unsigned char *src_ip, const unsigned char *tar_ip, 
+        const unsigned char *src_mac, const unsigned char *tar_mac, 
+        const struct scan_state *state) {
+    memset(src, 0, sizeof(struct syn_source));
+
+    src->src_mac = src_mac;
+    src->tar_mac = tar_mac;
+    src->hs = state->handshake;
+    src->src_ports = state->probe_src_ports;
+
+    if (state->family == AF_INET6) {
+        src->tmpl6 = malloc(sizeof(struct syn6_template));
+        src->buffs6 = malloc(TRANSPORT_BATCH * SYN6_FRAME_LEN);
+
+        init_syn6_template(src->tmpl6, src_ip, tar_ip, src_mac, tar_mac);
+    } else {
+        // The frame builder takes the addresses as strings
+        src->src_ip_str = get_ip_arr_str(src_ip);
+        src->tar_ip_str = get_ip_arr_str(tar_ip);
+    }
+}
+
+static void syn_source_build(struct syn_source *src, int slot, 
+        unsigned short src_port, unsigned short dst_port, 
+        struct transport_frame *frame) {
+    if (src->hs != NULL) {
+        src_port = handshake_src_port(src_port);
+    }
+
+    // Recorded before sending, an ICMP error about the probe can arrive first
+    atomic_store_explicit(&src->src_ports[dst_port], src_port, 
+            memory_order_relaxed);
+
+    if (src->tmpl6 != NULL) {
+        frame->data = src->buffs6[slot];
+        frame->len = stamp_syn6_probe(src->tmpl6, src_port, dst_port, 
+                src->buffs6[slot]);
+
+        return;
+    }
+
+    unsigned char *packet = construct_syn_packet(src->src_ip_str, 
+            src->tar_ip_str, src->src_mac, src->tar_mac, src_port, dst_port);
+
+    if (src->hs != NULL) {
+        stamp_syn_cookie(packet, syn_cookie(src->hs, src_port, dst_port));
+    }
+
+    frame->data = packet;
+    frame->len = 64;
+}
+
+static void syn_source_free(struct syn_source *src) {
+    free(src->src_ip_str);
+    free(src->tar_ip_str);
+    free(src->tmpl6);
+    free(src->buffs6);
+}
+
+/*
+ * Function: send_probe_batch
+ * --------------------------
+ * Sends a batch of SYN probes and frees the ones the source allocated.
+ *
+ * return: 0 on success, -1 if any probe could not be sent.
+ */
+static int send_probe_batch(struct transport *t, 
+        struct transport_frame *frames, int frames_len, 
+        const struct syn_source *src, struct scan_state *state) {
+    int sent = transport_send_batch(t, frames, frames_len);
+
+    for (int i = 0; i < frames_len && src->tmpl6 == NULL; i++) {
+        free((void *)frames[i].data);
+    }
+
+    if (sent < frames_len) {
+        fprintf(stderr, "ERROR: Problem sending SYN packet!");
+
+        return -1;
+    }
+
+    for (int i = 0; i < sent; i++) {
+        stats_inc(&state->stats.sender.probes_sent);
+    }
+
+    if (DEBUG >= 3) {
+        printf("Successfully sent %d SYN packets\n", sent);
+    }
+
+    return 0;
 }
 
 int scan_ports_raw(const unsigned char *src_ip, const unsigned char *tar_ip, 
         const unsigned char *src_mac, const unsigned char *tar_mac,
-        int start_port, int end_port, int inter_index) {
+        int start_port, int end_port, int inter_index, 
+        struct scan_state *state) {
     if (start_port < 1 || end_port > MAX_PORT) {
         fprintf(stderr, "ERROR: Ports must be between 0 and %d\n", MAX_PORT);
         
@@ -157,106 +348,561 @@ int scan_ports_raw(const unsigned char *src_ip, const unsigned char *tar_ip,
                 start_port, end_port);
     }
 
-    int sock_raw;
-
     // Sleep time inbetween sending packets in microseconds
     //const int SLEEP_TIME_MICS = 1000 * 1000 * 0.000000001;
     const int SLEEP_TIME_MICS = 0;
 
-    for (int curr_port = start_port; curr_port <= end_port; curr_port++) {
-        // Randomise source port
-        int src_port = get_random_port_num();
+    // Probes are sent in batches unless they are paced
+    const int BATCH_LEN = SLEEP_TIME_MICS > 0 ? 1 : TRANSPORT_BATCH;
 
-        // Raw socket
-        sock_raw = socket(AF_PACKET, SOCK_RAW, IPPROTO_RAW);
+    struct transport *t = transport_open(inter_index, src_mac, 0);
 
-        if (sock_raw < 0) {
-            return -1;
+    if (t == NULL) {
+        return -1;
+    }
+
+    struct transport_frame frames[TRANSPORT_BATCH];
+    int frames_len = 0;
+    int ret = 0;
+
+    struct syn_source src;
+    syn_source_init(&src, src_ip, tar_ip, src_mac, tar_mac, state);
+
+    unsigned long long send_start = get_time_ns();
+
+    // Skip the probes already sent before a checkpoint
+    int first_port = start_port + atomic_load(&state->cursor);
+
+    seed_random_port_num(state->seed, first_port - start_port);
+
+    for (int curr_port = first_port; curr_port <= end_port; curr_port++) {
+        if (scan_interrupted(state)) {
+            break;
         }
 
+        // Randomise source port
+        int src_port = get_random_port_num();
+
         // Construct the TCP SYN packet
-        unsigned char* packet = construct_syn_packet(get_ip_arr_str(src_ip), 
-                get_ip_arr_str(tar_ip), src_mac, tar_mac, src_port, curr_port);
+        syn_source_build(&src, frames_len, src_port, curr_port, 
+                &frames[frames_len]);
+        frames_len++;
         
-        int send_len = send_packet(packet, 64, sock_raw, inter_index, src_mac);
-
-        free(packet);
-        close(sock_raw);
+        // Stamped before sending as the reply can arrive before send returns
+        if (state->probe_sent_ns != NULL) {
+            atomic_store_explicit(&state->probe_sent_ns[curr_port], 
+                    get_time_ns(), memory_order_relaxed);
+        }
 
-        if (send_len < 0) {
-            fprintf(stderr, "ERROR: Problem sending SYN packet!");
-            
-            return -1;
+        if (frames_len < BATCH_LEN && curr_port < end_port) {
+            continue;
         }
 
-        if (DEBUG >= 3) {
-            printf("Successfully sent SYN packet to %s:%d\n", 
-                    get_ip_arr_str(tar_ip), curr_port);
+        ret = send_probe_batch(t, frames, frames_len, &src, state);
+        frames_len = 0;
+
+        if (ret < 0) {
+            break;
         }
 
+        atomic_store_explicit(&state->cursor, curr_port - start_port + 1, 
+                memory_order_relaxed);
+
         usleep(SLEEP_TIME_MICS);
     }
 
-    return 0;
+    // Probes built before an interrupt are still sent
+    if (frames_len > 0) {
+        ret = send_probe_batch(t, frames, frames_len, &src, state);
+
+        if (ret == 0) {
+            atomic_fetch_add_explicit(&state->cursor, frames_len, 
+                    memory_order_relaxed);
+        }
+    }
+
+    transport_close(t);
+    syn_source_free(&src);
+
+    record_phase(PHASE_SEND, send_start);
+
+    return ret;
 }
 
 int scan_ports_raw_arr(const unsigned char *src_ip, 
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, const unsigned short *ports, 
-        int ports_len, int inter_index) {
+        int ports_len, int inter_index, struct scan_state *state) {
     if (DEBUG >= 3)
         printf("Scanning host: %s: \n", get_ip_arr_str(src_ip));
 
-    int sock_raw;
+    // Sleep time inbetween sending packets in microseconds.  Probes written
+    // to a pcap file never reach a network, so they are not paced.
+    const int SLEEP_TIME_MICS = transport_get_kind() == TRANSPORT_PCAP ? 0 : 
+            1000 * 1000 * 0.1;
 
-    // Sleep time inbetween sending packets in microseconds
-    const int SLEEP_TIME_MICS = 1000 * 1000 * 0.1;
+    // Probes are sent in batches unless they are paced
+    const int BATCH_LEN = SLEEP_TIME_MICS > 0 ? 1 : TRANSPORT_BATCH;
 
-    for (int i = 0; i < ports_len; i++) {
-        int src_port = get_random_port_num();
-        int curr_port = ports[i];
+    struct transport *t = transport_open(inter_index, src_mac, 0);
 
-        // Raw socket
-        sock_raw = socket(AF_PACKET, SOCK_RAW, IPPROTO_RAW);
+    if (t == NULL) {
+        return -1;
+    }
 
-        if (sock_raw < 0) {
-            return -1;
+    struct transport_frame frames[TRANSPORT_BATCH];
+    int frames_len = 0;
+    int ret = 0;
+
+    struct syn_source src;
+    syn_source_init(&src, src_ip, tar_ip, src_mac, tar_mac, state);
+
+    unsigned long long send_start = get_time_ns();
+
+    // Skip the probes already sent before a checkpoint
+    int first_probe = atomic_load(&state->cursor);
+
+    seed_random_port_num(state->seed, first_probe);
+
+    for (int i = first_probe; i < ports_len; i++) {
+        if (scan_interrupted(state)) {
+            break;
         }
 
+        int src_port = get_random_port_num();
+        int curr_port = ports[i];
+
         // Construct the TCP SYN packet
-        unsigned char* packet = construct_syn_packet(get_ip_arr_str(src_ip),
-                get_ip_arr_str(tar_ip), src_mac, tar_mac, src_port, curr_port);
+        syn_source_build(&src, frames_len, src_port, curr_port, 
+                &frames[frames_len]);
+        frames_len++;
         
-        int send_len = send_packet(packet, 64, sock_raw, inter_index, src_mac);
+        // Stamped before sending as the reply can arrive before send returns
+        if (state->probe_sent_ns != NULL) {
+            atomic_store_explicit(&state->probe_sent_ns[curr_port], 
+                    get_time_ns(), memory_order_relaxed);
+        }
+
+        if (frames_len < BATCH_LEN && i < ports_len - 1) {
+            continue;
+        }
+
+        ret = send_probe_batch(t, frames, frames_len, &src, state);
+        frames_len = 0;
+
+        if (ret < 0) {
+            break;
+        }
+
+        atomic_store_explicit(&state->cursor, i + 1, memory_order_relaxed);
+
+        usleep(SLEEP_TIME_MICS);
+    }
+
+    // Probes built before an interrupt are still sent
+    if (frames_len > 0) {
+        ret = send_probe_batch(t, frames, frames_len, &src, state);
+
+        if (ret == 0) {
+            atomic_fetch_add_explicit(&state->cursor, frames_len, 
+                    memory_order_relaxed);
+        }
+    }
+
+    transport_close(t);
+    syn_source_free(&src);
+
+    record_phase(PHASE_SEND, send_start);
+
+    return ret;
+}
+
+/*
+ * Struct: udp_host_sender
+ * -----------------------
+ * The thread sending the probes of one target of a UDP scan of several.
+ *
+ * running: The number of targets whose probes are still being sent.
+ *
+ * finished: Set by the last target to finish, to stop the listener.
+ */
+struct udp_host_sender {
+    const struct udp_host *host;
+    const unsigned short *ports;
+    int ports_len;
+    atomic_int *running;
+    atomic_uchar *finished;
+    pthread_t tid;
+};
+
+static void finish_udp_host(struct udp_host_sender *sender) {
+    if (atomic_fetch_sub_explicit(sender->running, 1, 
+            memory_order_acq_rel) == 1) {
+        atomic_store_explicit(sender->finished, 1, memory_order_release);
+    }
+}
+
+static void * send_udp_host(void *sender_args) {
+    struct udp_host_sender *sender = (struct udp_host_sender *)sender_args;
+    const struct udp_host *host = sender->host;
+
+    if (DEBUG >= 3) {
+        printf("UDP packet sending thread created\n");
+    }
+
+    scan_udp_ports(host->src_ip, host->tar_ip, host->src_mac, host->tar_mac, 
+            sender->ports, sender->ports_len, host->inter_index, host->state);
+
+    // Every round already waited for its replies
+    finish_udp_host(sender);
+
+    return NULL;
+}
+
+int scan_udp_hosts_multi(const struct udp_host *hosts, int hosts_len, 
+        const unsigned short *ports, int ports_len) {
+    struct scan_state *states[UDP_PARALLEL_HOSTS];
+
+    for (int i = 0; i < hosts_len; i++) {
+        if (DEBUG >= 0) {
+            printf("Commencing UDP scan of target: %s\n", 
+                    get_ip_arr_str(hosts[i].tar_ip));
+        }
+
+        states[i] = hosts[i].state;
+        states[i]->probes_len = ports_len;
+    }
+
+    // Listen before the first probe is sent so no reply can be missed
+    struct transport *listen_t = transport_open(hosts[0].inter_index, 
+            hosts[0].src_mac, ETH_P_IP);
 
-        close(sock_raw);
-        free(packet);
+    if (listen_t == NULL) {
+        return -1;
+    }
 
-        if (send_len < 0) {
-            fprintf(stderr, "ERROR: Problem sending SYN packet!");
+    // Value shared between threads to indicate when the port scan has finished
+    atomic_uchar finished;
+    atomic_int running;
+
+    atomic_init(&finished, 0);
+    atomic_init(&running, hosts_len);
+
+    // Each target is paced on its own, so one that rate limits its ICMP
+    // errors does not hold back the others
+    struct udp_host_sender senders[UDP_PARALLEL_HOSTS];
+
+    for (int i = 0; i < hosts_len; i++) {
+        senders[i].host = &hosts[i];
+        senders[i].ports = ports;
+        senders[i].ports_len = ports_len;
+        senders[i].running = &running;
+        senders[i].finished = &finished;
+
+        if (pthread_create(&senders[i].tid, NULL, send_udp_host, 
+                (void *)&senders[i]) != 0) {
+            fprintf(stderr, "ERROR: Cannot start UDP sending thread!\n");
+            senders[i].host = NULL;
+            finish_udp_host(&senders[i]);
+        }
+    }
+
+    struct open_ports_dto *open_ports[UDP_PARALLEL_HOSTS];
+
+    int ret = listen_for_udp_replies(hosts[0].src_ip, hosts[0].src_mac, 
+            listen_t, &finished, states, hosts_len, open_ports);
+
+    for (int i = 0; i < hosts_len; i++) {
+        if (senders[i].host != NULL) {
+            pthread_join(senders[i].tid, NULL);
+        }
+    }
+
+    transport_close(listen_t);
+
+    for (int i = 0; i < hosts_len; i++) {
+        struct scan_state *state = states[i];
+
+        // Probes which were sent but never answered
+        int no_reply = 0;
+
+        if (!scan_interrupted(state)) {
+            for (int j = 0; j < ports_len; j++) {
+                if (state->port_states[ports[j]] == PORT_STATE_UNKNOWN) {
+                    state->port_states[ports[j]] = PORT_STATE_FILTERED;
+                    stats_inc(&state->stats.consumer.filtered);
+                    no_reply++;
+                }
+            }
+        }
+
+        // Error occurred during scan
+        if (ret < 0) {
+            continue;
+        }
+
+        if (hosts_len > 1) {
+            printf("\nResults of target: %s\n", 
+                    get_ip_arr_str(hosts[i].tar_ip));
+        }
+
+        print_open_ports(open_ports[i]->open_ports, 
+                open_ports[i]->open_ports_len);
+
+        if (no_reply > 0) {
+            printf("%d port(s) did not reply and are open|filtered\n", 
+                    no_reply);
+        }
+
+        free(open_ports[i]->open_ports);
+        free(open_ports[i]);
+    }
+
+    return ret;
+}
+
+int scan_udp_ports_multi(const unsigned char *src_ip, 
+        const unsigned char *tar_ip, const unsigned char *src_mac,
+        const unsigned char *tar_mac, const unsigned short *ports, 
+        int ports_len, int inter_index, struct scan_state *state) {
+    struct udp_host host;
+
+    host.src_ip = src_ip;
+    host.tar_ip = tar_ip;
+    host.src_mac = src_mac;
+    host.tar_mac = tar_mac;
+    host.inter_index = inter_index;
+    host.state = state;
+
+    return scan_udp_hosts_multi(&host, 1, ports, ports_len);
+}
+
+int scan_ports_connect(const unsigned char *tar_ip, 
+        const unsigned short *ports, int ports_len, struct scan_state *state) {
+    if (DEBUG >= 0) {
+        printf("Commencing connect() scan of target: %s\n", 
+                get_family_ip_str(state->family, tar_ip));
+    }
+
+    state->probes_len = ports_len;
+
+    int max_sockets = raise_nofile_limit(ports_len < CONNECT_MAX_SOCKETS ? 
+            ports_len : CONNECT_MAX_SOCKETS);
+
+    struct open_ports_dto *open_ports = connect_scan_ports(tar_ip, ports, 
+            ports_len, max_sockets, state);
+
+    finish_checkpoint(state);
+
+    // Connections which timed out
+    if (!scan_interrupted(state)) {
+        for (int i = 0; i < (int)atomic_load(&state->cursor); i++) {
+            if (state->port_states[ports[i]] == PORT_STATE_UNKNOWN) {
+                state->port_states[ports[i]] = PORT_STATE_FILTERED;
+                stats_inc(&state->stats.consumer.filtered);
+            }
+        }
+    }
+
+    // Error occurred during scan
+    if (open_ports == NULL) {
+        return -1;
+    }
+
+    print_open_ports(open_ports->open_ports, open_ports->open_ports_len);
+
+    free(open_ports->open_ports);
+    free(open_ports);
+
+    return 0;
+}
+
+/*
+ * Function: send_udp_round
+ * ------------------------
+ * Sends one round of UDP probes at the pacer's rate and waits for replies.
+ *
+ * return: 0 on success, -1 if a probe could not be sent.
+ */
+static int send_udp_round(struct transport *t, 
+        const struct udp_probe_builder *builder, struct udp_pacer *pacer, 
+        const unsigned short *ports, int ports_len, unsigned char first_round,
+        struct scan_state *state) {
+    unsigned char frame_buffs[TRANSPORT_BATCH][UDP_MAX_FRAME];
+    struct transport_frame frames[TRANSPORT_BATCH];
+
+    udp_pacer_start_round(pacer);
+
+    for (int i = 0; i < ports_len && !scan_interrupted(state);) {
+        int batch_len = udp_pacer_take(pacer, ports_len - i < TRANSPORT_BATCH ?
+                ports_len - i : TRANSPORT_BATCH);
+
+        for (int j = 0; j < batch_len; j++) {
+            frames[j].data = frame_buffs[j];
+            frames[j].len = build_udp_probe(builder, get_random_port_num(), 
+                    ports[i + j], frame_buffs[j]);
+
+            if (state->probe_sent_ns != NULL) {
+                atomic_store_explicit(&state->probe_sent_ns[ports[i + j]], 
+                        get_time_ns(), memory_order_relaxed);
+            }
+        }
+
+        if (transport_send_batch(t, frames, batch_len) < batch_len) {
+            fprintf(stderr, "ERROR: Problem sending UDP packet!");
 
             return -1;
         }
 
-        if (DEBUG >= 3) {
-            printf("Successfully sent SYN packet to %s:%d\n", 
-                    get_ip_arr_str(tar_ip), curr_port);
+        for (int j = 0; j < batch_len; j++) {
+            stats_inc(&state->stats.sender.probes_sent);
         }
 
-        usleep(SLEEP_TIME_MICS);
+        i += batch_len;
+
+        if (first_round) {
+            atomic_store_explicit(&state->cursor, i, memory_order_relaxed);
+        }
+    }
+
+    // Wait for the replies of the round, cut short by an interrupt
+    for (int waited_ms = 0; waited_ms < UDP_ROUND_WAIT_MS && 
+            !scan_interrupted(state); waited_ms += 100) {
+        usleep(100 * 1000);
     }
 
     return 0;
 }
 
-unsigned short int get_random_port_num() {
-    static unsigned char seeded = 0;
+int scan_udp_ports(const unsigned char *src_ip, const unsigned char *tar_ip,
+        const unsigned char *src_mac, const unsigned char *tar_mac,
+        const unsigned short *ports, int ports_len, int inter_index, 
+        struct scan_state *state) {
+    char *src_ip_str = get_ip_arr_str(src_ip);
+    char *tar_ip_str = get_ip_arr_str(tar_ip);
+
+    struct udp_probe_builder *builder = malloc(
+            sizeof(struct udp_probe_builder));
+    int ret = init_udp_probe_builder(builder, src_ip_str, tar_ip_str, src_mac,
+            tar_mac);
+
+    free(src_ip_str);
+    free(tar_ip_str);
+
+    if (ret < 0) {
+        free(builder);
+
+        return -1;
+    }
+
+    struct transport *t = transport_open(inter_index, src_mac, 0);
+
+    if (t == NULL) {
+        free_udp_probe_builder(builder);
+        free(builder);
+
+        return -1;
+    }
+
+    // Ports still to probe, every port in the first round
+    unsigned short *pending = malloc(sizeof(unsigned short) * ports_len);
+    memcpy(pending, ports, sizeof(unsigned short) * ports_len);
+
+    int pending_len = ports_len;
+
+    struct udp_pacer pacer;
+    udp_pacer_init(&pacer);
+
+    seed_random_port_num(state->seed, 0);
+
+    unsigned long long send_start = get_time_ns();
 
-    if (seeded == 0) {
-        srand(0);
-        seeded = 1;
+    for (int round = 1; round <= UDP_MAX_ROUNDS && pending_len > 0 && 
+            !scan_interrupted(state); round++) {
+        unsigned long long round_start = get_time_ns();
+
+        ret = send_udp_round(t, builder, &pacer, pending, pending_len, 
+                round == 1, state);
+
+        if (ret < 0) {
+            break;
+        }
+
+        // Keep the ports that are still unanswered
+        int sent_len = pending_len;
+        pending_len = 0;
+
+        for (int i = 0; i < sent_len; i++) {
+            if (__atomic_load_n(&state->port_states[pending[i]], 
+                    __ATOMIC_RELAXED) == PORT_STATE_UNKNOWN) {
+                pending[pending_len++] = pending[i];
+            }
+        }
+
+        int answered = sent_len - pending_len;
+
+        udp_pacer_end_round(&pacer, round, sent_len, answered, 
+                get_time_ns() - round_start);
+
+        // The ports left after a retry round without answers are silent
+        if (round > 1 && answered == 0) {
+            break;
+        }
+    }
+
+    record_phase(PHASE_SEND, send_start);
+
+    transport_close(t);
+    free_udp_probe_builder(builder);
+    free(builder);
+    free(pending);
+
+    return ret;
+}
+
+/*
+ * Returns 1 once every probe sent has been classified, so no reply is still 
+ * outstanding.  Never with a handshake, whose banners follow the SYN-ACKs.
+ */
+static int all_probes_answered(struct scan_state *state) {
+    if (state->handshake != NULL) {
+        return 0;
+    }
+
+    struct scan_stats *stats = &state->stats;
+    unsigned long answered = stats_read(&stats->consumer.open) + 
+            stats_read(&stats->consumer.closed) + 
+            stats_read(&stats->consumer.filtered);
+
+    return answered >= stats_read(&stats->sender.probes_sent);
+}
+
+void sleep_after_finish(struct scan_state *state) {
+    // Time between checks for the last replies in milliseconds
+    const int POLL_MS = 10;
+
+    // Interrupted scans only wait for replies already in flight
+    for (int waited_ms = 0; waited_ms < SLEEP_S_AFTER_FINISH * 1000 && 
+            !scan_interrupted(state) && !all_probes_answered(state); 
+            waited_ms += POLL_MS) {
+        usleep(POLL_MS * 1000);
     }
 
+    if (scan_interrupted(state)) {
+        sleep(INTERRUPT_GRACE_S);
+    }
+}
+
+void seed_random_port_num(unsigned int seed, unsigned int skip) {
+    srand(seed);
+
+    // Advance the sequence to where a resumed scan left off
+    for (unsigned int i = 0; i < skip; i++) {
+        rand();
+    }
+}
+
+unsigned short int get_random_port_num() {
     const int START = 100;
     const int END = MAX_PORT;
 
@@ -1,3 +1,7 @@
+#include <stdatomic.h>
+
+#include "checkpoint_service.h"
+
 // Time to sleep after finishing sending all the SYN packets
 #define SLEEP_S_AFTER_FINISH 5
 
@@ -15,7 +19,34 @@ struct scan_raw_port_args {
     int start_port;
     int end_port;
     int inter_index;
-    unsigned char *finished;
+    atomic_uchar *finished;
+    struct scan_state *state;
+};
+
+/*
+ * Struct: udp_host
+ * ----------------
+ * A target of a UDP scan of several targets at once.
+ * 
+ * src_ip: The source IP address in array format.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * src_mac: The source MAC address in array format.
+ * 
+ * tar_mac: The target MAC address in array format.
+ * 
+ * inter_index: The network interface index.
+ * 
+ * state: The scan state of the target.
+ */
+struct udp_host {
+    const unsigned char *src_ip;
+    const unsigned char *tar_ip;
+    const unsigned char *src_mac;
+    const unsigned char *tar_mac;
+    int inter_index;
+    struct scan_state *state;
 };
 
 struct scan_raw_arr_args {
@@ -26,7 +57,8 @@ struct scan_raw_arr_args {
     const unsigned short *ports;
     int ports_len;
     int inter_index;
-    unsigned char *finished;    
+    atomic_uchar *finished;
+    struct scan_state *state;
 };
 
 /*
@@ -38,7 +70,8 @@ struct scan_raw_arr_args {
  * 
  * src_ip: The source IP address in array format.
  * 
- * tar_ip: The target IP address in array format.
+ * tar_ip: The target IP address in array format.  Both addresses are IPv6
+ *         when the scan state's family is AF_INET6.
  * 
  * src_mac: The source MAC address in array format.
  * 
@@ -50,12 +83,14 @@ struct scan_raw_arr_args {
  * 
  * inter_index: The network interface index.
  * 
+ * state: The scan state used to resume from and checkpoint to.
+ * 
  * return: -1 for error and 0 for success.
  */
 int scan_ports_raw_multi(const unsigned char *src_ip,
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, int start_port, int end_port, 
-        int inter_index);
+        int inter_index, struct scan_state *state);
 
 /*
  * Function: scan_ports_raw_arr_multi
@@ -66,7 +101,8 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
  * 
  * src_ip: The source IP address in array format.
  * 
- * tar_ip: The target IP address in array format.
+ * tar_ip: The target IP address in array format.  Both addresses are IPv6
+ *         when the scan state's family is AF_INET6.
  * 
  * src_mac: The source MAC address in array format.
  * 
@@ -78,12 +114,14 @@ int scan_ports_raw_multi(const unsigned char *src_ip,
  * 
  * inter_index: The network interface number.
  * 
+ * state: The scan state used to resume from and checkpoint to.
+ * 
  * return: -1 for error, 0 for success.
  */
 int scan_ports_raw_arr_multi(const unsigned char *src_ip, 
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, const unsigned short *ports, 
-        int ports_len, int inter_index);
+        int ports_len, int inter_index, struct scan_state *state);
 
 /*
  * Function: scan_ports_raw_arr_proxy
@@ -117,7 +155,8 @@ void * scan_ports_raw_proxy(void *scan_args);
  * 
  * src_ip: The source IP address in array format.
  * 
- * tar_ip: The target IP address in array format.
+ * tar_ip: The target IP address in array format.  Both addresses are IPv6
+ *         when the scan state's family is AF_INET6.
  * 
  * src_mac: The source MAC address in array format.
  * 
@@ -129,11 +168,15 @@ void * scan_ports_raw_proxy(void *scan_args);
  * 
  * inter_index: The network interface index.
  * 
+ * state: The scan state.  Sending starts at its cursor, which is advanced
+ *        after every probe.
+ * 
 * return: an integer with 0 representing success and -1 as error.
  */
 int scan_ports_raw(const unsigned char *src_ip, const unsigned char *tar_ip, 
         const unsigned char *src_mac, const unsigned char *tar_mac,
-        int start_port, int end_port, int inter_index);
+        int start_port, int end_port, int inter_index, 
+        struct scan_state *state);
 
 /*
  * Function: scan_ports_raw_arr
@@ -142,7 +185,8 @@ int scan_ports_raw(const unsigned char *src_ip, const unsigned char *tar_ip,
  * 
  * src_ip: The source IP address in array format.
  * 
- * tar_ip: The target IP address in array format.
+ * tar_ip: The target IP address in array format.  Both addresses are IPv6
+ *         when the scan state's family is AF_INET6.
  * 
  * src_mac: The source MAC address.
  * 
@@ -158,12 +202,131 @@ int scan_ports_raw(const unsigned char *src_ip, const unsigned char *tar_ip,
  * 
  * inter_index: The network interface index.
  * 
+ * state: The scan state.  Sending starts at its cursor, which is advanced
+ *        after every probe.
+ * 
  * return: an integer with 0 representing success and -1 as error.
  */
 int scan_ports_raw_arr(const unsigned char *src_ip,
         const unsigned char *tar_ip, const unsigned char *src_mac,
         const unsigned char *tar_mac, const unsigned short *ports,
-        int ports_len, int inter_index);
+        int ports_len, int inter_index, struct scan_state *state);
+
+/*
+ * Function: scan_ports_connect
+ * ----------------------------
+ * Scans the TCP ports in the ports array with non-blocking connect() calls 
+ * (see connect_scan_ports), which needs no privileges.  Ports whose 
+ * connections time out are recorded as filtered.
+ * 
+ * tar_ip: The target IP address in array format, IPv6 when the scan state's
+ *         family is AF_INET6.
+ * 
+ * ports: The TCP ports to scan.
+ * 
+ * ports_len: The length of the ports array.
+ * 
+ * state: The scan state.
+ * 
+ * return: -1 for error, 0 for success.
+ */
+int scan_ports_connect(const unsigned char *tar_ip, 
+        const unsigned short *ports, int ports_len, struct scan_state *state);
+
+/*
+ * Function: scan_udp_hosts_multi
+ * ------------------------------
+ * Scans the UDP ports of several targets at once, as scan_udp_ports_multi 
+ * does for one.  Each target's probes are sent and paced by a thread of its
+ * own, so the wait for one target's rate limited ICMP errors overlaps the 
+ * others', and one listener on this thread classifies the replies of all of 
+ * them.  The results are printed per target once every target is done.
+ * 
+ * hosts: The targets, all reached through the interface and from the local
+ *        address of the first.
+ * 
+ * hosts_len: The number of targets, between 1 and UDP_PARALLEL_HOSTS.
+ * 
+ * ports: The UDP ports to scan on every target.
+ * 
+ * ports_len: The length of the ports array.
+ * 
+ * return: -1 for error, 0 for success.
+ */
+int scan_udp_hosts_multi(const struct udp_host *hosts, int hosts_len, 
+        const unsigned short *ports, int ports_len);
+
+/*
+ * Function: scan_udp_ports_multi
+ * ------------------------------
+ * Scans the UDP ports in the ports array, classifying replies on this thread 
+ * while probes are sent from another.  Ports that answer with a datagram are
+ * open, ports that answer with an ICMP port unreachable are closed and other
+ * ICMP unreachables mark a port filtered.  Ports that never answer are
+ * recorded as filtered and reported as open|filtered.
+ * 
+ * src_ip: The source IP address in array format.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * src_mac: The source MAC address in array format.
+ * 
+ * tar_mac: The target MAC address in array format.
+ * 
+ * ports: The UDP ports to scan.
+ * 
+ * ports_len: The length of the ports array.
+ * 
+ * inter_index: The network interface number.
+ * 
+ * state: The scan state.
+ * 
+ * return: -1 for error, 0 for success.
+ */
+int scan_udp_ports_multi(const unsigned char *src_ip, 
+        const unsigned char *tar_ip, const unsigned char *src_mac,
+        const unsigned char *tar_mac, const unsigned short *ports, 
+        int ports_len, int inter_index, struct scan_state *state);
+
+/*
+ * Function: scan_udp_ports
+ * ------------------------
+ * Sends UDP probes to the ports in rounds.  Every round retries the ports 
+ * still unanswered after the previous one, paced by a udp_pacer, until a 
+ * round gets no answers or UDP_MAX_ROUNDS is reached.
+ * 
+ * Arguments are as for scan_udp_ports_multi.
+ * 
+ * return: 0 on success, -1 on error.
+ */
+int scan_udp_ports(const unsigned char *src_ip, const unsigned char *tar_ip,
+        const unsigned char *src_mac, const unsigned char *tar_mac,
+        const unsigned short *ports, int ports_len, int inter_index, 
+        struct scan_state *state);
+
+/*
+ * Function: sleep_after_finish
+ * ----------------------------
+ * Waits for outstanding replies after the last probe was sent.  Waits up to
+ * SLEEP_S_AFTER_FINISH seconds, returning early once every probe has been 
+ * classified open, closed or filtered, or INTERRUPT_GRACE_S if the scan was 
+ * interrupted.
+ * 
+ * state: The scan state.
+ */
+void sleep_after_finish(struct scan_state *state);
+
+/*
+ * Function: seed_random_port_num
+ * ------------------------------
+ * Seeds the source port RNG and skips the first values of the sequence, so a
+ * resumed scan continues with the same source ports.
+ * 
+ * seed: The RNG seed.
+ * 
+ * skip: The number of values to skip.
+ */
+void seed_random_port_num(unsigned int seed, unsigned int skip);
 
 /*
  * Function: get_random_port_num
@@ -0,0 +1,1304 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include <net/if_arp.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+
+#include "sim_service.h"
+#include "arp_service.h"
+#include "ndp_service.h"
+#include "checksum_service.h"
+#include "../constants/constants.h"
+
+static unsigned long long sim_rand(struct sim_target *sim) {
+    // xorshift64*
+    sim->rng ^= sim->rng >> 12;
+    sim->rng ^= sim->rng << 25;
+    sim->rng ^= sim->rng >> 27;
+
+    return sim->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static double sim_rand_unit(struct sim_target *sim) {
+    return (sim_rand(sim) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int sim_lost(struct sim_target *sim) {
+    if (sim->config.loss > 0 && sim_rand_unit(sim) < sim->config.loss) {
+        sim->stats.lost++;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+struct sim_target * sim_create(const struct sim_config *config) {
+    struct sim_target *sim = malloc(sizeof(struct sim_target));
+
+    if (sim == NULL) {
+        return NULL;
+    }
+
+    memset(sim, 0, sizeof(struct sim_target));
+
+    sim->config = *config;
+    sim->rng = config->seed ? config->seed : 0x9E3779B97F4A7C15ULL;
+    sim->default_open = malloc(sizeof(char) * (MAX_PORT + 1));
+    memset(sim->default_open, 0, sizeof(char) * (MAX_PORT + 1));
+    sim->udp_open = malloc(sizeof(char) * (MAX_PORT + 1));
+    memset(sim->udp_open, 0, sizeof(char) * (MAX_PORT + 1));
+    sim->filtered = malloc(sizeof(char) * (MAX_PORT + 1));
+    memset(sim->filtered, 0, sizeof(char) * (MAX_PORT + 1));
+
+    if (config->icmp_rate > 0) {
+        sim->icmp_limits = calloc(SIM_ICMP_LIMIT_SLOTS, 
+                sizeof(struct sim_icmp_limit));
+    }
+
+    return sim;
+}
+
+void sim_free(struct sim_target *sim) {
+    if (sim == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < sim->hosts_len; i++) {
+        if (sim->hosts[i].open_ports != sim->default_open) {
+            free(sim->hosts[i].open_ports);
+        }
+    }
+
+    for (int i = 0; i < sim->hosts6_len; i++) {
+        if (sim->hosts6[i].open_ports != sim->default_open) {
+            free(sim->hosts6[i].open_ports);
+        }
+    }
+
+    free(sim->default_open);
+    free(sim->udp_open);
+    free(sim->filtered);
+    free(sim->icmp_limits);
+    free(sim->events);
+    free(sim);
+}
+
+int sim_parse_ports(const char *ports_str, unsigned char *open_ports) {
+    const char *pos = ports_str;
+
+    while (*pos != '\0') {
+        char *end;
+        long int first = strtol(pos, &end, 10);
+        long int last = first;
+
+        if (end == pos) {
+            return -1;
+        }
+
+        if (*end == '-') {
+            pos = end + 1;
+            last = strtol(pos, &end, 10);
+
+            if (end == pos) {
+                return -1;
+            }
+        }
+
+        if (first < 1 || last > MAX_PORT || first > last) {
+            return -1;
+        }
+
+        for (long int port = first; port <= last; port++) {
+            open_ports[port] = 1;
+        }
+
+        if (*end == ',') {
+            end++;
+        } else if (*end != '\0') {
+            return -1;
+        }
+
+        pos = end;
+    }
+
+    return 0;
+}
+
+/*
+ * Parses an IPv4 address, CIDR block or range in to the next host range.
+ */
+static int sim_parse_host(struct sim_target *sim, char *addr_str) {
+    if (sim->hosts_len >= SIM_MAX_HOSTS) {
+        return -1;
+    }
+
+    struct sim_host *host = &sim->hosts[sim->hosts_len];
+    struct in_addr ip_add;
+
+    char *sep;
+
+    if ((sep = strchr(addr_str, '/')) != NULL) {
+        *sep = '\0';
+
+        long int prefix_len = strtol(sep + 1, NULL, 10);
+
+        if (inet_pton(AF_INET, addr_str, &ip_add) < 1 || prefix_len < 1 ||
+                prefix_len > 32) {
+            return -1;
+        }
+
+        unsigned int mask = (prefix_len == 32) ? 0xFFFFFFFF : 
+                ~(0xFFFFFFFF >> prefix_len);
+
+        host->first_ip = ntohl(ip_add.s_addr) & mask;
+        host->last_ip = host->first_ip | ~mask;
+    } else if ((sep = strchr(addr_str, '-')) != NULL) {
+        *sep = '\0';
+
+        if (inet_pton(AF_INET, addr_str, &ip_add) < 1) {
+            return -1;
+        }
+
+        host->first_ip = ntohl(ip_add.s_addr);
+
+        if (inet_pton(AF_INET, sep + 1, &ip_add) < 1) {
+            return -1;
+        }
+
+        host->last_ip = ntohl(ip_add.s_addr);
+    } else {
+        if (inet_pton(AF_INET, addr_str, &ip_add) < 1) {
+            return -1;
+        }
+
+        host->first_ip = ntohl(ip_add.s_addr);
+        host->last_ip = host->first_ip;
+    }
+
+    if (host->first_ip > host->last_ip) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Parses an IPv6 address or prefix in to the next IPv6 host block.
+ */
+static int sim_parse_host6(struct sim_target *sim, char *addr_str) {
+    if (sim->hosts6_len >= SIM_MAX_HOSTS) {
+        return -1;
+    }
+
+    struct sim_host6 *host = &sim->hosts6[sim->hosts6_len];
+    host->prefix_len = IP6_LEN * 8;
+
+    char *sep;
+
+    if ((sep = strchr(addr_str, '/')) != NULL) {
+        *sep = '\0';
+        host->prefix_len = (int)strtol(sep + 1, NULL, 10);
+    }
+
+    if (inet_pton(AF_INET6, addr_str, host->prefix) < 1 || 
+            host->prefix_len < 1 || host->prefix_len > IP6_LEN * 8) {
+        return -1;
+    }
+
+    // Clear the host bits
+    for (int bit = host->prefix_len; bit < IP6_LEN * 8; bit++) {
+        host->prefix[bit / 8] &= ~(0x80 >> (bit % 8));
+    }
+
+    return 0;
+}
+
+int sim_add_hosts(struct sim_target *sim, const char *host_spec) {
+    const int MAX_SPEC_LEN = 64;
+    char addr_str[MAX_SPEC_LEN];
+
+    const char *ports_str = strchr(host_spec, '=');
+    int addr_len = ports_str ? (int)(ports_str - host_spec) : 
+            (int)strlen(host_spec);
+
+    if (addr_len >= MAX_SPEC_LEN) {
+        return -1;
+    }
+
+    memcpy(addr_str, host_spec, addr_len);
+    addr_str[addr_len] = '\0';
+
+    unsigned char is_ip6 = strchr(addr_str, ':') != NULL;
+    int ret = is_ip6 ? sim_parse_host6(sim, addr_str) : 
+            sim_parse_host(sim, addr_str);
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    unsigned char *open_ports = sim->default_open;
+
+    if (ports_str != NULL) {
+        open_ports = malloc(sizeof(char) * (MAX_PORT + 1));
+        memset(open_ports, 0, sizeof(char) * (MAX_PORT + 1));
+
+        if (sim_parse_ports(ports_str + 1, open_ports) < 0) {
+            free(open_ports);
+
+            return -1;
+        }
+    }
+
+    if (is_ip6) {
+        sim->hosts6[sim->hosts6_len++].open_ports = open_ports;
+    } else {
+        sim->hosts[sim->hosts_len++].open_ports = open_ports;
+    }
+
+    return 0;
+}
+
+static struct sim_host * sim_find_host(struct sim_target *sim, 
+        unsigned int ip) {
+    unsigned int host_ip = ntohl(ip);
+
+    for (int i = 0; i < sim->hosts_len; i++) {
+        if (host_ip >= sim->hosts[i].first_ip && 
+                host_ip <= sim->hosts[i].last_ip) {
+            return &sim->hosts[i];
+        }
+    }
+
+    return NULL;
+}
+
+void sim_get_mac(unsigned int ip, unsigned char *mac) {
+    const unsigned char *ip_bytes = (const unsigned char *)&ip;
+
+    mac[0] = SIM_MAC_PREFIX_0;
+    mac[1] = SIM_MAC_PREFIX_1;
+    mac[2] = SIM_MAC_PREFIX_2;
+    mac[3] = ip_bytes[1];
+    mac[4] = ip_bytes[2];
+    mac[5] = ip_bytes[3];
+}
+
+static struct sim_host6 * sim_find_host6(struct sim_target *sim, 
+        const unsigned char *ip) {
+    for (int i = 0; i < sim->hosts6_len; i++) {
+        const struct sim_host6 *host = &sim->hosts6[i];
+        int bytes = host->prefix_len / 8;
+        int bits = host->prefix_len % 8;
+
+        if (memcmp(ip, host->prefix, bytes) != 0) {
+            continue;
+        }
+
+        if (bits == 0 || ((ip[bytes] ^ host->prefix[bytes]) & 
+                (0xFF00 >> bits)) == 0) {
+            return &sim->hosts6[i];
+        }
+    }
+
+    return NULL;
+}
+
+void sim_get_mac6(const unsigned char *ip, unsigned char *mac) {
+    mac[0] = SIM_MAC_PREFIX_0;
+    mac[1] = SIM_MAC_PREFIX_1;
+    mac[2] = SIM_MAC_PREFIX_2;
+    mac[3] = ip[IP6_LEN - 3];
+    mac[4] = ip[IP6_LEN - 2];
+    mac[5] = ip[IP6_LEN - 1];
+}
+
+static void sim_push_event(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long due_ns) {
+    if (sim->events_len == sim->events_cap) {
+        sim->events_cap = sim->events_cap ? sim->events_cap * 2 : 1024;
+        sim->events = realloc(sim->events, 
+                sizeof(struct sim_event) * sim->events_cap);
+    }
+
+    // Sift the new event up the heap
+    int i = sim->events_len++;
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+
+        if (sim->events[parent].due_ns <= due_ns) {
+            break;
+        }
+
+        sim->events[i] = sim->events[parent];
+        i = parent;
+    }
+
+    sim->events[i].due_ns = due_ns;
+    sim->events[i].frame_len = frame_len;
+    memcpy(sim->events[i].frame, frame, frame_len);
+}
+
+static unsigned long long sim_reply_delay(struct sim_target *sim) {
+    long long delay_us = sim->config.rtt_us;
+
+    if (sim->config.jitter_us > 0) {
+        delay_us += (long long)(sim_rand(sim) % 
+                (2ULL * sim->config.jitter_us + 1)) - sim->config.jitter_us;
+    }
+
+    if (delay_us < 0) {
+        delay_us = 0;
+    }
+
+    return (unsigned long long)delay_us * 1000ULL;
+}
+
+static void sim_queue_reply(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long due_ns) {
+    if (sim_lost(sim)) {
+        return;
+    }
+
+    sim_push_event(sim, frame, frame_len, due_ns);
+}
+
+static void sim_handle_arp(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    if (frame_len < ARP_RQ_PSIZE) {
+        return;
+    }
+
+    const struct arphdr *arph = (const struct arphdr *)
+            (frame + sizeof(struct ethhdr));
+    const struct arp_payload *req = (const struct arp_payload *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct arphdr));
+
+    unsigned int tar_ip;
+    memcpy(&tar_ip, req->tar_ip, IP_LEN);
+
+    if (ntohs(arph->ar_op) != ARPOP_REQUEST || 
+            sim_find_host(sim, tar_ip) == NULL) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    unsigned char host_mac[MAC_LEN];
+    sim_get_mac(tar_ip, host_mac);
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, req->src_mac, MAC_LEN);
+    memcpy(eth->h_source, host_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_ARP);
+
+    struct arphdr *rep_arph = (struct arphdr *)(reply + sizeof(struct ethhdr));
+    *rep_arph = *arph;
+    rep_arph->ar_op = htons(ARPOP_REPLY);
+
+    struct arp_payload *rep = (struct arp_payload *)
+            (reply + sizeof(struct ethhdr) + sizeof(struct arphdr));
+    memcpy(rep->src_mac, host_mac, MAC_LEN);
+    memcpy(rep->src_ip, req->tar_ip, IP_LEN);
+    memcpy(rep->tar_mac, req->src_mac, MAC_LEN);
+    memcpy(rep->tar_ip, req->src_ip, IP_LEN);
+
+    sim->stats.arp_replies++;
+    sim_queue_reply(sim, reply, ARP_RQ_PSIZE, now_ns + sim_reply_delay(sim));
+}
+
+static void sim_handle_icmp(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+
+    int ip_len = ntohs(iph->tot_len);
+    int ip_hdr_len = iph->ihl * 4;
+
+    if (ip_len > frame_len - (int)sizeof(struct ethhdr) || 
+            sizeof(struct ethhdr) + ip_len > SIM_MAX_FRAME ||
+            ip_len < ip_hdr_len + (int)sizeof(struct icmphdr)) {
+        return;
+    }
+
+    const struct icmphdr *icmph = (const struct icmphdr *)
+            ((const unsigned char *)iph + ip_hdr_len);
+
+    if (icmph->type != ICMP_ECHO || sim->config.drop_echo) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    int reply_len = sizeof(struct ethhdr) + ip_len;
+
+    memcpy(reply, frame, reply_len);
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac(iph->daddr, eth->h_source);
+
+    struct iphdr *rep_iph = (struct iphdr *)(reply + sizeof(struct ethhdr));
+    rep_iph->saddr = iph->daddr;
+    rep_iph->daddr = iph->saddr;
+    rep_iph->ttl = 64;
+    rep_iph->check = 0;
+    rep_iph->check = checksum_fold(checksum_add(0, rep_iph, ip_hdr_len));
+
+    struct icmphdr *rep_icmph = (struct icmphdr *)
+            ((unsigned char *)rep_iph + ip_hdr_len);
+    rep_icmph->type = ICMP_ECHOREPLY;
+    rep_icmph->checksum = 0;
+    rep_icmph->checksum = checksum_fold(checksum_add(0, rep_icmph, 
+            ip_len - ip_hdr_len));
+
+    sim->stats.echo_replies++;
+    sim_queue_reply(sim, reply, reply_len, now_ns + sim_reply_delay(sim));
+}
+
+static unsigned short sim_tcp_checksum(const struct iphdr *iph, 
+        const struct tcphdr *th, int tcp_len) {
+    struct psheader psh;
+    memset(&psh, 0, sizeof(struct psheader));
+
+    psh.saddr = iph->saddr;
+    psh.daddr = iph->daddr;
+    psh.protocol = IPPROTO_TCP;
+    psh.tcpseglen = htons(tcp_len);
+
+    unsigned long sum = checksum_add(0, &psh, sizeof(struct psheader));
+
+    return checksum_fold(checksum_add(sum, th, tcp_len));
+}
+
+/*
+ * The initial sequence number of a connection, a hash of its addresses and
+ * ports so the scanner's ACK can be checked without keeping connections.
+ */
+static unsigned int sim_isn(const struct sim_target *sim, 
+        const struct iphdr *iph, const struct tcphdr *th) {
+    unsigned long long x = ((unsigned long long)iph->saddr << 32 | 
+            iph->daddr) ^ ((unsigned long long)th->source << 16 | th->dest) ^
+            ((unsigned long long)sim->config.seed << 40);
+
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+
+    return (unsigned int)x;
+}
+
+/*
+ * Cancels the queued SYN-ACK retransmits of the connection a frame belongs
+ * to.
+ */
+static void sim_cancel_tcp(struct sim_target *sim, const struct iphdr *iph,
+        const struct tcphdr *th) {
+    for (int i = 0; i < sim->events_len; i++) {
+        const unsigned char *ev = sim->events[i].frame;
+        const struct iphdr *ev_iph = (const struct iphdr *)
+                (ev + sizeof(struct ethhdr));
+        const struct tcphdr *ev_th = (const struct tcphdr *)
+                (ev + sizeof(struct ethhdr) + sizeof(struct iphdr));
+
+        if (((const struct ethhdr *)ev)->h_proto == htons(ETH_P_IP) &&
+                ev_iph->protocol == IPPROTO_TCP && 
+                ev_iph->saddr == iph->daddr && 
+                ev_th->source == th->dest && ev_th->dest == th->source &&
+                ev_th->syn) {
+            sim->events[i].frame_len = 0;
+        }
+    }
+}
+
+/*
+ * Sends the configured banner in reply to the ACK completing a handshake,
+ * acknowledging any data the ACK carried.
+ */
+static void sim_send_banner(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    int ip_hdr_len = iph->ihl * 4;
+    const struct tcphdr *th = (const struct tcphdr *)
+            ((const unsigned char *)iph + ip_hdr_len);
+
+    int banner_len = strlen(sim->config.banner);
+
+    if (banner_len == 0) {
+        return;
+    }
+
+    int data_len = ntohs(iph->tot_len) - ip_hdr_len - th->doff * 4;
+    int ip_end = sizeof(struct ethhdr) + ntohs(iph->tot_len);
+
+    if (data_len < 0 || ip_end > frame_len) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    const int TCP_LEN = sizeof(struct tcphdr) + banner_len + 2;
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac(iph->daddr, eth->h_source);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *rep_iph = (struct iphdr *)(reply + sizeof(struct ethhdr));
+    rep_iph->version = 4;
+    rep_iph->ihl = 5;
+    rep_iph->tot_len = htons(sizeof(struct iphdr) + TCP_LEN);
+    rep_iph->id = htons((unsigned short)sim_rand(sim));
+    rep_iph->frag_off = htons(IP_DF);
+    rep_iph->ttl = 64;
+    rep_iph->protocol = IPPROTO_TCP;
+    rep_iph->saddr = iph->daddr;
+    rep_iph->daddr = iph->saddr;
+    rep_iph->check = checksum_fold(checksum_add(0, rep_iph, 
+            sizeof(struct iphdr)));
+
+    struct tcphdr *rep_th = (struct tcphdr *)
+            ((unsigned char *)rep_iph + sizeof(struct iphdr));
+    rep_th->source = th->dest;
+    rep_th->dest = th->source;
+    rep_th->seq = th->ack_seq;
+    rep_th->ack_seq = htonl(ntohl(th->seq) + data_len);
+    rep_th->doff = 5;
+    rep_th->psh = 1;
+    rep_th->ack = 1;
+    rep_th->window = htons(64240);
+
+    unsigned char *data = (unsigned char *)rep_th + sizeof(struct tcphdr);
+    memcpy(data, sim->config.banner, banner_len);
+    memcpy(data + banner_len, "\r\n", 2);
+
+    rep_th->check = sim_tcp_checksum(rep_iph, rep_th, TCP_LEN);
+
+    sim->stats.banners++;
+    sim_queue_reply(sim, reply, sizeof(struct ethhdr) + sizeof(struct iphdr) +
+            TCP_LEN, now_ns + sim_reply_delay(sim));
+}
+
+/*
+ * Takes a token from the host's ICMP error bucket, refilled at icmp_rate per
+ * second up to icmp_burst like the kernel's icmp_ratelimit.
+ */
+static int sim_icmp_allowed(struct sim_target *sim, unsigned int ip,
+        unsigned long long now_ns) {
+    if (sim->icmp_limits == NULL) {
+        return 1;
+    }
+
+    struct sim_icmp_limit *limit = 
+            &sim->icmp_limits[ntohl(ip) % SIM_ICMP_LIMIT_SLOTS];
+
+    if (limit->ip != ip || limit->last_ns == 0) {
+        limit->ip = ip;
+        limit->tokens = sim->config.icmp_burst;
+        limit->last_ns = now_ns;
+    }
+
+    limit->tokens += (now_ns - limit->last_ns) / 1e9 * sim->config.icmp_rate;
+    limit->last_ns = now_ns;
+
+    if (limit->tokens > sim->config.icmp_burst) {
+        limit->tokens = sim->config.icmp_burst;
+    }
+
+    if (limit->tokens < 1) {
+        sim->stats.icmp_limited++;
+
+        return 0;
+    }
+
+    limit->tokens -= 1;
+
+    return 1;
+}
+
+/*
+ * Answers a SYN to a filtered port with an ICMP administratively prohibited 
+ * error quoting the IP header and 8 bytes of the segment, as a firewall 
+ * rejecting it would.
+ */
+static void sim_send_prohibited(struct sim_target *sim, 
+        const unsigned char *frame, unsigned long long now_ns) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    int ip_hdr_len = iph->ihl * 4;
+
+    if (!sim_icmp_allowed(sim, iph->daddr, now_ns)) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac(iph->daddr, eth->h_source);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *rep_iph = (struct iphdr *)(reply + sizeof(struct ethhdr));
+    unsigned char *rep_data = (unsigned char *)rep_iph + sizeof(struct iphdr);
+
+    struct icmphdr *icmph = (struct icmphdr *)rep_data;
+    icmph->type = ICMP_DEST_UNREACH;
+    icmph->code = ICMP_PKT_FILTERED;
+
+    int quote_len = ip_hdr_len + 8;
+    memcpy(rep_data + sizeof(struct icmphdr), iph, quote_len);
+
+    int data_len = sizeof(struct icmphdr) + quote_len;
+    icmph->checksum = checksum_fold(checksum_add(0, icmph, data_len));
+
+    rep_iph->version = 4;
+    rep_iph->ihl = 5;
+    rep_iph->tot_len = htons(sizeof(struct iphdr) + data_len);
+    rep_iph->id = htons((unsigned short)sim_rand(sim));
+    rep_iph->ttl = 64;
+    rep_iph->protocol = IPPROTO_ICMP;
+    rep_iph->saddr = iph->daddr;
+    rep_iph->daddr = iph->saddr;
+    rep_iph->check = checksum_fold(checksum_add(0, rep_iph, 
+            sizeof(struct iphdr)));
+
+    sim->stats.prohibited++;
+    sim_queue_reply(sim, reply, sizeof(struct ethhdr) + sizeof(struct iphdr) +
+            data_len, now_ns + sim_reply_delay(sim));
+}
+
+static void sim_handle_tcp(struct sim_target *sim, struct sim_host *host,
+        const unsigned char *frame, int frame_len, unsigned long long now_ns) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    int ip_hdr_len = iph->ihl * 4;
+
+    if (frame_len < (int)(sizeof(struct ethhdr) + ip_hdr_len + 
+            sizeof(struct tcphdr))) {
+        return;
+    }
+
+    const struct tcphdr *th = (const struct tcphdr *)
+            ((const unsigned char *)iph + ip_hdr_len);
+
+    // The scanner's kernel resets the half open connection
+    if (th->rst) {
+        sim_cancel_tcp(sim, iph, th);
+
+        return;
+    }
+
+    unsigned char open = host->open_ports[ntohs(th->dest)];
+
+    // The scanner completed the handshake itself
+    if (!th->syn && th->ack) {
+        if (open && ntohl(th->ack_seq) == sim_isn(sim, iph, th) + 1) {
+            sim_cancel_tcp(sim, iph, th);
+            sim_send_banner(sim, frame, frame_len, now_ns);
+
+            return;
+        }
+    } else if (!th->syn || th->ack) {
+        return;
+    }
+
+    // Any other ACK belongs to no connection, such as an ACK ping
+    unsigned char stray_ack = !th->syn;
+
+    if (!stray_ack && sim->filtered[ntohs(th->dest)]) {
+        sim_send_prohibited(sim, frame, now_ns);
+
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac(iph->daddr, eth->h_source);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *rep_iph = (struct iphdr *)(reply + sizeof(struct ethhdr));
+    rep_iph->version = 4;
+    rep_iph->ihl = 5;
+    rep_iph->tot_len = htons(sizeof(struct iphdr) + sizeof(struct tcphdr));
+    rep_iph->id = htons((unsigned short)sim_rand(sim));
+    rep_iph->frag_off = htons(IP_DF);
+    rep_iph->ttl = 64;
+    rep_iph->protocol = IPPROTO_TCP;
+    rep_iph->saddr = iph->daddr;
+    rep_iph->daddr = iph->saddr;
+    rep_iph->check = checksum_fold(checksum_add(0, rep_iph, 
+            sizeof(struct iphdr)));
+
+    struct tcphdr *rep_th = (struct tcphdr *)
+            ((unsigned char *)rep_iph + sizeof(struct iphdr));
+    rep_th->source = th->dest;
+    rep_th->dest = th->source;
+    rep_th->doff = 5;
+
+    if (stray_ack) {
+        // Reset from the sequence number the ACK acknowledged, like a real
+        // stack
+        rep_th->seq = th->ack_seq;
+        rep_th->rst = 1;
+    } else if (open) {
+        rep_th->seq = htonl(sim_isn(sim, iph, th));
+        rep_th->ack_seq = htonl(ntohl(th->seq) + 1);
+        rep_th->syn = 1;
+        rep_th->ack = 1;
+        rep_th->window = htons(64240);
+    } else {
+        rep_th->ack_seq = htonl(ntohl(th->seq) + 1);
+        rep_th->rst = 1;
+        rep_th->ack = 1;
+    }
+
+    rep_th->check = sim_tcp_checksum(rep_iph, rep_th, sizeof(struct tcphdr));
+
+    int reply_len = sizeof(struct ethhdr) + sizeof(struct iphdr) + 
+            sizeof(struct tcphdr);
+    unsigned long long due_ns = now_ns + sim_reply_delay(sim);
+
+    if (!open || stray_ack) {
+        sim->stats.resets++;
+        sim_queue_reply(sim, reply, reply_len, due_ns);
+
+        return;
+    }
+
+    sim->stats.syn_acks++;
+    sim_queue_reply(sim, reply, reply_len, due_ns);
+
+    // Retransmit with exponential backoff until reset
+    unsigned long long retrans_ns = sim->config.retrans_us * 1000ULL;
+
+    for (int i = 0; i < sim->config.synack_retrans; i++) {
+        due_ns += retrans_ns;
+        retrans_ns *= 2;
+
+        sim_queue_reply(sim, reply, reply_len, due_ns);
+    }
+}
+
+static void sim_handle_udp(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    int ip_hdr_len = iph->ihl * 4;
+
+    if (frame_len < (int)(sizeof(struct ethhdr) + ip_hdr_len + 
+            sizeof(struct udphdr))) {
+        return;
+    }
+
+    const struct udphdr *uh = (const struct udphdr *)
+            ((const unsigned char *)iph + ip_hdr_len);
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac(iph->daddr, eth->h_source);
+    eth->h_proto = htons(ETH_P_IP);
+
+    struct iphdr *rep_iph = (struct iphdr *)(reply + sizeof(struct ethhdr));
+    rep_iph->version = 4;
+    rep_iph->ihl = 5;
+    rep_iph->id = htons((unsigned short)sim_rand(sim));
+    rep_iph->ttl = 64;
+    rep_iph->saddr = iph->daddr;
+    rep_iph->daddr = iph->saddr;
+
+    unsigned char *rep_data = (unsigned char *)rep_iph + sizeof(struct iphdr);
+    int data_len;
+
+    if (sim->udp_open[ntohs(uh->dest)]) {
+        // Open ports answer with an empty datagram
+        struct udphdr *rep_uh = (struct udphdr *)rep_data;
+        rep_uh->source = uh->dest;
+        rep_uh->dest = uh->source;
+        rep_uh->len = htons(sizeof(struct udphdr));
+
+        data_len = sizeof(struct udphdr);
+        rep_iph->protocol = IPPROTO_UDP;
+        sim->stats.udp_replies++;
+    } else {
+        if (!sim_icmp_allowed(sim, iph->daddr, now_ns)) {
+            return;
+        }
+
+        // Port unreachable quoting the IP header and 8 bytes of the datagram
+        struct icmphdr *icmph = (struct icmphdr *)rep_data;
+        icmph->type = ICMP_DEST_UNREACH;
+        icmph->code = ICMP_PORT_UNREACH;
+
+        int quote_len = ip_hdr_len + 8;
+        memcpy(rep_data + sizeof(struct icmphdr), iph, quote_len);
+
+        data_len = sizeof(struct icmphdr) + quote_len;
+        icmph->checksum = checksum_fold(checksum_add(0, icmph, data_len));
+        rep_iph->protocol = IPPROTO_ICMP;
+        sim->stats.port_unreachables++;
+    }
+
+    rep_iph->tot_len = htons(sizeof(struct iphdr) + data_len);
+    rep_iph->check = checksum_fold(checksum_add(0, rep_iph, 
+            sizeof(struct iphdr)));
+
+    sim_queue_reply(sim, reply, sizeof(struct ethhdr) + sizeof(struct iphdr) +
+            data_len, now_ns + sim_reply_delay(sim));
+}
+
+/*
+ * Fills in the ethernet and IPv6 headers of a reply from a virtual host.
+ */
+static void sim_ip6_reply_headers(unsigned char *reply, 
+        const unsigned char *frame, const unsigned char *host_ip, 
+        const struct in6_addr *dst_ip, unsigned short plen, 
+        unsigned char next_header, unsigned char hop_limit) {
+    struct ethhdr *eth = (struct ethhdr *)reply;
+    memcpy(eth->h_dest, ((const struct ethhdr *)frame)->h_source, MAC_LEN);
+    sim_get_mac6(host_ip, eth->h_source);
+    eth->h_proto = htons(ETH_P_IPV6);
+
+    struct ip6_hdr *ip6h = (struct ip6_hdr *)(reply + sizeof(struct ethhdr));
+    ip6h->ip6_flow = htonl(6 << 28);
+    ip6h->ip6_plen = htons(plen);
+    ip6h->ip6_nxt = next_header;
+    ip6h->ip6_hlim = hop_limit;
+    memcpy(&ip6h->ip6_src, host_ip, IP6_LEN);
+    ip6h->ip6_dst = *dst_ip;
+}
+
+static void sim_handle_ns(struct sim_target *sim, const unsigned char *frame,
+        int plen, unsigned long long now_ns) {
+    const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+            (frame + sizeof(struct ethhdr));
+    const struct ndp_message *ns = (const struct ndp_message *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+    // Solicitations are multicast, the host is named by the target address
+    if (plen < (int)offsetof(struct ndp_message, opt_type) ||
+            ip6h->ip6_hlim != 255 || 
+            sim_find_host6(sim, ns->target) == NULL || sim_lost(sim)) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    sim_ip6_reply_headers(reply, frame, ns->target, &ip6h->ip6_src, 
+            sizeof(struct ndp_message), IPPROTO_ICMPV6, 255);
+
+    struct ndp_message *na = (struct ndp_message *)
+            (reply + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+    na->type = NDP_NEIGHBOR_ADVERT;
+    na->flags = htonl(0x60000000);      // Solicited and override
+    memcpy(na->target, ns->target, IP6_LEN);
+    na->opt_type = NDP_OPT_TARGET_LLADDR;
+    na->opt_len = 1;
+    sim_get_mac6(ns->target, na->opt_mac);
+
+    unsigned long sum = ip6_pseudo_sum(ns->target, 
+            (const unsigned char *)&ip6h->ip6_src, sizeof(struct ndp_message), 
+            IPPROTO_ICMPV6);
+    na->checksum = checksum_fold(checksum_add(sum, na, 
+            sizeof(struct ndp_message)));
+
+    sim->stats.neighbor_adverts++;
+    sim_queue_reply(sim, reply, sizeof(struct ethhdr) + 
+            sizeof(struct ip6_hdr) + sizeof(struct ndp_message), 
+            now_ns + sim_reply_delay(sim));
+}
+
+static void sim_handle_icmp6(struct sim_target *sim, 
+        const unsigned char *frame, int plen, unsigned long long now_ns) {
+    const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+            (frame + sizeof(struct ethhdr));
+    const struct icmp6_hdr *icmph = (const struct icmp6_hdr *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+    int reply_len = sizeof(struct ethhdr) + sizeof(struct ip6_hdr) + plen;
+
+    if (plen < (int)sizeof(struct icmp6_hdr) || reply_len > SIM_MAX_FRAME ||
+            icmph->icmp6_type != ICMP6_ECHO_REQUEST) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memcpy(reply, frame, reply_len);
+
+    const unsigned char *host_ip = (const unsigned char *)&ip6h->ip6_dst;
+    sim_ip6_reply_headers(reply, frame, host_ip, &ip6h->ip6_src, plen, 
+            IPPROTO_ICMPV6, 64);
+
+    struct icmp6_hdr *rep_icmph = (struct icmp6_hdr *)
+            (reply + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+    rep_icmph->icmp6_type = ICMP6_ECHO_REPLY;
+    rep_icmph->icmp6_cksum = 0;
+
+    unsigned long sum = ip6_pseudo_sum(host_ip, 
+            (const unsigned char *)&ip6h->ip6_src, plen, IPPROTO_ICMPV6);
+    rep_icmph->icmp6_cksum = checksum_fold(checksum_add(sum, rep_icmph, plen));
+
+    sim->stats.echo_replies++;
+    sim_queue_reply(sim, reply, reply_len, now_ns + sim_reply_delay(sim));
+}
+
+static void sim_handle_tcp6(struct sim_target *sim, struct sim_host6 *host,
+        const unsigned char *frame, int plen, unsigned long long now_ns) {
+    const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+            (frame + sizeof(struct ethhdr));
+    const struct tcphdr *th = (const struct tcphdr *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+    if (plen < (int)sizeof(struct tcphdr)) {
+        return;
+    }
+
+    // The scanner's kernel resets the half open connection
+    if (th->rst) {
+        for (int i = 0; i < sim->events_len; i++) {
+            const unsigned char *ev = sim->events[i].frame;
+            const struct ip6_hdr *ev_ip6h = (const struct ip6_hdr *)
+                    (ev + sizeof(struct ethhdr));
+            const struct tcphdr *ev_th = (const struct tcphdr *)
+                    (ev + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+
+            if (((const struct ethhdr *)ev)->h_proto == htons(ETH_P_IPV6) &&
+                    ev_ip6h->ip6_nxt == IPPROTO_TCP &&
+                    memcmp(&ev_ip6h->ip6_src, &ip6h->ip6_dst, IP6_LEN) == 0 &&
+                    ev_th->source == th->dest && ev_th->dest == th->source) {
+                sim->events[i].frame_len = 0;
+            }
+        }
+
+        return;
+    }
+
+    if (!th->syn || th->ack) {
+        return;
+    }
+
+    unsigned char reply[SIM_MAX_FRAME];
+    memset(reply, 0, SIM_MAX_FRAME);
+
+    const unsigned char *host_ip = (const unsigned char *)&ip6h->ip6_dst;
+    sim_ip6_reply_headers(reply, frame, host_ip, &ip6h->ip6_src, 
+            sizeof(struct tcphdr), IPPROTO_TCP, 64);
+
+    struct tcphdr *rep_th = (struct tcphdr *)
+            (reply + sizeof(struct ethhdr) + sizeof(struct ip6_hdr));
+    rep_th->source = th->dest;
+    rep_th->dest = th->source;
+    rep_th->ack_seq = htonl(ntohl(th->seq) + 1);
+    rep_th->doff = 5;
+    rep_th->ack = 1;
+
+    unsigned char open = host->open_ports[ntohs(th->dest)];
+
+    if (open) {
+        rep_th->seq = htonl((unsigned int)sim_rand(sim));
+        rep_th->syn = 1;
+        rep_th->window = htons(64240);
+    } else {
+        rep_th->rst = 1;
+    }
+
+    unsigned long sum = ip6_pseudo_sum(host_ip, 
+            (const unsigned char *)&ip6h->ip6_src, sizeof(struct tcphdr), 
+            IPPROTO_TCP);
+    rep_th->check = checksum_fold(checksum_add(sum, rep_th, 
+            sizeof(struct tcphdr)));
+
+    int reply_len = sizeof(struct ethhdr) + sizeof(struct ip6_hdr) + 
+            sizeof(struct tcphdr);
+    unsigned long long due_ns = now_ns + sim_reply_delay(sim);
+
+    if (!open) {
+        sim->stats.resets++;
+        sim_queue_reply(sim, reply, reply_len, due_ns);
+
+        return;
+    }
+
+    sim->stats.syn_acks++;
+    sim_queue_reply(sim, reply, reply_len, due_ns);
+
+    // Retransmit with exponential backoff until reset
+    unsigned long long retrans_ns = sim->config.retrans_us * 1000ULL;
+
+    for (int i = 0; i < sim->config.synack_retrans; i++) {
+        due_ns += retrans_ns;
+        retrans_ns *= 2;
+
+        sim_queue_reply(sim, reply, reply_len, due_ns);
+    }
+}
+
+static void sim_handle_ip6(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    if (frame_len < (int)(sizeof(struct ethhdr) + sizeof(struct ip6_hdr))) {
+        return;
+    }
+
+    const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+            (frame + sizeof(struct ethhdr));
+    const unsigned char *payload = frame + sizeof(struct ethhdr) + 
+            sizeof(struct ip6_hdr);
+
+    int plen = ntohs(ip6h->ip6_plen);
+
+    if (plen > frame_len - (int)(sizeof(struct ethhdr) + 
+            sizeof(struct ip6_hdr))) {
+        return;
+    }
+
+    if (ip6h->ip6_nxt == IPPROTO_ICMPV6 && plen > 0 && 
+            payload[0] == NDP_NEIGHBOR_SOLICIT) {
+        sim_handle_ns(sim, frame, plen, now_ns);
+
+        return;
+    }
+
+    struct sim_host6 *host = sim_find_host6(sim, 
+            (const unsigned char *)&ip6h->ip6_dst);
+
+    if (host == NULL || sim_lost(sim)) {
+        return;
+    }
+
+    if (ip6h->ip6_nxt == IPPROTO_ICMPV6) {
+        sim_handle_icmp6(sim, frame, plen, now_ns);
+    } else if (ip6h->ip6_nxt == IPPROTO_TCP) {
+        sim_handle_tcp6(sim, host, frame, plen, now_ns);
+    }
+}
+
+void sim_handle_frame(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns) {
+    if (frame_len < (int)sizeof(struct ethhdr)) {
+        return;
+    }
+
+    sim->stats.frames_in++;
+
+    const struct ethhdr *eth = (const struct ethhdr *)frame;
+
+    if (ntohs(eth->h_proto) == ETH_P_ARP) {
+        if (!sim_lost(sim)) {
+            sim_handle_arp(sim, frame, frame_len, now_ns);
+        }
+
+        return;
+    }
+
+    if (ntohs(eth->h_proto) == ETH_P_IPV6) {
+        sim_handle_ip6(sim, frame, frame_len, now_ns);
+
+        return;
+    }
+
+    if (ntohs(eth->h_proto) != ETH_P_IP || 
+            frame_len < (int)(sizeof(struct ethhdr) + sizeof(struct iphdr))) {
+        return;
+    }
+
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+
+    struct sim_host *host = sim_find_host(sim, iph->daddr);
+
+    if (host == NULL || sim_lost(sim)) {
+        return;
+    }
+
+    if (iph->protocol == IPPROTO_ICMP) {
+        sim_handle_icmp(sim, frame, frame_len, now_ns);
+    } else if (iph->protocol == IPPROTO_TCP) {
+        sim_handle_tcp(sim, host, frame, frame_len, now_ns);
+    } else if (iph->protocol == IPPROTO_UDP) {
+        sim_handle_udp(sim, frame, frame_len, now_ns);
+    }
+}
+
+unsigned long long sim_next_due(const struct sim_target *sim) {
+    if (sim->events_len == 0) {
+        return 0;
+    }
+
+    return sim->events[0].due_ns;
+}
+
+int sim_pop_due(struct sim_target *sim, unsigned long long now_ns, 
+        struct sim_event *event) {
+    while (sim->events_len > 0 && sim->events[0].due_ns <= now_ns) {
+        *event = sim->events[0];
+
+        // Move the last event to the root and sift it down
+        struct sim_event last = sim->events[--sim->events_len];
+        int i = 0;
+
+        for (;;) {
+            int child = 2 * i + 1;
+
+            if (child >= sim->events_len) {
+                break;
+            }
+
+            if (child + 1 < sim->events_len && 
+                    sim->events[child + 1].due_ns < sim->events[child].due_ns) {
+                child++;
+            }
+
+            if (last.due_ns <= sim->events[child].due_ns) {
+                break;
+            }
+
+            sim->events[i] = sim->events[child];
+            i = child;
+        }
+
+        if (sim->events_len > 0) {
+            sim->events[i] = last;
+        }
+
+        // Skip retransmits cancelled by a reset
+        if (event->frame_len == 0) {
+            continue;
+        }
+
+        sim->stats.frames_out++;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+struct sim_target * sim_create_from_args(int argc, const char **argv) {
+    const char *open_ports = NULL;
+    const char *udp_open_ports = NULL;
+    const char *filtered_ports = NULL;
+    // IPv4 and IPv6 hosts are counted separately
+    const char *host_specs[2 * SIM_MAX_HOSTS];
+    int host_specs_len = 0;
+
+    struct sim_config config;
+    memset(&config, 0, sizeof(struct sim_config));
+    config.rtt_us = 1000;
+    config.retrans_us = 1000000;
+    config.icmp_burst = 6;
+    config.seed = 1;
+
+    for (int i = 0; i + 1 < argc; i += 2) {
+        const char *val = argv[i + 1];
+
+        if (strcmp(argv[i], "-host") == 0 && 
+                host_specs_len < 2 * SIM_MAX_HOSTS) {
+            host_specs[host_specs_len++] = val;
+        } else if (strcmp(argv[i], "-open") == 0) {
+            open_ports = val;
+        } else if (strcmp(argv[i], "-udp-open") == 0) {
+            udp_open_ports = val;
+        } else if (strcmp(argv[i], "-filtered") == 0) {
+            filtered_ports = val;
+        } else if (strcmp(argv[i], "-rtt") == 0) {
+            config.rtt_us = (unsigned int)(atof(val) * 1000);
+        } else if (strcmp(argv[i], "-jitter") == 0) {
+            config.jitter_us = (unsigned int)(atof(val) * 1000);
+        } else if (strcmp(argv[i], "-loss") == 0) {
+            config.loss = atof(val);
+        } else if (strcmp(argv[i], "-retrans") == 0) {
+            config.synack_retrans = atoi(val);
+        } else if (strcmp(argv[i], "-icmp-rate") == 0) {
+            config.icmp_rate = atof(val);
+        } else if (strcmp(argv[i], "-icmp-burst") == 0) {
+            config.icmp_burst = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(argv[i], "-drop-echo") == 0) {
+            config.drop_echo = atoi(val) != 0;
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            config.seed = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(argv[i], "-banner") == 0) {
+            if (strlen(val) > SIM_MAX_BANNER) {
+                fprintf(stderr, "ERROR: Banner is longer than %d bytes!\n",
+                        SIM_MAX_BANNER);
+
+                return NULL;
+            }
+
+            strcpy(config.banner, val);
+        } else {
+            fprintf(stderr, "ERROR: Unknown simulator option %s!\n", argv[i]);
+
+            return NULL;
+        }
+    }
+
+    if (argc % 2 != 0 || host_specs_len == 0 || config.loss < 0 || 
+            config.loss > 1 || config.icmp_rate < 0 || 
+            config.icmp_burst < 1) {
+        fprintf(stderr, "ERROR: Invalid simulator options!\n");
+
+        return NULL;
+    }
+
+    struct sim_target *sim = sim_create(&config);
+
+    if (sim == NULL) {
+        fprintf(stderr, "ERROR: Unable to allocate simulator!\n");
+
+        return NULL;
+    }
+
+    if (open_ports != NULL && 
+            sim_parse_ports(open_ports, sim->default_open) < 0) {
+        fprintf(stderr, "ERROR: Invalid port list %s!\n", open_ports);
+        sim_free(sim);
+
+        return NULL;
+    }
+
+    if (udp_open_ports != NULL && 
+            sim_parse_ports(udp_open_ports, sim->udp_open) < 0) {
+        fprintf(stderr, "ERROR: Invalid port list %s!\n", udp_open_ports);
+        sim_free(sim);
+
+        return NULL;
+    }
+
+    if (filtered_ports != NULL && 
+            sim_parse_ports(filtered_ports, sim->filtered) < 0) {
+        fprintf(stderr, "ERROR: Invalid port list %s!\n", filtered_ports);
+        sim_free(sim);
+
+        return NULL;
+    }
+
+    for (int i = 0; i < host_specs_len; i++) {
+        if (sim_add_hosts(sim, host_specs[i]) < 0) {
+            fprintf(stderr, "ERROR: Invalid host spec %s!\n", host_specs[i]);
+            sim_free(sim);
+
+            return NULL;
+        }
+    }
+
+    return sim;
+}
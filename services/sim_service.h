@@ -0,0 +1,323 @@
+#ifndef SIM_SERVICE_H
+#define SIM_SERVICE_H
+
+#include "../constants/constants.h"
+
+// Largest frame the simulator generates
+#define SIM_MAX_FRAME 128
+
+// Longest banner open ports send once a handshake completes
+#define SIM_MAX_BANNER 64
+
+// Maximum number of virtual host ranges
+#define SIM_MAX_HOSTS 64
+
+// Slots of the per-host ICMP error rate limit table
+#define SIM_ICMP_LIMIT_SLOTS 65536
+
+// First 3 bytes of every virtual host's MAC address
+#define SIM_MAC_PREFIX_0 0x02
+#define SIM_MAC_PREFIX_1 0x4d
+#define SIM_MAC_PREFIX_2 0x50
+
+/*
+ * Struct: sim_host
+ * ----------------
+ * A range of virtual hosts sharing one open port set.
+ *
+ * first_ip: First IP address of the range (host byte order).
+ *
+ * last_ip: Last IP address of the range (host byte order).
+ *
+ * open_ports: A MAX_PORT + 1 table, 1 for every open port.
+ */
+struct sim_host {
+    unsigned int first_ip;
+    unsigned int last_ip;
+    unsigned char *open_ports;
+};
+
+/*
+ * Struct: sim_host6
+ * -----------------
+ * A block of virtual IPv6 hosts sharing one open port set.
+ *
+ * prefix: The network prefix of the block.
+ *
+ * prefix_len: The length of the prefix in bits.
+ *
+ * open_ports: A MAX_PORT + 1 table, 1 for every open port.
+ */
+struct sim_host6 {
+    unsigned char prefix[IP6_LEN];
+    int prefix_len;
+    unsigned char *open_ports;
+};
+
+/*
+ * Struct: sim_config
+ * ------------------
+ * Behaviour of the simulated network.
+ *
+ * rtt_us: Round trip time added to every reply in microseconds.
+ *
+ * jitter_us: Maximum random variation of the round trip time.
+ *
+ * loss: Probability (0 - 1) that any frame to or from a virtual host is lost.
+ *
+ * synack_retrans: Number of times an unanswered SYN-ACK is retransmitted.
+ *
+ * retrans_us: Delay before the first SYN-ACK retransmit, doubled each time.
+ *
+ * icmp_rate: ICMP errors each host may send per second, or 0 for no limit.
+ *            Linux limits destination unreachables to 1 per second.
+ *
+ * icmp_burst: ICMP errors a host may send at once before icmp_rate applies.
+ *
+ * drop_echo: 1 if hosts drop ICMP echo requests, like hosts behind a
+ *            firewall, so only TCP pings find them.
+ *
+ * seed: Seed of the loss and jitter RNG.
+ *
+ * banner: Line open ports send, followed by CRLF, once the scanner completes
+ *         the handshake, or empty for none.
+ */
+struct sim_config {
+    unsigned int rtt_us;
+    unsigned int jitter_us;
+    double loss;
+    int synack_retrans;
+    unsigned int retrans_us;
+    double icmp_rate;
+    unsigned int icmp_burst;
+    unsigned char drop_echo;
+    unsigned int seed;
+    char banner[SIM_MAX_BANNER + 1];
+};
+
+/*
+ * Struct: sim_event
+ * -----------------
+ * A reply frame waiting until its due time.
+ */
+struct sim_event {
+    unsigned long long due_ns;
+    int frame_len;
+    unsigned char frame[SIM_MAX_FRAME];
+};
+
+/*
+ * Struct: sim_stats
+ * -----------------
+ * Counters of the simulator.
+ */
+struct sim_stats {
+    unsigned long frames_in;
+    unsigned long frames_out;
+    unsigned long arp_replies;
+    unsigned long neighbor_adverts;
+    unsigned long echo_replies;
+    unsigned long syn_acks;
+    unsigned long resets;
+    unsigned long banners;
+    unsigned long udp_replies;
+    unsigned long port_unreachables;
+    unsigned long prohibited;
+    unsigned long icmp_limited;
+    unsigned long lost;
+};
+
+/*
+ * Struct: sim_icmp_limit
+ * ----------------------
+ * ICMP error token bucket of one virtual host.
+ */
+struct sim_icmp_limit {
+    unsigned int ip;
+    double tokens;
+    unsigned long long last_ns;
+};
+
+/*
+ * Struct: sim_target
+ * ------------------
+ * A simulated network of virtual hosts.
+ *
+ * config: The network behaviour.
+ *
+ * hosts: The virtual host ranges.
+ *
+ * hosts_len: The number of host ranges.
+ *
+ * hosts6: The virtual IPv6 host blocks.
+ *
+ * hosts6_len: The number of IPv6 host blocks.
+ *
+ * default_open: Open port table for hosts without their own port set.
+ *
+ * udp_open: Open UDP port table of every host.
+ *
+ * filtered: Table of the TCP ports of every host a firewall blocks, whose 
+ *           SYNs are answered with an ICMP administratively prohibited error.
+ *
+ * icmp_limits: ICMP error token buckets indexed by host IP, or NULL if ICMP
+ *              errors are not rate limited.
+ *
+ * events: Min-heap of pending reply frames ordered by due time.
+ *
+ * events_len: The number of pending frames.
+ *
+ * events_cap: The capacity of events.
+ *
+ * rng: State of the loss and jitter RNG.
+ *
+ * stats: Counters.
+ */
+struct sim_target {
+    struct sim_config config;
+    struct sim_host hosts[SIM_MAX_HOSTS];
+    int hosts_len;
+    struct sim_host6 hosts6[SIM_MAX_HOSTS];
+    int hosts6_len;
+    unsigned char *default_open;
+    unsigned char *udp_open;
+    unsigned char *filtered;
+    struct sim_icmp_limit *icmp_limits;
+    struct sim_event *events;
+    int events_len;
+    int events_cap;
+    unsigned long long rng;
+    struct sim_stats stats;
+};
+
+/*
+ * Function: sim_create
+ * --------------------
+ * Creates a simulated network with no virtual hosts.
+ *
+ * config: The network behaviour.
+ *
+ * return: A new simulated network, or NULL on error.
+ */
+struct sim_target * sim_create(const struct sim_config *config);
+
+/*
+ * Function: sim_create_from_args
+ * ------------------------------
+ * Creates a simulated network from command line style options:
+ * -host <spec> (repeatable), -open <ports>, -udp-open <ports>, 
+ * -filtered <ports>, -rtt <ms>, -jitter <ms>, -loss <p>, -retrans <n>, 
+ * -icmp-rate <n>, -icmp-burst <n>, -drop-echo <0|1>, -seed <n> and 
+ * -banner <text>.
+ *
+ * argc: The number of options.
+ *
+ * argv: The options.
+ *
+ * return: A new simulated network, or NULL if the options are invalid.
+ */
+struct sim_target * sim_create_from_args(int argc, const char **argv);
+
+/*
+ * Function: sim_free
+ * ------------------
+ * Frees a simulated network.
+ */
+void sim_free(struct sim_target *sim);
+
+/*
+ * Function: sim_parse_ports
+ * -------------------------
+ * Parses a port list such as "22,80,8000-8080" in to an open port table.
+ *
+ * ports_str: The port list.
+ *
+ * open_ports: A MAX_PORT + 1 table to mark the ports in.
+ *
+ * return: 0 on success, -1 if the list is invalid.
+ */
+int sim_parse_ports(const char *ports_str, unsigned char *open_ports);
+
+/*
+ * Function: sim_add_hosts
+ * -----------------------
+ * Adds virtual hosts.  The host spec is an IPv4 address, a CIDR block or a
+ * range "first-last", or an IPv6 address or prefix such as "fd00::/64",
+ * optionally followed by "=ports" to give the hosts their own open ports
+ * instead of the default set.
+ *
+ * sim: The simulated network.
+ *
+ * host_spec: The host spec.
+ *
+ * return: 0 on success, -1 if the spec is invalid.
+ */
+int sim_add_hosts(struct sim_target *sim, const char *host_spec);
+
+/*
+ * Function: sim_get_mac
+ * ---------------------
+ * Returns the MAC address of a virtual host.
+ *
+ * ip: The host IP address (network byte order).
+ *
+ * mac: Populated with the MAC address.
+ */
+void sim_get_mac(unsigned int ip, unsigned char *mac);
+
+/*
+ * Function: sim_get_mac6
+ * ----------------------
+ * Returns the MAC address of a virtual IPv6 host.
+ *
+ * ip: The host IPv6 address in array format.
+ *
+ * mac: Populated with the MAC address.
+ */
+void sim_get_mac6(const unsigned char *ip, unsigned char *mac);
+
+/*
+ * Function: sim_handle_frame
+ * --------------------------
+ * Handles a frame sent to the simulated network and queues any replies: ARP
+ * replies, ICMP echo replies, SYN-ACKs (and their retransmits) for open ports,
+ * RSTs for closed ports, banners for IPv4 handshakes completed with a
+ * banner configured, UDP replies for open UDP ports and, within the ICMP
+ * rate limit, port unreachables for closed UDP ports.  IPv6 hosts answer
+ * Neighbor Solicitations, ICMPv6 echo requests and TCP SYNs.
+ *
+ * sim: The simulated network.
+ *
+ * frame: The received ethernet frame.
+ *
+ * frame_len: The length of the frame.
+ *
+ * now_ns: The current time, from get_time_ns().
+ */
+void sim_handle_frame(struct sim_target *sim, const unsigned char *frame,
+        int frame_len, unsigned long long now_ns);
+
+/*
+ * Function: sim_next_due
+ * ----------------------
+ * return: The due time of the next queued reply, or 0 if none are queued.
+ */
+unsigned long long sim_next_due(const struct sim_target *sim);
+
+/*
+ * Function: sim_pop_due
+ * ---------------------
+ * Pops the next reply whose due time has passed.
+ *
+ * sim: The simulated network.
+ *
+ * now_ns: The current time.
+ *
+ * event: Populated with the reply.
+ *
+ * return: 1 if a reply was popped, otherwise 0.
+ */
+int sim_pop_due(struct sim_target *sim, unsigned long long now_ns, 
+        struct sim_event *event);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "spec_service.h"
+#include "network_helper.h"
+#include "../constants/constants.h"
+
+/*
+ * Parses a port number of exactly len digits.  Returns -1 if invalid.
+ */
+static long parse_port_num(const char *str, int len) {
+    if (len < 1 || len > 5) {
+        return -1;
+    }
+
+    long port = 0;
+
+    for (int i = 0; i < len; i++) {
+        if (str[i] < '0' || str[i] > '9') {
+            return -1;
+        }
+
+        port = port * 10 + (str[i] - '0');
+    }
+
+    return (port >= 1 && port <= MAX_PORT) ? port : -1;
+}
+
+int parse_port_spec(const char *spec, struct interval_set *ports) {
+    const char *entry = spec;
+
+    for (;;) {
+        const char *comma = strchr(entry, ',');
+        int entry_len = comma != NULL ? (int)(comma - entry) :
+                (int)strlen(entry);
+        const char *dash = memchr(entry, '-', entry_len);
+
+        long first;
+        long last;
+
+        if (dash == NULL) {
+            first = parse_port_num(entry, entry_len);
+            last = first;
+        } else {
+            int first_len = (int)(dash - entry);
+            int last_len = entry_len - first_len - 1;
+
+            first = first_len > 0 ? parse_port_num(entry, first_len) : 1;
+            last = last_len > 0 ? parse_port_num(dash + 1, last_len) :
+                    MAX_PORT;
+
+            // A lone dash is not a range
+            if (first_len == 0 && last_len == 0) {
+                first = -1;
+            }
+        }
+
+        if (first < 0 || last < 0 || first > last) {
+            fprintf(stderr, "ERROR: Invalid port range: %.*s\n", entry_len,
+                    entry);
+
+            return -1;
+        }
+
+        if (interval_set_add(ports, (unsigned int)first,
+                (unsigned int)last) < 0) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return -1;
+        }
+
+        if (comma == NULL) {
+            break;
+        }
+
+        entry = comma + 1;
+    }
+
+    interval_set_normalize(ports);
+
+    return 0;
+}
+
+int parse_target_entry(const char *entry, int entry_len, unsigned int *first,
+        unsigned int *last) {
+    const char *slash = memchr(entry, '/', entry_len);
+    const char *dash = memchr(entry, '-', entry_len);
+
+    if (slash != NULL) {
+        int addr_len = (int)(slash - entry);
+        int prefix_digits = entry_len - addr_len - 1;
+        int prefix_len = 0;
+
+        if (prefix_digits < 1 || prefix_digits > 2) {
+            return -1;
+        }
+
+        for (int i = 0; i < prefix_digits; i++) {
+            if (slash[1 + i] < '0' || slash[1 + i] > '9') {
+                return -1;
+            }
+
+            prefix_len = prefix_len * 10 + (slash[1 + i] - '0');
+        }
+
+        unsigned int ip;
+
+        if (prefix_len > 32 || parse_ip_str(entry, addr_len, &ip) < 0) {
+            return -1;
+        }
+
+        unsigned int mask = prefix_len == 0 ? 0 :
+                ~(0xFFFFFFFF >> (prefix_len - 1) >> 1);
+
+        *first = ip & mask;
+        *last = *first | ~mask;
+
+        return 0;
+    }
+
+    if (dash != NULL) {
+        int first_len = (int)(dash - entry);
+
+        int last_len = entry_len - first_len - 1;
+
+        if (parse_ip_str(entry, first_len, first) < 0 ||
+                parse_ip_str(dash + 1, last_len, last) < 0 || 
+                *first > *last) {
+            return -1;
+        }
+
+        return 0;
+    }
+
+    if (parse_ip_str(entry, entry_len, first) < 0) {
+        return -1;
+    }
+
+    *last = *first;
+
+    return 0;
+}
+
+int parse_target_spec(const char *spec, struct interval_set *targets) {
+    const char *entry = spec;
+
+    for (;;) {
+        const char *comma = strchr(entry, ',');
+        int entry_len = comma != NULL ? (int)(comma - entry) :
+                (int)strlen(entry);
+
+        unsigned int first;
+        unsigned int last;
+
+        if (parse_target_entry(entry, entry_len, &first, &last) < 0) {
+            fprintf(stderr, "ERROR: Invalid target: %.*s\n", entry_len, entry);
+
+            return -1;
+        }
+
+        if (interval_set_add(targets, first, last) < 0) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return -1;
+        }
+
+        if (comma == NULL) {
+            break;
+        }
+
+        entry = comma + 1;
+    }
+
+    interval_set_normalize(targets);
+
+    return 0;
+}
+
+/*
+ * Struct: target_chunk
+ * --------------------
+ * A part of a target file parsed by one thread.
+ *
+ * start: The first byte of the part.
+ *
+ * end: One past the last byte, after a line break or at the end of file.
+ *
+ * targets: The normalized addresses of the part.
+ *
+ * ret: 0 if the part was parsed, -1 on error.
+ */
+struct target_chunk {
+    const char *start;
+    const char *end;
+    struct interval_set targets;
+    int ret;
+};
+
+static int is_target_separator(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ',';
+}
+
+static void * parse_target_chunk(void *arg) {
+    struct target_chunk *chunk = (struct target_chunk *)arg;
+    const char *curr = chunk->start;
+    const char *end = chunk->end;
+
+    chunk->ret = -1;
+
+    while (curr < end) {
+        if (is_target_separator(*curr)) {
+            curr++;
+
+            continue;
+        }
+
+        if (*curr == '#') {
+            const char *line_end = memchr(curr, '\n', end - curr);
+            curr = line_end != NULL ? line_end + 1 : end;
+
+            continue;
+        }
+
+        const char *entry = curr;
+
+        while (curr < end && !is_target_separator(*curr) && *curr != '#') {
+            curr++;
+        }
+
+        int entry_len = (int)(curr - entry);
+        unsigned int first;
+        unsigned int last;
+
+        if (parse_target_entry(entry, entry_len, &first, &last) < 0) {
+            fprintf(stderr, "ERROR: Invalid target: %.*s\n", 
+                    entry_len < 64 ? entry_len : 64, entry);
+
+            return NULL;
+        }
+
+        if (interval_set_add(&chunk->targets, first, last) < 0) {
+            fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+
+            return NULL;
+        }
+    }
+
+    interval_set_normalize(&chunk->targets);
+    chunk->ret = 0;
+
+    return NULL;
+}
+
+int load_target_file(const char *path, struct interval_set *targets) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot open target file: %s\n", path);
+
+        return -1;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "ERROR: No targets in target file: %s\n", path);
+        close(fd);
+
+        return -1;
+    }
+
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Cannot map target file: %s\n", path);
+
+        return -1;
+    }
+
+    madvise((void *)data, st.st_size, MADV_SEQUENTIAL);
+
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long max_threads = st.st_size / TARGET_CHUNK_MIN + 1;
+
+    if (threads > max_threads) {
+        threads = max_threads;
+    }
+
+    if (threads > TARGET_FILE_MAX_THREADS) {
+        threads = TARGET_FILE_MAX_THREADS;
+    }
+
+    if (threads < 1) {
+        threads = 1;
+    }
+
+    struct target_chunk chunks[TARGET_FILE_MAX_THREADS];
+    pthread_t tids[TARGET_FILE_MAX_THREADS];
+    unsigned char started[TARGET_FILE_MAX_THREADS];
+    const char *data_end = data + st.st_size;
+    const char *chunk_start = data;
+    int chunks_len = 0;
+
+    // Chunks end after a line break so no entry or comment is split
+    for (long i = 0; i < threads && chunk_start < data_end; i++) {
+        const char *chunk_end = data + st.st_size / threads * (i + 1);
+
+        // A long line may have carried the last chunk past this one's share,
+        // which then ends at the next line break rather than taking the rest
+        if (chunk_end < chunk_start) {
+            chunk_end = chunk_start;
+        }
+
+        if (i == threads - 1) {
+            chunk_end = data_end;
+        } else {
+            const char *line_end = memchr(chunk_end, '\n', 
+                    data_end - chunk_end);
+            chunk_end = line_end != NULL ? line_end + 1 : data_end;
+        }
+
+        struct target_chunk *chunk = &chunks[chunks_len];
+        chunk->start = chunk_start;
+        chunk->end = chunk_end;
+        interval_set_init(&chunk->targets);
+
+        started[chunks_len] = pthread_create(&tids[chunks_len], NULL, 
+                parse_target_chunk, (void *)chunk) == 0;
+
+        // Parse it on this thread instead
+        if (!started[chunks_len]) {
+            parse_target_chunk(chunk);
+        }
+
+        chunks_len++;
+        chunk_start = chunk_end;
+    }
+
+    int ret = 0;
+
+    for (int i = 0; i < chunks_len; i++) {
+        if (started[i]) {
+            pthread_join(tids[i], NULL);
+        }
+
+        if (chunks[i].ret < 0) {
+            ret = -1;
+        }
+    }
+
+    munmap((void *)data, st.st_size);
+
+    // Chunks are merged in pairs, so each address is copied log(n) times
+    for (int step = 1; ret == 0 && step < chunks_len; step *= 2) {
+        for (int i = 0; i + step < chunks_len; i += step * 2) {
+            if (interval_set_merge(&chunks[i].targets, 
+                    &chunks[i + step].targets) < 0) {
+                fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+                ret = -1;
+
+                break;
+            }
+        }
+    }
+
+    if (ret == 0 && chunks[0].targets.size == 0) {
+        fprintf(stderr, "ERROR: No targets in target file: %s\n", path);
+        ret = -1;
+    }
+
+    if (ret == 0 && interval_set_merge(targets, &chunks[0].targets) < 0) {
+        fprintf(stderr, "ERROR: Unknown error allocating memory!\n");
+        ret = -1;
+    }
+
+    for (int i = 0; i < chunks_len; i++) {
+        interval_set_free(&chunks[i].targets);
+    }
+
+    return ret;
+}
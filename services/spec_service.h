@@ -0,0 +1,74 @@
+#ifndef SPEC_SERVICE_H
+#define SPEC_SERVICE_H
+
+#include "interval_set.h"
+
+// Most threads parsing a target file, and the least bytes each one parses
+#define TARGET_FILE_MAX_THREADS 16
+#define TARGET_CHUNK_MIN (1 << 20)
+
+/*
+ * Function: parse_port_spec
+ * -------------------------
+ * Parses a comma separated port list such as "1-1024,3306,8000-9000" in to
+ * a normalized set.  A range may leave out its first or last port, e.g.
+ * "-1024" or "60000-".
+ *
+ * spec: The port list.
+ *
+ * ports: An initialised set the ports are added to.
+ *
+ * return: 0 on success, -1 if the list is invalid.
+ */
+int parse_port_spec(const char *spec, struct interval_set *ports);
+
+/*
+ * Function: parse_target_entry
+ * ----------------------------
+ * Parses one IPv4 target: an address, a CIDR block such as "10.0.0.0/24" or
+ * a range such as "10.0.0.5-10.0.0.20".
+ *
+ * entry: The target, not NUL terminated.
+ *
+ * entry_len: The length of the target.
+ *
+ * first: Populated with the first address (host byte order).
+ *
+ * last: Populated with the last address (host byte order).
+ *
+ * return: 0 on success, -1 if the target is invalid.
+ */
+int parse_target_entry(const char *entry, int entry_len, unsigned int *first,
+        unsigned int *last);
+
+/*
+ * Function: parse_target_spec
+ * ---------------------------
+ * Parses a comma separated list of IPv4 targets (see parse_target_entry) in
+ * to a normalized set of addresses in host byte order.
+ *
+ * spec: The target list.
+ *
+ * targets: An initialised set the addresses are added to.
+ *
+ * return: 0 on success, -1 if the list is invalid.
+ */
+int parse_target_spec(const char *spec, struct interval_set *targets);
+
+/*
+ * Function: load_target_file
+ * --------------------------
+ * Adds the IPv4 targets (see parse_target_entry) listed in a file, separated
+ * by whitespace or commas.  Lines starting with # are comments.  The file is
+ * mapped and split at line breaks in to chunks that are parsed and 
+ * normalized by a thread each, then merged.
+ *
+ * path: The target file.
+ *
+ * targets: A normalized set the addresses are added to.
+ *
+ * return: 0 on success, -1 if the file cannot be read or is invalid.
+ */
+int load_target_file(const char *path, struct interval_set *targets);
+
+#endif
\ No newline at end of file
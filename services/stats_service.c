@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <time.h>
+
+#include "stats_service.h"
+#include "checkpoint_service.h"
+#include "transport_service.h"
+#include "../constants/constants.h"
+
+static double get_time_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+void init_scan_stats(struct scan_stats *stats) {
+    memset(stats, 0, sizeof(struct scan_stats));
+
+    stats->listen_transport = NULL;
+    pthread_mutex_init(&stats->listen_lock, NULL);
+    atomic_init(&stats->stop, 0);
+}
+
+void reset_scan_stats(struct scan_stats *stats) {
+    memset(&stats->sender, 0, sizeof(struct stats_counters));
+    memset(&stats->receiver, 0, sizeof(struct stats_counters));
+    memset(&stats->consumer, 0, sizeof(struct stats_counters));
+
+    stats->kernel_packets = 0;
+    stats->kernel_drops = 0;
+}
+
+static void read_kernel_stats(struct scan_stats *stats) {
+    if (stats->listen_transport == NULL) {
+        return;
+    }
+
+    struct transport_stats tstats;
+    transport_get_stats(stats->listen_transport, &tstats);
+
+    stats->kernel_packets = tstats.kernel_packets;
+    stats->kernel_drops = tstats.kernel_drops;
+}
+
+void set_listen_transport(struct scan_stats *stats, struct transport *t) {
+    pthread_mutex_lock(&stats->listen_lock);
+
+    read_kernel_stats(stats);
+    stats->listen_transport = t;
+
+    pthread_mutex_unlock(&stats->listen_lock);
+}
+
+void update_kernel_stats(struct scan_stats *stats) {
+    pthread_mutex_lock(&stats->listen_lock);
+    read_kernel_stats(stats);
+    pthread_mutex_unlock(&stats->listen_lock);
+}
+
+void format_status_line(struct scan_state *state, double elapsed_s, 
+        double pps, char *buff, int buff_len) {
+    struct scan_stats *stats = &state->stats;
+
+    unsigned long sent = atomic_load_explicit(&state->cursor, 
+            memory_order_relaxed);
+    unsigned long total = state->probes_len;
+    double percent = total ? (100.0 * sent / total) : 0.0;
+
+    char eta[32];
+
+    if (sent >= total) {
+        snprintf(eta, sizeof(eta), "draining");
+    } else if (pps > 0) {
+        long int eta_s = (long int)((total - sent) / pps);
+        snprintf(eta, sizeof(eta), "%ldm %02lds", eta_s / 60, eta_s % 60);
+    } else {
+        snprintf(eta, sizeof(eta), "stalled");
+    }
+
+    snprintf(buff, buff_len, "[%5.0fs] sent %lu/%lu (%.1f%%) | replies %lu | "
+            "open %lu closed %lu filtered %lu | %.0f pps | drops %lu | ETA %s",
+            elapsed_s, sent, total, percent,
+            stats_read(&stats->receiver.replies_received),
+            stats_read(&stats->consumer.open),
+            stats_read(&stats->consumer.closed),
+            stats_read(&stats->consumer.filtered),
+            pps, stats->kernel_drops, eta);
+}
+
+static void write_status_line(const char *stats_path, const char *line) {
+    if (stats_path == NULL) {
+        fprintf(stderr, "%s\n", line);
+
+        return;
+    }
+
+    const int MAX_PATH = 4096;
+    char *tmp_path = malloc(sizeof(char) * MAX_PATH);
+    snprintf(tmp_path, MAX_PATH, "%s.tmp", stats_path);
+
+    // Replace the file so readers never see a partial line
+    FILE *fp = fopen(tmp_path, "w");
+
+    if (fp != NULL) {
+        fprintf(fp, "%s\n", line);
+        fclose(fp);
+        rename(tmp_path, stats_path);
+    }
+
+    free(tmp_path);
+}
+
+static void * stats_thread(void *stats_args) {
+    struct scan_state *state = (struct scan_state *)stats_args;
+    struct scan_stats *stats = &state->stats;
+
+    const int MAX_LINE_LEN = 256;
+    char *line = malloc(sizeof(char) * MAX_LINE_LEN);
+
+    // Check for stop requests every 0.1 seconds
+    const int SLEEP_TIME_MICS = 1000 * 1000 * 0.1;
+
+    double start_time = get_time_s();
+    double last_time = start_time;
+    unsigned long last_sent = stats_read(&stats->sender.probes_sent);
+
+    while (!atomic_load_explicit(&stats->stop, memory_order_acquire)) {
+        usleep(SLEEP_TIME_MICS);
+
+        double curr_time = get_time_s();
+
+        if (curr_time - last_time < STATS_INTERVAL_S) {
+            continue;
+        }
+
+        unsigned long sent = stats_read(&stats->sender.probes_sent);
+        double pps = (sent - last_sent) / (curr_time - last_time);
+
+        update_kernel_stats(stats);
+        format_status_line(state, curr_time - start_time, pps, line, 
+                MAX_LINE_LEN);
+        write_status_line(stats->stats_path, line);
+
+        last_time = curr_time;
+        last_sent = sent;
+    }
+
+    // Final status line
+    double curr_time = get_time_s();
+    double pps = stats_read(&stats->sender.probes_sent) / 
+            (curr_time - start_time);
+
+    update_kernel_stats(stats);
+    format_status_line(state, curr_time - start_time, pps, line, MAX_LINE_LEN);
+    write_status_line(stats->stats_path, line);
+
+    free(line);
+
+    return NULL;
+}
+
+int start_stats_thread(struct scan_state *state, const char *stats_path) {
+    struct scan_stats *stats = &state->stats;
+
+    stats->stats_path = stats_path;
+
+    // A scan run again after the thread was stopped starts it again
+    atomic_store_explicit(&stats->stop, 0, memory_order_relaxed);
+
+    if (pthread_create(&stats->tid, NULL, stats_thread, (void *)state) != 0) {
+        return -1;
+    }
+
+    stats->running = 1;
+
+    return 0;
+}
+
+void stop_stats_thread(struct scan_state *state) {
+    struct scan_stats *stats = &state->stats;
+
+    if (!stats->running) {
+        return;
+    }
+
+    atomic_store_explicit(&stats->stop, 1, memory_order_release);
+    pthread_join(stats->tid, NULL);
+
+    stats->running = 0;
+}
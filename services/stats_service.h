@@ -0,0 +1,181 @@
+#ifndef STATS_SERVICE_H
+#define STATS_SERVICE_H
+
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "../constants/constants.h"
+
+struct scan_state;
+struct transport;
+
+// Seconds between status lines
+#define STATS_INTERVAL_S 1
+
+/*
+ * Struct: stats_counters
+ * ----------------------
+ * Counters owned by a single thread.  Each block starts on its own cache line
+ * so the sending, receiving and consuming threads never write to a shared
+ * line.  Only the owning thread writes, the stats thread only reads.
+ */
+struct stats_counters {
+    _Alignas(CACHE_LINE_SIZE) atomic_ulong probes_sent;
+    atomic_ulong replies_received;
+    atomic_ulong open;
+    atomic_ulong closed;
+    atomic_ulong filtered;
+};
+
+/*
+ * Struct: scan_stats
+ * ------------------
+ * Live statistics of a scan.
+ *
+ * sender: Counters of the probe sending thread.
+ *
+ * receiver: Counters of the reply receiving thread.
+ *
+ * consumer: Counters of the reply classifying thread.
+ *
+ * listen_transport: The transport replies are received on, or NULL.
+ *
+ * listen_lock: Guards listen_transport while it is closed.
+ *
+ * kernel_packets: Packets seen by the listen transport (PACKET_STATISTICS).
+ *
+ * kernel_drops: Packets dropped by the listen transport (PACKET_STATISTICS).
+ *
+ * stats_path: File the status line is written to, or NULL for stderr.
+ *
+ * stop: Set to stop the stats thread.
+ *
+ * running: 1 if the stats thread was started.
+ *
+ * tid: The stats thread.
+ */
+struct scan_stats {
+    struct stats_counters sender;
+    struct stats_counters receiver;
+    struct stats_counters consumer;
+
+    _Alignas(CACHE_LINE_SIZE) struct transport *listen_transport;
+    pthread_mutex_t listen_lock;
+    unsigned long kernel_packets;
+    unsigned long kernel_drops;
+    const char *stats_path;
+    atomic_uchar stop;
+    unsigned char running;
+    pthread_t tid;
+};
+
+/*
+ * Function: stats_inc
+ * -------------------
+ * Increments a counter owned by the calling thread.  As there is a single
+ * writer a relaxed load and store is enough and avoids a locked instruction.
+ *
+ * counter: The counter to increment.
+ */
+static inline void stats_inc(atomic_ulong *counter) {
+    atomic_store_explicit(counter, 
+            atomic_load_explicit(counter, memory_order_relaxed) + 1, 
+            memory_order_relaxed);
+}
+
+/*
+ * Function: stats_read
+ * --------------------
+ * return: The current value of a counter.
+ */
+static inline unsigned long stats_read(atomic_ulong *counter) {
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+/*
+ * Function: init_scan_stats
+ * -------------------------
+ * Zeros the statistics of a scan.
+ *
+ * stats: The statistics to initialise.
+ */
+void init_scan_stats(struct scan_stats *stats);
+
+/*
+ * Function: reset_scan_stats
+ * --------------------------
+ * Zeros the counters of a scan that is run again.  The stats thread must not
+ * be running.
+ *
+ * stats: The statistics to reset.
+ */
+void reset_scan_stats(struct scan_stats *stats);
+
+/*
+ * Function: set_listen_transport
+ * ------------------------------
+ * Sets the transport replies are received on.  Clearing it reads the final
+ * kernel counters first, so it must be cleared before the transport is 
+ * closed.
+ *
+ * stats: The scan statistics.
+ *
+ * t: The listen transport, or NULL.
+ */
+void set_listen_transport(struct scan_stats *stats, struct transport *t);
+
+/*
+ * Function: update_kernel_stats
+ * -----------------------------
+ * Reads the kernel receive counters (PACKET_STATISTICS) of the listen 
+ * transport.
+ *
+ * stats: The scan statistics.
+ */
+void update_kernel_stats(struct scan_stats *stats);
+
+/*
+ * Function: start_stats_thread
+ * ----------------------------
+ * Starts a thread that prints a status line every STATS_INTERVAL_S seconds 
+ * with probes sent, replies, port states, probes per second, receive drops
+ * and the estimated time remaining.
+ *
+ * state: The scan state.
+ *
+ * stats_path: File to write the status line to, or NULL to print it to 
+ *             stderr.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int start_stats_thread(struct scan_state *state, const char *stats_path);
+
+/*
+ * Function: stop_stats_thread
+ * ---------------------------
+ * Stops the stats thread, if it was started, after writing a final status
+ * line.
+ *
+ * state: The scan state.
+ */
+void stop_stats_thread(struct scan_state *state);
+
+/*
+ * Function: format_status_line
+ * ----------------------------
+ * Formats the current scan statistics in to a single status line.
+ *
+ * state: The scan state.
+ *
+ * elapsed_s: Seconds since the scan started.
+ *
+ * pps: The current probes per second.
+ *
+ * buff: The buffer to write to.
+ *
+ * buff_len: The length of buff.
+ */
+void format_status_line(struct scan_state *state, double elapsed_s, 
+        double pps, char *buff, int buff_len);
+
+#endif
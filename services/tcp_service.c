@@ -5,14 +5,23 @@
 
 #include <net/ethernet.h>
 #include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/ip_icmp.h>
 #include <arpa/inet.h>
 #include <netinet/tcp.h>
 
 #include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "tcp_service.h"
 #include "checksum_service.h"
+#include "checkpoint_service.h"
+#include "handshake_service.h"
+#include "histogram_service.h"
 #include "network_helper.h"
+#include "transport_service.h"
 #include "../constants/constants.h"
 
 unsigned char * construct_syn_packet(const char *src_ip, const char *dst_ip, 
@@ -104,124 +113,511 @@ unsigned char * construct_syn_packet(const char *src_ip, const char *dst_ip,
     return sendbuff;
 }
 
-struct open_ports_dto * listen_for_ACK_replies(const unsigned char* tar_ip, 
-        const unsigned char* dest_mac, unsigned char *stop_listening) {
-    if (DEBUG >= 2) {
-        printf("Listening to ACK replies from target IP: %s\n", 
-                get_ip_arr_str(tar_ip));
+void init_syn6_template(struct syn6_template *tmpl, 
+        const unsigned char *src_ip, const unsigned char *dst_ip, 
+        const unsigned char *src_mac, const unsigned char *dst_mac) {
+    memset(tmpl, 0, sizeof(struct syn6_template));
+
+    // Construct the ethernet header
+    struct ethhdr *eth = (struct ethhdr *)(tmpl->frame);
+
+    memcpy(eth->h_source, src_mac, MAC_LEN);
+    memcpy(eth->h_dest, dst_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_IPV6);
+
+    // Construct the IPv6 header
+    struct ip6_hdr *ip6h = (struct ip6_hdr *)
+            (tmpl->frame + sizeof(struct ethhdr));
+
+    ip6h->ip6_flow = htonl(6 << 28);    // Version 6, no traffic class
+    ip6h->ip6_plen = htons(sizeof(struct tcphdr));
+    ip6h->ip6_nxt = IPPROTO_TCP;
+    ip6h->ip6_hlim = 64;
+
+    memcpy(&ip6h->ip6_src, src_ip, IP6_LEN);
+    memcpy(&ip6h->ip6_dst, dst_ip, IP6_LEN);
+
+    // Construct the TCP header, the same SYN as construct_syn_packet
+    struct tcphdr *th = (struct tcphdr *)
+            ((unsigned char *)ip6h + sizeof(struct ip6_hdr));
+
+    th->syn = 1;
+    th->doff = 5;
+    th->window = htons(5840);
+
+    // Sum everything but the ports, which are added per probe
+    tmpl->sum = ip6_pseudo_sum(src_ip, dst_ip, sizeof(struct tcphdr), 
+            IPPROTO_TCP);
+    tmpl->sum = checksum_add(tmpl->sum, th, sizeof(struct tcphdr));
+}
+
+int stamp_syn6_probe(const struct syn6_template *tmpl, 
+        unsigned short src_port, unsigned short dst_port, 
+        unsigned char *frame) {
+    memcpy(frame, tmpl->frame, SYN6_FRAME_LEN);
+
+    struct tcphdr *th = (struct tcphdr *)(frame + sizeof(struct ethhdr) + 
+            sizeof(struct ip6_hdr));
+
+    th->source = htons(src_port);
+    th->dest = htons(dst_port);
+    th->check = checksum_fold(checksum_add(tmpl->sum, th, 4));
+
+    return SYN6_FRAME_LEN;
+}
+
+/*
+ * Decodes an ICMP destination unreachable error quoting a probe from the
+ * local address to the target in to a reply record of protocol IPPROTO_ICMP,
+ * with the ICMP code as its flags and the quoted sequence number.  Returns 1
+ * if decoded, otherwise 0.
+ */
+static int decode_tcp_icmp_error(const unsigned char *frame, int frame_len,
+        int ip_hdr_len, const unsigned char *loc_ip, 
+        const unsigned char *tar_ip, struct reply_record *rec) {
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+    const unsigned char *data = (const unsigned char *)iph + ip_hdr_len;
+    int data_len = frame_len - sizeof(struct ethhdr) - ip_hdr_len;
+
+    if (data_len < (int)(sizeof(struct icmphdr) + sizeof(struct iphdr))) {
+        return 0;
     }
 
-    // Temporary array to hold open port numbers.
-    unsigned short int *open_ports = malloc(sizeof(short int) * MAX_PORT);
-    
-    int sock_listen_raw = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_IP));
-    //int sock_listen_raw = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+    const struct icmphdr *icmph = (const struct icmphdr *)data;
 
-    if (sock_listen_raw < 0) {
-        fprintf(stderr, "ERROR: Cannot open raw socket!\n");
+    if (loc_ip == NULL || icmph->type != ICMP_DEST_UNREACH) {
+        return 0;
+    }
 
-        errno = EIO;
+    // The error quotes the IP header and the first 8 bytes of the probe, the
+    // ports and sequence number.  It may come from a router on the way.
+    const struct iphdr *quoted_iph = (const struct iphdr *)
+            (data + sizeof(struct icmphdr));
+    int quoted_hdr_len = quoted_iph->ihl * 4;
+
+    if (data_len < (int)sizeof(struct icmphdr) + quoted_hdr_len + 8 ||
+            quoted_iph->protocol != IPPROTO_TCP ||
+            compare_ip_add((const unsigned char *)&(quoted_iph->saddr),
+            loc_ip) != 0 ||
+            compare_ip_add((const unsigned char *)&(quoted_iph->daddr),
+            tar_ip) != 0) {
+        return 0;
+    }
 
-        return NULL;
+    const struct tcphdr *quoted_th = (const struct tcphdr *)
+            ((const unsigned char *)quoted_iph + quoted_hdr_len);
+
+    rec->src_ip = quoted_iph->daddr;
+    rec->src_port = ntohs(quoted_th->dest);
+    rec->dst_port = ntohs(quoted_th->source);
+    rec->protocol = IPPROTO_ICMP;
+    rec->tcp_flags = icmph->code;
+    rec->seq = ntohl(quoted_th->seq);
+    rec->ack = 0;
+    rec->payload_off = 0;
+    rec->payload_len = 0;
+
+    return 1;
+}
+
+int decode_tcp_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec) {
+    if (frame_len < (int)(sizeof(struct ethhdr) + sizeof(struct iphdr))) {
+        return 0;
     }
 
-    // Receive a network packet and copy it in to buffer.
-    const int MAX_R_BUFF_SZ = 65535;
+    // Extract ethernet header
+    const struct ethhdr *eth = (const struct ethhdr *)(frame);
 
-    unsigned char *rec_buff = malloc(sizeof(char) * MAX_R_BUFF_SZ);
+    // Packet was not addressed to this interface
+    if (compare_mac_add(eth->h_dest, dest_mac) != 0) {
+        return 0;
+    }
 
-    struct sockaddr saddr;
-    int saddr_len = sizeof(struct sockaddr);
+    // Extract IP header
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
 
-    // Sleep time in microseconds (0.2 seconds)
-    const int SLEEP_TIME_MICS = 1000 * 1000 * 0.2;
+    if (DEBUG >= 3) {
+        printf("IP packet received: ");
+        printf("src: %s ", get_ip_32_str(iph->saddr));
+        printf("proto: %d\n", iph->protocol);
+    }
 
-    int array_index = 0;
+    int ip_hdr_len = iph->ihl * 4;
+
+    if (iph->protocol == IPPROTO_ICMP) {
+        return decode_tcp_icmp_error(frame, frame_len, ip_hdr_len, loc_ip,
+                tar_ip, rec);
+    }
+
+    // Packet was not from target IP address and was not TCP
+    if ((compare_ip_add((const unsigned char *)&(iph->saddr), tar_ip) != 0) ||
+            (iph->protocol != 6)) {
+        return 0;
+    }
+
+    if (frame_len < (int)(sizeof(struct ethhdr) + ip_hdr_len + 
+            sizeof(struct tcphdr))) {
+        return 0;
+    }
+
+    // Extract TCP header
+    const struct tcphdr *th = (const struct tcphdr *)(frame + 
+            sizeof(struct ethhdr) + ip_hdr_len);
+
+    rec->src_ip = iph->saddr;
+    rec->src_port = ntohs(th->source);
+    rec->dst_port = ntohs(th->dest);
+    rec->protocol = iph->protocol;
+    rec->tcp_flags = ((const unsigned char *)th)[TCP_FLAGS_OFFSET];
+    rec->seq = ntohl(th->seq);
+    rec->ack = ntohl(th->ack_seq);
+
+    // The payload ends at the IP length, not at any ethernet padding
+    int payload_off = sizeof(struct ethhdr) + ip_hdr_len + th->doff * 4;
+    int payload_end = sizeof(struct ethhdr) + ntohs(iph->tot_len);
+
+    if (payload_end > frame_len) {
+        payload_end = frame_len;
+    }
 
-    while (!(*stop_listening)) {
-        // Reset errno
-        errno = 0;
+    rec->payload_off = (unsigned short)payload_off;
+    rec->payload_len = payload_end > payload_off ? 
+            (unsigned short)(payload_end - payload_off) : 0;
 
-        // Reset buffer
-        memset(rec_buff, 0, MAX_R_BUFF_SZ);
+    return 1;
+}
+
+int decode_tcp6_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec) {
+    // ICMPv6 errors are not decoded
+    (void)loc_ip;
+
+    const int HDRS_LEN = sizeof(struct ethhdr) + sizeof(struct ip6_hdr);
+
+    if (frame_len < HDRS_LEN + (int)sizeof(struct tcphdr)) {
+        return 0;
+    }
 
-        // Non-blocking call
-        int buf_len = recvfrom(sock_listen_raw, rec_buff, MAX_R_BUFF_SZ, 
-                MSG_DONTWAIT, &saddr, (socklen_t *)&saddr_len);
-        
-        if (buf_len == -1) {
-            if (errno == EWOULDBLOCK || errno == EAGAIN) {
-                // Sleep before next iteration
-                usleep(SLEEP_TIME_MICS);
+    const struct ethhdr *eth = (const struct ethhdr *)(frame);
+
+    // Packet was not addressed to this interface or was not IPv6
+    if (compare_mac_add(eth->h_dest, dest_mac) != 0 || 
+            eth->h_proto != htons(ETH_P_IPV6)) {
+        return 0;
+    }
+
+    const struct ip6_hdr *ip6h = (const struct ip6_hdr *)
+            (frame + sizeof(struct ethhdr));
+
+    // Packet was not from target IP address and was not TCP
+    if (ip6h->ip6_nxt != IPPROTO_TCP || compare_ip6_add(
+            (const unsigned char *)&ip6h->ip6_src, tar_ip) != 0) {
+        return 0;
+    }
+
+    const struct tcphdr *th = (const struct tcphdr *)(frame + HDRS_LEN);
+
+    memcpy(&rec->src_ip, tar_ip + IP6_LEN - IP_LEN, IP_LEN);
+    rec->src_port = ntohs(th->source);
+    rec->dst_port = ntohs(th->dest);
+    rec->protocol = IPPROTO_TCP;
+    rec->tcp_flags = ((const unsigned char *)th)[TCP_FLAGS_OFFSET];
+    rec->seq = ntohl(th->seq);
+    rec->ack = ntohl(th->ack_seq);
+
+    int payload_off = HDRS_LEN + th->doff * 4;
+    int payload_end = sizeof(struct ethhdr) + sizeof(struct ip6_hdr) + 
+            ntohs(ip6h->ip6_plen);
+
+    if (payload_end > frame_len) {
+        payload_end = frame_len;
+    }
 
+    rec->payload_off = (unsigned short)payload_off;
+    rec->payload_len = payload_end > payload_off ? 
+            (unsigned short)(payload_end - payload_off) : 0;
+
+    return 1;
+}
+
+void * receive_tcp_replies(void *recv_args) {
+    struct tcp_receiver_args *args = (struct tcp_receiver_args *)recv_args;
+
+    if (DEBUG >= 3) {
+        printf("TCP reply receiving thread created\n");
+    }
+
+    struct transport_frame frames[TRANSPORT_BATCH];
+
+    // Receive timeout in milliseconds (0.2 seconds)
+    const int RECV_TIMEOUT_MS = 200;
+
+    struct reply_record rec;
+
+    const unsigned char timings_enabled = get_timings()->enabled;
+
+    args->error = 0;
+
+    for (;;) {
+        // Once told to stop, drain whatever is left in the transport and exit
+        unsigned char stopping = atomic_load_explicit(args->stop_listening,
+                memory_order_acquire);
+
+        int frames_len = transport_recv_batch(args->transport, frames, 
+                TRANSPORT_BATCH, stopping ? 0 : RECV_TIMEOUT_MS);
+
+        // An error occurred
+        if (frames_len < 0) {
+            args->error = 1;
+
+            break;
+        }
+
+        if (frames_len == 0) {
+            if (stopping) {
+                break;
+            }
+
+            continue;
+        }
+
+        unsigned long long rx_ns = timings_enabled ? get_time_ns() : 0;
+
+        for (int i = 0; i < frames_len; i++) {
+            if (!args->decode(frames[i].data, frames[i].len, args->loc_ip,
+                    args->tar_ip, args->dest_mac, &rec)) {
                 continue;
             }
-            // An error occurred
-            else {
-                return NULL;
+
+            rec.rx_ns = rx_ns;
+
+            stats_inc(&args->stats->receiver.replies_received);
+
+            // Never drop a reply; wait for the consumer to make room
+            while (!reply_ring_push_payload(args->ring, &rec, 
+                    frames[i].data + rec.payload_off)) {
+                sched_yield();
             }
         }
+    }
+
+    reply_ring_close(args->ring);
+
+    return NULL;
+}
+
+void record_probe_rtt(struct scan_state *state, 
+        const struct reply_record *rec) {
+    if (state->probe_sent_ns == NULL || rec->rx_ns == 0) {
+        return;
+    }
+
+    unsigned long long sent_ns = atomic_load_explicit(
+            &state->probe_sent_ns[rec->src_port], memory_order_relaxed);
+
+    if (sent_ns == 0 || rec->rx_ns < sent_ns) {
+        return;
+    }
+
+    hist_record(&get_timings()->probe_rtt, rec->rx_ns - sent_ns);
+}
+
+/*
+ * Marks the port an ICMP error answers filtered if the code says a firewall
+ * or router dropped the probe, as nmap does.  The error must quote the source
+ * port the probe was sent from and its sequence number, 0 or with a handshake
+ * the probe's cookie, so errors about other connections to the target are
+ * ignored.
+ */
+static void handle_icmp_error(struct scan_state *state, 
+        const struct reply_record *rec) {
+    unsigned short src_port = atomic_load_explicit(
+            &state->probe_src_ports[rec->src_port], memory_order_relaxed);
+    unsigned int seq = state->handshake != NULL ? 
+            syn_cookie(state->handshake, rec->dst_port, rec->src_port) : 0;
+
+    if (src_port == 0 || rec->dst_port != src_port || rec->seq != seq) {
+        return;
+    }
+
+    switch (rec->tcp_flags) {
+        case ICMP_NET_UNREACH:
+        case ICMP_HOST_UNREACH:
+        case ICMP_PROT_UNREACH:
+        case ICMP_PORT_UNREACH:
+        case ICMP_NET_ANO:
+        case ICMP_HOST_ANO:
+        case ICMP_PKT_FILTERED:
+            break;
+        default:
+            return;
+    }
+
+    if (state->port_states[rec->src_port] != PORT_STATE_UNKNOWN) {
+        return;
+    }
+
+    record_probe_rtt(state, rec);
+
+    state->port_states[rec->src_port] = PORT_STATE_FILTERED;
+    stats_inc(&state->stats.consumer.filtered);
+
+    if (DEBUG >= 2) {
+        printf("Filtered TCP port detected: %d (ICMP code %d)\n", 
+                rec->src_port, rec->tcp_flags);
+    }
+}
+
+struct open_ports_dto * listen_for_ACK_replies(const unsigned char *loc_ip, 
+        const unsigned char* tar_ip, const unsigned char* dest_mac, 
+        struct transport *t, atomic_uchar *stop_listening, 
+        struct scan_state *state) {
+    if (DEBUG >= 2) {
+        printf("Listening to ACK replies from target IP: %s\n", 
+                get_family_ip_str(state->family, tar_ip));
+    }
+
+    // Banners read by the handshake are carried with their replies
+    struct reply_ring *ring = state->handshake != NULL ? 
+            reply_ring_create_payloads(BANNER_MAX_LEN) : reply_ring_create();
+
+    if (ring == NULL) {
+        errno = EIO;
+
+        return NULL;
+    }
+
+    struct tcp_receiver_args recv_args;
+    memset(&recv_args, 0, sizeof(struct tcp_receiver_args));
+
+    recv_args.loc_ip = loc_ip;
+    recv_args.tar_ip = tar_ip;
+    recv_args.dest_mac = dest_mac;
+    recv_args.stop_listening = stop_listening;
+    recv_args.ring = ring;
+    recv_args.transport = t;
+    recv_args.decode = state->family == AF_INET6 ? decode_tcp6_reply : 
+            decode_tcp_reply;
+    recv_args.stats = &state->stats;
 
-        // Extract ethernet header
-        struct ethhdr *eth = (struct ethhdr *)(rec_buff);
+    set_listen_transport(&state->stats, t);
 
-        unsigned char rec_mac_des[MAC_LEN];
-        for (int i = 0; i < MAC_LEN; i++) {
-            rec_mac_des[i] = eth->h_dest[i];
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, receive_tcp_replies, 
+            (void *)&recv_args) != 0) {
+        set_listen_transport(&state->stats, NULL);
+        reply_ring_free(ring);
+
+        errno = EIO;
+
+        return NULL;
+    }
+
+    unsigned char payload[BANNER_MAX_LEN];
+    unsigned char *rec_payload = state->handshake != NULL ? payload : NULL;
+
+    // Sleep time in microseconds when there is nothing to consume (1 ms)
+    const int SLEEP_TIME_MICS = 1000;
+
+    // Temporary array to hold open port numbers.
+    unsigned short int *open_ports = malloc(sizeof(short int) * MAX_PORT);
+
+    int array_index = 0;
+
+    // Carry over open ports restored from a checkpoint
+    for (int port = 0; port <= MAX_PORT; port++) {
+        if (state->port_states[port] == PORT_STATE_OPEN) {
+            open_ports[array_index++] = (unsigned short int)port;
+        }
+    }
+
+    struct reply_record rec;
+    int pop_ret;
+
+    while ((pop_ret = reply_ring_consume(ring, &rec, rec_payload)) != -1) {
+        // Saved on time however busy the rings are
+        checkpoint_tick(state);
+
+        if (pop_ret == 0) {
+            usleep(SLEEP_TIME_MICS);
+
+            continue;
         }
 
-        // Packet was not addressed to this interface
-        if (compare_mac_add(rec_mac_des, dest_mac) != 0) {
+        // ICMP errors come before the handshake, their codes are not flags
+        if (rec.protocol == IPPROTO_ICMP) {
+            handle_icmp_error(state, &rec);
+
             continue;
         }
-        
-        // Extract IP header
-        struct iphdr *iph = (struct iphdr *)
-                (rec_buff + sizeof(struct ethhdr));
-
-        if (DEBUG >= 3) {
-            printf("IP packet received: ");
-            printf("src: %s ", get_ip_32_str(iph->saddr));
-            printf("proto: %d\n", iph->protocol);
+
+        // Segments of completed handshakes and replies with bad cookies
+        if (state->handshake != NULL && 
+                !handshake_handle_reply(state->handshake, &rec, payload)) {
+            continue;
         }
 
-        // Packet was not from target IP address and was not TCP
-        if ((compare_ip_add(get_ip_32_arr(iph->saddr), tar_ip) != 0) ||
-                (iph->protocol != 6)) {
+        // Ports already classified, so retransmitted SYN-ACKs are only counted
+        // once
+        if (state->port_states[rec.src_port] != PORT_STATE_UNKNOWN) {
             continue;
         }
 
-        // Extract TCP header
-        struct tcphdr *th = (struct tcphdr *)(rec_buff + 
-                sizeof(struct ethhdr) + sizeof(struct iphdr));
+        record_probe_rtt(state, &rec);
+
+        if (rec.tcp_flags & TH_RST) {
+            state->port_states[rec.src_port] = PORT_STATE_CLOSED;
+            stats_inc(&state->stats.consumer.closed);
+
+            continue;
+        }
 
         // Check that packet was an ACK with no RESET flag
-        if ((th->ack != 1) || th->rst == 1) {
+        if (!(rec.tcp_flags & TH_ACK)) {
             continue;
         }
 
+        state->port_states[rec.src_port] = PORT_STATE_OPEN;
+        stats_inc(&state->stats.consumer.open);
+
         if (DEBUG >= 2) {
-            printf("Open TCP port detected: %d\n", htons(th->source));
+            printf("Open TCP port detected: %d\n", rec.src_port);
         }
 
-        open_ports[array_index] = (unsigned short int)htons(th->source);
+        open_ports[array_index] = rec.src_port;
 
         array_index++;
     }
 
-    // Find real length of open_ports array
-    int open_ports_len = array_index;
+    pthread_join(tid, NULL);
+
+    set_listen_transport(&state->stats, NULL);
+    reply_ring_free(ring);
+
+    if (recv_args.error) {
+        free(open_ports);
+
+        errno = EIO;
 
-    // No open ports found
-    if (open_ports_len == 0) {
         return NULL;
     }
 
+    // Find real length of open_ports array
+    int open_ports_len = array_index;
+
     // Realloc array
-    open_ports = realloc(open_ports, open_ports_len * sizeof(short int));
+    if (open_ports_len > 0) {
+        open_ports = realloc(open_ports, open_ports_len * sizeof(short int));
 
-    if (open_ports == NULL) {
-        return NULL;
+        if (open_ports == NULL) {
+            return NULL;
+        }
     }
 
     struct open_ports_dto *open_ports_struct = malloc(
@@ -1,8 +1,76 @@
+#include <stdatomic.h>
+
+#include "ring_buffer.h"
+#include "checkpoint_service.h"
+
+// Offset of the flags byte within the TCP header
+#define TCP_FLAGS_OFFSET 13
+
+// Length of an IPv6 SYN probe (ethernet, IPv6 and TCP headers)
+#define SYN6_FRAME_LEN 74
+
+/*
+ * Struct: syn6_template
+ * ---------------------
+ * A prebuilt IPv6 SYN probe frame with zero ports.  IPv6 has no header 
+ * checksum, so stamping a probe only copies the frame, sets the ports and 
+ * finishes the TCP checksum.
+ *
+ * frame: The frame.
+ *
+ * sum: The unfolded TCP checksum sum of the frame without its ports.
+ */
+struct syn6_template {
+    unsigned char frame[SYN6_FRAME_LEN];
+    unsigned long sum;
+};
+
 struct open_ports_dto {
     unsigned short int *open_ports;
     unsigned int open_ports_len;
 };
 
+// Decodes a received frame in to a reply record, see decode_tcp_reply
+typedef int (*reply_decoder)(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec);
+
+/*
+ * Struct: tcp_receiver_args
+ * -------------------------
+ * Arguments for the receive_tcp_replies() thread.
+ *
+ * loc_ip: The local IP address probes are sent from in array format, or
+ *         NULL to ignore ICMP errors.
+ *
+ * tar_ip: The target IP address in array format.
+ *
+ * dest_mac: The local MAC address replies must be addressed to.
+ *
+ * stop_listening: Set (with release semantics) once all probes were sent.
+ *
+ * ring: The ring decoded replies are pushed on to.
+ *
+ * transport: The transport to drain.
+ *
+ * decode: Decodes the frames worth pushing on to the ring.
+ *
+ * stats: The scan statistics.
+ *
+ * error: Set to 1 by the thread if the transport failed.
+ */
+struct tcp_receiver_args {
+    const unsigned char *loc_ip;
+    const unsigned char *tar_ip;
+    const unsigned char *dest_mac;
+    atomic_uchar *stop_listening;
+    struct reply_ring *ring;
+    struct transport *transport;
+    reply_decoder decode;
+    struct scan_stats *stats;
+    int error;
+};
+
 /*
  * Function: construct_syn_packet
  * ------------------------------
@@ -26,10 +94,121 @@ unsigned char * construct_syn_packet(const char *src_ip, const char *dst_ip,
         const unsigned char *src_mac, const unsigned char *dst_mac, 
         unsigned short int src_port, unsigned short int dst_port);
 
+/*
+ * Function: init_syn6_template
+ * ----------------------------
+ * Builds an IPv6 SYN probe template.
+ * 
+ * tmpl: The template to build.
+ * 
+ * src_ip: The source IPv6 address in array format.
+ * 
+ * dst_ip: The destination IPv6 address in array format.
+ * 
+ * src_mac: The source MAC address represented as an array.
+ * 
+ * dst_mac: The destination MAC address represented as an array.
+ */
+void init_syn6_template(struct syn6_template *tmpl, 
+        const unsigned char *src_ip, const unsigned char *dst_ip, 
+        const unsigned char *src_mac, const unsigned char *dst_mac);
+
+/*
+ * Function: stamp_syn6_probe
+ * --------------------------
+ * Copies a template in to a probe frame for a pair of ports.
+ * 
+ * tmpl: The template.
+ * 
+ * src_port: The source port.
+ * 
+ * dst_port: The destination port.
+ * 
+ * frame: A buffer of at least SYN6_FRAME_LEN bytes.
+ * 
+ * return: The length of the frame.
+ */
+int stamp_syn6_probe(const struct syn6_template *tmpl, 
+        unsigned short src_port, unsigned short dst_port, 
+        unsigned char *frame);
+
+/*
+ * Function: decode_tcp_reply
+ * --------------------------
+ * Decodes a received ethernet frame in to a reply record if it is a TCP 
+ * segment from the target addressed to the local interface, or an ICMP 
+ * destination unreachable error quoting a probe from the local address to the
+ * target.  Errors are recorded with protocol IPPROTO_ICMP, the ICMP code in 
+ * place of the TCP flags and the quoted sequence number.
+ * 
+ * frame: The received ethernet frame.
+ * 
+ * frame_len: The length of the frame in bytes.
+ * 
+ * loc_ip: The local IP address in array format, or NULL to ignore ICMP
+ *         errors.
+ * 
+ * tar_ip: The target IP address in array format.
+ * 
+ * dest_mac: The local MAC address in array format.
+ * 
+ * rec: Populated with the decoded reply.
+ * 
+ * return: 1 if the frame was decoded, or 0 if it should be ignored.
+ */
+int decode_tcp_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec);
+
+/*
+ * Function: decode_tcp6_reply
+ * ---------------------------
+ * The IPv6 counterpart of decode_tcp_reply.  tar_ip is an IPv6 address and
+ * the record's src_ip holds its low 32 bits.  Replies carrying IPv6 extension
+ * headers and ICMPv6 errors are ignored, so loc_ip is unused.
+ */
+int decode_tcp6_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec);
+
+/*
+ * Function: receive_tcp_replies
+ * -----------------------------
+ * Drains the raw socket, decodes replies and pushes them on to the reply
+ * ring.  Does no classification so the socket is emptied as fast as possible.
+ * Closes the ring once stop_listening is set and the socket is empty.
+ * 
+ * recv_args: A struct tcp_receiver_args structure cast as (void *).
+ * 
+ * return: NULL.
+ */
+void * receive_tcp_replies(void *recv_args);
+
+/*
+ * Function: record_probe_rtt
+ * --------------------------
+ * Records the round trip time of the probe a reply answers, if timings are
+ * enabled.
+ * 
+ * state: The scan state holding the probe send times.
+ * 
+ * rec: The reply.
+ */
+void record_probe_rtt(struct scan_state *state, 
+        const struct reply_record *rec);
+
 /*
  * Function: listen_for_ACK_replies
  * --------------------------------
  * Listens for ACK TCP packets which are destined for the src_mac address.
+ * Replies are received on a separate thread and classified here as they are
+ * popped from the reply ring.  Ports whose probes an ICMP error reports as 
+ * unreachable or administratively prohibited are marked filtered at once, if
+ * the error quotes the source port and sequence number the probe was sent
+ * with.
+ * 
+ * loc_ip: The local IP address probes are sent from in array format, or NULL
+ *         to ignore ICMP errors.
  * 
  * tar_ip: The target IP address represented in array format that the function
  *         will listen to replies from.
@@ -37,11 +216,20 @@ unsigned char * construct_syn_packet(const char *src_ip, const char *dst_ip,
  * dest_mac: The MAC address we use to filter out unwanted packets not meant
  *           for this interface.
  * 
+ * t: The transport to receive replies on, opened before the first probe was 
+ *    sent.
+ * 
  * stop_listening: A variable indicating whether to stop listening for packets
  *                 and return.
  * 
- * return: A unsigned short int array of open ports or NULL on error or no ports
- *         found. errno is set to EIO(5) on error.
-  */
-struct open_ports_dto * listen_for_ACK_replies(const unsigned char* tar_ip, 
-        const unsigned char* dest_mac, unsigned char *stop_listening);
\ No newline at end of file
+ * state: The scan state.  Classified ports are recorded in its port state
+ *        table and checkpoints are written periodically.  Its family selects
+ *        the IPv4 or IPv6 decoder.
+ * 
+ * return: The open ports found, or NULL on error.  errno is set to EIO(5) on
+ *         error.
+ */
+struct open_ports_dto * listen_for_ACK_replies(const unsigned char *loc_ip, 
+        const unsigned char* tar_ip, const unsigned char* dest_mac, 
+        struct transport *t, atomic_uchar *stop_listening, 
+        struct scan_state *state);
\ No newline at end of file
@@ -0,0 +1,763 @@
+// sendmmsg and recvmmsg
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+#include <linux/if_ether.h>
+#include <arpa/inet.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "transport_service.h"
+#include "pcap_service.h"
+#include "sim_service.h"
+#include "histogram_service.h"
+#include "../constants/constants.h"
+
+// The configured backend, shared by every transport
+static struct {
+    enum transport_kind kind;
+    struct pcap_writer *pcap_out;
+    char *pcap_in_path;
+    struct sim_target *sim;
+    pthread_mutex_t lock;
+} backend = {
+    .kind = TRANSPORT_RAW,
+    .pcap_out = NULL,
+    .pcap_in_path = NULL,
+    .sim = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER
+};
+
+static int configure_pcap(const char *files) {
+    const int MAX_PATH = 4096;
+    char out_path[MAX_PATH];
+
+    const char *in_path = strchr(files, ',');
+    int out_len = in_path ? (int)(in_path - files) : (int)strlen(files);
+
+    if (out_len >= MAX_PATH) {
+        return -1;
+    }
+
+    memcpy(out_path, files, out_len);
+    out_path[out_len] = '\0';
+
+    if (out_len > 0) {
+        backend.pcap_out = pcap_writer_open(out_path);
+
+        if (backend.pcap_out == NULL) {
+            return -1;
+        }
+    }
+
+    if (in_path != NULL && in_path[1] != '\0') {
+        // Every receiving transport replays the file, check it once up front
+        struct pcap_reader *reader = pcap_reader_open(in_path + 1);
+
+        if (reader == NULL) {
+            return -1;
+        }
+
+        pcap_reader_close(reader);
+        backend.pcap_in_path = strdup(in_path + 1);
+    }
+
+    return 0;
+}
+
+static int configure_sim(const char *options) {
+    char *options_copy = strdup(options);
+    const char **sim_argv = malloc(sizeof(char *) * (strlen(options) + 1));
+    int sim_argc = 0;
+
+    char *save_ptr;
+
+    for (char *token = strtok_r(options_copy, " ", &save_ptr); token != NULL;
+            token = strtok_r(NULL, " ", &save_ptr)) {
+        sim_argv[sim_argc++] = token;
+    }
+
+    backend.sim = sim_create_from_args(sim_argc, sim_argv);
+
+    free(sim_argv);
+    free(options_copy);
+
+    return backend.sim ? 0 : -1;
+}
+
+int transport_configure(const char *spec) {
+    const char *PCAP_PREFIX = "pcap:";
+    const char *SIM_PREFIX = "sim:";
+
+    if (strcmp(spec, "raw") == 0) {
+        backend.kind = TRANSPORT_RAW;
+    } else if (strcmp(spec, "ring") == 0) {
+        backend.kind = TRANSPORT_RING;
+    } else if (strncmp(spec, PCAP_PREFIX, strlen(PCAP_PREFIX)) == 0) {
+        backend.kind = TRANSPORT_PCAP;
+
+        return configure_pcap(spec + strlen(PCAP_PREFIX));
+    } else if (strncmp(spec, SIM_PREFIX, strlen(SIM_PREFIX)) == 0) {
+        backend.kind = TRANSPORT_SIM;
+
+        return configure_sim(spec + strlen(SIM_PREFIX));
+    } else {
+        fprintf(stderr, "ERROR: Unknown transport: %s\n", spec);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int transport_shutdown() {
+    int ret = pcap_writer_close(backend.pcap_out);
+
+    free(backend.pcap_in_path);
+    sim_free(backend.sim);
+
+    backend.pcap_out = NULL;
+    backend.pcap_in_path = NULL;
+    backend.sim = NULL;
+
+    return ret;
+}
+
+enum transport_kind transport_get_kind() {
+    return backend.kind;
+}
+
+static unsigned long long get_real_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void sleep_ns(unsigned long long ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ULL;
+    ts.tv_nsec = ns % 1000000000ULL;
+
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Function: open_packet_socket
+ * ----------------------------
+ * Opens an AF_PACKET socket bound to the transport's interface and protocol.
+ *
+ * return: The socket, or -1 on error.
+ */
+static int open_packet_socket(struct transport *t) {
+    int sock = socket(AF_PACKET, SOCK_RAW, htons(t->protocol));
+
+    if (sock < 0) {
+        fprintf(stderr, "ERROR: Cannot open raw socket!\n");
+
+        return -1;
+    }
+
+    if (t->protocol != 0) {
+        // Our own probes are of no interest to the receive path
+        int ignore = 1;
+        setsockopt(sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore,
+                sizeof(int));
+
+        int rcvbuf = TRANSPORT_RCVBUF;
+
+        if (setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf,
+                sizeof(int)) < 0) {
+            setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(int));
+        }
+    }
+
+    return sock;
+}
+
+static int bind_packet_socket(struct transport *t) {
+    struct sockaddr_ll sadr_ll;
+    memset(&sadr_ll, 0, sizeof(struct sockaddr_ll));
+
+    sadr_ll.sll_family = AF_PACKET;
+    sadr_ll.sll_protocol = htons(t->protocol);
+    sadr_ll.sll_ifindex = t->if_index;
+
+    if (bind(t->fd, (struct sockaddr *)&sadr_ll,
+            sizeof(struct sockaddr_ll)) < 0) {
+        fprintf(stderr, "ERROR: Cannot bind raw socket to interface %d!\n",
+                t->if_index);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+static int open_ring(struct transport *t) {
+    int version = TPACKET_V2;
+
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_VERSION, &version,
+            sizeof(int)) < 0) {
+        fprintf(stderr, "ERROR: TPACKET_V2 is not supported!\n");
+
+        return -1;
+    }
+
+    struct tpacket_req req;
+    memset(&req, 0, sizeof(struct tpacket_req));
+
+    req.tp_block_size = TRANSPORT_RING_BLOCK_SZ;
+    req.tp_frame_size = TRANSPORT_RING_FRAME_SZ;
+
+    unsigned int frames_per_block =
+            TRANSPORT_RING_BLOCK_SZ / TRANSPORT_RING_FRAME_SZ;
+    unsigned long rx_len = 0;
+
+    if (t->protocol != 0) {
+        req.tp_block_nr = TRANSPORT_RX_RING_BLOCKS;
+        req.tp_frame_nr = TRANSPORT_RX_RING_BLOCKS * frames_per_block;
+
+        if (setsockopt(t->fd, SOL_PACKET, PACKET_RX_RING, &req,
+                sizeof(struct tpacket_req)) < 0) {
+            fprintf(stderr, "ERROR: Cannot create PACKET_RX_RING!\n");
+
+            return -1;
+        }
+
+        t->rx_frames = req.tp_frame_nr;
+        rx_len = (unsigned long)req.tp_block_nr * req.tp_block_size;
+    }
+
+    req.tp_block_nr = TRANSPORT_TX_RING_BLOCKS;
+    req.tp_frame_nr = TRANSPORT_TX_RING_BLOCKS * frames_per_block;
+
+    if (setsockopt(t->fd, SOL_PACKET, PACKET_TX_RING, &req,
+            sizeof(struct tpacket_req)) < 0) {
+        fprintf(stderr, "ERROR: Cannot create PACKET_TX_RING!\n");
+
+        return -1;
+    }
+
+    t->tx_frames = req.tp_frame_nr;
+
+    // The RX ring is mapped first, followed by the TX ring
+    t->ring_len = rx_len + (unsigned long)req.tp_block_nr * req.tp_block_size;
+    t->ring = mmap(NULL, t->ring_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+            t->fd, 0);
+
+    if (t->ring == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Cannot map packet ring!\n");
+        t->ring = NULL;
+
+        return -1;
+    }
+
+    t->tx_ring = t->ring + rx_len;
+
+    return 0;
+}
+
+struct transport * transport_open(int if_index, const unsigned char *src_mac,
+        unsigned short protocol) {
+    struct transport *t = malloc(sizeof(struct transport));
+
+    if (t == NULL) {
+        return NULL;
+    }
+
+    memset(t, 0, sizeof(struct transport));
+
+    t->kind = backend.kind;
+    t->fd = -1;
+    t->if_index = if_index;
+    t->protocol = protocol;
+    memcpy(t->src_mac, src_mac, MAC_LEN);
+
+    atomic_init(&t->sent, 0);
+    atomic_init(&t->send_errors, 0);
+    atomic_init(&t->received, 0);
+
+    if (t->kind == TRANSPORT_RAW || t->kind == TRANSPORT_RING) {
+        t->fd = open_packet_socket(t);
+
+        if (t->fd < 0 || (t->kind == TRANSPORT_RING && open_ring(t) < 0) ||
+                bind_packet_socket(t) < 0) {
+            transport_close(t);
+
+            return NULL;
+        }
+    }
+
+    if (t->kind == TRANSPORT_RAW && protocol != 0) {
+        t->rx_buff = malloc(TRANSPORT_BATCH * TRANSPORT_FRAME_SZ);
+    } else if (t->kind == TRANSPORT_SIM) {
+        t->rx_buff = malloc(TRANSPORT_BATCH * sizeof(struct sim_event));
+    } else if (t->kind == TRANSPORT_PCAP && protocol != 0 && 
+            backend.pcap_in_path != NULL) {
+        // Like a socket, each receiving transport sees every input frame
+        t->pcap_in = pcap_reader_open(backend.pcap_in_path);
+
+        if (t->pcap_in == NULL) {
+            transport_close(t);
+
+            return NULL;
+        }
+    }
+
+    return t;
+}
+
+static int send_raw(struct transport *t, const struct transport_frame *frames,
+        int frames_len) {
+    struct sockaddr_ll sadr_ll;
+    memset(&sadr_ll, 0, sizeof(struct sockaddr_ll));
+
+    sadr_ll.sll_ifindex = t->if_index;
+    sadr_ll.sll_halen = ETH_ALEN;
+    memcpy(sadr_ll.sll_addr, t->src_mac, MAC_LEN);
+
+    struct mmsghdr msgs[TRANSPORT_BATCH];
+    struct iovec iovs[TRANSPORT_BATCH];
+
+    int sent = 0;
+
+    while (sent < frames_len) {
+        int batch_len = frames_len - sent;
+
+        if (batch_len > TRANSPORT_BATCH) {
+            batch_len = TRANSPORT_BATCH;
+        }
+
+        memset(msgs, 0, sizeof(struct mmsghdr) * batch_len);
+
+        for (int i = 0; i < batch_len; i++) {
+            iovs[i].iov_base = (void *)frames[sent + i].data;
+            iovs[i].iov_len = frames[sent + i].len;
+
+            msgs[i].msg_hdr.msg_name = &sadr_ll;
+            msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_ll);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+
+        int ret = sendmmsg(t->fd, msgs, batch_len, 0);
+
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "ERROR: Cannot send packet!\n");
+            break;
+        }
+
+        sent += ret;
+    }
+
+    return sent;
+}
+
+static struct tpacket2_hdr * get_ring_frame(unsigned char *ring,
+        unsigned int index) {
+    const unsigned int FRAMES_PER_BLOCK =
+            TRANSPORT_RING_BLOCK_SZ / TRANSPORT_RING_FRAME_SZ;
+
+    return (struct tpacket2_hdr *)(ring +
+            (unsigned long)(index / FRAMES_PER_BLOCK) *
+            TRANSPORT_RING_BLOCK_SZ +
+            (index % FRAMES_PER_BLOCK) * TRANSPORT_RING_FRAME_SZ);
+}
+
+static int send_ring(struct transport *t, const struct transport_frame *frames,
+        int frames_len) {
+    const int MAX_DATA_LEN = TRANSPORT_RING_FRAME_SZ - TPACKET2_HDRLEN;
+
+    int queued = 0;
+
+    for (int i = 0; i < frames_len; i++) {
+        struct tpacket2_hdr *hdr = get_ring_frame(t->tx_ring, t->tx_head);
+
+        // The ring is full, wait for the kernel to send the queued frames
+        if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) !=
+                TP_STATUS_AVAILABLE) {
+            send(t->fd, NULL, 0, 0);
+
+            if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) ==
+                    TP_STATUS_WRONG_FORMAT) {
+                __atomic_store_n(&hdr->tp_status, TP_STATUS_AVAILABLE,
+                        __ATOMIC_RELEASE);
+            }
+
+            if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) !=
+                    TP_STATUS_AVAILABLE) {
+                break;
+            }
+        }
+
+        if (frames[i].len > MAX_DATA_LEN) {
+            break;
+        }
+
+        unsigned char *data = (unsigned char *)hdr + TPACKET2_HDRLEN -
+                sizeof(struct sockaddr_ll);
+
+        memcpy(data, frames[i].data, frames[i].len);
+        hdr->tp_len = frames[i].len;
+
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+                __ATOMIC_RELEASE);
+
+        t->tx_head = (t->tx_head + 1) % t->tx_frames;
+        queued++;
+    }
+
+    // Blocks until every queued frame was handed to the device
+    if (queued > 0 && send(t->fd, NULL, 0, 0) < 0) {
+        fprintf(stderr, "ERROR: Cannot send packet!\n");
+
+        return 0;
+    }
+
+    return queued;
+}
+
+static int send_pcap(struct transport *t, const struct transport_frame *frames,
+        int frames_len) {
+    (void)t;
+
+    int sent = 0;
+
+    pthread_mutex_lock(&backend.lock);
+
+    if (backend.pcap_out == NULL) {
+        sent = frames_len;
+    } else {
+        unsigned long long now = get_real_time_ns();
+
+        for (; sent < frames_len; sent++) {
+            if (pcap_writer_write(backend.pcap_out, frames[sent].data,
+                    frames[sent].len, now) < 0) {
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&backend.lock);
+
+    return sent;
+}
+
+static int send_sim(struct transport *t, const struct transport_frame *frames,
+        int frames_len) {
+    (void)t;
+
+    pthread_mutex_lock(&backend.lock);
+
+    unsigned long long now = get_time_ns();
+
+    for (int i = 0; i < frames_len; i++) {
+        sim_handle_frame(backend.sim, frames[i].data, frames[i].len, now);
+    }
+
+    pthread_mutex_unlock(&backend.lock);
+
+    return frames_len;
+}
+
+int transport_send_batch(struct transport *t,
+        const struct transport_frame *frames, int frames_len) {
+    int sent = 0;
+
+    switch (t->kind) {
+        case TRANSPORT_RAW:
+            sent = send_raw(t, frames, frames_len);
+            break;
+        case TRANSPORT_RING:
+            sent = send_ring(t, frames, frames_len);
+            break;
+        case TRANSPORT_PCAP:
+            sent = send_pcap(t, frames, frames_len);
+            break;
+        case TRANSPORT_SIM:
+            sent = send_sim(t, frames, frames_len);
+            break;
+    }
+
+    atomic_fetch_add_explicit(&t->sent, sent, memory_order_relaxed);
+    atomic_fetch_add_explicit(&t->send_errors, frames_len - sent,
+            memory_order_relaxed);
+
+    if (sent == 0 && frames_len > 0) {
+        return -1;
+    }
+
+    return sent;
+}
+
+int transport_send(struct transport *t, const unsigned char *frame,
+        int frame_len) {
+    struct transport_frame tf = { .data = frame, .len = frame_len };
+
+    return transport_send_batch(t, &tf, 1) == 1 ? 0 : -1;
+}
+
+static int wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    int ret = poll(&pfd, 1, timeout_ms);
+
+    if (ret < 0 && errno == EINTR) {
+        return 0;
+    }
+
+    return ret;
+}
+
+static int recv_raw(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms) {
+    struct mmsghdr msgs[TRANSPORT_BATCH];
+    struct iovec iovs[TRANSPORT_BATCH];
+
+    memset(msgs, 0, sizeof(struct mmsghdr) * frames_len);
+
+    for (int i = 0; i < frames_len; i++) {
+        iovs[i].iov_base = t->rx_buff + i * TRANSPORT_FRAME_SZ;
+        iovs[i].iov_len = TRANSPORT_FRAME_SZ;
+
+        msgs[i].msg_hdr.msg_iov = &iovs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int ret = recvmmsg(t->fd, msgs, frames_len, MSG_DONTWAIT, NULL);
+
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+            timeout_ms > 0) {
+        int poll_ret = wait_readable(t->fd, timeout_ms);
+
+        if (poll_ret <= 0) {
+            return poll_ret;
+        }
+
+        ret = recvmmsg(t->fd, msgs, frames_len, MSG_DONTWAIT, NULL);
+    }
+
+    if (ret < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+
+        return -1;
+    }
+
+    for (int i = 0; i < ret; i++) {
+        frames[i].data = iovs[i].iov_base;
+        frames[i].len = msgs[i].msg_len;
+    }
+
+    return ret;
+}
+
+static int recv_ring(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms) {
+    // Hand the frames of the previous batch back to the kernel
+    while (t->rx_release != t->rx_head) {
+        struct tpacket2_hdr *hdr = get_ring_frame(t->ring, t->rx_release);
+
+        __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        t->rx_release = (t->rx_release + 1) % t->rx_frames;
+    }
+
+    int received = 0;
+
+    for (int attempt = 0; attempt < 2 && received == 0; attempt++) {
+        if (attempt == 1) {
+            if (timeout_ms <= 0 || wait_readable(t->fd, timeout_ms) <= 0) {
+                break;
+            }
+        }
+
+        while (received < frames_len) {
+            struct tpacket2_hdr *hdr = get_ring_frame(t->ring, t->rx_head);
+
+            if (!(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) &
+                    TP_STATUS_USER)) {
+                break;
+            }
+
+            frames[received].data = (unsigned char *)hdr + hdr->tp_mac;
+            frames[received].len = hdr->tp_snaplen;
+
+            t->rx_head = (t->rx_head + 1) % t->rx_frames;
+            received++;
+        }
+    }
+
+    return received;
+}
+
+static int recv_pcap(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms) {
+    int received = 0;
+
+    while (t->pcap_in != NULL && received < frames_len) {
+        const unsigned char *frame;
+        int frame_len;
+
+        if (pcap_reader_next(t->pcap_in, &frame, &frame_len, NULL) != 1) {
+            break;
+        }
+
+        // Apply the protocol filter of the bound socket
+        if (t->protocol != ETH_P_ALL && (frame_len < ETH_HLEN || 
+                ntohs(((const struct ethhdr *)frame)->h_proto) != 
+                t->protocol)) {
+            continue;
+        }
+
+        frames[received].data = frame;
+        frames[received].len = frame_len;
+        received++;
+    }
+
+    // Nothing left to read, behave like an idle link
+    if (received == 0 && timeout_ms > 0) {
+        sleep_ns(timeout_ms * 1000000ULL);
+    }
+
+    return received;
+}
+
+static int recv_sim(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms) {
+    struct sim_event *events = (struct sim_event *)t->rx_buff;
+
+    unsigned long long deadline = get_time_ns() + timeout_ms * 1000000ULL;
+    int received = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&backend.lock);
+
+        unsigned long long now = get_time_ns();
+
+        while (received < frames_len &&
+                sim_pop_due(backend.sim, now, &events[received])) {
+            frames[received].data = events[received].frame;
+            frames[received].len = events[received].frame_len;
+            received++;
+        }
+
+        unsigned long long next_due = sim_next_due(backend.sim);
+
+        pthread_mutex_unlock(&backend.lock);
+
+        if (received > 0 || now >= deadline) {
+            break;
+        }
+
+        // Sleep until the next reply is due, without missing one queued by a
+        // concurrent send for longer than a millisecond
+        unsigned long long wake = deadline;
+
+        if (next_due != 0 && next_due < wake) {
+            wake = next_due;
+        }
+
+        if (wake > now + 1000000ULL) {
+            wake = now + 1000000ULL;
+        }
+
+        sleep_ns(wake - now);
+    }
+
+    return received;
+}
+
+int transport_recv_batch(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms) {
+    if (t->protocol == 0) {
+        return -1;
+    }
+
+    if (frames_len > TRANSPORT_BATCH) {
+        frames_len = TRANSPORT_BATCH;
+    }
+
+    int received = 0;
+
+    switch (t->kind) {
+        case TRANSPORT_RAW:
+            received = recv_raw(t, frames, frames_len, timeout_ms);
+            break;
+        case TRANSPORT_RING:
+            received = recv_ring(t, frames, frames_len, timeout_ms);
+            break;
+        case TRANSPORT_PCAP:
+            received = recv_pcap(t, frames, frames_len, timeout_ms);
+            break;
+        case TRANSPORT_SIM:
+            received = recv_sim(t, frames, frames_len, timeout_ms);
+            break;
+    }
+
+    if (received > 0) {
+        atomic_fetch_add_explicit(&t->received, received,
+                memory_order_relaxed);
+    }
+
+    return received;
+}
+
+void transport_get_stats(struct transport *t, struct transport_stats *stats) {
+    // The kernel resets PACKET_STATISTICS on every read
+    if (t->fd >= 0 && t->protocol != 0) {
+        struct tpacket_stats kstats;
+        socklen_t kstats_len = sizeof(struct tpacket_stats);
+
+        if (getsockopt(t->fd, SOL_PACKET, PACKET_STATISTICS, &kstats,
+                &kstats_len) == 0) {
+            t->kernel_packets += kstats.tp_packets;
+            t->kernel_drops += kstats.tp_drops;
+        }
+    }
+
+    stats->sent = atomic_load_explicit(&t->sent, memory_order_relaxed);
+    stats->send_errors = atomic_load_explicit(&t->send_errors,
+            memory_order_relaxed);
+    stats->received = atomic_load_explicit(&t->received,
+            memory_order_relaxed);
+    stats->kernel_packets = t->kernel_packets;
+    stats->kernel_drops = t->kernel_drops;
+}
+
+void transport_close(struct transport *t) {
+    if (t == NULL) {
+        return;
+    }
+
+    if (t->ring != NULL) {
+        munmap(t->ring, t->ring_len);
+    }
+
+    if (t->fd >= 0) {
+        close(t->fd);
+    }
+
+    pcap_reader_close(t->pcap_in);
+    free(t->rx_buff);
+    free(t);
+}
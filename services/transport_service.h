@@ -0,0 +1,225 @@
+#ifndef TRANSPORT_SERVICE_H
+#define TRANSPORT_SERVICE_H
+
+#include <stdatomic.h>
+
+#include "../constants/constants.h"
+
+struct pcap_reader;
+
+// Maximum number of frames moved by one batch
+#define TRANSPORT_BATCH 64
+
+// Receive buffer per frame of the raw backend.  Replies are only parsed up to
+// the TCP header so longer frames are truncated.
+#define TRANSPORT_FRAME_SZ 2048
+
+// Socket receive buffer of receiving raw transports
+#define TRANSPORT_RCVBUF (4 * 1024 * 1024)
+
+// Ring backend geometry (TPACKET_V2)
+#define TRANSPORT_RING_FRAME_SZ 2048
+#define TRANSPORT_RING_BLOCK_SZ (64 * 1024)
+#define TRANSPORT_RX_RING_BLOCKS 64
+#define TRANSPORT_TX_RING_BLOCKS 8
+
+/*
+ * Enum: transport_kind
+ * --------------------
+ * TRANSPORT_RAW: AF_PACKET socket with sendmmsg and recvmmsg.
+ *
+ * TRANSPORT_RING: AF_PACKET socket with mmap'd PACKET_TX_RING and 
+ *                 PACKET_RX_RING.
+ *
+ * TRANSPORT_PCAP: Sent frames are written to a pcap file and received frames 
+ *                 are read from a pcap file.
+ *
+ * TRANSPORT_SIM: In-memory loopback to a simulated network (sim_service).
+ */
+enum transport_kind {
+    TRANSPORT_RAW,
+    TRANSPORT_RING,
+    TRANSPORT_PCAP,
+    TRANSPORT_SIM
+};
+
+/*
+ * Struct: transport_frame
+ * -----------------------
+ * A frame to send, or a received frame.  Received frames remain valid until
+ * the next receive on the same transport.
+ */
+struct transport_frame {
+    const unsigned char *data;
+    int len;
+};
+
+/*
+ * Struct: transport_stats
+ * -----------------------
+ * sent: Frames sent.
+ *
+ * send_errors: Frames that could not be sent.
+ *
+ * received: Frames received.
+ *
+ * kernel_packets: Frames seen by the socket (PACKET_STATISTICS).
+ *
+ * kernel_drops: Frames dropped by the socket (PACKET_STATISTICS).
+ */
+struct transport_stats {
+    unsigned long sent;
+    unsigned long send_errors;
+    unsigned long received;
+    unsigned long kernel_packets;
+    unsigned long kernel_drops;
+};
+
+/*
+ * Struct: transport
+ * -----------------
+ * An open transport.  A transport is used by one thread, only 
+ * transport_get_stats may be called from another.
+ */
+struct transport {
+    enum transport_kind kind;
+    int fd;
+    int if_index;
+    unsigned short protocol;
+    unsigned char src_mac[MAC_LEN];
+
+    atomic_ulong sent;
+    atomic_ulong send_errors;
+    atomic_ulong received;
+    unsigned long kernel_packets;
+    unsigned long kernel_drops;
+
+    // Raw and simulated backends
+    unsigned char *rx_buff;
+
+    // Pcap backend
+    struct pcap_reader *pcap_in;
+
+    // Ring backend
+    unsigned char *ring;
+    unsigned long ring_len;
+    unsigned char *tx_ring;
+    unsigned int rx_frames;
+    unsigned int rx_head;
+    unsigned int rx_release;
+    unsigned int tx_frames;
+    unsigned int tx_head;
+};
+
+/*
+ * Function: transport_configure
+ * -----------------------------
+ * Selects the backend used by every transport opened afterwards.
+ *
+ * spec: One of:
+ *       "raw" (the default),
+ *       "ring",
+ *       "pcap:<out.pcap>[,<in.pcap>]", writing sent frames to out.pcap and 
+ *       receiving the frames of in.pcap (either may be empty),
+ *       "sim:<options>", a simulated network with the space separated 
+ *       options of mports-sim, e.g. "sim:-host 10.0.0.0/24 -open 22,80".
+ *
+ * return: 0 on success, -1 if the spec is invalid.
+ */
+int transport_configure(const char *spec);
+
+/*
+ * Function: transport_shutdown
+ * ----------------------------
+ * Closes the pcap files or simulated network of the configured backend.
+ *
+ * return: 0 on success, -1 if the pcap file could not be written.
+ */
+int transport_shutdown();
+
+/*
+ * Function: transport_get_kind
+ * ----------------------------
+ * return: The configured backend.
+ */
+enum transport_kind transport_get_kind();
+
+/*
+ * Function: transport_open
+ * ------------------------
+ * Opens a transport on an interface.
+ *
+ * if_index: The interface index.
+ *
+ * src_mac: The interface MAC address.
+ *
+ * protocol: Ethertype to receive (e.g. ETH_P_IP), or 0 to only send.
+ *
+ * return: A new transport, or NULL on error.
+ */
+struct transport * transport_open(int if_index, const unsigned char *src_mac,
+        unsigned short protocol);
+
+/*
+ * Function: transport_send_batch
+ * ------------------------------
+ * Sends frames.
+ *
+ * t: The transport.
+ *
+ * frames: The frames to send.
+ *
+ * frames_len: The number of frames.
+ *
+ * return: The number of frames sent, or -1 if none could be sent.
+ */
+int transport_send_batch(struct transport *t, 
+        const struct transport_frame *frames, int frames_len);
+
+/*
+ * Function: transport_send
+ * ------------------------
+ * Sends a single frame.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int transport_send(struct transport *t, const unsigned char *frame, 
+        int frame_len);
+
+/*
+ * Function: transport_recv_batch
+ * ------------------------------
+ * Receives up to frames_len frames, waiting up to timeout_ms for the first.
+ *
+ * t: The transport.
+ *
+ * frames: Populated with the received frames.
+ *
+ * frames_len: The maximum number of frames, at most TRANSPORT_BATCH.
+ *
+ * timeout_ms: Milliseconds to wait, 0 to return immediately.
+ *
+ * return: The number of frames received (0 on timeout), or -1 on error.
+ */
+int transport_recv_batch(struct transport *t, struct transport_frame *frames,
+        int frames_len, int timeout_ms);
+
+/*
+ * Function: transport_get_stats
+ * -----------------------------
+ * Reads the counters of a transport.
+ *
+ * t: The transport.
+ *
+ * stats: Populated with the counters.
+ */
+void transport_get_stats(struct transport *t, struct transport_stats *stats);
+
+/*
+ * Function: transport_close
+ * -------------------------
+ * Closes a transport.
+ */
+void transport_close(struct transport *t);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,622 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "udp_service.h"
+#include "tcp_service.h"
+#include "checksum_service.h"
+#include "histogram_service.h"
+#include "network_helper.h"
+#include "transport_service.h"
+#include "../constants/constants.h"
+
+// DNS: version.bind TXT query in the CHAOS class
+static const unsigned char PAYLOAD_DNS[] = {
+    0x00, 0x06, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x07, 'v', 'e', 'r', 's', 'i', 'o', 'n', 0x04, 'b', 'i', 'n', 'd', 0x00,
+    0x00, 0x10, 0x00, 0x03
+};
+
+// Portmapper: ONC RPC NULL call to program 100000 version 2
+static const unsigned char PAYLOAD_RPC[] = {
+    0x72, 0xfe, 0x1d, 0x13, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x01, 0x86, 0xa0, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00
+};
+
+// NTP: version 4 client request
+static const unsigned char PAYLOAD_NTP[48] = {
+    0xe3, 0x00, 0x04, 0xfa, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00
+};
+
+// NetBIOS name service: node status request for "*"
+static const unsigned char PAYLOAD_NETBIOS[] = {
+    0x80, 0xf0, 0x00, 0x10, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x20, 'C', 'K', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A',
+    'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A', 'A',
+    'A', 'A', 'A', 'A', 0x00, 0x00, 0x21, 0x00, 0x01
+};
+
+// SNMP: v1 get-request for sysDescr.0 with the community "public"
+static const unsigned char PAYLOAD_SNMP[] = {
+    0x30, 0x26, 0x02, 0x01, 0x00, 0x04, 0x06, 'p', 'u', 'b', 'l', 'i', 'c',
+    0xa0, 0x19, 0x02, 0x01, 0x01, 0x02, 0x01, 0x00, 0x02, 0x01, 0x00, 0x30,
+    0x0e, 0x30, 0x0c, 0x06, 0x08, 0x2b, 0x06, 0x01, 0x02, 0x01, 0x01, 0x01,
+    0x00, 0x05, 0x00
+};
+
+// SSDP: discovery of every service
+static const unsigned char PAYLOAD_SSDP[] =
+        "M-SEARCH * HTTP/1.1\r\n"
+        "HOST: 239.255.255.250:1900\r\n"
+        "MAN: \"ssdp:discover\"\r\n"
+        "MX: 1\r\n"
+        "ST: ssdp:all\r\n\r\n";
+
+// mDNS: PTR query for the DNS-SD service list
+static const unsigned char PAYLOAD_MDNS[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x09, '_', 's', 'e', 'r', 'v', 'i', 'c', 'e', 's', 0x07, '_', 'd', 'n',
+    's', '-', 's', 'd', 0x04, '_', 'u', 'd', 'p', 0x05, 'l', 'o', 'c', 'a',
+    'l', 0x00, 0x00, 0x0c, 0x00, 0x01
+};
+
+// Memcached: "stats" behind the UDP frame header
+static const unsigned char PAYLOAD_MEMCACHED[] = {
+    0x00, 0x01, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 's', 't', 'a', 't', 's',
+    '\r', '\n'
+};
+
+static const struct udp_payload UDP_PAYLOADS[] = {
+    { 53, sizeof(PAYLOAD_DNS), PAYLOAD_DNS },
+    { 111, sizeof(PAYLOAD_RPC), PAYLOAD_RPC },
+    { 123, sizeof(PAYLOAD_NTP), PAYLOAD_NTP },
+    { 137, sizeof(PAYLOAD_NETBIOS), PAYLOAD_NETBIOS },
+    { 161, sizeof(PAYLOAD_SNMP), PAYLOAD_SNMP },
+    { 1900, sizeof(PAYLOAD_SSDP) - 1, PAYLOAD_SSDP },
+    { 5353, sizeof(PAYLOAD_MDNS), PAYLOAD_MDNS },
+    { 11211, sizeof(PAYLOAD_MEMCACHED), PAYLOAD_MEMCACHED }
+};
+
+static const int UDP_PAYLOADS_LEN =
+        sizeof(UDP_PAYLOADS) / sizeof(struct udp_payload);
+
+const struct udp_payload * get_udp_payload(unsigned short port) {
+    for (int i = 0; i < UDP_PAYLOADS_LEN; i++) {
+        if (UDP_PAYLOADS[i].port == port) {
+            return &UDP_PAYLOADS[i];
+        }
+    }
+
+    return NULL;
+}
+
+int get_common_udp_ports_arr(unsigned short int *arr_copy) {
+    const unsigned short int COMM_POR_UDP[] = {
+        7,          // ECHO
+        53,         // DNS
+        67,         // DHCP (Server)
+        68,         // DHCP (Client)
+        69,         // TFTP
+        111,        // RPC PORTMAPPER
+        123,        // NTP
+        135,        // Ms RPC EPMAP
+        137,        // NETBIOS NS
+        138,        // NETBIOS (Datagram service)
+        161,        // SNMP
+        162,        // SNMP TRAP
+        445,        // Microsoft-DS
+        500,        // IKE
+        514,        // SYSLOG
+        520,        // RIP
+        631,        // IPP
+        1434,       // Ms SQL Monitor
+        1900,       // SSDP
+        4500,       // IPSEC NAT-T
+        5353,       // mDNS
+        11211,      // MEMCACHED
+        49152       // Windows RPC
+    };
+
+    int arr_len = sizeof(COMM_POR_UDP) / sizeof(COMM_POR_UDP[0]);
+
+    memcpy(arr_copy, COMM_POR_UDP, sizeof(COMM_POR_UDP));
+
+    return arr_len;
+}
+
+unsigned char * construct_udp_packet(const char *src_ip, const char *dst_ip,
+        const unsigned char *src_mac, const unsigned char *dst_mac,
+        unsigned short int src_port, unsigned short int dst_port,
+        const unsigned char *payload, int payload_len, int *frame_len) {
+    if (DEBUG >= 3) {
+        printf("Constructing UDP/IP packet for destination IP: %s\n", dst_ip);
+    }
+
+    const int HDRS_LEN = sizeof(struct ethhdr) + sizeof(struct iphdr) +
+            sizeof(struct udphdr);
+
+    if (payload_len < 0 || HDRS_LEN + payload_len > UDP_MAX_FRAME) {
+        return NULL;
+    }
+
+    int total_len = HDRS_LEN + payload_len;
+
+    unsigned char *sendbuff = malloc(total_len);
+    memset(sendbuff, 0, total_len);
+
+    // Construct the ethernet header
+    struct ethhdr *eth = (struct ethhdr *)(sendbuff);
+
+    memcpy(eth->h_source, src_mac, MAC_LEN);
+    memcpy(eth->h_dest, dst_mac, MAC_LEN);
+    eth->h_proto = htons(ETH_P_IP);
+
+    // Construct the IP header
+    struct iphdr *iph = (struct iphdr *)(sendbuff + sizeof(struct ethhdr));
+
+    iph->frag_off = htons(IP_DF);
+    iph->ihl = 5;
+    iph->version = 4;
+    iph->id = htons(10201);
+    iph->ttl = 64;
+    iph->protocol = IPPROTO_UDP;
+    iph->tot_len = htons(total_len - sizeof(struct ethhdr));
+    iph->daddr = inet_addr(dst_ip);
+    iph->saddr = inet_addr(src_ip);
+    iph->check = ip_checksum((unsigned short int *)iph);
+
+    // Construct the UDP header and payload
+    struct udphdr *uh = (struct udphdr *)(sendbuff + sizeof(struct ethhdr) +
+            sizeof(struct iphdr));
+
+    uh->source = htons(src_port);
+    uh->dest = htons(dst_port);
+    uh->len = htons(sizeof(struct udphdr) + payload_len);
+
+    if (payload_len > 0) {
+        memcpy(sendbuff + HDRS_LEN, payload, payload_len);
+    }
+
+    struct psheader psh;
+    memset(&psh, 0, sizeof(struct psheader));
+
+    psh.saddr = iph->saddr;
+    psh.daddr = iph->daddr;
+    psh.protocol = IPPROTO_UDP;
+    psh.tcpseglen = uh->len;
+
+    unsigned long sum = checksum_add(0, &psh, sizeof(struct psheader));
+    uh->check = checksum_fold(checksum_add(sum, uh,
+            sizeof(struct udphdr) + payload_len));
+
+    // A zero checksum means no checksum in UDP
+    if (uh->check == 0) {
+        uh->check = 0xFFFF;
+    }
+
+    *frame_len = total_len;
+
+    return sendbuff;
+}
+
+int init_udp_template(struct udp_template *tmpl, const char *src_ip,
+        const char *dst_ip, const unsigned char *src_mac,
+        const unsigned char *dst_mac, const unsigned char *payload,
+        int payload_len) {
+    unsigned char *frame = construct_udp_packet(src_ip, dst_ip, src_mac,
+            dst_mac, 0, 0, payload, payload_len, &tmpl->len);
+
+    if (frame == NULL) {
+        return -1;
+    }
+
+    memcpy(tmpl->frame, frame, tmpl->len);
+    free(frame);
+
+    const struct iphdr *iph = (const struct iphdr *)
+            (tmpl->frame + sizeof(struct ethhdr));
+    struct udphdr *uh = (struct udphdr *)
+            (tmpl->frame + sizeof(struct ethhdr) + sizeof(struct iphdr));
+
+    struct psheader psh;
+    memset(&psh, 0, sizeof(struct psheader));
+
+    psh.saddr = iph->saddr;
+    psh.daddr = iph->daddr;
+    psh.protocol = IPPROTO_UDP;
+    psh.tcpseglen = uh->len;
+
+    // Sum everything but the ports, which are added per probe
+    uh->check = 0;
+
+    tmpl->sum = checksum_add(0, &psh, sizeof(struct psheader));
+    tmpl->sum = checksum_add(tmpl->sum, uh,
+            tmpl->len - sizeof(struct ethhdr) - sizeof(struct iphdr));
+
+    return 0;
+}
+
+int stamp_udp_probe(const struct udp_template *tmpl, unsigned short src_port,
+        unsigned short dst_port, unsigned char *frame) {
+    memcpy(frame, tmpl->frame, tmpl->len);
+
+    struct udphdr *uh = (struct udphdr *)
+            (frame + sizeof(struct ethhdr) + sizeof(struct iphdr));
+
+    uh->source = htons(src_port);
+    uh->dest = htons(dst_port);
+    uh->check = checksum_fold(checksum_add(tmpl->sum, uh, 4));
+
+    if (uh->check == 0) {
+        uh->check = 0xFFFF;
+    }
+
+    return tmpl->len;
+}
+
+int init_udp_probe_builder(struct udp_probe_builder *builder,
+        const char *src_ip, const char *dst_ip, const unsigned char *src_mac,
+        const unsigned char *dst_mac) {
+    builder->templates = malloc(sizeof(struct udp_template) *
+            (UDP_PAYLOADS_LEN + 1));
+
+    if (builder->templates == NULL) {
+        return -1;
+    }
+
+    memset(builder->port_template, 0, sizeof(builder->port_template));
+
+    if (init_udp_template(&builder->templates[0], src_ip, dst_ip, src_mac,
+            dst_mac, NULL, 0) < 0) {
+        free_udp_probe_builder(builder);
+
+        return -1;
+    }
+
+    for (int i = 0; i < UDP_PAYLOADS_LEN; i++) {
+        if (init_udp_template(&builder->templates[i + 1], src_ip, dst_ip,
+                src_mac, dst_mac, UDP_PAYLOADS[i].data,
+                UDP_PAYLOADS[i].len) < 0) {
+            free_udp_probe_builder(builder);
+
+            return -1;
+        }
+
+        builder->port_template[UDP_PAYLOADS[i].port] = i + 1;
+    }
+
+    return 0;
+}
+
+int build_udp_probe(const struct udp_probe_builder *builder,
+        unsigned short src_port, unsigned short dst_port,
+        unsigned char *frame) {
+    return stamp_udp_probe(
+            &builder->templates[builder->port_template[dst_port]], src_port,
+            dst_port, frame);
+}
+
+void free_udp_probe_builder(struct udp_probe_builder *builder) {
+    free(builder->templates);
+    builder->templates = NULL;
+}
+
+int decode_udp_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec) {
+    if (frame_len < (int)(sizeof(struct ethhdr) + sizeof(struct iphdr))) {
+        return 0;
+    }
+
+    const struct ethhdr *eth = (const struct ethhdr *)(frame);
+
+    // Packet was not addressed to this interface
+    if (compare_mac_add(eth->h_dest, dest_mac) != 0) {
+        return 0;
+    }
+
+    const struct iphdr *iph = (const struct iphdr *)
+            (frame + sizeof(struct ethhdr));
+
+    int ip_hdr_len = iph->ihl * 4;
+    const unsigned char *data = (const unsigned char *)iph + ip_hdr_len;
+    int data_len = frame_len - sizeof(struct ethhdr) - ip_hdr_len;
+
+    rec->src_ip = iph->saddr;
+    rec->protocol = iph->protocol;
+    rec->tcp_flags = 0;
+
+    if (iph->protocol == IPPROTO_UDP) {
+        if ((tar_ip != NULL && 
+                compare_ip_add((const unsigned char *)&(iph->saddr), tar_ip)
+                != 0) || data_len < (int)sizeof(struct udphdr)) {
+            return 0;
+        }
+
+        const struct udphdr *uh = (const struct udphdr *)data;
+
+        rec->src_port = ntohs(uh->source);
+        rec->dst_port = ntohs(uh->dest);
+
+        return 1;
+    }
+
+    if (iph->protocol != IPPROTO_ICMP ||
+            data_len < (int)(sizeof(struct icmphdr) + sizeof(struct iphdr))) {
+        return 0;
+    }
+
+    const struct icmphdr *icmph = (const struct icmphdr *)data;
+
+    if (icmph->type != ICMP_DEST_UNREACH) {
+        return 0;
+    }
+
+    // The error quotes the IP header and the first 8 bytes of the probe.  It
+    // may come from a router on the way rather than the target itself.
+    const struct iphdr *quoted_iph = (const struct iphdr *)
+            (data + sizeof(struct icmphdr));
+    int quoted_hdr_len = quoted_iph->ihl * 4;
+
+    if (data_len < (int)(sizeof(struct icmphdr) + quoted_hdr_len +
+            sizeof(struct udphdr)) || quoted_iph->protocol != IPPROTO_UDP ||
+            compare_ip_add((const unsigned char *)&(quoted_iph->saddr),
+            loc_ip) != 0 || (tar_ip != NULL &&
+            compare_ip_add((const unsigned char *)&(quoted_iph->daddr),
+            tar_ip) != 0)) {
+        return 0;
+    }
+
+    const struct udphdr *quoted_uh = (const struct udphdr *)
+            ((const unsigned char *)quoted_iph + quoted_hdr_len);
+
+    // The error is about the probed target, whoever sent it
+    rec->src_ip = quoted_iph->daddr;
+    rec->src_port = ntohs(quoted_uh->dest);
+    rec->dst_port = ntohs(quoted_uh->source);
+    rec->tcp_flags = icmph->code;
+
+    return 1;
+}
+
+unsigned char classify_udp_reply(const struct reply_record *rec) {
+    if (rec->protocol == IPPROTO_UDP) {
+        return PORT_STATE_OPEN;
+    }
+
+    switch (rec->tcp_flags) {
+        case ICMP_PORT_UNREACH:
+            return PORT_STATE_CLOSED;
+        case ICMP_NET_UNREACH:
+        case ICMP_HOST_UNREACH:
+        case ICMP_PROT_UNREACH:
+        case ICMP_NET_ANO:
+        case ICMP_HOST_ANO:
+        case ICMP_PKT_FILTERED:
+            return PORT_STATE_FILTERED;
+        default:
+            return PORT_STATE_UNKNOWN;
+    }
+}
+
+void udp_pacer_init(struct udp_pacer *pacer) {
+    udp_pacer_init_rate(pacer, UDP_START_PPS);
+}
+
+void udp_pacer_init_rate(struct udp_pacer *pacer, double rate_pps) {
+    pacer->rate_pps = rate_pps;
+    pacer->start_ns = 0;
+    pacer->sent = 0;
+}
+
+void udp_pacer_start_round(struct udp_pacer *pacer) {
+    pacer->start_ns = get_time_ns();
+    pacer->sent = 0;
+}
+
+int udp_pacer_take(struct udp_pacer *pacer, int max) {
+    for (;;) {
+        unsigned long long elapsed_ns = get_time_ns() - pacer->start_ns;
+        unsigned long allowed = (unsigned long)
+                (elapsed_ns / 1e9 * pacer->rate_pps) + 1;
+
+        if (allowed > pacer->sent) {
+            int take = allowed - pacer->sent > (unsigned long)max ? max :
+                    (int)(allowed - pacer->sent);
+
+            pacer->sent += take;
+
+            return take;
+        }
+
+        // Sleep until the next probe is due
+        unsigned long long due_ns = (unsigned long long)
+                (pacer->sent * 1e9 / pacer->rate_pps);
+
+        struct timespec ts;
+        ts.tv_sec = (due_ns - elapsed_ns) / 1000000000ULL;
+        ts.tv_nsec = (due_ns - elapsed_ns) % 1000000000ULL;
+
+        nanosleep(&ts, NULL);
+    }
+}
+
+void udp_pacer_end_round(struct udp_pacer *pacer, int round,
+        unsigned long probes, unsigned long answered,
+        unsigned long long elapsed_ns) {
+    // First answers say nothing about loss
+    if (round < 2 || answered == 0 || probes == 0) {
+        return;
+    }
+
+    double reply_pps = answered / (elapsed_ns / 1e9);
+    double rate_pps = pacer->rate_pps / 2;
+
+    if (rate_pps > 2 * reply_pps) {
+        rate_pps = 2 * reply_pps;
+    }
+
+    if (rate_pps < UDP_MIN_PPS) {
+        rate_pps = UDP_MIN_PPS;
+    }
+
+    if (DEBUG >= 1) {
+        printf("Round %d: %lu of %lu retried probes answered, pacing at "
+                "%.1f probes/s\n", round, answered, probes, rate_pps);
+    }
+
+    pacer->rate_pps = rate_pps;
+}
+
+/*
+ * Returns the index of the target a reply is about, or -1 if it is about 
+ * none of them.
+ */
+static int find_reply_target(struct scan_state **states, int states_len, 
+        const struct reply_record *rec) {
+    // A lone target's replies were already matched by the decoder
+    if (states_len == 1) {
+        return 0;
+    }
+
+    for (int i = 0; i < states_len; i++) {
+        if (states[i]->tar_ip == rec->src_ip) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int listen_for_udp_replies(const unsigned char *loc_ip,
+        const unsigned char *dest_mac, struct transport *t, 
+        atomic_uchar *stop_listening, struct scan_state **states, 
+        int states_len, struct open_ports_dto **open_ports) {
+    if (DEBUG >= 2) {
+        printf("Listening to UDP replies from %d target(s)\n", states_len);
+    }
+
+    struct reply_ring *ring = reply_ring_create();
+
+    if (ring == NULL) {
+        errno = EIO;
+
+        return -1;
+    }
+
+    // The receiver and kernel counters are kept by the first target's stats
+    struct tcp_receiver_args recv_args;
+    memset(&recv_args, 0, sizeof(struct tcp_receiver_args));
+
+    recv_args.loc_ip = loc_ip;
+    recv_args.tar_ip = states_len == 1 ? 
+            (const unsigned char *)&states[0]->tar_ip : NULL;
+    recv_args.dest_mac = dest_mac;
+    recv_args.stop_listening = stop_listening;
+    recv_args.ring = ring;
+    recv_args.transport = t;
+    recv_args.decode = decode_udp_reply;
+    recv_args.stats = &states[0]->stats;
+
+    set_listen_transport(&states[0]->stats, t);
+
+    pthread_t tid;
+
+    if (pthread_create(&tid, NULL, receive_tcp_replies,
+            (void *)&recv_args) != 0) {
+        set_listen_transport(&states[0]->stats, NULL);
+        reply_ring_free(ring);
+
+        errno = EIO;
+
+        return -1;
+    }
+
+    // Sleep time in microseconds when there is nothing to consume (1 ms)
+    const int SLEEP_TIME_MICS = 1000;
+
+    for (int i = 0; i < states_len; i++) {
+        open_ports[i] = malloc(sizeof(struct open_ports_dto));
+        open_ports[i]->open_ports = malloc(sizeof(short int) * MAX_PORT);
+        open_ports[i]->open_ports_len = 0;
+    }
+
+    struct reply_record rec;
+    int pop_ret;
+
+    while ((pop_ret = reply_ring_consume(ring, &rec, NULL)) != -1) {
+        if (pop_ret == 0) {
+            usleep(SLEEP_TIME_MICS);
+
+            continue;
+        }
+
+        int target = find_reply_target(states, states_len, &rec);
+        unsigned char port_state = classify_udp_reply(&rec);
+
+        if (target < 0 || port_state == PORT_STATE_UNKNOWN) {
+            continue;
+        }
+
+        struct scan_state *state = states[target];
+
+        // The sender reads the table to find the ports to retry
+        if (__atomic_load_n(&state->port_states[rec.src_port],
+                __ATOMIC_RELAXED) != PORT_STATE_UNKNOWN) {
+            continue;
+        }
+
+        record_probe_rtt(state, &rec);
+
+        __atomic_store_n(&state->port_states[rec.src_port], port_state,
+                __ATOMIC_RELAXED);
+
+        if (port_state == PORT_STATE_OPEN) {
+            stats_inc(&state->stats.consumer.open);
+
+            if (DEBUG >= 2) {
+                printf("Open UDP port detected: %s:%d\n", 
+                        get_ip_32_str(rec.src_ip), rec.src_port);
+            }
+
+            struct open_ports_dto *found = open_ports[target];
+            found->open_ports[found->open_ports_len++] = rec.src_port;
+        } else if (port_state == PORT_STATE_CLOSED) {
+            stats_inc(&state->stats.consumer.closed);
+        } else {
+            stats_inc(&state->stats.consumer.filtered);
+        }
+    }
+
+    pthread_join(tid, NULL);
+
+    set_listen_transport(&states[0]->stats, NULL);
+    reply_ring_free(ring);
+
+    if (recv_args.error) {
+        for (int i = 0; i < states_len; i++) {
+            free(open_ports[i]->open_ports);
+            free(open_ports[i]);
+            open_ports[i] = NULL;
+        }
+
+        errno = EIO;
+
+        return -1;
+    }
+
+    return 0;
+}
\ No newline at end of file
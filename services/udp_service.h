@@ -0,0 +1,344 @@
+#ifndef UDP_SERVICE_H
+#define UDP_SERVICE_H
+
+#include <stdatomic.h>
+
+#include "ring_buffer.h"
+#include "checkpoint_service.h"
+
+struct open_ports_dto;
+struct transport;
+
+// Largest UDP probe frame (ethernet, IP and UDP headers and the payload)
+#define UDP_MAX_FRAME 256
+
+// Probe rate of the first round in probes per second
+#define UDP_START_PPS 1000
+
+// Lowest probe rate the pacer slows down to
+#define UDP_MIN_PPS 1
+
+// Maximum number of times a port is probed
+#define UDP_MAX_ROUNDS 8
+
+// Time to wait for replies at the end of each round in milliseconds
+#define UDP_ROUND_WAIT_MS 1500
+
+// Most targets of a list scanned at once, each paced by its own ICMP rate
+// limit
+#define UDP_PARALLEL_HOSTS 16
+
+/*
+ * Struct: udp_payload
+ * -------------------
+ * A protocol specific payload sent to a well known UDP port, so services that
+ * ignore empty datagrams still answer.
+ */
+struct udp_payload {
+    unsigned short port;
+    unsigned short len;
+    const unsigned char *data;
+};
+
+/*
+ * Struct: udp_template
+ * --------------------
+ * A prebuilt UDP probe frame with zero ports.  Stamping a probe only copies
+ * the frame, sets the ports and finishes the checksum.
+ *
+ * frame: The frame.
+ *
+ * len: The length of the frame.
+ *
+ * sum: The unfolded UDP checksum sum of the frame without its ports.
+ */
+struct udp_template {
+    unsigned char frame[UDP_MAX_FRAME];
+    int len;
+    unsigned long sum;
+};
+
+/*
+ * Struct: udp_probe_builder
+ * -------------------------
+ * The probe templates of a scan: one per payload and an empty one.
+ *
+ * templates: The templates, the empty one first.
+ *
+ * port_template: Index of the template used for each destination port.
+ */
+struct udp_probe_builder {
+    struct udp_template *templates;
+    unsigned char port_template[MAX_PORT + 1];
+};
+
+/*
+ * Struct: udp_pacer
+ * -----------------
+ * Paces the probes sent to one host.  Hosts rate limit the ICMP port
+ * unreachables closed UDP ports answer with (Linux sends 1 per second after a
+ * burst of 6), so probing faster than the host can answer only turns closed
+ * ports in to unanswered ones.  The rate is lowered towards the reply rate the
+ * host sustained whenever a retry round gets answers the previous round lost.
+ *
+ * rate_pps: The current probe rate in probes per second.
+ *
+ * start_ns: When the current round started.
+ *
+ * sent: Probes sent in the current round.
+ */
+struct udp_pacer {
+    double rate_pps;
+    unsigned long long start_ns;
+    unsigned long sent;
+};
+
+/*
+ * Function: get_udp_payload
+ * -------------------------
+ * return: The payload for a UDP port, or NULL if the port gets an empty
+ *         datagram.
+ */
+const struct udp_payload * get_udp_payload(unsigned short port);
+
+/*
+ * Function: get_common_udp_ports_arr
+ * ----------------------------------
+ * Copies common UDP port numbers into the arr_copy array parameter.
+ *
+ * arr_copy: An array of at least MAX_PORT elements.
+ *
+ * return: The length of the array copied.
+ */
+int get_common_udp_ports_arr(unsigned short int *arr_copy);
+
+/*
+ * Function: construct_udp_packet
+ * ------------------------------
+ * Constructs and populates a UDP IP packet.
+ *
+ * src_ip: The source IP address represented as a string.
+ *
+ * dst_ip: The destination IP address represented as a string.
+ *
+ * src_mac: The source MAC address represented as an array.
+ *
+ * dst_mac: The destination MAC address represented as an array.
+ *
+ * src_port: The source port.
+ *
+ * dst_port: The destination port.
+ *
+ * payload: The UDP payload, or NULL.
+ *
+ * payload_len: The length of the payload.
+ *
+ * frame_len: Populated with the length of the packet.
+ *
+ * return: A UDP IP packet ready to send, or NULL if the payload is too long.
+ */
+unsigned char * construct_udp_packet(const char *src_ip, const char *dst_ip,
+        const unsigned char *src_mac, const unsigned char *dst_mac,
+        unsigned short int src_port, unsigned short int dst_port,
+        const unsigned char *payload, int payload_len, int *frame_len);
+
+/*
+ * Function: init_udp_template
+ * ---------------------------
+ * Builds a probe template.  Arguments are as for construct_udp_packet.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int init_udp_template(struct udp_template *tmpl, const char *src_ip,
+        const char *dst_ip, const unsigned char *src_mac,
+        const unsigned char *dst_mac, const unsigned char *payload,
+        int payload_len);
+
+/*
+ * Function: stamp_udp_probe
+ * -------------------------
+ * Copies a template in to a probe frame for a pair of ports.
+ *
+ * tmpl: The template.
+ *
+ * src_port: The source port.
+ *
+ * dst_port: The destination port.
+ *
+ * frame: A buffer of at least UDP_MAX_FRAME bytes.
+ *
+ * return: The length of the frame.
+ */
+int stamp_udp_probe(const struct udp_template *tmpl, unsigned short src_port,
+        unsigned short dst_port, unsigned char *frame);
+
+/*
+ * Function: init_udp_probe_builder
+ * --------------------------------
+ * Builds the probe templates for a target.
+ *
+ * builder: The builder to initialise.
+ *
+ * src_ip: The source IP address represented as a string.
+ *
+ * dst_ip: The destination IP address represented as a string.
+ *
+ * src_mac: The source MAC address represented as an array.
+ *
+ * dst_mac: The destination MAC address represented as an array.
+ *
+ * return: 0 on success, -1 on error.
+ */
+int init_udp_probe_builder(struct udp_probe_builder *builder,
+        const char *src_ip, const char *dst_ip, const unsigned char *src_mac,
+        const unsigned char *dst_mac);
+
+/*
+ * Function: build_udp_probe
+ * -------------------------
+ * Stamps the probe for a destination port, carrying the port's payload.
+ *
+ * return: The length of the frame.
+ */
+int build_udp_probe(const struct udp_probe_builder *builder,
+        unsigned short src_port, unsigned short dst_port, 
+        unsigned char *frame);
+
+/*
+ * Function: free_udp_probe_builder
+ * --------------------------------
+ * Frees the templates of a builder.
+ */
+void free_udp_probe_builder(struct udp_probe_builder *builder);
+
+/*
+ * Function: decode_udp_reply
+ * --------------------------
+ * Decodes a received ethernet frame in to a reply record if it is a UDP
+ * datagram from the target, or an ICMP destination unreachable quoting a UDP
+ * probe from the local address to the target, addressed to the local
+ * interface.  For ICMP errors the record's src_ip is the probed target, 
+ * src_port the probed port and tcp_flags holds the ICMP code.
+ *
+ * frame: The received ethernet frame.
+ *
+ * frame_len: The length of the frame in bytes.
+ *
+ * loc_ip: The local IP address in array format.
+ *
+ * tar_ip: The target IP address in array format, or NULL to decode replies
+ *         about any target.
+ *
+ * dest_mac: The local MAC address in array format.
+ *
+ * rec: Populated with the decoded reply.
+ *
+ * return: 1 if the frame was decoded, or 0 if it should be ignored.
+ */
+int decode_udp_reply(const unsigned char *frame, int frame_len,
+        const unsigned char *loc_ip, const unsigned char *tar_ip,
+        const unsigned char *dest_mac, struct reply_record *rec);
+
+/*
+ * Function: classify_udp_reply
+ * ----------------------------
+ * return: The PORT_STATE_* a decoded UDP reply gives its port: open for a
+ *         UDP datagram, closed for a port unreachable and filtered for the
+ *         other administratively prohibited or unreachable codes.
+ *         PORT_STATE_UNKNOWN if the reply says nothing about the port.
+ */
+unsigned char classify_udp_reply(const struct reply_record *rec);
+
+/*
+ * Function: udp_pacer_init
+ * ------------------------
+ * Initialises a pacer at UDP_START_PPS.
+ */
+void udp_pacer_init(struct udp_pacer *pacer);
+
+/*
+ * Function: udp_pacer_init_rate
+ * -----------------------------
+ * Initialises a pacer at a given rate, for probes that are not UDP scan
+ * rounds.
+ *
+ * pacer: The pacer.
+ *
+ * rate_pps: The probe rate in probes per second.
+ */
+void udp_pacer_init_rate(struct udp_pacer *pacer, double rate_pps);
+
+/*
+ * Function: udp_pacer_start_round
+ * -------------------------------
+ * Starts a round of probes at the current rate.
+ */
+void udp_pacer_start_round(struct udp_pacer *pacer);
+
+/*
+ * Function: udp_pacer_take
+ * ------------------------
+ * Waits until at least one probe may be sent.
+ *
+ * pacer: The pacer.
+ *
+ * max: The most probes wanted.
+ *
+ * return: The number of probes that may be sent now, between 1 and max.
+ */
+int udp_pacer_take(struct udp_pacer *pacer, int max);
+
+/*
+ * Function: udp_pacer_end_round
+ * -----------------------------
+ * Adjusts the rate after a round.  Answers to retried probes mean earlier
+ * replies were lost, most often to ICMP rate limiting, so the rate is halved
+ * and capped at twice the reply rate the host sustained.
+ *
+ * pacer: The pacer.
+ *
+ * round: The round number, starting at 1.
+ *
+ * probes: The probes sent in the round.
+ *
+ * answered: The probes of the round whose port was classified.
+ *
+ * elapsed_ns: The length of the round including the wait for replies.
+ */
+void udp_pacer_end_round(struct udp_pacer *pacer, int round,
+        unsigned long probes, unsigned long answered,
+        unsigned long long elapsed_ns);
+
+/*
+ * Function: listen_for_udp_replies
+ * --------------------------------
+ * Listens for UDP replies and ICMP unreachables from a group of targets 
+ * scanned at once and classifies the probed ports as they are popped from
+ * the reply ring.
+ *
+ * loc_ip: The local IP address probes are sent from in array format.
+ *
+ * dest_mac: The local MAC address.
+ *
+ * t: The transport to receive replies on, opened before the first probe was
+ *    sent.
+ *
+ * stop_listening: A variable indicating whether to stop listening for packets
+ *                 and return.
+ *
+ * states: The scan states of the IPv4 targets.  Classified ports are recorded
+ *         in the port state table of their target, which its sender reads to
+ *         pick the ports to retry.
+ *
+ * states_len: The number of targets, at most UDP_PARALLEL_HOSTS.
+ *
+ * open_ports: Populated with the open ports found on each target.
+ *
+ * return: 0 on success, -1 on error.  errno is set to EIO(5) on error.
+ */
+int listen_for_udp_replies(const unsigned char *loc_ip,
+        const unsigned char *dest_mac, struct transport *t, 
+        atomic_uchar *stop_listening, struct scan_state **states, 
+        int states_len, struct open_ports_dto **open_ports);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,58 @@
+#!/bin/bash
+# Generates the static top ports table from a ranked port list, ordered by
+# rank so the ports most likely to be open are probed first.
+#
+# Usage: tools/gen_top_ports.sh <ranks.txt> <top_ports.h>
+#
+# Each list line holds a port, its rank (1 first) and a service name.
+# Blank lines and lines starting with # are skipped.
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 <ranks.txt> <top_ports.h>" >&2
+    exit 1
+fi
+
+IN=$1
+OUT=$2
+
+# Ties keep the lower port first so the table is stable
+PORTS=$(grep -v '^[[:space:]]*\(#\|$\)' "$IN" | sort -k2,2n -k1,1n -s |
+        awk '
+            $1 !~ /^[0-9]+$/ || $1 < 1 || $1 > 65535 || seen[$1]++ {
+                print "invalid or duplicate port: " $1 > "/dev/stderr"
+                exit 1
+            }
+            { ports[NR] = $1; services[NR] = $3 }
+            END {
+                for (i = 1; i <= NR; i++) {
+                    printf "    %-11s // %s\n", ports[i] (i < NR ? "," : ""),
+                            services[i]
+                }
+            }')
+
+if [ $? -ne 0 ] || [ -z "$PORTS" ]; then
+    echo "ERROR: Cannot generate top ports from $IN" >&2
+    exit 1
+fi
+
+PORTS_LEN=$(echo "$PORTS" | wc -l)
+
+cat > "$OUT.tmp" << EOF
+/*
+ * Generated by tools/gen_top_ports.sh from $(basename "$IN").
+ * Do not edit, edit the port list instead.
+ */
+#ifndef TOP_PORTS_H
+#define TOP_PORTS_H
+
+#define TOP_TCP_PORTS_LEN $PORTS_LEN
+
+// TCP ports ordered by how likely they are to be open, most likely first
+static const unsigned short TOP_TCP_PORTS[TOP_TCP_PORTS_LEN] = {
+$PORTS
+};
+
+#endif
+EOF
+
+mv "$OUT.tmp" "$OUT"
@@ -0,0 +1,506 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <netinet/ip.h>
+#include <netinet/tcp.h>
+#include <net/ethernet.h>
+
+#include "../services/tcp_service.h"
+#include "../services/udp_service.h"
+#include "../services/icmp_service.h"
+#include "../services/arp_service.h"
+#include "../services/checksum_service.h"
+#include "../services/ring_buffer.h"
+#include "../services/histogram_service.h"
+#include "../services/fingerprint_service.h"
+#include "../services/prefix_tree.h"
+#include "../constants/constants.h"
+
+// Minimum run time of each benchmark once calibrated
+#define BENCH_MIN_NS 200000000ULL
+
+// Banners in the synthetic corpus matched against the fingerprints
+#define BENCH_BANNERS 64
+
+// Length of each banner in the corpus, padded with printable noise
+#define BENCH_BANNER_LEN 96
+
+// Excluded prefixes in the prefix tree, like a large do-not-scan list
+#define BENCH_PREFIXES 100000
+
+// Addresses looked up in the prefix tree, half of them excluded
+#define BENCH_LOOKUPS 4096
+
+// Calls to malloc and calloc, counted by the linker wrappers below
+static unsigned long alloc_count = 0;
+
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t nmemb, size_t size);
+
+void * __wrap_malloc(size_t size) {
+    alloc_count++;
+
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t nmemb, size_t size) {
+    alloc_count++;
+
+    return __real_calloc(nmemb, size);
+}
+
+/*
+ * Struct: bench_ctx
+ * -----------------
+ * Inputs shared by every benchmark.
+ */
+struct bench_ctx {
+    unsigned char loc_mac[MAC_LEN];
+    unsigned char tar_mac[MAC_LEN];
+    unsigned char loc_ip[IP_LEN];
+    unsigned char tar_ip[IP_LEN];
+    const char *loc_ip_str;
+    const char *tar_ip_str;
+    unsigned char *syn_packet;
+    unsigned char *reply_frame;
+    unsigned char *other_frame;
+    struct psheader psh;
+    struct udp_probe_builder udp_builder;
+    unsigned char udp_frame[UDP_MAX_FRAME];
+    struct syn6_template syn6_tmpl;
+    unsigned char syn6_frame[SYN6_FRAME_LEN];
+    struct fingerprint_matcher *fp_matcher;
+    unsigned char banners[BENCH_BANNERS][BENCH_BANNER_LEN];
+    struct interval_set excluded;
+    struct prefix_tree *exclusions;
+    unsigned int lookups[BENCH_LOOKUPS];
+};
+
+/*
+ * Struct: bench
+ * -------------
+ * A benchmark.  fn runs one operation and returns a value that is summed so 
+ * the work cannot be optimised away.
+ */
+struct bench {
+    const char *name;
+    unsigned long (*fn)(struct bench_ctx *ctx, unsigned long i);
+};
+
+static unsigned long bench_syn_packet(struct bench_ctx *ctx, unsigned long i) {
+    unsigned char *packet = construct_syn_packet(ctx->loc_ip_str, 
+            ctx->tar_ip_str, ctx->loc_mac, ctx->tar_mac, 5000, 
+            (unsigned short)(i % MAX_PORT) + 1);
+    unsigned long ret = packet[51];
+
+    free(packet);
+
+    return ret;
+}
+
+static unsigned long bench_syn6_probe(struct bench_ctx *ctx, unsigned long i) {
+    stamp_syn6_probe(&ctx->syn6_tmpl, 5000, (unsigned short)(i % MAX_PORT) + 1,
+            ctx->syn6_frame);
+
+    return ctx->syn6_frame[71];
+}
+
+static unsigned long bench_udp_packet(struct bench_ctx *ctx, unsigned long i) {
+    (void)i;
+
+    const struct udp_payload *payload = get_udp_payload(53);
+    int frame_len;
+
+    unsigned char *packet = construct_udp_packet(ctx->loc_ip_str, 
+            ctx->tar_ip_str, ctx->loc_mac, ctx->tar_mac, 5000, 53, 
+            payload->data, payload->len, &frame_len);
+    unsigned long ret = packet[41];
+
+    free(packet);
+
+    return ret;
+}
+
+static unsigned long bench_udp_probe(struct bench_ctx *ctx, unsigned long i) {
+    (void)i;
+
+    build_udp_probe(&ctx->udp_builder, 5000, 53, ctx->udp_frame);
+
+    return ctx->udp_frame[41];
+}
+
+static unsigned long bench_icmp_packet(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    unsigned char *packet = construct_icmp_packet(ctx->loc_ip_str, 
+            ctx->tar_ip_str, ctx->loc_mac, ctx->tar_mac);
+    unsigned long ret = packet[36];
+
+    free(packet);
+
+    return ret;
+}
+
+static unsigned long bench_arp_packet(struct bench_ctx *ctx, unsigned long i) {
+    (void)i;
+
+    unsigned char *packet = make_arp_packet(ctx->loc_mac, ctx->tar_mac, 
+            ctx->loc_ip, ctx->tar_ip);
+    unsigned long ret = packet[21];
+
+    free(packet);
+
+    return ret;
+}
+
+static unsigned long bench_ip_checksum(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    return ip_checksum((const unsigned short *)
+            (ctx->syn_packet + sizeof(struct ethhdr)));
+}
+
+static unsigned long bench_tcp_checksum(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    return tcp_checksum((const unsigned short *)(ctx->syn_packet + 
+            sizeof(struct ethhdr) + sizeof(struct iphdr)), 
+            (const unsigned short *)&ctx->psh);
+}
+
+static unsigned long bench_icmp_checksum(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    return icmp_checksum((const unsigned short *)(ctx->syn_packet + 
+            sizeof(struct ethhdr) + sizeof(struct iphdr)));
+}
+
+static unsigned long bench_decode_reply(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    struct reply_record rec;
+
+    if (decode_tcp_reply(ctx->reply_frame, 64, ctx->loc_ip, ctx->tar_ip, 
+            ctx->loc_mac, &rec)) {
+        return rec.src_port;
+    }
+
+    return 0;
+}
+
+static unsigned long bench_decode_other(struct bench_ctx *ctx, 
+        unsigned long i) {
+    (void)i;
+
+    struct reply_record rec;
+
+    return decode_tcp_reply(ctx->other_frame, 64, ctx->loc_ip, ctx->tar_ip, 
+            ctx->loc_mac, &rec);
+}
+
+static unsigned long bench_match_fingerprint(struct bench_ctx *ctx, 
+        unsigned long i) {
+    return match_fingerprint(ctx->fp_matcher, 
+            ctx->banners[i % BENCH_BANNERS], BENCH_BANNER_LEN) != NULL;
+}
+
+/*
+ * Function: bench_match_fingerprint_linear
+ * ----------------------------------------
+ * Searches the banner for one pattern after another, for comparison with
+ * the compiled matcher.
+ */
+static unsigned long bench_match_fingerprint_linear(struct bench_ctx *ctx, 
+        unsigned long i) {
+    const unsigned char *banner = ctx->banners[i % BENCH_BANNERS];
+    int fps_len;
+    const struct fingerprint *fps = get_default_fingerprints(&fps_len);
+
+    for (int f = 0; f < fps_len; f++) {
+        int last = (fps[f].flags & FP_ANCHORED) ? 0 : 
+                BENCH_BANNER_LEN - fps[f].pattern_len;
+
+        for (int start = 0; start <= last; start++) {
+            int (*cmp)(const char *, const char *, size_t) = 
+                    (fps[f].flags & FP_NOCASE) ? strncasecmp : strncmp;
+
+            if (cmp((const char *)banner + start, 
+                    (const char *)fps[f].pattern, fps[f].pattern_len) == 0) {
+                return f + 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static unsigned long bench_prefix_tree(struct bench_ctx *ctx, 
+        unsigned long i) {
+    return prefix_tree_contains(ctx->exclusions, 
+            ctx->lookups[i % BENCH_LOOKUPS]);
+}
+
+/*
+ * Function: bench_prefix_tree_search
+ * ----------------------------------
+ * Binary searches the excluded intervals, for comparison with the prefix 
+ * tree.
+ */
+static unsigned long bench_prefix_tree_search(struct bench_ctx *ctx, 
+        unsigned long i) {
+    return interval_set_contains(&ctx->excluded, 
+            ctx->lookups[i % BENCH_LOOKUPS]);
+}
+
+static const struct bench BENCHES[] = {
+    { "construct_syn_packet", bench_syn_packet },
+    { "stamp_syn6_probe", bench_syn6_probe },
+    { "construct_udp_packet", bench_udp_packet },
+    { "build_udp_probe", bench_udp_probe },
+    { "construct_icmp_packet", bench_icmp_packet },
+    { "make_arp_packet", bench_arp_packet },
+    { "ip_checksum", bench_ip_checksum },
+    { "tcp_checksum", bench_tcp_checksum },
+    { "icmp_checksum", bench_icmp_checksum },
+    { "decode_tcp_reply", bench_decode_reply },
+    { "decode_tcp_reply_ignored", bench_decode_other },
+    { "match_fingerprint", bench_match_fingerprint },
+    { "match_fingerprint_linear", bench_match_fingerprint_linear },
+    { "prefix_tree_contains", bench_prefix_tree },
+    { "prefix_tree_search", bench_prefix_tree_search }
+};
+
+/*
+ * Function: open_cycle_counter
+ * ----------------------------
+ * Opens a perf event counting user space CPU cycles of this thread.
+ *
+ * return: The counter, or -1 if perf events are unavailable.
+ */
+static int open_cycle_counter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(struct perf_event_attr));
+
+    attr.size = sizeof(struct perf_event_attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static unsigned long long read_counter(int fd) {
+    unsigned long long count = 0;
+
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) {
+        return 0;
+    }
+
+    return count;
+}
+
+static volatile unsigned long bench_sink;
+
+/*
+ * Function: run_bench
+ * -------------------
+ * Runs a benchmark for at least BENCH_MIN_NS and prints ns/op, allocations/op
+ * and cycles/op.
+ */
+static void run_bench(const struct bench *bench, struct bench_ctx *ctx, 
+        int cycle_fd) {
+    unsigned long sum = 0;
+    unsigned long iters = 1000;
+
+    // Warm up and calibrate the iteration count
+    for (;;) {
+        unsigned long long start = get_time_ns();
+
+        for (unsigned long i = 0; i < iters; i++) {
+            sum += bench->fn(ctx, i);
+        }
+
+        unsigned long long elapsed = get_time_ns() - start;
+
+        if (elapsed >= BENCH_MIN_NS / 10) {
+            iters = (unsigned long)((double)iters * BENCH_MIN_NS / elapsed);
+            break;
+        }
+
+        iters *= 10;
+    }
+
+    unsigned long allocs_start = alloc_count;
+
+    if (cycle_fd >= 0) {
+        ioctl(cycle_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(cycle_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    unsigned long long start = get_time_ns();
+
+    for (unsigned long i = 0; i < iters; i++) {
+        sum += bench->fn(ctx, i);
+    }
+
+    unsigned long long elapsed = get_time_ns() - start;
+
+    if (cycle_fd >= 0) {
+        ioctl(cycle_fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    bench_sink = sum;
+
+    printf("%-26s %12lu %10.2f %10.2f ", bench->name, iters, 
+            (double)elapsed / iters, 
+            (double)(alloc_count - allocs_start) / iters);
+
+    if (cycle_fd >= 0) {
+        printf("%10.1f\n", (double)read_counter(cycle_fd) / iters);
+    } else {
+        printf("%10s\n", "n/a");
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    const char *filter = (argc > 1) ? argv[1] : NULL;
+
+    struct bench_ctx ctx;
+    memset(&ctx, 0, sizeof(struct bench_ctx));
+
+    const unsigned char LOC_MAC[MAC_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    const unsigned char TAR_MAC[MAC_LEN] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x02};
+    const unsigned char LOC_IP[IP_LEN] = {10, 0, 0, 1};
+    const unsigned char TAR_IP[IP_LEN] = {10, 0, 0, 2};
+
+    memcpy(ctx.loc_mac, LOC_MAC, MAC_LEN);
+    memcpy(ctx.tar_mac, TAR_MAC, MAC_LEN);
+    memcpy(ctx.loc_ip, LOC_IP, IP_LEN);
+    memcpy(ctx.tar_ip, TAR_IP, IP_LEN);
+    ctx.loc_ip_str = "10.0.0.1";
+    ctx.tar_ip_str = "10.0.0.2";
+
+    // Probe, reply from the target and a frame from another host
+    ctx.syn_packet = construct_syn_packet(ctx.loc_ip_str, ctx.tar_ip_str, 
+            ctx.loc_mac, ctx.tar_mac, 5000, 80);
+    ctx.reply_frame = construct_syn_packet(ctx.tar_ip_str, ctx.loc_ip_str, 
+            ctx.tar_mac, ctx.loc_mac, 80, 5000);
+    ctx.other_frame = construct_syn_packet("10.0.0.3", ctx.loc_ip_str, 
+            ctx.tar_mac, ctx.loc_mac, 80, 5000);
+
+    const struct iphdr *iph = (const struct iphdr *)
+            (ctx.syn_packet + sizeof(struct ethhdr));
+    ctx.psh.saddr = iph->saddr;
+    ctx.psh.daddr = iph->daddr;
+    ctx.psh.protocol = IPPROTO_TCP;
+    ctx.psh.tcpseglen = htons(sizeof(struct tcphdr));
+
+    init_udp_probe_builder(&ctx.udp_builder, ctx.loc_ip_str, ctx.tar_ip_str, 
+            ctx.loc_mac, ctx.tar_mac);
+
+    const unsigned char LOC_IP6[IP6_LEN] = {0xfd, 0, 0, 0, 0, 0, 0, 0, 
+            0, 0, 0, 0, 0, 0, 0, 1};
+    const unsigned char TAR_IP6[IP6_LEN] = {0xfd, 0, 0, 0, 0, 0, 0, 0, 
+            0, 0, 0, 0, 0, 0, 0, 2};
+
+    init_syn6_template(&ctx.syn6_tmpl, LOC_IP6, TAR_IP6, ctx.loc_mac, 
+            ctx.tar_mac);
+
+    // Half the banners are real ones, the rest match nothing
+    const char *BANNERS[] = {
+        "SSH-2.0-OpenSSH_9.6p1 Ubuntu-3ubuntu13",
+        "220 mail.example.com ESMTP Postfix (Ubuntu)",
+        "220 (vsFTPd 3.0.5)",
+        "+OK Dovecot (Ubuntu) ready.",
+        "* OK [CAPABILITY IMAP4rev1 SASL-IR LOGIN-REFERRALS] ready.",
+        "RFB 003.008",
+        "@RSYNCD: 31.0",
+        "220 ProFTPD Server (Debian) [::ffff:10.0.0.2]"
+    };
+    const int BANNERS_LEN = sizeof(BANNERS) / sizeof(const char *);
+
+    int fps_len;
+    const struct fingerprint *fps = get_default_fingerprints(&fps_len);
+
+    ctx.fp_matcher = compile_fingerprints(fps, fps_len);
+    srand(1);
+
+    for (int i = 0; i < BENCH_BANNERS; i++) {
+        for (int j = 0; j < BENCH_BANNER_LEN; j++) {
+            ctx.banners[i][j] = 'a' + rand() % 26;
+        }
+
+        if (i % 2 == 0) {
+            const char *banner = BANNERS[(i / 2) % BANNERS_LEN];
+
+            memcpy(ctx.banners[i], banner, strlen(banner));
+        }
+    }
+
+    // Random /16 to /32 prefixes
+    interval_set_init(&ctx.excluded);
+
+    for (int i = 0; i < BENCH_PREFIXES; i++) {
+        unsigned int prefix_len = 16 + rand() % 17;
+        unsigned int mask = ~0U << (32 - prefix_len);
+        unsigned int prefix = ((unsigned int)rand() << 16 ^ rand()) & mask;
+
+        interval_set_add(&ctx.excluded, prefix, prefix | ~mask);
+    }
+
+    interval_set_normalize(&ctx.excluded);
+    ctx.exclusions = prefix_tree_build(&ctx.excluded);
+
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+        const struct interval *iv = 
+                &ctx.excluded.intervals[rand() % ctx.excluded.len];
+
+        ctx.lookups[i] = i % 2 == 0 ? iv->first + rand() % 
+                (iv->last - iv->first + 1) : 
+                ((unsigned int)rand() << 16 ^ rand());
+    }
+
+    int cycle_fd = open_cycle_counter();
+
+    if (cycle_fd < 0) {
+        printf("NOTE: perf events unavailable, cycles/op not measured.\n\n");
+    }
+
+    printf("%-26s %12s %10s %10s %10s\n", "benchmark", "iterations", "ns/op", 
+            "allocs/op", "cycles/op");
+
+    for (int i = 0; i < (int)(sizeof(BENCHES) / sizeof(struct bench)); i++) {
+        if (filter != NULL && strstr(BENCHES[i].name, filter) == NULL) {
+            continue;
+        }
+
+        run_bench(&BENCHES[i], &ctx, cycle_fd);
+    }
+
+    if (cycle_fd >= 0) {
+        close(cycle_fd);
+    }
+
+    free(ctx.syn_packet);
+    free(ctx.reply_frame);
+    free(ctx.other_frame);
+    free_udp_probe_builder(&ctx.udp_builder);
+    free_fingerprints(ctx.fp_matcher);
+    prefix_tree_free(ctx.exclusions);
+    interval_set_free(&ctx.excluded);
+
+    return 0;
+}
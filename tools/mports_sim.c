@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <errno.h>
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+#include <linux/if_tun.h>
+
+#include "../services/sim_service.h"
+#include "../services/histogram_service.h"
+#include "../constants/constants.h"
+
+// Maximum number of frames read before replies are sent
+#define SIM_RX_BATCH 64
+
+static volatile sig_atomic_t stop_sim = 0;
+
+static void handle_stop(int sig) {
+    (void)sig;
+
+    stop_sim = 1;
+}
+
+/*
+ * Function: print_usage
+ * ---------------------
+ * Prints the simulator usage.
+ */
+static void print_usage() {
+    printf("Usage: mports-sim (-dev <interface> | -tap <name>) " 
+            "-host <spec> [-host <spec> ...] [options]\n\n");
+    printf("  -dev <interface>  Answer frames arriving on an interface.\n");
+    printf("  -tap <name>       Create a TAP interface and answer frames on "
+            "it.\n");
+    printf("  -host <spec>      Virtual hosts: an IP, a CIDR block or a range "
+            "a-b,\n");
+    printf("                    or an IPv6 address or prefix such as "
+            "fd00::/64,\n");
+    printf("                    optionally with their own ports as "
+            "spec=22,80.\n");
+    printf("  -open <ports>     Default open ports, e.g. 22,80,8000-8080.\n");
+    printf("  -udp-open <ports> Open UDP ports, closed UDP ports answer with "
+            "ICMP\n");
+    printf("                    port unreachables.\n");
+    printf("  -filtered <ports> TCP ports behind a firewall, SYNs to them "
+            "answer with\n");
+    printf("                    ICMP administratively prohibited.\n");
+    printf("  -rtt <ms>         Round trip time (default 1).\n");
+    printf("  -jitter <ms>      Maximum round trip time variation "
+            "(default 0).\n");
+    printf("  -loss <p>         Probability 0-1 that a frame is lost "
+            "(default 0).\n");
+    printf("  -retrans <n>      SYN-ACK retransmits (default 0).\n");
+    printf("  -icmp-rate <n>    ICMP errors per second per host, like the "
+            "kernel's\n");
+    printf("                    icmp_ratelimit (default 0, unlimited).\n");
+    printf("  -icmp-burst <n>   ICMP errors sent at once before the rate "
+            "applies\n");
+    printf("                    (default 6).\n");
+    printf("  -drop-echo <0|1>  Drop ICMP echo requests, like a firewall "
+            "(default 0).\n");
+    printf("  -seed <n>         Seed for loss and jitter (default 1).\n");
+}
+
+/*
+ * Function: open_device_socket
+ * ----------------------------
+ * Opens a packet socket on an interface in promiscuous mode, so that frames
+ * to the virtual hosts' MAC addresses are received.
+ *
+ * return: The socket, or -1 on error.
+ */
+static int open_device_socket(const char *dev) {
+    int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+
+    if (sock < 0) {
+        perror("ERROR: socket");
+
+        return -1;
+    }
+
+    int if_index = if_nametoindex(dev);
+
+    if (if_index == 0) {
+        fprintf(stderr, "ERROR: Unknown interface %s!\n", dev);
+        close(sock);
+
+        return -1;
+    }
+
+    struct sockaddr_ll addr;
+    memset(&addr, 0, sizeof(struct sockaddr_ll));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(ETH_P_ALL);
+    addr.sll_ifindex = if_index;
+
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(struct sockaddr_ll)) < 0) {
+        perror("ERROR: bind");
+        close(sock);
+
+        return -1;
+    }
+
+    struct packet_mreq mreq;
+    memset(&mreq, 0, sizeof(struct packet_mreq));
+    mreq.mr_ifindex = if_index;
+    mreq.mr_type = PACKET_MR_PROMISC;
+
+    if (setsockopt(sock, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq, 
+            sizeof(struct packet_mreq)) < 0) {
+        perror("ERROR: PACKET_ADD_MEMBERSHIP");
+        close(sock);
+
+        return -1;
+    }
+
+    // Do not receive our own replies
+    int ignore = 1;
+    setsockopt(sock, SOL_PACKET, PACKET_IGNORE_OUTGOING, &ignore, 
+            sizeof(int));
+
+    return sock;
+}
+
+/*
+ * Function: open_tap
+ * ------------------
+ * Creates a TAP interface.
+ *
+ * return: The TAP file descriptor, or -1 on error.
+ */
+static int open_tap(const char *name) {
+    int fd = open("/dev/net/tun", O_RDWR);
+
+    if (fd < 0) {
+        perror("ERROR: /dev/net/tun");
+
+        return -1;
+    }
+
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(struct ifreq));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        perror("ERROR: TUNSETIFF");
+        close(fd);
+
+        return -1;
+    }
+
+    return fd;
+}
+
+static void print_sim_stats(const struct sim_target *sim) {
+    printf("\nFrames in: %lu\n", sim->stats.frames_in);
+    printf("Frames out: %lu\n", sim->stats.frames_out);
+    printf("ARP replies: %lu\n", sim->stats.arp_replies);
+    printf("Neighbor advertisements: %lu\n", sim->stats.neighbor_adverts);
+    printf("Echo replies: %lu\n", sim->stats.echo_replies);
+    printf("SYN-ACKs: %lu\n", sim->stats.syn_acks);
+    printf("RSTs: %lu\n", sim->stats.resets);
+    printf("Banners: %lu\n", sim->stats.banners);
+    printf("UDP replies: %lu\n", sim->stats.udp_replies);
+    printf("Port unreachables: %lu\n", sim->stats.port_unreachables);
+    printf("Administratively prohibited: %lu\n", sim->stats.prohibited);
+    printf("ICMP rate limited: %lu\n", sim->stats.icmp_limited);
+    printf("Lost: %lu\n", sim->stats.lost);
+}
+
+int main(int argc, const char *argv[]) {
+    const char *dev = NULL;
+    const char *tap = NULL;
+
+    // Everything but the device is passed on to the simulator
+    const char **sim_argv = malloc(sizeof(char *) * argc);
+    int sim_argc = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-dev") == 0 && i + 1 < argc) {
+            dev = argv[++i];
+        } else if (strcmp(argv[i], "-tap") == 0 && i + 1 < argc) {
+            tap = argv[++i];
+        } else {
+            sim_argv[sim_argc++] = argv[i];
+        }
+    }
+
+    if ((dev == NULL) == (tap == NULL)) {
+        print_usage();
+        free(sim_argv);
+
+        return -1;
+    }
+
+    struct sim_target *sim = sim_create_from_args(sim_argc, sim_argv);
+
+    free(sim_argv);
+
+    if (sim == NULL) {
+        print_usage();
+
+        return -1;
+    }
+
+    int fd = (dev != NULL) ? open_device_socket(dev) : open_tap(tap);
+
+    if (fd < 0) {
+        sim_free(sim);
+
+        return -1;
+    }
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(struct sigaction));
+    act.sa_handler = handle_stop;
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+
+    printf("Simulating %d host range(s) on %s\n", 
+            sim->hosts_len + sim->hosts6_len, dev != NULL ? dev : tap);
+
+    unsigned char frame[ETH_FRAME_LEN + ETH_FCS_LEN];
+    struct sim_event event;
+
+    while (!stop_sim) {
+        unsigned long long now = get_time_ns();
+        unsigned long long next_due = sim_next_due(sim);
+
+        int timeout_ms = 100;
+
+        if (next_due != 0) {
+            timeout_ms = (next_due <= now) ? 0 : 
+                    (int)((next_due - now + 999999) / 1000000);
+
+            if (timeout_ms > 100) {
+                timeout_ms = 100;
+            }
+        }
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR) {
+            perror("ERROR: poll");
+            break;
+        }
+
+        now = get_time_ns();
+
+        if (pfd.revents & POLLIN) {
+            for (int i = 0; i < SIM_RX_BATCH; i++) {
+                int frame_len = (dev != NULL) ? 
+                        recv(fd, frame, sizeof(frame), MSG_DONTWAIT) :
+                        read(fd, frame, sizeof(frame));
+
+                if (frame_len <= 0) {
+                    break;
+                }
+
+                sim_handle_frame(sim, frame, frame_len, now);
+
+                // The TAP fd is blocking, only read what poll reported
+                if (tap != NULL) {
+                    break;
+                }
+            }
+        }
+
+        while (sim_pop_due(sim, now, &event)) {
+            if (write(fd, event.frame, event.frame_len) < 0) {
+                perror("ERROR: write");
+            }
+        }
+    }
+
+    print_sim_stats(sim);
+
+    close(fd);
+    sim_free(sim);
+
+    return 0;
+}
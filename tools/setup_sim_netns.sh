@@ -0,0 +1,34 @@
+#!/bin/bash
+# Creates a veth pair for scanning the simulator without touching real hosts.
+#
+#   sim0 (host side, given 10.200.0.1/16) <-> sim1 (in netns mports-sim)
+#
+# Usage: sudo tools/setup_sim_netns.sh [up|down]
+#
+# Then run the simulator on the far end and scan through sim0:
+#   sudo ip netns exec mports-sim ./mports-sim -dev sim1 \
+#       -host 10.200.1.0/24 -open 22,80,443
+#   sudo ./mports -ip 10.200.1.5 -dev sim0
+
+NS=mports-sim
+
+if [ "$1" == "down" ]; then
+    ip link del sim0 2> /dev/null
+    ip netns del $NS 2> /dev/null
+    exit 0
+fi
+
+ip netns add $NS || exit 1
+ip link add sim0 type veth peer name sim1 || exit 1
+ip link set sim1 netns $NS
+
+ip addr add 10.200.0.1/16 dev sim0
+ip link set sim0 up
+
+# The simulator answers for the virtual hosts, so sim1 gets no address and the
+# namespace's kernel stays silent
+ip netns exec $NS ip link set lo up
+ip netns exec $NS ip link set sim1 up
+
+# Checksum offload would leave partial checksums on veth frames
+ethtool -K sim0 tx off > /dev/null 2>&1 || true
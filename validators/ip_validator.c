@@ -3,9 +3,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-#include <errno.h>
-
 #include <netinet/in.h>
+#include <arpa/inet.h>
 
 #include "ip_validator.h"
 #include "../services/network_helper.h"
@@ -24,66 +23,20 @@ unsigned char validate_ip_str(const char* ip_str) {
         return 0;
     }
 
-    char *str = malloc(sizeof(char) * 30);
-    memset(str, 0, sizeof(char) * 30);
-    strcpy(str, ip_str);
-
-    const char *delim = ".";
-
-    char *token = strtok(str, delim);
-
-    if (token == NULL) {
-        return 0;
-    }
-
-    int i;
-    for (i = 0; token != NULL; i++) {
-        // If more than 3 digits then not valid
-        if (i >= IP_LEN) {
-            if (DEBUG >= 2) {
-                printf("IP address is too long!\n");
-            }
-
-            return 0;
-        }
-
-        errno = 0;
+    unsigned int ip;
 
-        long int num = strtol(token, NULL, 10);
-
-        // Check no error occurred
-        if (errno != 0) {
-            if (DEBUG >= 2) {
-                printf("Could not parse integer from IP string token!\n");
-            }
-
-            return 0;
-        }
-
-        // First and last digit cannot be 0
-        if ((i == 0 || i == 3) && (num == 0)) {
-            if (DEBUG >= 2) {
-                printf("First and last digit of IP address cannot be 0!\n");
-            }
-
-            return 0;
-        } 
-        
-        if (num < 0 || num > 255) {
-            if (DEBUG >= 2) {
-                printf("IP address is outside of valid range!\n");
-            }
-            
-            return 0;
+    if (parse_ip_str(ip_str, (int)strlen(ip_str), &ip) < 0) {
+        if (DEBUG >= 2) {
+            printf("IP address is not 4 numbers between 0 and 255!\n");
         }
 
-        token = strtok(NULL, delim);
+        return 0;
     }
 
-    // Check that IP address is 4 blocks of numbers
-    if (i != 4) {
+    // First and last digit cannot be 0
+    if ((ip >> 24) == 0 || (ip & 0xFF) == 0) {
         if (DEBUG >= 2) {
-            printf("IP address is not the correct length!\n");
+            printf("First and last digit of IP address cannot be 0!\n");
         }
 
         return 0;
@@ -148,4 +101,34 @@ unsigned char validate_ip_add(struct in_addr* ip_add) {
     unsigned char *temp_ip = get_ip_arr_rep(ip_add);
 
     return validate_ip_arr(temp_ip);
+}
+
+unsigned char validate_ip6_str(const char *ip_str) {
+    if (DEBUG >= 2) {
+        printf("Validating IPv6 address string...\n");
+    }
+
+    struct in6_addr ip_add;
+
+    if (ip_str == NULL || inet_pton(AF_INET6, ip_str, &ip_add) < 1) {
+        if (DEBUG >= 2) {
+            printf("IPv6 address could not be parsed!\n");
+        }
+
+        return 0;
+    }
+
+    if (IN6_IS_ADDR_UNSPECIFIED(&ip_add) || IN6_IS_ADDR_MULTICAST(&ip_add)) {
+        if (DEBUG >= 2) {
+            printf("IPv6 address cannot be unspecified or multicast!\n");
+        }
+
+        return 0;
+    }
+
+    if (DEBUG >= 2) {
+        printf("IPv6 address is valid!\n");
+    }
+
+    return 1;
 }
\ No newline at end of file
@@ -32,4 +32,17 @@ unsigned char validate_ip_arr(const unsigned char *ip_arr);
  * return: A boolean value indicating true(1) on success or false (0) if
  *         validation failed.
  */
-unsigned char validate_ip_add(struct in_addr* ip_add);
\ No newline at end of file
+unsigned char validate_ip_add(struct in_addr* ip_add);
+
+/*
+ * Function: validate_ip6_str
+ * --------------------------
+ * Validates a IPv6 address string.  The unspecified address and multicast
+ * addresses are not valid targets.
+ * 
+ * ip_str: The string representation of an IPv6 address.
+ * 
+ * return: A boolean value indicating true (1) as success or false (0) if 
+ *         validation failed.
+ */
+unsigned char validate_ip6_str(const char *ip_str);
\ No newline at end of file